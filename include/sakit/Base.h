@@ -52,6 +52,8 @@ namespace sakit
 		Base();
 
 		int _sendDirect(hstream* stream, int count);
+		int _sendDirect(const char* data, int count);
+		int64_t _sendFileDirect(chstr filename, int64_t offset, int64_t count);
 		int _receiveDirect(hstream* stream, int maxCount);
 		int _receiveFromDirect(hstream* stream, Host& remoteHost, unsigned short& remotePort);
 
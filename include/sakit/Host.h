@@ -21,6 +21,7 @@
 
 namespace sakit
 {
+	/// @note IP addresses are kept in binary form so comparing them and passing them to sockets doesn't need any string conversion.
 	class sakitExport Host
 	{
 	public:
@@ -28,19 +29,41 @@ namespace sakit
 		Host(const char* domain);
 		Host(chstr domain);
 		Host(unsigned char a, unsigned char b, unsigned char c, unsigned char d);
+		/// @brief Creates a host from a binary address in network byte order.
+		/// @param size 4 for IPv4 and 16 for IPv6. Any other size creates an empty host.
+		Host(const unsigned char* binaryAddress, int size);
 
+		/// @return True if the host is an IPv4 or IPv6 address.
 		bool isIp() const;
+		bool isIpv4() const;
+		bool isIpv6() const;
+		/// @return The address in network byte order or NULL if the host is a domain.
+		const unsigned char* getBinaryAddress() const;
+		/// @return 4 for IPv4, 16 for IPv6 and 0 for a domain.
+		HL_DEFINE_GET(int, binaryAddressSize, BinaryAddressSize);
+		unsigned int getHash() const;
 
+		/// @note Hosts created from a binary address are only formatted when this is called.
 		hstr toString() const;
 
 		bool operator==(const Host& other) const;
 		bool operator!=(const Host& other) const;
+		/// @note Allows using Host as key in an hmap.
+		bool operator<(const Host& other) const;
 
 		static const Host Localhost;
 		static const Host Any;
 
 	protected:
+		/// @note Empty if the host was created from a binary address.
 		hstr address;
+		unsigned char binaryAddress[16];
+		int binaryAddressSize;
+
+		void _set(chstr domain);
+
+		static bool _parseIpv4(const char* data, int size, unsigned char* result);
+		static bool _parseIpv6(const char* data, int size, unsigned char* result);
 
 	};
 
@@ -0,0 +1,120 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a cache for HTTP responses.
+
+#ifndef SAKIT_HTTP_CACHE_H
+#define SAKIT_HTTP_CACHE_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hsbase.h>
+#include <hltypes/hstring.h>
+
+#include "sakitExport.h"
+#include "Url.h"
+
+namespace sakit
+{
+	class HttpResponse;
+	class HttpSocket;
+
+	/// @brief Stores responses to GET requests so they can be reused without downloading them again.
+	/// @note Responses are kept in memory with least-recently-used eviction and optionally on disk. Cache-Control and Expires are honored.
+	/// Stale responses are revalidated with If-None-Match and If-Modified-Since and a 304 response is answered with the cached body.
+	/// @note Can be shared by multiple HttpSocket instances.
+	class sakitExport HttpCache
+	{
+	public:
+		friend class HttpSocket;
+		friend class HttpStaticFileDelegate;
+
+		/// @param diskPath If not empty, responses are also stored in this directory and survive the process.
+		HttpCache(chstr diskPath = "");
+		~HttpCache();
+
+		HL_DEFINE_GET(int64_t, maxMemorySize, MaxMemorySize);
+		/// @note Least recently used responses are removed from memory until their bodies fit into this size.
+		void setMaxMemorySize(int64_t value);
+		HL_DEFINE_GET(hstr, diskPath, DiskPath);
+		void setDiskPath(chstr value);
+		int64_t getMemorySize();
+		int getEntryCount();
+
+		/// @brief Removes all responses from memory and disk.
+		void clear();
+
+		static int64_t DefaultMaxMemorySize;
+
+	protected:
+		class Entry
+		{
+		public:
+			hstr key;
+			/// @note Values of the request headers named by the response's Vary header.
+			hmap<hstr, hstr> varyHeaders;
+			HttpResponse* response;
+			/// @note In seconds since the epoch.
+			int64_t storedTime;
+			int64_t apparentAge;
+			int64_t freshnessLifetime;
+
+			Entry(chstr key, HttpResponse* response);
+			~Entry();
+
+			/// @brief Recalculates the freshness from the response headers.
+			void update();
+			bool isFresh(int64_t now) const;
+			int64_t getSize() const;
+
+		};
+
+		int64_t maxMemorySize;
+		hstr diskPath;
+		/// @note Ordered from least to most recently used.
+		harray<Entry*> entries;
+		int64_t memorySize;
+		hmutex mutex;
+
+		/// @return True if a fresh response was found and copied into response.
+		/// @note If only a stale response was found, validators receives the conditional request headers to revalidate it.
+		bool _lookup(const Url& url, const hmap<hstr, hstr>& requestHeaders, HttpResponse* response, hmap<hstr, hstr>& validators);
+		/// @brief Stores a copy of the response if it may be cached.
+		void _store(const Url& url, const hmap<hstr, hstr>& requestHeaders, HttpResponse* response);
+		/// @brief Refreshes the cached response after a 304 and replaces response with it.
+		/// @return False if the cached response isn't available anymore.
+		bool _revalidate(const Url& url, const hmap<hstr, hstr>& requestHeaders, HttpResponse* response);
+
+		Entry* _find(chstr key, const hmap<hstr, hstr>& requestHeaders);
+		void _add(Entry* entry);
+		void _remove(Entry* entry);
+		void _touch(Entry* entry);
+		void _evict();
+		void _copyResponse(Entry* entry, HttpResponse* response);
+
+		hstr _makeFilename(chstr key);
+		Entry* _loadFromDisk(chstr key);
+		void _saveToDisk(Entry* entry);
+
+		static bool _isCacheable(HttpResponse* response);
+		static hmap<hstr, hstr> _makeVaryHeaders(HttpResponse* response, const hmap<hstr, hstr>& requestHeaders);
+		static bool _hasDirective(chstr cacheControl, chstr directive);
+		static int64_t _findDirectiveValue(chstr cacheControl, chstr directive);
+		static int64_t _parseHttpDate(chstr value);
+
+	private:
+		HttpCache(const HttpCache& other); // prevents copying
+
+	};
+
+}
+#endif
@@ -0,0 +1,83 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a client that executes many HTTP requests concurrently over pooled connections.
+
+#ifndef SAKIT_HTTP_CLIENT_H
+#define SAKIT_HTTP_CLIENT_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hstring.h>
+
+#include "Base.h"
+#include "HttpRequest.h"
+#include "sakitExport.h"
+
+namespace sakit
+{
+	class HttpClientThread;
+	class HttpSocketDelegate;
+
+	/// @brief Executes queued HTTP requests on a small number of threads.
+	/// @note The HttpSocket passed to the delegate is the pooled connection that executed the request. It must not be used or deleted by the delegate.
+	class sakitExport HttpClient : public Base
+	{
+	public:
+		friend class HttpClientThread;
+
+		HttpClient(HttpSocketDelegate* socketDelegate, int threadCount = 1);
+		~HttpClient();
+
+		HL_DEFINE_ISSET(keepAlive, KeepAlive);
+		HL_DEFINE_ISSET(reportProgress, ReportProgress);
+		/// @note Requires sakit to be built with _ZLIB.
+		HL_DEFINE_ISSET(contentDecoding, ContentDecoding);
+		HL_DEFINE_GET(int, maxConnections, MaxConnections);
+		void setMaxConnections(int value);
+		HL_DEFINE_GET(int, maxHostConnections, MaxHostConnections);
+		void setMaxHostConnections(int value);
+		int getQueuedCount();
+		int getExecutingCount();
+
+		void update(float timeDelta = 0.0f);
+
+		/// @brief Queues a copy of the request for execution.
+		bool executeAsync(const HttpRequest& request);
+		/// @brief Removes all requests that have not started executing yet.
+		void clearQueue();
+
+		static int DefaultMaxConnections;
+		static int DefaultMaxHostConnections;
+
+	protected:
+		HttpSocketDelegate* socketDelegate;
+		bool keepAlive;
+		bool reportProgress;
+		bool contentDecoding;
+		int maxConnections;
+		int maxHostConnections;
+		harray<HttpClientThread*> threads;
+		/// @note Everything below is protected by mutexQueue.
+		harray<HttpRequest*> queuedRequests;
+		hmap<hstr, int> hostConnections;
+		int connectionCount;
+		int executingCount;
+		hmutex mutexQueue;
+
+	private:
+		HttpClient(const HttpClient& other); // prevents copying
+
+	};
+
+}
+#endif
@@ -0,0 +1,122 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a download that fetches segments of a resource over multiple connections.
+
+#ifndef SAKIT_HTTP_DOWNLOAD_H
+#define SAKIT_HTTP_DOWNLOAD_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hsbase.h>
+#include <hltypes/hstring.h>
+
+#include "Base.h"
+#include "sakitExport.h"
+#include "Url.h"
+
+namespace sakit
+{
+	class HttpDownloadDelegate;
+	class HttpDownloadThread;
+
+	/// @brief Downloads a resource over multiple connections at once using HTTP Range requests.
+	/// @note The size and range support are determined with a HEAD request first. If the server doesn't support ranges, the resource is downloaded with a single request.
+	/// @note Each segment is written to its offset in the destination piece by piece while it's being received. A failed segment is requested again without affecting the others.
+	class sakitExport HttpDownload : public Base
+	{
+	public:
+		friend class HttpDownloadThread;
+
+		HttpDownload(HttpDownloadDelegate* downloadDelegate);
+		~HttpDownload();
+
+		HL_DEFINE_GET(int, connectionCount, ConnectionCount);
+		/// @note Has to be set while not executing.
+		void setConnectionCount(int value);
+		/// @note Resources that would be split into smaller segments than this use fewer connections.
+		HL_DEFINE_GETSET(int64_t, minSegmentSize, MinSegmentSize);
+		/// @note Limits how much of the resource is requested at once per connection.
+		HL_DEFINE_GETSET(int64_t, maxSegmentSize, MaxSegmentSize);
+		/// @note How many times a failed segment is requested again before the whole download fails.
+		HL_DEFINE_GETSET(int, maxRetries, MaxRetries);
+		bool isExecuting();
+		int64_t getDownloadedSize();
+		/// @return The size of the resource or -1 if it isn't known (yet).
+		int64_t getTotalSize();
+
+		void update(float timeDelta = 0.0f);
+
+		/// @note destination has to support seeking and has to stay valid until the download has finished.
+		bool execute(Url url, hsbase* destination, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		/// @note destination has to support seeking and has to stay valid until the download has finished.
+		bool executeAsync(Url url, hsbase* destination, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+
+		static int DefaultConnectionCount;
+		static int64_t DefaultMinSegmentSize;
+		static int64_t DefaultMaxSegmentSize;
+		static int DefaultMaxRetries;
+
+	protected:
+		class Segment
+		{
+		public:
+			int64_t offset;
+			/// @note -1 if the whole resource is requested without a known size.
+			int64_t size;
+			int attempts;
+
+			Segment(int64_t offset = 0LL, int64_t size = -1LL);
+
+		};
+
+		HttpDownloadDelegate* downloadDelegate;
+		int connectionCount;
+		int64_t minSegmentSize;
+		int64_t maxSegmentSize;
+		int maxRetries;
+		Url url;
+		hsbase* destination;
+		hmap<hstr, hstr> customHeaders;
+		/// @note Sent with every segment request. Contains Range related headers when ranged is true.
+		hmap<hstr, hstr> segmentHeaders;
+		bool ranged;
+		harray<HttpDownloadThread*> threads;
+		HttpDownloadThread* thread;
+		/// @note Everything below is protected by mutexSegments.
+		harray<Segment> queuedSegments;
+		int activeSegments;
+		int64_t downloadedSize;
+		int64_t totalSize;
+		bool failed;
+		hmutex mutexSegments;
+		/// @note Protects destination while segments are written.
+		hmutex mutexDestination;
+
+		bool _canExecute();
+		bool _start(Url& url, hsbase* destination, const hmap<hstr, hstr>& customHeaders);
+		void _createThreads();
+		void _destroyThreads();
+
+		bool _execute();
+		bool _prepare();
+		bool _allocateDestination(int64_t size);
+		bool _takeSegment(Segment& segment);
+		void _finishSegment(Segment& segment, bool success, int64_t size);
+
+	private:
+		HttpDownload(const HttpDownload& other); // prevents copying
+
+	};
+
+}
+#endif
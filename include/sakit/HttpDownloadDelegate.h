@@ -0,0 +1,35 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a HTTP download delegate.
+
+#ifndef SAKIT_HTTP_DOWNLOAD_DELEGATE_H
+#define SAKIT_HTTP_DOWNLOAD_DELEGATE_H
+
+#include "sakitExport.h"
+#include "Url.h"
+
+namespace sakit
+{
+	class HttpDownload;
+
+	class sakitExport HttpDownloadDelegate
+	{
+	public:
+		HttpDownloadDelegate();
+		virtual ~HttpDownloadDelegate();
+
+		virtual void onDownloadCompleted(HttpDownload* download, Url url);
+		virtual void onDownloadFailed(HttpDownload* download, Url url);
+
+	};
+
+}
+#endif
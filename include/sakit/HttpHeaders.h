@@ -0,0 +1,76 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a flat table of HTTP header fields with case-insensitive names.
+
+#ifndef SAKIT_HTTP_HEADERS_H
+#define SAKIT_HTTP_HEADERS_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hstring.h>
+
+#include "sakitExport.h"
+
+namespace sakit
+{
+	/// @brief Stores header fields in one contiguous buffer so parsing a response doesn't allocate per field.
+	/// @note Names are compared case-insensitively. Well-known names are interned to small ids so they are compared as integers.
+	/// @note Fields are copied once into the buffer instead of referencing the received data, since a response's raw stream can be reallocated
+	/// or replaced while the headers are still in use, e.g. in a cached response.
+	class sakitExport HttpHeaders
+	{
+	public:
+		HttpHeaders();
+
+		int size() const;
+		bool hasKey(chstr name) const;
+		/// @note If a field appears multiple times, the last value is returned.
+		hstr tryGet(chstr name, chstr defaultValue) const;
+		hstr operator[](chstr name) const;
+		/// @brief Replaces all fields with this name.
+		void set(chstr name, chstr value);
+		/// @brief Adds a field without replacing existing ones with the same name.
+		void add(const char* name, int nameLength, const char* value, int valueLength);
+		bool remove(chstr name);
+		void clear();
+		harray<hstr> keys() const;
+		/// @note In the same order as keys().
+		harray<hstr> values() const;
+		hmap<hstr, hstr> toMap() const;
+
+		/// @return The interned id of a well-known header name or -1.
+		static int findId(const char* name, int length);
+
+	protected:
+		class Entry
+		{
+		public:
+			int id;
+			int name;
+			int nameLength;
+			int value;
+			int valueLength;
+
+			Entry(int id = -1, int name = 0, int nameLength = 0, int value = 0, int valueLength = 0);
+
+		};
+
+		harray<Entry> entries;
+		/// @note Names and values are offsets into this buffer.
+		hstr data;
+
+		int _indexOf(const char* name, int length, int id) const;
+
+	};
+
+}
+#endif
@@ -0,0 +1,137 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a client that retries and hedges HTTP requests.
+
+#ifndef SAKIT_HTTP_POLICY_CLIENT_H
+#define SAKIT_HTTP_POLICY_CLIENT_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hstring.h>
+
+#include "Base.h"
+#include "HttpRequest.h"
+#include "HttpSocketDelegate.h"
+#include "sakitExport.h"
+
+namespace sakit
+{
+	class HttpResponse;
+	class HttpSocket;
+
+	/// @brief Executes HTTP requests asynchronously and hides slow or failing attempts.
+	/// @note Idempotent requests that fail to connect or time out are retried after an exponential backoff with random jitter.
+	/// @note If hedging is enabled, a second attempt of an idempotent request is started once the first one takes longer than the
+	/// hedge percentile of recently measured latencies. The first attempt to finish is reported and the other one is aborted.
+	/// @note The HttpSocket passed to the delegate is the one that executed the winning attempt. It must not be used or deleted by the delegate.
+	class sakitExport HttpPolicyClient : public Base
+	{
+	public:
+		HttpPolicyClient(HttpSocketDelegate* socketDelegate);
+		~HttpPolicyClient();
+
+		HL_DEFINE_GET(int, maxRetries, MaxRetries);
+		void setMaxRetries(int value);
+		/// @note In seconds. The backoff before retry n is a random value between 0 and retryBaseDelay * 2^n.
+		HL_DEFINE_GETSET(float, retryBaseDelay, RetryBaseDelay);
+		/// @note In seconds.
+		HL_DEFINE_GETSET(float, retryMaxDelay, RetryMaxDelay);
+		HL_DEFINE_ISSET(hedging, Hedging);
+		/// @note Between 0 and 1.
+		HL_DEFINE_GET(float, hedgePercentile, HedgePercentile);
+		void setHedgePercentile(float value);
+		/// @note In seconds. Used until enough latencies have been measured.
+		HL_DEFINE_GETSET(float, hedgeDelay, HedgeDelay);
+		/// @return The delay in seconds after which a hedged attempt would currently be started.
+		float getCurrentHedgeDelay();
+		int getExecutingCount();
+
+		void update(float timeDelta = 0.0f);
+
+		/// @brief Starts executing a copy of the request.
+		bool executeAsync(const HttpRequest& request);
+
+		static int DefaultMaxRetries;
+		static float DefaultRetryBaseDelay;
+		static float DefaultRetryMaxDelay;
+		static float DefaultHedgePercentile;
+		static float DefaultHedgeDelay;
+
+	protected:
+		/// @brief Receives the results of the attempts and passes them on to the client.
+		class AttemptDelegate : public HttpSocketDelegate
+		{
+		public:
+			AttemptDelegate(HttpPolicyClient* client);
+
+			void onExecuteCompleted(HttpSocket* socket, HttpResponse* response, Url url);
+			void onExecuteFailed(HttpSocket* socket, HttpResponse* response, Url url);
+
+		protected:
+			HttpPolicyClient* client;
+
+		};
+
+		class Operation
+		{
+		public:
+			HttpRequest* request;
+			bool idempotent;
+			/// @note The sockets of attempts that are currently executing.
+			harray<HttpSocket*> sockets;
+			/// @note When each of the sockets started executing, in milliseconds.
+			harray<int64_t> startTimes;
+			int retries;
+			/// @note -1 if nothing is scheduled.
+			int64_t retryTime;
+			int64_t hedgeTime;
+
+			Operation(HttpRequest* request);
+			~Operation();
+
+		};
+
+		HttpSocketDelegate* socketDelegate;
+		AttemptDelegate attemptDelegate;
+		int maxRetries;
+		float retryBaseDelay;
+		float retryMaxDelay;
+		bool hedging;
+		float hedgePercentile;
+		float hedgeDelay;
+		/// @note Everything below is protected by mutexOperations.
+		harray<Operation*> operations;
+		harray<HttpSocket*> idleSockets;
+		/// @note Sockets that were aborted or belong to a finished operation, but haven't reported their result yet.
+		harray<HttpSocket*> drainingSockets;
+		/// @note Latencies of successful attempts in seconds, oldest first.
+		harray<float> latencies;
+		hmutex mutexOperations;
+
+		Operation* _findOperation(HttpSocket* socket);
+		HttpSocket* _acquireSocket();
+		bool _startAttempt(Operation* operation);
+		float _calculateBackoff(int retry);
+		float _calculateHedgeDelay();
+
+		void _onAttemptCompleted(HttpSocket* socket, HttpResponse* response, Url url);
+		void _onAttemptFailed(HttpSocket* socket, HttpResponse* response, Url url);
+
+		static bool _isIdempotent(chstr method);
+
+	private:
+		HttpPolicyClient(const HttpPolicyClient& other); // prevents copying
+
+	};
+
+}
+#endif
@@ -0,0 +1,50 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines an HTTP request that can be queued for execution.
+
+#ifndef SAKIT_HTTP_REQUEST_H
+#define SAKIT_HTTP_REQUEST_H
+
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hstring.h>
+
+#include "sakitExport.h"
+#include "Url.h"
+
+#define SAKIT_HTTP_REQUEST_METHOD_OPTIONS "OPTIONS"
+#define SAKIT_HTTP_REQUEST_METHOD_GET "GET"
+#define SAKIT_HTTP_REQUEST_METHOD_HEAD "HEAD"
+#define SAKIT_HTTP_REQUEST_METHOD_POST "POST"
+#define SAKIT_HTTP_REQUEST_METHOD_PUT "PUT"
+#define SAKIT_HTTP_REQUEST_METHOD_DELETE "DELETE"
+#define SAKIT_HTTP_REQUEST_METHOD_TRACE "TRACE"
+#define SAKIT_HTTP_REQUEST_METHOD_CONNECT "CONNECT"
+
+namespace sakit
+{
+	class sakitExport HttpRequest
+	{
+	public:
+		hstr method;
+		Url url;
+		hstr body;
+		hmap<hstr, hstr> headers;
+
+		HttpRequest();
+		HttpRequest(chstr method, Url url, chstr body = "", hmap<hstr, hstr> headers = hmap<hstr, hstr>());
+
+		HttpRequest* clone() const;
+
+	};
+
+}
+#endif
@@ -16,9 +16,13 @@
 #include <hltypes/henum.h>
 #include <hltypes/hltypesUtil.h>
 #include <hltypes/hmap.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hsbase.h>
 #include <hltypes/hstream.h>
 #include <hltypes/hstring.h>
 
+#include "HttpHeaders.h"
+#include "HttpTiming.h"
 #include "sakitExport.h"
 
 #define SAKIT_HTTP_RESPONSE_HEADER_ACCESS_CONTROL_ALLOW_ORIGIN "Access-Control-Allow-Origin"
@@ -116,13 +120,41 @@ namespace sakit
 		hstr protocol;
 		Code statusCode;
 		hstr statusMessage;
-		hmap<hstr, hstr> headers;
+		HttpHeaders headers;
 		hstream body;
 		hstream raw;
 		bool headersComplete;
 		bool bodyComplete;
+		/// @note Set if the body couldn't be decoded. The response ends there and is reported as failed so a truncated body isn't mistaken for a complete one.
+		bool bodyFailed;
+		/// @note Set to false for responses that never carry a body (e.g. to a HEAD request) so the body isn't parsed.
+		bool bodyExpected;
+		/// @note If true, a body with a gzip or deflate Content-Encoding is decoded while it's being received. Requires sakit to be built with _ZLIB.
+		bool decodeContent;
+		/// @note Decoded from the headers once they are complete. -1 if there is no Content-Length.
+		int64_t contentLength;
+		/// @note Decoded from the headers once they are complete.
+		bool chunked;
+		/// @note Decoded from the headers once they are complete.
+		bool connectionClose;
+		/// @note Filled in once the response is complete.
+		HttpTiming timing;
+		/// @brief If set, the body of a successful (2xx) response is written there while it's being received instead of being kept in body.
+		/// @note The received data isn't kept either so the memory usage doesn't depend on the size of the body. Not reset by clear().
+		hsbase* bodyDestination;
+		/// @note Locked while writing to bodyDestination if set, e.g. when multiple responses write into the same destination.
+		hmutex* bodyDestinationMutex;
+		/// @note Where the next part of the body is written to in bodyDestination. Advanced by every written part.
+		int64_t bodyDestinationOffset;
+		/// @note The body fails if it would be written beyond this offset. -1 if there is no limit.
+		int64_t bodyDestinationEnd;
+
+		/// @brief Bodies with a Content-Length up to this size have their buffer allocated once when the headers are complete.
+		/// @note Larger bodies grow their buffer while being received so a bogus Content-Length can't allocate huge amounts of memory.
+		static int64_t MaxReservedBodySize;
 
 		HttpResponse();
+		~HttpResponse();
 
 		void clear();
 		void parseFromRaw();
@@ -132,13 +164,30 @@ namespace sakit
 		HttpResponse* clone() const;
 
 	protected:
-		int chunkSize;
-		int chunkRead;
+		int64_t chunkSize;
+		int64_t chunkRead;
+		bool chunkTrailers;
+		bool chunkDelimiterPending;
 		int newDataSize;
+		hstr contentEncoding;
+		void* decoder;
+		bool decoderFinished;
 
-		void _getRawData(hstr& data, int& size);
 		void _readHeaders();
+		void _readStatusLine(const char* data, int size);
+		void _decodeHeaders();
+		void _reserveBody();
 		void _readBody();
+		int _writeBody(int count);
+		void _writeBodyDestination();
+
+		bool _createDecoder();
+		void _destroyDecoder();
+		/// @brief Ends the response since the rest of the body can't be used anymore.
+		void _failBody();
+
+	private:
+		HttpResponse(const HttpResponse& other); // prevents copying
 
 	};
 
@@ -0,0 +1,177 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines an HTTP/1.1 server.
+
+#ifndef SAKIT_HTTP_SERVER_H
+#define SAKIT_HTTP_SERVER_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hstream.h>
+#include <hltypes/hstring.h>
+
+#include "HttpResponse.h"
+#include "sakitExport.h"
+#include "TcpServer.h"
+#include "TcpSocketDelegate.h"
+
+#define SAKIT_HTTP_SERVER_ANY_METHOD ""
+
+namespace sakit
+{
+	class HttpServerDelegate;
+	class HttpServerRequest;
+	class HttpServerResponse;
+	class TcpSocket;
+
+	/// @brief Serves HTTP/1.1 requests on accepted TCP connections.
+	/// @note Connections are kept alive and pipelined requests are answered in order. Requests are dispatched to delegates by routes.
+	/// @note Requests are handled on the thread that calls update().
+	class sakitExport HttpServer : public TcpServer
+	{
+	public:
+		friend class HttpServerResponse;
+
+		HttpServer(HttpServerDelegate* serverDelegate);
+		~HttpServer();
+
+		HL_DEFINE_ISSET(keepAlive, KeepAlive);
+		/// @note In seconds. Idle connections are closed after this time.
+		HL_DEFINE_GETSET(float, keepAliveTimeout, KeepAliveTimeout);
+		/// @note The largest amount of unprocessed data a connection can hold, which limits the size of a request including its body.
+		HL_DEFINE_GETSET(int, maxBufferSize, MaxBufferSize);
+		int getConnectionCount();
+
+		void update(float timeDelta = 0.0f);
+
+		/// @brief Dispatches requests to a delegate.
+		/// @param method The request method or SAKIT_HTTP_SERVER_ANY_METHOD.
+		/// @param path An exact path or a prefix ending with "*", e.g. "/admin/*". The longest matching prefix is used.
+		void addRoute(chstr method, chstr path, HttpServerDelegate* delegate);
+		bool removeRoute(chstr method, chstr path);
+		void clearRoutes();
+
+		static float DefaultKeepAliveTimeout;
+		static int DefaultMaxBufferSize;
+
+	protected:
+		/// @brief Receives the data of all accepted connections and passes it on to the server.
+		class ConnectionDelegate : public TcpSocketDelegate
+		{
+		public:
+			ConnectionDelegate(HttpServer* server);
+
+			void onReceived(TcpSocket* socket, hstream* stream);
+			void onReceiveFailed(TcpSocket* socket);
+
+		protected:
+			HttpServer* server;
+
+		};
+
+		class Connection
+		{
+		public:
+			TcpSocket* socket;
+			/// @note Received data starting at position hasn't been processed yet.
+			hstr buffer;
+			int position;
+			/// @note A chunked response that is still being sent. Requests that come after it wait until it's finished.
+			HttpServerResponse* openResponse;
+			bool closing;
+			/// @note Set once openResponse has been finished so the waiting requests are processed in the next update().
+			bool resume;
+			bool continueSent;
+			int64_t lastActivity;
+			/// @note The file of a response that is still being sent. Requests that come after it wait until it's finished.
+			hstr sendFilename;
+			int64_t sendFileOffset;
+			/// @note How much of the file is left to send.
+			int64_t sendFileSize;
+			/// @note Set if the connection has to be closed once the file has been sent.
+			bool sendFileClose;
+			/// @note Data after position up to this offset has already been searched for the end of the request head.
+			int headScanPosition;
+			/// @note A request whose head has been parsed while its body is still being received.
+			HttpServerRequest* request;
+			/// @note Offset of the body of request after position.
+			int bodyStart;
+			/// @note Content-Length of request or -1 if its body is chunked.
+			int64_t bodyLength;
+			/// @note Offset after bodyStart up to which the chunked body has already been decoded into request.
+			int chunkedPosition;
+			/// @note Set once the last chunk has been decoded and only the trailers are left.
+			bool chunkedTrailers;
+
+			Connection(TcpSocket* socket);
+			~Connection();
+
+		};
+
+		class Route
+		{
+		public:
+			hstr method;
+			hstr path;
+			bool prefix;
+			HttpServerDelegate* delegate;
+
+			Route(chstr method = "", chstr path = "", HttpServerDelegate* delegate = NULL);
+
+		};
+
+		HttpServerDelegate* httpServerDelegate;
+		ConnectionDelegate connectionDelegate;
+		bool keepAlive;
+		float keepAliveTimeout;
+		int maxBufferSize;
+		harray<Connection*> httpConnections;
+		harray<Route> routes;
+		/// @note Chunked responses whose connection was closed before they were finished.
+		harray<HttpServerResponse*> orphanedResponses;
+		harray<HttpServerResponse*> finishedResponses;
+
+		void _onAccepted(TcpSocket* socket);
+		void _onReceived(TcpSocket* socket, hstream* stream);
+		void _onReceiveFailed(TcpSocket* socket);
+
+		Connection* _findConnection(TcpSocket* socket);
+		Connection* _findConnection(HttpServerResponse* response);
+		void _removeClosedConnections();
+		void _processRequests(Connection* connection);
+		/// @return 1 if connection->request is complete, 0 if more data is needed or -1 if the connection was closed because of an invalid request.
+		/// @note Parsing continues where it stopped the last time so data isn't searched or decoded again while a request is being received.
+		int _parseRequest(Connection* connection);
+		int _parseHead(Connection* connection);
+		void _dispatch(Connection* connection, HttpServerRequest& request);
+		HttpServerDelegate* _findDelegate(HttpServerRequest& request, harray<hstr>& allowedMethods);
+		void _respondError(Connection* connection, HttpResponse::Code statusCode);
+		bool _send(Connection* connection, chstr data);
+		void _sendHead(Connection* connection, HttpServerResponse* response, int64_t contentLength);
+		bool _sendChunk(HttpServerResponse* response, chstr data);
+		void _finishResponse(HttpServerResponse* response);
+		/// @brief Sends as much of the connection's file as its socket can take right now.
+		/// @return True if the whole file has been sent.
+		bool _sendFilePiece(Connection* connection);
+		void _closeConnection(Connection* connection);
+
+		/// @brief Appends the chunks from data after position to body and advances position past them.
+		/// @return 1 if the body is complete, 0 if more data is needed or -1 if it's invalid.
+		static int _decodeChunkedBody(const char* data, int size, int& position, bool& trailers, hstr& body);
+		static hstr _makeStatusLine(HttpResponse::Code statusCode);
+
+	private:
+		HttpServer(const HttpServer& other); // prevents copying
+
+	};
+
+}
+#endif
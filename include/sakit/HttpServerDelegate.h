@@ -0,0 +1,38 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a delegate for the HTTP server callbacks.
+
+#ifndef SAKIT_HTTP_SERVER_DELEGATE_H
+#define SAKIT_HTTP_SERVER_DELEGATE_H
+
+#include "sakitExport.h"
+#include "TcpServerDelegate.h"
+
+namespace sakit
+{
+	class HttpServer;
+	class HttpServerRequest;
+	class HttpServerResponse;
+
+	class sakitExport HttpServerDelegate : public TcpServerDelegate
+	{
+	public:
+		HttpServerDelegate();
+
+		/// @brief Fills in the response to a request.
+		/// @note Called for requests that matched a route of this delegate. The server's own delegate receives all requests that didn't match any route.
+		/// @note By default responds with 404 Not Found.
+		virtual void onRequest(HttpServer* server, HttpServerRequest* request, HttpServerResponse* response);
+
+	};
+
+}
+#endif
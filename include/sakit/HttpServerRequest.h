@@ -0,0 +1,48 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines an HTTP request received by an HttpServer.
+
+#ifndef SAKIT_HTTP_SERVER_REQUEST_H
+#define SAKIT_HTTP_SERVER_REQUEST_H
+
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hstring.h>
+
+#include "Host.h"
+#include "HttpHeaders.h"
+#include "sakitExport.h"
+#include "Url.h"
+
+namespace sakit
+{
+	class sakitExport HttpServerRequest
+	{
+	public:
+		hstr method;
+		/// @note The request target as it was sent, e.g. "/status?verbose=1".
+		hstr target;
+		/// @note The target without the query.
+		hstr path;
+		/// @note Built from the Host header and the target. Only valid if the client sent a Host header.
+		Url url;
+		hstr protocol;
+		HttpHeaders headers;
+		/// @note Already decoded if it was sent with chunked transfer encoding.
+		hstr body;
+		Host remoteHost;
+		unsigned short remotePort;
+
+		HttpServerRequest();
+
+	};
+
+}
+#endif
@@ -0,0 +1,81 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines an HTTP response sent by an HttpServer.
+
+#ifndef SAKIT_HTTP_SERVER_RESPONSE_H
+#define SAKIT_HTTP_SERVER_RESPONSE_H
+
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hstream.h>
+#include <hltypes/hstring.h>
+
+#include "HttpHeaders.h"
+#include "HttpResponse.h"
+#include "sakitExport.h"
+
+namespace sakit
+{
+	class HttpServer;
+
+	/// @note Created by the server for every request and passed to the handling delegate. The server sends it once the delegate returns.
+	class sakitExport HttpServerResponse
+	{
+	public:
+		friend class HttpServer;
+
+		HttpResponse::Code statusCode;
+		/// @note Content-Length, Transfer-Encoding and Connection are set by the server.
+		HttpHeaders headers;
+		hstream body;
+		/// @note If true, the response is sent with chunked transfer encoding and stays open after the delegate returns until finish() is called.
+		/// Pipelined requests on the same connection are processed only after that.
+		bool chunked;
+
+		HL_DEFINE_IS(finished, Finished);
+
+		/// @brief Uses a part of a file as the body instead of the body stream.
+		/// @note The file is sent straight from the file system with TcpSocket::sendFileNonBlocking(), piece by piece in HttpServer::update()
+		/// whenever the connection can take more data. Ignored for chunked responses.
+		void setBodyFile(chstr filename, int64_t offset, int64_t size);
+		/// @brief Uses memory as the body instead of the body stream without copying it.
+		/// @note The data has to stay valid until the delegate call returns. Ignored for chunked responses.
+		void setBodyData(const char* data, int size);
+
+		/// @brief Sends a piece of a chunked response right away. Anything written to body before is sent first.
+		/// @return False if the response isn't chunked or the connection has been closed.
+		/// @note Has to be called on the same thread as HttpServer::update().
+		bool sendChunk(chstr data);
+		/// @brief Ends a chunked response. The response must not be used afterwards since the server deletes it.
+		/// @note Has to be called on the same thread as HttpServer::update().
+		void finish();
+
+	protected:
+		HttpServer* server;
+		bool finished;
+		bool headSent;
+		bool headRequest;
+		bool connectionClose;
+		hstr bodyFilename;
+		int64_t bodyFileOffset;
+		int64_t bodyFileSize;
+		const char* bodyData;
+		int bodyDataSize;
+
+		HttpServerResponse(HttpServer* server, bool headRequest, bool connectionClose);
+		~HttpServerResponse();
+
+	private:
+		HttpServerResponse(const HttpServerResponse& other); // prevents copying
+
+	};
+
+}
+#endif
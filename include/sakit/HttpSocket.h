@@ -13,9 +13,13 @@
 #ifndef SAKIT_HTTP_SOCKET_H
 #define SAKIT_HTTP_SOCKET_H
 
+#include <hltypes/harray.h>
 #include <hltypes/henum.h>
 #include <hltypes/hltypesUtil.h>
 #include <hltypes/hmap.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hsbase.h>
+#include <hltypes/hstream.h>
 #include <hltypes/hstring.h>
 
 #include "sakitExport.h"
@@ -53,6 +57,7 @@
 #define SAKIT_HTTP_REQUEST_HEADER_RANGE "Range"
 #define SAKIT_HTTP_REQUEST_HEADER_REFERER "Referer"
 #define SAKIT_HTTP_REQUEST_HEADER_TE "TE"
+#define SAKIT_HTTP_REQUEST_HEADER_TRANSFER_ENCODING "Transfer-Encoding"
 #define SAKIT_HTTP_REQUEST_HEADER_USER_AGENT "User-Agent"
 #define SAKIT_HTTP_REQUEST_HEADER_UPGRADE "Upgrade"
 #define SAKIT_HTTP_REQUEST_HEADER_VIA "Via"
@@ -60,6 +65,9 @@
 
 namespace sakit
 {
+	class HpackField;
+	class HttpCache;
+	class HttpPhaseTimer;
 	class HttpResponse;
 	class HttpSocketDelegate;
 	class HttpSocketThread;
@@ -69,9 +77,16 @@ namespace sakit
 	class sakitExport HttpSocket : public SocketBase
 	{
 	public:
+		friend class HttpClient;
+		friend class HttpClientThread;
+		friend class HttpPolicyClient;
+
 		HL_ENUM_CLASS_PREFIX_DECLARE(sakitExport, Protocol,
 		(
 			HL_ENUM_DECLARE(Protocol, Http11);
+			/// @note HTTP/2 over plain TCP with prior knowledge (h2c). Async requests to the same host are multiplexed as concurrent streams on a
+			/// single connection, keepAlive and pipelining aren't required. Synchronous requests still use HTTP/1.1 and async requests with a streamed body aren't supported.
+			HL_ENUM_DECLARE(Protocol, Http20);
 		));
 
 		HttpSocket(HttpSocketDelegate* socketDelegate, Protocol protocol = Protocol::Http11);
@@ -79,7 +94,19 @@ namespace sakit
 
 		HL_DEFINE_ISSET(keepAlive, KeepAlive);
 		HL_DEFINE_ISSET(reportProgress, ReportProgress);
+		/// @note Only async requests are pipelined and keepAlive has to be enabled. Has to be set while not executing.
+		/// @note If the connection is lost, only unanswered GET, HEAD, OPTIONS and TRACE requests are sent again, all others fail.
+		HL_DEFINE_ISSET(pipelining, Pipelining);
+		/// @note Requests gzip and deflate encoded bodies and decodes them while receiving. Requires sakit to be built with _ZLIB.
+		HL_DEFINE_ISSET(contentDecoding, ContentDecoding);
+		/// @note If enabled, an async GET request without a body that is identical to one already executing on another coalescing socket
+		/// doesn't go to the network. It waits for that request and its delegate receives the same response object.
+		/// @note The shared response must not be modified by the delegate. Progress is only reported to the socket that actually executes the request.
+		HL_DEFINE_ISSET(coalescing, Coalescing);
 		HL_DEFINE_GETSET(Protocol, protocol, Protocol);
+		/// @note Only GET requests without a body are cached. Pipelined requests are not cached. The cache is not owned by the socket.
+		HL_DEFINE_GET(HttpCache*, cache, Cache);
+		inline void setCache(HttpCache* value) { this->cache = value; }
 		HL_DEFINE_SET(unsigned short, remotePort, RemotePort);
 		/// @note This is due to keepAlive which has to be set beforehand
 		bool isConnected();
@@ -87,76 +114,155 @@ namespace sakit
 
 		void update(float timeDelta = 0.0f);
 
-		bool executeOptions(HttpResponse* response, Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeGet(HttpResponse* response, Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeHead(HttpResponse* response, Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executePost(HttpResponse* response, Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executePut(HttpResponse* response, Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeDelete(HttpResponse* response, Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeTrace(HttpResponse* response, Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeConnect(HttpResponse* response, Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-
-		bool executeOptionsAsync(Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeGetAsync(Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeHeadAsync(Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executePostAsync(Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executePutAsync(Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeDeleteAsync(Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeTraceAsync(Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeConnectAsync(Url url, chstr customBody = "", hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
+		bool executeOptions(HttpResponse* response, Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeGet(HttpResponse* response, Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeHead(HttpResponse* response, Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executePost(HttpResponse* response, Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executePut(HttpResponse* response, Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeDelete(HttpResponse* response, Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeTrace(HttpResponse* response, Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeConnect(HttpResponse* response, Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+
+		bool executeOptionsAsync(Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeGetAsync(Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeHeadAsync(Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executePostAsync(Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executePutAsync(Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeDeleteAsync(Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeTraceAsync(Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeConnectAsync(Url url, chstr customBody = "", const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
 
 		// these are used when a persistent connection is available
-		bool executeOptions(HttpResponse* response, chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeGet(HttpResponse* response, chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeHead(HttpResponse* response, chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executePost(HttpResponse* response, chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executePut(HttpResponse* response, chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeDelete(HttpResponse* response, chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeTrace(HttpResponse* response, chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeConnect(HttpResponse* response, chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-
-		bool executeOptionsAsync(chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeGetAsync(chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeHeadAsync(chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executePostAsync(chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executePutAsync(chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeDeleteAsync(chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeTraceAsync(chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
-		bool executeConnectAsync(chstr customBody, hmap<hstr, hstr> customHeaders = hmap<hstr, hstr>());
+		bool executeOptions(HttpResponse* response, chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeGet(HttpResponse* response, chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeHead(HttpResponse* response, chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executePost(HttpResponse* response, chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executePut(HttpResponse* response, chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeDelete(HttpResponse* response, chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeTrace(HttpResponse* response, chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeConnect(HttpResponse* response, chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+
+		bool executeOptionsAsync(chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeGetAsync(chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeHeadAsync(chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executePostAsync(chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executePutAsync(chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeDeleteAsync(chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeTraceAsync(chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+		bool executeConnectAsync(chstr customBody, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>());
+
+		// these read the body in pieces while sending instead of keeping all of it in memory
+		/// @note The body is read from the current position of bodyStream which has to stay valid until the request has finished.
+		/// @note If chunked is false, Content-Length is determined from the remaining size of bodyStream.
+		bool executePost(HttpResponse* response, Url url, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>(), bool chunked = false);
+		bool executePut(HttpResponse* response, Url url, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>(), bool chunked = false);
+
+		bool executePostAsync(Url url, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>(), bool chunked = false);
+		bool executePutAsync(Url url, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders = hmap<hstr, hstr>(), bool chunked = false);
 
 		bool abort();
 
 		static unsigned short DefaultPort;
+		/// @note Used for HTTPS URLs without a port.
+		static unsigned short DefaultTlsPort;
 
 	protected:
+		/// @brief An executing request that identical requests of other sockets wait for.
+		class Flight
+		{
+		public:
+			hstr key;
+			HttpResponse* response;
+			State result;
+			bool finished;
+			/// @note The executing socket and every waiting socket hold one reference.
+			int references;
+
+			Flight(chstr key);
+			~Flight();
+
+		};
+
 		HttpSocketDelegate* socketDelegate;
 		HttpSocketThread* thread;
 		Protocol protocol;
 		bool keepAlive;
 		bool reportProgress;
+		bool pipelining;
+		bool contentDecoding;
+		bool coalescing;
+		Flight* flight;
+		/// @note If true, this socket waits for the flight instead of executing it.
+		bool flightFollower;
 		Url url;
+		/// @note Used by synchronous requests.
+		hstream requestStream;
+		HttpCache* cache;
+		/// @note Set up when a request is executed so its response can be stored in or revalidated against the cache.
+		bool cacheRequest;
+		bool cacheRevalidating;
+		hmap<hstr, hstr> cacheRequestHeaders;
+		/// @note Fresh responses from the cache for async requests that are reported in the next update().
+		harray<HttpResponse*> cachedResponses;
+		harray<Url> cachedUrls;
+
+		bool _executeMethod(HttpResponse* response, chstr method, Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders);
+		bool _executeMethod(HttpResponse* response, chstr method, chstr customBody, const hmap<hstr, hstr>& customHeaders);
+		bool _executeMethodInternal(HttpResponse* response, chstr method, Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders, hsbase* bodyStream = NULL, bool chunked = false);
+		bool _executeMethodStream(HttpResponse* response, chstr method, Url& url, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders, bool chunked);
+
+		bool _executeMethodAsync(chstr method, Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders);
+		bool _executeMethodAsync(chstr method, chstr customBody, const hmap<hstr, hstr>& customHeaders);
+		bool _executeMethodInternalAsync(chstr method, Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders, hsbase* bodyStream = NULL, bool chunked = false);
+		bool _executeMethodStreamAsync(chstr method, Url& url, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders, bool chunked);
+		bool _executeMethodPipelinedAsync(chstr method, Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders);
+		/// @return True if async requests are queued on the thread, either pipelined or multiplexed.
+		bool _isQueuing();
 
-		bool _executeMethod(HttpResponse* response, chstr method, Url& url, chstr customBody, hmap<hstr, hstr>& customHeaders);
-		bool _executeMethod(HttpResponse* response, chstr method, chstr customBody, hmap<hstr, hstr>& customHeaders);
-		bool _executeMethodInternal(HttpResponse* response, chstr method, Url& url, chstr customBody, hmap<hstr, hstr>& customHeaders);
+		void _updatePipelined();
+		void _updateCached();
+		bool _updateFollower();
 
-		bool _executeMethodAsync(chstr method, Url& url, chstr customBody, hmap<hstr, hstr>& customHeaders);
-		bool _executeMethodAsync(chstr method, chstr customBody, hmap<hstr, hstr>& customHeaders);
-		bool _executeMethodInternalAsync(chstr method, Url& url, chstr customBody, hmap<hstr, hstr>& customHeaders);
+		/// @return True if the request waits for an identical executing request instead of being executed.
+		bool _joinFlight(chstr method, const Url& url, chstr customBody, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders);
+		/// @brief Makes the response available to all waiting sockets.
+		void _finishFlight(HttpResponse* response, State result);
+		void _leaveFlight();
+
+		/// @return True if a fresh response from the cache was copied into response.
+		/// @note Adds conditional headers to requestHeaders if a stale response has to be revalidated.
+		bool _lookupCache(chstr method, const Url& url, chstr customBody, hsbase* bodyStream, hmap<hstr, hstr>& requestHeaders, HttpResponse* response);
+		/// @brief Stores the received response in the cache or replaces a 304 response with the cached one.
+		void _updateCache(HttpResponse* response, const Url& url);
 
 		int _send(hstream* stream, int count);
 		bool _sendAsync(hstream* stream, int count);
+		bool _sendBodyStream(hsbase* bodyStream, bool chunked);
 		void _terminateConnection();
+		/// @brief Enables TLS on the socket for HTTPS URLs.
+		/// @note A connection can't switch between TLS and plain text so an existing one is closed if that would be required.
+		/// @return The port that the connection is made to.
+		unsigned short _prepareConnection(bool multiplexing = false);
 
-		int _receiveHttpDirect(HttpResponse* response);
+		int _receiveHttpDirect(HttpResponse* response, HttpPhaseTimer* timer = NULL);
 
 		bool _canExecute(State state);
+		bool _canExecutePipelined(State state);
 		bool _canAbort(State state);
 
-		hstr _processRequest(chstr method, Url url, chstr customBody, hmap<hstr, hstr> customHeaders);
+		/// @brief Writes the request line, headers and an in-memory body to the end of output.
+		void _processRequest(hstream& output, chstr method, const Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders, hsbase* bodyStream = NULL, bool chunked = false);
+		/// @brief Sets up the header fields and the body of a request that is sent as an HTTP/2 stream.
+		void _processRequestHttp2(harray<HpackField>& fields, hstr& body, chstr method, const Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders);
 
 		hstr _makeProtocol();
 
+		/// @note Protected by flightsMutex, just like the contents of all flights.
+		static hmap<hstr, Flight*> flights;
+		static hmutex flightsMutex;
+
+		static void _releaseFlight(Flight* flight);
+
 	private:
 		HttpSocket(const HttpSocket& other); // prevents copying
 
@@ -0,0 +1,110 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines an HTTP server delegate that serves files from a directory.
+
+#ifndef SAKIT_HTTP_STATIC_FILE_DELEGATE_H
+#define SAKIT_HTTP_STATIC_FILE_DELEGATE_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hstring.h>
+
+#include "HttpServerDelegate.h"
+#include "sakitExport.h"
+
+namespace sakit
+{
+	class HttpServer;
+	class HttpServerRequest;
+	class HttpServerResponse;
+
+	/// @brief Serves files from a directory for GET and HEAD requests.
+	/// @note Supports single byte ranges, If-Range and If-Modified-Since. Files are sent with TcpSocket::sendFileNonBlocking() so their data never passes through a stream.
+	/// Small files are kept in memory with least-recently-used eviction so the most requested ones don't have to be opened again.
+	/// @note Usually added as a prefix route, e.g. server->addRoute(SAKIT_HTTP_SERVER_ANY_METHOD, "/files/*", &delegate) with "/files/" as urlPrefix.
+	class sakitExport HttpStaticFileDelegate : public HttpServerDelegate
+	{
+	public:
+		/// @param urlPrefix Removed from the request path before it's resolved inside rootPath.
+		HttpStaticFileDelegate(chstr rootPath, chstr urlPrefix = "");
+		~HttpStaticFileDelegate();
+
+		HL_DEFINE_GETSET(hstr, rootPath, RootPath);
+		HL_DEFINE_GETSET(hstr, urlPrefix, UrlPrefix);
+		/// @note Served for requests to a directory. Empty to respond with 404 instead.
+		HL_DEFINE_GETSET(hstr, indexFilename, IndexFilename);
+		HL_DEFINE_GET(int64_t, maxCacheSize, MaxCacheSize);
+		/// @note Least recently used files are removed from the cache until it fits into this size.
+		void setMaxCacheSize(int64_t value);
+		/// @note Larger files are always sent from the file system.
+		HL_DEFINE_GETSET(int64_t, maxCachedFileSize, MaxCachedFileSize);
+		HL_DEFINE_GET(int64_t, cacheSize, CacheSize);
+		int getCachedFileCount();
+
+		void clearCache();
+
+		void onRequest(HttpServer* server, HttpServerRequest* request, HttpServerResponse* response);
+
+		static int64_t DefaultMaxCacheSize;
+		static int64_t DefaultMaxCachedFileSize;
+
+	protected:
+		class CachedFile
+		{
+		public:
+			hstr filename;
+			int64_t size;
+			/// @note In seconds since the epoch.
+			int64_t modificationTime;
+			/// @note Read into memory instead of being mapped since a mapping of a file that gets truncated can't be accessed safely.
+			char* data;
+
+			CachedFile(chstr filename, int64_t size, int64_t modificationTime);
+			~CachedFile();
+
+			bool load();
+
+		private:
+			CachedFile(const CachedFile& other); // prevents copying
+
+		};
+
+		hstr rootPath;
+		hstr urlPrefix;
+		hstr indexFilename;
+		int64_t maxCacheSize;
+		int64_t maxCachedFileSize;
+		/// @note Ordered from least to most recently used.
+		harray<CachedFile*> cachedFiles;
+		int64_t cacheSize;
+
+		/// @return The file inside rootPath or an empty string if the path tries to leave it or doesn't start with urlPrefix.
+		/// @note urlPrefix only matches whole path segments, e.g. "/files" matches "/files/a" but not "/filesystem".
+		hstr _resolveFilename(chstr path);
+		/// @return The cached file or NULL if it can't be cached.
+		/// @note Entries of files that have been modified since they were cached are replaced.
+		CachedFile* _getCachedFile(chstr filename, int64_t size, int64_t modificationTime);
+		void _evict();
+
+		/// @return False if the file doesn't exist.
+		static bool _getFileInfo(chstr filename, int64_t& size, int64_t& modificationTime, bool& directory);
+		/// @return 1 if a valid range was found, 0 if the whole file should be sent and -1 if the range can't be satisfied.
+		static int _parseRange(chstr value, int64_t size, int64_t& start, int64_t& end);
+		static hstr _makeHttpDate(int64_t time);
+		static hstr _findContentType(chstr filename);
+
+	private:
+		HttpStaticFileDelegate(const HttpStaticFileDelegate& other); // prevents copying
+
+	};
+
+}
+#endif
@@ -0,0 +1,97 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines the timing breakdown of an HTTP request.
+
+#ifndef SAKIT_HTTP_TIMING_H
+#define SAKIT_HTTP_TIMING_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hstring.h>
+
+#include "sakitExport.h"
+
+#define SAKIT_HTTP_TIMING_BUCKET_COUNT 14
+
+namespace sakit
+{
+	class HttpTiming;
+	class Url;
+
+	/// @brief Counts how many requests fell into each duration bucket, separately for every phase.
+	class sakitExport HttpTimingHistogram
+	{
+	public:
+		int count;
+		/// @note Each array has SAKIT_HTTP_TIMING_BUCKET_COUNT buckets. Bucket i counts durations up to BucketBounds[i], the last one counts everything longer.
+		harray<int> dns;
+		harray<int> connect;
+		harray<int> send;
+		harray<int> firstByte;
+		harray<int> download;
+		harray<int> total;
+
+		HttpTimingHistogram();
+
+		void add(const HttpTiming& timing);
+
+		/// @return The upper bound in seconds of the bucket that contains the percentile (between 0 and 1) of the samples.
+		/// @note Samples in the last bucket are reported with the bound of the bucket before it.
+		static float getPercentile(const harray<int>& buckets, float percentile);
+
+		/// @note In seconds.
+		static const float BucketBounds[SAKIT_HTTP_TIMING_BUCKET_COUNT - 1];
+
+	protected:
+		static void _add(harray<int>& buckets, float value);
+
+	};
+
+	/// @brief How long each phase of a request took.
+	/// @note All durations are in seconds and measured with the tick count. Phases that didn't happen are 0, e.g. DNS and connect on a reused connection.
+	class sakitExport HttpTiming
+	{
+	public:
+		friend class HttpClient;
+		friend class HttpSocket;
+
+		float dns;
+		float connect;
+		float send;
+		/// @note From the end of sending the request until the first byte of the response.
+		float firstByte;
+		/// @note From the first byte until the response was complete.
+		float download;
+		/// @note Includes the time waiting for a connection or for earlier pipelined requests.
+		float total;
+		bool connectionReused;
+
+		HttpTiming();
+
+		void clear();
+
+		/// @return The histograms of all origins that have completed requests, mapped by "host:port".
+		static hmap<hstr, HttpTimingHistogram> getHistograms();
+		static HttpTimingHistogram getHistogram(chstr origin);
+		static void clearHistograms();
+
+	protected:
+		static hmap<hstr, HttpTimingHistogram> histograms;
+		static hmutex histogramsMutex;
+
+		static void _record(const Url& url, const HttpTiming& timing);
+
+	};
+
+}
+#endif
@@ -41,6 +41,8 @@ namespace sakit
 
 		int send(hstream* stream, int count = INT_MAX);
 		int send(chstr data);
+		/// @note Sends straight from memory. The data doesn't have to stay valid after the call returns.
+		int send(const char* data, int count);
 
 		bool sendAsync(hstream* stream, int count = INT_MAX);
 		bool sendAsync(chstr data);
@@ -56,6 +58,8 @@ namespace sakit
 		Socket(SocketDelegate* socketDelegate, State idleState);
 
 		int _send(hstream* stream, int count);
+		bool _prepareSend();
+		void _finishSend();
 		bool _prepareReceive(hstream* stream);
 		int _finishReceive(int result);
 		bool _startReceiveAsync(int maxValue);
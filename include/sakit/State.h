@@ -48,6 +48,7 @@ namespace sakit
 		static harray<State> allowedServerStartStates;
 		static harray<State> allowedServerStopStates;
 		static harray<State> allowedHttpExecuteStates;
+		static harray<State> allowedHttpExecutePipelinedStates;
 		static harray<State> allowedHttpAbortStates;
 
 	));
@@ -30,6 +30,13 @@ namespace sakit
 		~TcpServer();
 
 		harray<TcpSocket*> getSockets();
+		bool isTlsEnabled() const;
+		/// @brief Encrypts all accepted connections with TLS using the given PEM files.
+		/// @note The handshake is done by the thread that first sends or receives on an accepted socket so accepting isn't held up by it.
+		/// @note Servers with the same certificate share the session cache and the session ticket keys so clients can resume sessions with any of them.
+		/// @note Empty filenames disable TLS again. Has to be set before the server is started.
+		/// @return False if the certificate or the private key couldn't be loaded.
+		bool setTlsCertificate(chstr certificateFilename, chstr privateKeyFilename);
 
 		void update(float timeDelta = 0.0f);
 
@@ -42,6 +49,8 @@ namespace sakit
 		TcpSocketDelegate* acceptedDelegate;
 
 		void _updateSockets();
+		/// @brief Called for every accepted socket before the delegate is notified.
+		virtual void _onAccepted(TcpSocket* socket);
 
 	private:
 		TcpServer(const TcpServer& other); // prevents copying
@@ -34,6 +34,24 @@ namespace sakit
 		~TcpSocket();
 
 		bool setNagleAlgorithmActive(bool value);
+		bool isTlsEnabled() const;
+		/// @brief Encrypts the connection with TLS once it has been established.
+		/// @param serverName Sent for SNI and verified against the certificate. The host that is connected to is used if empty.
+		/// @note Has to be set before connecting.
+		void setTlsEnabled(bool value, chstr serverName = "");
+		bool isTlsVerifyingPeer() const;
+		void setTlsVerifyingPeer(bool value);
+		/// @return True if the last handshake resumed a cached session instead of doing a full one.
+		bool isTlsResumed() const;
+
+		/// @brief Sends a part of a file straight from the file system.
+		/// @note Uses sendfile() where the platform supports it so the data is never copied into user space.
+		/// @return How many bytes have been sent.
+		int64_t sendFile(chstr filename, int64_t offset, int64_t count);
+		/// @brief Sends as much of a part of a file as the socket can take right away without waiting.
+		/// @return How many bytes have been sent or -1 if sending failed.
+		/// @note Meant to be called repeatedly, e.g. from an update loop, until everything has been sent.
+		int64_t sendFileNonBlocking(chstr filename, int64_t offset, int64_t count);
 
 		void update(float timeDelta = 0.0f);
 
@@ -37,7 +37,8 @@ namespace sakit
 		HL_DEFINE_GET(hstr, host, Host);
 		HL_DEFINE_GET(unsigned short, port, Port);
 		HL_DEFINE_GET(hstr, path, Path);
-		HL_DEFINE_GET2(hmap, hstr, hstr, query, Query);
+		/// @note A query that was set as part of a URL string is only decoded when it's accessed.
+		hmap<hstr, hstr> getQuery() const;
 		HL_DEFINE_GET(hstr, fragment, Fragment);
 		void set(chstr url);
 		void set(chstr host, chstr path, hmap<hstr, hstr> query = hmap<hstr, hstr>(), chstr fragment = "", chstr scheme = SAKIT_HTTP_SCHEME);
@@ -60,14 +61,22 @@ namespace sakit
 		hstr host;
 		unsigned short port;
 		hstr path;
-		hmap<hstr, hstr> query;
 		hstr fragment;
-		char queryDelimiter;
+		/// @note The URL as it was set, the original query is kept as a range in it.
+		hstr data;
+		int queryOffset;
+		int querySize;
+		/// @note Only used if the query wasn't set as part of a URL string.
+		hmap<hstr, hstr> query;
 
-		void _checkValues(chstr query);
+		void _reset();
+		bool _checkValues(const char* host, int hostSize, const char* path, int pathSize, const char* fragment, int fragmentSize);
 
-		static bool _checkCharset(chstr string, chstr allowed);
-		static hstr _encodeWwwFormComponent(chstr string, chstr allowed);
+		/// @param charset Character class bits from the lookup table in the implementation.
+		static bool _checkCharset(chstr string, unsigned char charset);
+		static hstr _encodeWwwFormComponent(chstr string, unsigned char charset);
+		/// @note Writes the encoded string to output and returns its size. output needs room for three times the size of the string.
+		static int _encodeWwwFormComponent(const char* string, int size, unsigned char charset, char* output);
 		static hstr _decodeWwwFormComponent(chstr string);
 
 	};
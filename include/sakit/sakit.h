@@ -37,7 +37,24 @@ namespace sakit
 	sakitFnExport void setGlobalTimeout(float globalTimeout, float globalRetryFrequency = 0.01f);
 	sakitFnExport harray<NetworkAdapter> getNetworkAdapters();
 	/// @return The IP of the domain/host.
+	/// @note Results are cached, the same as for the lookups done when connecting.
 	sakitFnExport Host resolveHost(Host domain);
+	/// @brief Starts resolving the domain/host in the background so connecting to it later doesn't have to wait for the lookup.
+	sakitFnExport void prefetchHost(Host domain);
+	/// @brief Sets how long resolved hosts and failed lookups are cached, in seconds.
+	sakitFnExport void setResolverCacheTtl(float ttl, float negativeTtl);
+	sakitFnExport void clearResolverCache();
+	/// @brief Replaces the system resolver, e.g. with a custom DNS client or a stub server for testing.
+	/// @param function Has to be thread-safe since it's called from multiple threads at once. NULL restores the system resolver.
+	/// @note Results are cached just like those of the system resolver.
+	sakitFnExport void setResolverLookupFunction(bool (*function)(chstr hostname, harray<Host>& addresses));
+	/// @brief Sets the PEM file with the certificate authorities that TLS peers are verified against.
+	/// @note The system's default locations are used if empty.
+	sakitFnExport void setTlsCertificateAuthorityFile(chstr filename);
+	/// @brief Lets the kernel encrypt TLS records where supported so files can be sent without copying them into user space.
+	sakitFnExport void setTlsKernelOffloadEnabled(bool value);
+	/// @brief Forgets all TLS sessions that could be resumed by new connections.
+	sakitFnExport void clearTlsSessionCache();
 	/// @return The domain/host associated with this IP address.
 	sakitFnExport Host resolveIp(Host ip);
 	/// @return The port for the given service name.
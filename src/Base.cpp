@@ -78,6 +78,66 @@ namespace sakit
 		return sent;
 	}
 	
+	int Base::_sendDirect(const char* data, int count)
+	{
+		int sent = 0;
+		while (count > 0)
+		{
+			if (!this->socket->send(data + sent, count, sent))
+			{
+				break;
+			}
+			if (count == 0)
+			{
+				break;
+			}
+			hthread::sleep(this->retryFrequency * 1000.0f);
+		}
+		return sent;
+	}
+
+	int64_t Base::_sendFileDirect(chstr filename, int64_t offset, int64_t count)
+	{
+		int fileDescriptor = PlatformSocket::openFile(filename);
+		if (fileDescriptor < 0)
+		{
+			hlog::error(logTag, "Could not open file for sending: " + filename);
+			return 0;
+		}
+		int64_t sent = 0;
+		int64_t lastSent = 0;
+		float time = 0.0f;
+		while (count > 0)
+		{
+			if (!this->socket->sendFile(fileDescriptor, offset, count, sent))
+			{
+				break;
+			}
+			if (count == 0)
+			{
+				break;
+			}
+			if (lastSent != sent)
+			{
+				lastSent = sent;
+				// retry attempts are reset after a successful send
+				time = 0.0f;
+			}
+			else
+			{
+				time += this->retryFrequency;
+				if (time >= this->timeout)
+				{
+					hlog::warn(logTag, "Timed out while sending file.");
+					break;
+				}
+			}
+			hthread::sleep(this->retryFrequency * 1000.0f);
+		}
+		PlatformSocket::closeFile(fileDescriptor);
+		return sent;
+	}
+
 	int Base::_receiveDirect(hstream* stream, int maxCount)
 	{
 		float time = 0.0f;
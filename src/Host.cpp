@@ -6,6 +6,8 @@
 /// This program is free software; you can redistribute it and/or modify it under
 /// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
 
+#include <string.h>
+
 #include <hltypes/harray.h>
 #include <hltypes/hlog.h>
 #include <hltypes/hstring.h>
@@ -19,56 +21,330 @@ namespace sakit
 	const Host Host::Localhost("localhost");
 	const Host Host::Any("0.0.0.0");
 
-	Host::Host()
+	Host::Host() :
+		binaryAddressSize(0)
 	{
-		this->address = "";
+		memset(this->binaryAddress, 0, sizeof(this->binaryAddress));
 	}
 
 	Host::Host(const char* domain)
 	{
-		this->address = domain;
+		this->_set(domain);
 	}
 
 	Host::Host(chstr domain)
 	{
-		this->address = domain;
+		this->_set(domain);
 	}
 
-	Host::Host(unsigned char a, unsigned char b, unsigned char c, unsigned char d)
+	Host::Host(unsigned char a, unsigned char b, unsigned char c, unsigned char d) :
+		binaryAddressSize(4)
 	{
-		this->address = hsprintf("%d.%d.%d.%d", a, b, c, d);
+		memset(this->binaryAddress, 0, sizeof(this->binaryAddress));
+		this->binaryAddress[0] = a;
+		this->binaryAddress[1] = b;
+		this->binaryAddress[2] = c;
+		this->binaryAddress[3] = d;
 	}
 
-	bool Host::isIp() const
+	Host::Host(const unsigned char* binaryAddress, int size) :
+		binaryAddressSize(0)
 	{
-		harray<hstr> fragments = this->address.split('.');
-		if (fragments.size() != 4)
+		memset(this->binaryAddress, 0, sizeof(this->binaryAddress));
+		if (size == 4 || size == 16)
 		{
-			return false;
+			memcpy(this->binaryAddress, binaryAddress, size);
+			this->binaryAddressSize = size;
+		}
+	}
+
+	void Host::_set(chstr domain)
+	{
+		this->address = domain;
+		this->binaryAddressSize = 0;
+		memset(this->binaryAddress, 0, sizeof(this->binaryAddress));
+		if (Host::_parseIpv4(domain.cStr(), domain.size(), this->binaryAddress))
+		{
+			this->binaryAddressSize = 4;
 		}
-		foreach (hstr, it, fragments)
+		else if (domain.contains(':') && Host::_parseIpv6(domain.cStr(), domain.size(), this->binaryAddress))
 		{
-			if (!(*it).isNumber() || (int)(*it) >= 256)
+			this->binaryAddressSize = 16;
+		}
+	}
+
+	bool Host::isIp() const
+	{
+		return (this->binaryAddressSize > 0);
+	}
+
+	bool Host::isIpv4() const
+	{
+		return (this->binaryAddressSize == 4);
+	}
+
+	bool Host::isIpv6() const
+	{
+		return (this->binaryAddressSize == 16);
+	}
+
+	const unsigned char* Host::getBinaryAddress() const
+	{
+		return (this->binaryAddressSize > 0 ? this->binaryAddress : NULL);
+	}
+
+	unsigned int Host::getHash() const
+	{
+		// FNV-1a
+		unsigned int result = 2166136261u;
+		if (this->binaryAddressSize > 0)
+		{
+			for_iter (i, 0, this->binaryAddressSize)
 			{
-				return false;
+				result = (result ^ this->binaryAddress[i]) * 16777619u;
 			}
+			return result;
 		}
-		return true;
+		const char* data = this->address.cStr();
+		int size = this->address.size();
+		for_iter (i, 0, size)
+		{
+			result = (result ^ (unsigned char)data[i]) * 16777619u;
+		}
+		return result;
 	}
 
 	hstr Host::toString() const
 	{
-		return this->address;
+		if (this->address != "" || this->binaryAddressSize == 0)
+		{
+			return this->address;
+		}
+		const unsigned char* bytes = this->binaryAddress;
+		if (this->binaryAddressSize == 4)
+		{
+			return hsprintf("%d.%d.%d.%d", bytes[0], bytes[1], bytes[2], bytes[3]);
+		}
+		// IPv4-mapped addresses keep their IPv4 notation
+		static const unsigned char mappedPrefix[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+		if (memcmp(bytes, mappedPrefix, sizeof(mappedPrefix)) == 0)
+		{
+			return hsprintf("::ffff:%d.%d.%d.%d", bytes[12], bytes[13], bytes[14], bytes[15]);
+		}
+		// the longest run of zero groups is compressed as defined by RFC 5952
+		int groups[8];
+		int bestStart = -1;
+		int bestLength = 0;
+		int start = -1;
+		for_iter (i, 0, 8)
+		{
+			groups[i] = (bytes[i * 2] << 8) | bytes[i * 2 + 1];
+			if (groups[i] != 0)
+			{
+				start = -1;
+				continue;
+			}
+			if (start < 0)
+			{
+				start = i;
+			}
+			if (i - start + 1 > bestLength)
+			{
+				bestStart = start;
+				bestLength = i - start + 1;
+			}
+		}
+		if (bestLength < 2)
+		{
+			bestStart = -1;
+		}
+		hstr result;
+		int i = 0;
+		while (i < 8)
+		{
+			if (i == bestStart)
+			{
+				result += "::";
+				i += bestLength;
+				continue;
+			}
+			if (i > 0 && i != bestStart + bestLength)
+			{
+				result += ":";
+			}
+			result += hsprintf("%x", groups[i]);
+			++i;
+		}
+		return result;
 	}
 
 	bool Host::operator==(const Host& other) const
 	{
+		if (this->binaryAddressSize > 0 || other.binaryAddressSize > 0)
+		{
+			return (this->binaryAddressSize == other.binaryAddressSize && memcmp(this->binaryAddress, other.binaryAddress, this->binaryAddressSize) == 0);
+		}
 		return (this->address == other.address);
 	}
 
 	bool Host::operator!=(const Host& other) const
 	{
-		return (this->address != other.address);
+		return !(*this == other);
+	}
+
+	bool Host::operator<(const Host& other) const
+	{
+		if (this->binaryAddressSize != other.binaryAddressSize)
+		{
+			return (this->binaryAddressSize < other.binaryAddressSize);
+		}
+		if (this->binaryAddressSize > 0)
+		{
+			return (memcmp(this->binaryAddress, other.binaryAddress, this->binaryAddressSize) < 0);
+		}
+		return (this->address < other.address);
+	}
+
+	bool Host::_parseIpv4(const char* data, int size, unsigned char* result)
+	{
+		unsigned char bytes[4] = {0};
+		int part = 0;
+		int value = 0;
+		int digits = 0;
+		for_iter (i, 0, size)
+		{
+			if (data[i] >= '0' && data[i] <= '9')
+			{
+				// leading zeros would be octal in some notations so they are not accepted
+				if (digits > 0 && value == 0)
+				{
+					return false;
+				}
+				value = value * 10 + (data[i] - '0');
+				++digits;
+				if (value > 255)
+				{
+					return false;
+				}
+			}
+			else if (data[i] == '.' && digits > 0 && part < 3)
+			{
+				bytes[part] = (unsigned char)value;
+				++part;
+				value = 0;
+				digits = 0;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		if (digits == 0 || part != 3)
+		{
+			return false;
+		}
+		bytes[3] = (unsigned char)value;
+		memcpy(result, bytes, sizeof(bytes));
+		return true;
+	}
+
+	bool Host::_parseIpv6(const char* data, int size, unsigned char* result)
+	{
+		unsigned char bytes[16] = {0};
+		int count = 0;
+		int compressed = -1;
+		int i = 0;
+		int end = 0;
+		int value = 0;
+		if (size >= 2 && data[0] == ':' && data[1] == ':')
+		{
+			compressed = 0;
+			i = 2;
+		}
+		else if (size == 0 || data[0] == ':')
+		{
+			return false;
+		}
+		while (i < size)
+		{
+			end = i;
+			while (end < size && data[end] != ':')
+			{
+				++end;
+			}
+			// the last 32 bits can be written in IPv4 notation
+			if (end == size && memchr(&data[i], '.', end - i) != NULL)
+			{
+				if (count > 12 || !Host::_parseIpv4(&data[i], end - i, &bytes[count]))
+				{
+					return false;
+				}
+				count += 4;
+				break;
+			}
+			if (end - i < 1 || end - i > 4 || count >= 16)
+			{
+				return false;
+			}
+			value = 0;
+			for_iter (j, i, end)
+			{
+				if (data[j] >= '0' && data[j] <= '9')
+				{
+					value = value * 16 + (data[j] - '0');
+				}
+				else if (data[j] >= 'a' && data[j] <= 'f')
+				{
+					value = value * 16 + (data[j] - 'a' + 10);
+				}
+				else if (data[j] >= 'A' && data[j] <= 'F')
+				{
+					value = value * 16 + (data[j] - 'A' + 10);
+				}
+				else
+				{
+					return false;
+				}
+			}
+			bytes[count] = (unsigned char)(value >> 8);
+			bytes[count + 1] = (unsigned char)(value & 0xFF);
+			count += 2;
+			i = end;
+			if (i < size)
+			{
+				++i; // skip ':'
+				if (i == size)
+				{
+					return false;
+				}
+				if (data[i] == ':')
+				{
+					if (compressed >= 0)
+					{
+						return false;
+					}
+					compressed = count;
+					++i;
+				}
+			}
+		}
+		if (compressed >= 0)
+		{
+			if (count >= 16)
+			{
+				return false;
+			}
+			// the groups after "::" are moved to the end
+			int tail = count - compressed;
+			memmove(&bytes[16 - tail], &bytes[compressed], tail);
+			memset(&bytes[compressed], 0, 16 - tail - compressed);
+		}
+		else if (count != 16)
+		{
+			return false;
+		}
+		memcpy(result, bytes, sizeof(bytes));
+		return true;
 	}
 
 }
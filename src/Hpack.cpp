@@ -0,0 +1,585 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <string.h>
+
+#include <hltypes/harray.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hstream.h>
+#include <hltypes/hstring.h>
+
+#include "Hpack.h"
+
+#define HPACK_STATIC_TABLE_SIZE 61
+#define HPACK_FIELD_OVERHEAD 32
+// enough for all internal nodes of the Huffman code
+#define HPACK_HUFFMAN_TREE_SIZE 512
+
+namespace sakit
+{
+	struct _StaticField
+	{
+		const char* name;
+		const char* value;
+	};
+
+	// the static table as defined by RFC 7541, index 1 is at position 0
+	static const _StaticField _staticTable[HPACK_STATIC_TABLE_SIZE] =
+	{
+		{":authority", ""},
+		{":method", "GET"},
+		{":method", "POST"},
+		{":path", "/"},
+		{":path", "/index.html"},
+		{":scheme", "http"},
+		{":scheme", "https"},
+		{":status", "200"},
+		{":status", "204"},
+		{":status", "206"},
+		{":status", "304"},
+		{":status", "400"},
+		{":status", "404"},
+		{":status", "500"},
+		{"accept-charset", ""},
+		{"accept-encoding", "gzip, deflate"},
+		{"accept-language", ""},
+		{"accept-ranges", ""},
+		{"accept", ""},
+		{"access-control-allow-origin", ""},
+		{"age", ""},
+		{"allow", ""},
+		{"authorization", ""},
+		{"cache-control", ""},
+		{"content-disposition", ""},
+		{"content-encoding", ""},
+		{"content-language", ""},
+		{"content-length", ""},
+		{"content-location", ""},
+		{"content-range", ""},
+		{"content-type", ""},
+		{"cookie", ""},
+		{"date", ""},
+		{"etag", ""},
+		{"expect", ""},
+		{"expires", ""},
+		{"from", ""},
+		{"host", ""},
+		{"if-match", ""},
+		{"if-modified-since", ""},
+		{"if-none-match", ""},
+		{"if-range", ""},
+		{"if-unmodified-since", ""},
+		{"last-modified", ""},
+		{"link", ""},
+		{"location", ""},
+		{"max-forwards", ""},
+		{"proxy-authenticate", ""},
+		{"proxy-authorization", ""},
+		{"range", ""},
+		{"referer", ""},
+		{"refresh", ""},
+		{"retry-after", ""},
+		{"server", ""},
+		{"set-cookie", ""},
+		{"strict-transport-security", ""},
+		{"transfer-encoding", ""},
+		{"user-agent", ""},
+		{"vary", ""},
+		{"via", ""},
+		{"www-authenticate", ""}
+	};
+
+	// the Huffman code as defined by RFC 7541, the code of EOS is never valid in a string
+	static const unsigned int _huffmanCodes[256] =
+	{
+		0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+		0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+		0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+		0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+		0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+		0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+		0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+		0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+		0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+		0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+		0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+		0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+		0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+		0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+		0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+		0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+		0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+		0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+		0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+		0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+		0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+		0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+		0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+		0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+		0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+		0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+		0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+		0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+		0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+		0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+		0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+		0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee
+	};
+
+	static const unsigned char _huffmanCodeLengths[256] =
+	{
+		13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+		28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+		6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+		5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+		13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+		7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+		15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+		6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+		20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+		24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+		22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+		21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+		26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+		19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+		20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+		26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26
+	};
+
+	// children of every node, a leaf is stored as -(symbol + 1)
+	static short _huffmanTree[HPACK_HUFFMAN_TREE_SIZE][2];
+	static bool _huffmanTreeBuilt = false;
+	static hmutex _huffmanTreeMutex;
+
+	static void _buildHuffmanTree()
+	{
+		hmutex::ScopeLock lock(&_huffmanTreeMutex);
+		if (_huffmanTreeBuilt)
+		{
+			return;
+		}
+		memset(_huffmanTree, 0, sizeof(_huffmanTree));
+		int nodeCount = 1;
+		int node = 0;
+		int bit = 0;
+		for_iter (i, 0, 256)
+		{
+			node = 0;
+			for (int j = _huffmanCodeLengths[i] - 1; j > 0; --j)
+			{
+				bit = (_huffmanCodes[i] >> j) & 1;
+				if (_huffmanTree[node][bit] == 0)
+				{
+					_huffmanTree[node][bit] = (short)nodeCount;
+					++nodeCount;
+				}
+				node = _huffmanTree[node][bit];
+			}
+			_huffmanTree[node][_huffmanCodes[i] & 1] = (short)(-(i + 1));
+		}
+		_huffmanTreeBuilt = true;
+	}
+
+	// fields that change with every request or must not be exposed to compression side channels aren't indexed
+	static bool _isIndexable(const HpackField& field)
+	{
+		return (field.name != ":path" && field.name != "content-length" && field.name != "etag" && field.name != "if-none-match" &&
+			field.name != "if-modified-since" && field.name != "authorization" && field.name != "proxy-authorization" && field.name != "cookie");
+	}
+
+	static bool _isSensitive(const HpackField& field)
+	{
+		return (field.name == "authorization" || field.name == "proxy-authorization" || field.name == "cookie");
+	}
+
+	HpackField::HpackField(chstr name, chstr value)
+	{
+		this->name = name;
+		this->value = value;
+	}
+
+	int HpackField::getSize() const
+	{
+		return (this->name.size() + this->value.size() + HPACK_FIELD_OVERHEAD);
+	}
+
+	HpackTable::HpackTable() :
+		size(0),
+		maxSize(HPACK_DEFAULT_TABLE_SIZE)
+	{
+	}
+
+	void HpackTable::setMaxSize(int value)
+	{
+		this->maxSize = value;
+		this->_evict();
+	}
+
+	int HpackTable::getCount() const
+	{
+		return this->fields.size();
+	}
+
+	const HpackField& HpackTable::get(int index) const
+	{
+		return this->fields[index];
+	}
+
+	void HpackTable::add(const HpackField& field)
+	{
+		int fieldSize = field.getSize();
+		if (fieldSize > this->maxSize)
+		{
+			this->clear();
+			return;
+		}
+		this->fields.insertAt(0, field);
+		this->size += fieldSize;
+		this->_evict();
+	}
+
+	void HpackTable::clear()
+	{
+		this->fields.clear();
+		this->size = 0;
+	}
+
+	void HpackTable::_evict()
+	{
+		while (this->size > this->maxSize && this->fields.size() > 0)
+		{
+			this->size -= this->fields.removeLast().getSize();
+		}
+	}
+
+	HpackEncoder::HpackEncoder() :
+		maxTableSize(HPACK_DEFAULT_TABLE_SIZE),
+		tableSizeChanged(false)
+	{
+	}
+
+	void HpackEncoder::setMaxTableSize(int value)
+	{
+		// the encoder never uses more than the default, even if the decoder would allow it
+		value = hmin(value, HPACK_DEFAULT_TABLE_SIZE);
+		if (value != this->maxTableSize)
+		{
+			this->maxTableSize = value;
+			this->tableSizeChanged = true;
+		}
+	}
+
+	void HpackEncoder::reset()
+	{
+		this->table.clear();
+		this->table.setMaxSize(HPACK_DEFAULT_TABLE_SIZE);
+		this->maxTableSize = HPACK_DEFAULT_TABLE_SIZE;
+		this->tableSizeChanged = false;
+	}
+
+	void HpackEncoder::encode(const harray<HpackField>& fields, hstream& output)
+	{
+		if (this->tableSizeChanged)
+		{
+			this->table.setMaxSize(this->maxTableSize);
+			HpackEncoder::_writeInteger(output, 0x20, 5, this->maxTableSize);
+			this->tableSizeChanged = false;
+		}
+		int index = 0;
+		bool valueMatched = false;
+		foreachc (HpackField, it, fields)
+		{
+			index = this->_find((*it), valueMatched);
+			if (index > 0 && valueMatched)
+			{
+				HpackEncoder::_writeInteger(output, 0x80, 7, index);
+				continue;
+			}
+			if (_isIndexable(*it) && (*it).getSize() <= this->table.getMaxSize() / 2)
+			{
+				HpackEncoder::_writeInteger(output, 0x40, 6, index);
+				this->table.add(*it);
+			}
+			else
+			{
+				HpackEncoder::_writeInteger(output, (_isSensitive(*it) ? 0x10 : 0x00), 4, index);
+			}
+			if (index == 0)
+			{
+				HpackEncoder::_writeString(output, (*it).name);
+			}
+			HpackEncoder::_writeString(output, (*it).value);
+		}
+	}
+
+	int HpackEncoder::_find(const HpackField& field, bool& valueMatched)
+	{
+		int result = 0;
+		valueMatched = false;
+		for_iter (i, 0, HPACK_STATIC_TABLE_SIZE)
+		{
+			if (field.name == _staticTable[i].name)
+			{
+				if (field.value == _staticTable[i].value)
+				{
+					valueMatched = true;
+					return (i + 1);
+				}
+				if (result == 0)
+				{
+					result = i + 1;
+				}
+			}
+		}
+		int count = this->table.getCount();
+		for_iter (i, 0, count)
+		{
+			const HpackField& entry = this->table.get(i);
+			if (field.name == entry.name)
+			{
+				if (field.value == entry.value)
+				{
+					valueMatched = true;
+					return (HPACK_STATIC_TABLE_SIZE + i + 1);
+				}
+				if (result == 0)
+				{
+					result = HPACK_STATIC_TABLE_SIZE + i + 1;
+				}
+			}
+		}
+		return result;
+	}
+
+	void HpackEncoder::_writeInteger(hstream& output, unsigned char prefix, int prefixBits, int value)
+	{
+		int max = (1 << prefixBits) - 1;
+		unsigned char byte = 0;
+		if (value < max)
+		{
+			byte = (unsigned char)(prefix | value);
+			output.writeRaw(&byte, 1);
+			return;
+		}
+		byte = (unsigned char)(prefix | max);
+		output.writeRaw(&byte, 1);
+		value -= max;
+		while (value >= 0x80)
+		{
+			byte = (unsigned char)((value & 0x7F) | 0x80);
+			output.writeRaw(&byte, 1);
+			value >>= 7;
+		}
+		byte = (unsigned char)value;
+		output.writeRaw(&byte, 1);
+	}
+
+	void HpackEncoder::_writeString(hstream& output, chstr value)
+	{
+		// strings are sent without Huffman coding which is always allowed
+		HpackEncoder::_writeInteger(output, 0x00, 7, value.size());
+		if (value.size() > 0)
+		{
+			output.writeRaw((void*)value.cStr(), value.size());
+		}
+	}
+
+	HpackDecoder::HpackDecoder() :
+		maxTableSize(HPACK_DEFAULT_TABLE_SIZE)
+	{
+	}
+
+	void HpackDecoder::reset()
+	{
+		this->table.clear();
+		this->table.setMaxSize(this->maxTableSize);
+	}
+
+	bool HpackDecoder::decode(const unsigned char* data, int size, harray<HpackField>& fields)
+	{
+		int position = 0;
+		int index = 0;
+		unsigned char byte = 0;
+		bool fieldsStarted = false;
+		HpackField field;
+		while (position < size)
+		{
+			byte = data[position];
+			if ((byte & 0x80) != 0) // indexed field
+			{
+				if (!HpackDecoder::_readInteger(data, size, position, 7, index) || !this->_getField(index, field))
+				{
+					return false;
+				}
+				fields += field;
+				fieldsStarted = true;
+				continue;
+			}
+			if ((byte & 0xE0) == 0x20) // dynamic table size update
+			{
+				// only allowed at the start of a header block
+				if (fieldsStarted || !HpackDecoder::_readInteger(data, size, position, 5, index) || index > this->maxTableSize)
+				{
+					return false;
+				}
+				this->table.setMaxSize(index);
+				continue;
+			}
+			// literal field with incremental indexing, without indexing or never indexed
+			bool indexing = ((byte & 0xC0) == 0x40);
+			if (!HpackDecoder::_readInteger(data, size, position, (indexing ? 6 : 4), index))
+			{
+				return false;
+			}
+			if (index > 0)
+			{
+				if (!this->_getField(index, field))
+				{
+					return false;
+				}
+			}
+			else if (!HpackDecoder::_readString(data, size, position, field.name))
+			{
+				return false;
+			}
+			if (!HpackDecoder::_readString(data, size, position, field.value))
+			{
+				return false;
+			}
+			if (indexing)
+			{
+				this->table.add(field);
+			}
+			fields += field;
+			fieldsStarted = true;
+		}
+		return true;
+	}
+
+	bool HpackDecoder::_getField(int index, HpackField& field)
+	{
+		if (index <= 0)
+		{
+			return false;
+		}
+		if (index <= HPACK_STATIC_TABLE_SIZE)
+		{
+			field.name = _staticTable[index - 1].name;
+			field.value = _staticTable[index - 1].value;
+			return true;
+		}
+		index -= HPACK_STATIC_TABLE_SIZE + 1;
+		if (index >= this->table.getCount())
+		{
+			return false;
+		}
+		field = this->table.get(index);
+		return true;
+	}
+
+	bool HpackDecoder::_readInteger(const unsigned char* data, int size, int& position, int prefixBits, int& value)
+	{
+		if (position >= size)
+		{
+			return false;
+		}
+		int max = (1 << prefixBits) - 1;
+		value = data[position] & max;
+		++position;
+		if (value < max)
+		{
+			return true;
+		}
+		int shift = 0;
+		unsigned char byte = 0;
+		do
+		{
+			// larger values can't be valid and would overflow
+			if (position >= size || shift > 21)
+			{
+				return false;
+			}
+			byte = data[position];
+			++position;
+			value += (byte & 0x7F) << shift;
+			shift += 7;
+		} while ((byte & 0x80) != 0);
+		return true;
+	}
+
+	bool HpackDecoder::_readString(const unsigned char* data, int size, int& position, hstr& value)
+	{
+		if (position >= size)
+		{
+			return false;
+		}
+		bool huffman = ((data[position] & 0x80) != 0);
+		int length = 0;
+		if (!HpackDecoder::_readInteger(data, size, position, 7, length) || length > size - position)
+		{
+			return false;
+		}
+		if (huffman)
+		{
+			if (!HpackDecoder::_decodeHuffman(&data[position], length, value))
+			{
+				return false;
+			}
+		}
+		else
+		{
+			value = hstr((const char*)&data[position], length);
+		}
+		position += length;
+		return true;
+	}
+
+	bool HpackDecoder::_decodeHuffman(const unsigned char* data, int size, hstr& value)
+	{
+		_buildHuffmanTree();
+		harray<char> result;
+		int node = 0;
+		int next = 0;
+		int paddingBits = 0;
+		bool paddingOnes = true;
+		int bit = 0;
+		for_iter (i, 0, size)
+		{
+			for (int j = 7; j >= 0; --j)
+			{
+				bit = (data[i] >> j) & 1;
+				next = _huffmanTree[node][bit];
+				if (next == 0)
+				{
+					return false; // EOS or an unassigned code
+				}
+				++paddingBits;
+				paddingOnes = (paddingOnes && bit == 1);
+				if (next < 0)
+				{
+					result += (char)(-next - 1);
+					node = 0;
+					paddingBits = 0;
+					paddingOnes = true;
+				}
+				else
+				{
+					node = next;
+				}
+			}
+		}
+		// the padding has to be the most significant bits of EOS and shorter than a byte
+		if (paddingBits > 7 || !paddingOnes)
+		{
+			return false;
+		}
+		value = (result.size() > 0 ? hstr(&result[0], result.size()) : hstr());
+		return true;
+	}
+
+}
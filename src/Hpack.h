@@ -0,0 +1,117 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines the HPACK header compression used by HTTP/2.
+
+#ifndef SAKIT_HPACK_H
+#define SAKIT_HPACK_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hstream.h>
+#include <hltypes/hstring.h>
+
+#define HPACK_DEFAULT_TABLE_SIZE 4096
+
+namespace sakit
+{
+	class HpackField
+	{
+	public:
+		hstr name;
+		hstr value;
+
+		HpackField(chstr name = "", chstr value = "");
+
+		/// @note As defined by HPACK, including the overhead of an entry.
+		int getSize() const;
+
+	};
+
+	/// @brief The dynamic table that both sides of a connection keep in sync.
+	class HpackTable
+	{
+	public:
+		HpackTable();
+
+		HL_DEFINE_GET(int, maxSize, MaxSize);
+		/// @note Evicts the oldest fields until the table fits.
+		void setMaxSize(int value);
+		int getCount() const;
+
+		/// @param index 0 is the most recently added field.
+		const HpackField& get(int index) const;
+		/// @note A field larger than the whole table empties it without being added.
+		void add(const HpackField& field);
+		void clear();
+
+	protected:
+		/// @note Ordered from the newest to the oldest field.
+		harray<HpackField> fields;
+		int size;
+		int maxSize;
+
+		void _evict();
+
+	};
+
+	class HpackEncoder
+	{
+	public:
+		HpackEncoder();
+
+		/// @brief Limits the dynamic table to what the decoder of the other side allows.
+		/// @note The change is signaled at the start of the next header block.
+		void setMaxTableSize(int value);
+		void reset();
+
+		/// @brief Appends a header block to output.
+		/// @note Fields that are likely to repeat are added to the dynamic table so later requests only need their index.
+		void encode(const harray<HpackField>& fields, hstream& output);
+
+	protected:
+		HpackTable table;
+		int maxTableSize;
+		bool tableSizeChanged;
+
+		/// @return The HPACK index of the field or 0. If only the name was found, valueMatched is false.
+		int _find(const HpackField& field, bool& valueMatched);
+
+		static void _writeInteger(hstream& output, unsigned char prefix, int prefixBits, int value);
+		static void _writeString(hstream& output, chstr value);
+
+	};
+
+	class HpackDecoder
+	{
+	public:
+		HpackDecoder();
+
+		void reset();
+
+		/// @brief Decodes a complete header block.
+		/// @return False if the block is invalid which is a connection error since the dynamic table can't be kept in sync anymore.
+		bool decode(const unsigned char* data, int size, harray<HpackField>& fields);
+
+	protected:
+		HpackTable table;
+		/// @note The limit that was announced to the encoder.
+		int maxTableSize;
+
+		bool _getField(int index, HpackField& field);
+
+		static bool _readInteger(const unsigned char* data, int size, int& position, int prefixBits, int& value);
+		static bool _readString(const unsigned char* data, int size, int& position, hstr& value);
+		static bool _decodeHuffman(const unsigned char* data, int size, hstr& value);
+
+	};
+
+}
+#endif
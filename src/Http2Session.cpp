@@ -0,0 +1,684 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <string.h>
+
+#include <hltypes/harray.h>
+#include <hltypes/hlog.h>
+#include <hltypes/hstream.h>
+#include <hltypes/hstring.h>
+
+#include "Http2Session.h"
+#include "HttpResponse.h"
+#include "sakit.h"
+
+#define HTTP_DELIMITER "\r\n"
+#define REQUEST_HEAD "HEAD"
+
+#define HTTP2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define HTTP2_FRAME_HEADER_SIZE 9
+
+#define HTTP2_FRAME_DATA 0x0
+#define HTTP2_FRAME_HEADERS 0x1
+#define HTTP2_FRAME_PRIORITY 0x2
+#define HTTP2_FRAME_RST_STREAM 0x3
+#define HTTP2_FRAME_SETTINGS 0x4
+#define HTTP2_FRAME_PUSH_PROMISE 0x5
+#define HTTP2_FRAME_PING 0x6
+#define HTTP2_FRAME_GOAWAY 0x7
+#define HTTP2_FRAME_WINDOW_UPDATE 0x8
+#define HTTP2_FRAME_CONTINUATION 0x9
+
+#define HTTP2_FLAG_END_STREAM 0x1
+#define HTTP2_FLAG_ACK 0x1
+#define HTTP2_FLAG_END_HEADERS 0x4
+#define HTTP2_FLAG_PADDED 0x8
+#define HTTP2_FLAG_PRIORITY 0x20
+
+#define HTTP2_SETTING_HEADER_TABLE_SIZE 0x1
+#define HTTP2_SETTING_ENABLE_PUSH 0x2
+#define HTTP2_SETTING_MAX_CONCURRENT_STREAMS 0x3
+#define HTTP2_SETTING_INITIAL_WINDOW_SIZE 0x4
+#define HTTP2_SETTING_MAX_FRAME_SIZE 0x5
+
+#define HTTP2_ERROR_NO_ERROR 0x0
+#define HTTP2_ERROR_REFUSED_STREAM 0x7
+#define HTTP2_ERROR_CANCEL 0x8
+
+#define HTTP2_DEFAULT_WINDOW_SIZE 65535
+#define HTTP2_DEFAULT_MAX_FRAME_SIZE 16384
+#define HTTP2_MAX_FRAME_SIZE 16777215
+#define HTTP2_MAX_WINDOW_SIZE 0x7FFFFFFF
+#define HTTP2_MAX_STREAM_ID 0x7FFFFFFF
+// used until the server announces its own limit
+#define HTTP2_DEFAULT_MAX_CONCURRENT_STREAMS 100
+// large enough that a response body isn't throttled by waiting for window updates
+#define HTTP2_RECEIVE_WINDOW_SIZE 1048576
+
+namespace sakit
+{
+	Http2Session::Stream::Stream(int id, HttpSocketThread::Request* request, int64_t sendWindow) :
+		bodyOffset(0),
+		receivedCount(0)
+	{
+		this->id = id;
+		this->request = request;
+		this->sendWindow = sendWindow;
+	}
+
+	Http2Session::Http2Session()
+	{
+		this->reset();
+	}
+
+	Http2Session::~Http2Session()
+	{
+		foreach (Stream*, it, this->streams)
+		{
+			delete (*it);
+		}
+	}
+
+	bool Http2Session::isClosing() const
+	{
+		return (this->goingAway || this->nextStreamId > HTTP2_MAX_STREAM_ID);
+	}
+
+	bool Http2Session::canOpenStream() const
+	{
+		return (!this->isClosing() && this->streams.size() < this->peerMaxConcurrentStreams);
+	}
+
+	int Http2Session::getStreamCount() const
+	{
+		return this->streams.size();
+	}
+
+	void Http2Session::reset()
+	{
+		foreach (Stream*, it, this->streams)
+		{
+			delete (*it);
+		}
+		this->streams.clear();
+		this->encoder.reset();
+		this->decoder.reset();
+		this->input.clear();
+		this->nextStreamId = 1;
+		this->goingAway = false;
+		this->sendWindow = HTTP2_DEFAULT_WINDOW_SIZE;
+		this->receivedCount = 0;
+		this->peerMaxConcurrentStreams = HTTP2_DEFAULT_MAX_CONCURRENT_STREAMS;
+		this->peerInitialWindowSize = HTTP2_DEFAULT_WINDOW_SIZE;
+		this->peerMaxFrameSize = HTTP2_DEFAULT_MAX_FRAME_SIZE;
+		this->headerBlock.clear();
+		this->headerBlockStreamId = 0;
+		this->headerBlockEndStream = false;
+	}
+
+	void Http2Session::start(hstream& output)
+	{
+		output.writeRaw((void*)HTTP2_PREFACE, (int)strlen(HTTP2_PREFACE));
+		// server push is never used, the streams only carry the responses to requests
+		unsigned char settings[12] = {0};
+		settings[1] = HTTP2_SETTING_ENABLE_PUSH;
+		settings[7] = HTTP2_SETTING_INITIAL_WINDOW_SIZE;
+		settings[8] = (unsigned char)((HTTP2_RECEIVE_WINDOW_SIZE >> 24) & 0xFF);
+		settings[9] = (unsigned char)((HTTP2_RECEIVE_WINDOW_SIZE >> 16) & 0xFF);
+		settings[10] = (unsigned char)((HTTP2_RECEIVE_WINDOW_SIZE >> 8) & 0xFF);
+		settings[11] = (unsigned char)(HTTP2_RECEIVE_WINDOW_SIZE & 0xFF);
+		Http2Session::_writeFrameHeader(output, sizeof(settings), HTTP2_FRAME_SETTINGS, 0, 0);
+		output.writeRaw(settings, sizeof(settings));
+		// the connection window can only be changed with an update
+		Http2Session::_writeWindowUpdate(output, 0, HTTP2_RECEIVE_WINDOW_SIZE - HTTP2_DEFAULT_WINDOW_SIZE);
+	}
+
+	void Http2Session::openStream(HttpSocketThread::Request* request, hstream& output)
+	{
+		Stream* stream = new Stream((int)this->nextStreamId, request, this->peerInitialWindowSize);
+		this->nextStreamId += 2;
+		this->streams += stream;
+		request->response->clear();
+		request->response->bodyExpected = (request->method != REQUEST_HEAD);
+		request->response->decodeContent = request->decodeContent;
+		hstream block;
+		this->encoder.encode(request->headerFields, block);
+		int size = (int)block.size();
+		int length = hmin(size, this->peerMaxFrameSize);
+		unsigned char flags = (length == size ? HTTP2_FLAG_END_HEADERS : 0);
+		if (request->body.size() == 0)
+		{
+			flags |= HTTP2_FLAG_END_STREAM;
+		}
+		Http2Session::_writeFrameHeader(output, length, HTTP2_FRAME_HEADERS, flags, stream->id);
+		output.writeRaw(&block[0], length);
+		// header blocks that don't fit into a single frame are continued right away, no other frame may be sent in between
+		int offset = length;
+		while (offset < size)
+		{
+			length = hmin(size - offset, this->peerMaxFrameSize);
+			Http2Session::_writeFrameHeader(output, length, HTTP2_FRAME_CONTINUATION, (offset + length == size ? HTTP2_FLAG_END_HEADERS : 0), stream->id);
+			output.writeRaw(&block[offset], length);
+			offset += length;
+		}
+	}
+
+	void Http2Session::sendData(hstream& output)
+	{
+		int remaining = 0;
+		int length = 0;
+		bool progress = true;
+		// streams take turns so a large body doesn't use up the whole connection window
+		while (progress && this->sendWindow > 0)
+		{
+			progress = false;
+			foreach (Stream*, it, this->streams)
+			{
+				remaining = (*it)->request->body.size() - (*it)->bodyOffset;
+				length = (int)hmin(hmin((int64_t)remaining, (*it)->sendWindow), hmin(this->sendWindow, (int64_t)this->peerMaxFrameSize));
+				if (length <= 0)
+				{
+					continue;
+				}
+				Http2Session::_writeFrameHeader(output, length, HTTP2_FRAME_DATA, (length == remaining ? HTTP2_FLAG_END_STREAM : 0), (*it)->id);
+				output.writeRaw((void*)&(*it)->request->body.cStr()[(*it)->bodyOffset], length);
+				(*it)->bodyOffset += length;
+				(*it)->sendWindow -= length;
+				this->sendWindow -= length;
+				progress = true;
+				if (this->sendWindow <= 0)
+				{
+					break;
+				}
+			}
+		}
+	}
+
+	bool Http2Session::receive(const unsigned char* data, int size, hstream& output, harray<HttpSocketThread::Request*>& finished,
+		harray<HttpSocketThread::Request*>& failed, harray<HttpSocketThread::Request*>& refused)
+	{
+		this->input.seek(0, hseek::End);
+		this->input.writeRaw((void*)data, size);
+		int total = (int)this->input.size();
+		int position = 0;
+		const unsigned char* header = NULL;
+		int length = 0;
+		int streamId = 0;
+		bool success = true;
+		while (success && total - position >= HTTP2_FRAME_HEADER_SIZE)
+		{
+			header = &this->input[position];
+			length = (header[0] << 16) | (header[1] << 8) | header[2];
+			// larger frames were never allowed in the settings
+			if (length > HTTP2_DEFAULT_MAX_FRAME_SIZE)
+			{
+				hlog::warn(logTag, hsprintf("HTTP/2 frame is too large: %d", length));
+				return false;
+			}
+			if (total - position - HTTP2_FRAME_HEADER_SIZE < length)
+			{
+				break; // not enough bytes to read
+			}
+			streamId = (int)(Http2Session::_readUInt32(&header[5]) & HTTP2_MAX_STREAM_ID);
+			if (this->headerBlockStreamId != 0 && (header[3] != HTTP2_FRAME_CONTINUATION || streamId != this->headerBlockStreamId))
+			{
+				hlog::warn(logTag, "HTTP/2 header block was interrupted!");
+				return false;
+			}
+			success = this->_processFrame(header[3], header[4], streamId, &header[HTTP2_FRAME_HEADER_SIZE], length, output, finished, failed, refused);
+			position += HTTP2_FRAME_HEADER_SIZE + length;
+		}
+		if (!success)
+		{
+			return false;
+		}
+		if (position > 0)
+		{
+			// only the beginning of an incomplete frame is kept
+			hstream remaining;
+			if (position < total)
+			{
+				remaining.writeRaw(&this->input[position], total - position);
+			}
+			this->input = remaining;
+		}
+		return true;
+	}
+
+	Http2Session::Stream* Http2Session::_findStream(int id)
+	{
+		foreach (Stream*, it, this->streams)
+		{
+			if ((*it)->id == id)
+			{
+				return (*it);
+			}
+		}
+		return NULL;
+	}
+
+	void Http2Session::_completeStream(Stream* stream, hstream& output, harray<HttpSocketThread::Request*>& finished)
+	{
+		if (stream->bodyOffset < stream->request->body.size())
+		{
+			// the rest of the body isn't needed anymore
+			Http2Session::_writeFrameHeader(output, 4, HTTP2_FRAME_RST_STREAM, 0, stream->id);
+			Http2Session::_writeUInt32(output, HTTP2_ERROR_NO_ERROR);
+		}
+		finished += stream->request;
+		this->_closeStream(stream);
+	}
+
+	void Http2Session::_closeStream(Stream* stream)
+	{
+		this->streams -= stream;
+		delete stream;
+	}
+
+	bool Http2Session::_processFrame(unsigned char type, unsigned char flags, int streamId, const unsigned char* payload, int length, hstream& output,
+		harray<HttpSocketThread::Request*>& finished, harray<HttpSocketThread::Request*>& failed, harray<HttpSocketThread::Request*>& refused)
+	{
+		Stream* stream = NULL;
+		int offset = 0;
+		int padding = 0;
+		unsigned int code = 0;
+		if (type == HTTP2_FRAME_DATA)
+		{
+			return this->_processData(flags, streamId, payload, length, output, finished, failed);
+		}
+		if (type == HTTP2_FRAME_HEADERS)
+		{
+			if (streamId == 0)
+			{
+				return false;
+			}
+			if ((flags & HTTP2_FLAG_PADDED) != 0)
+			{
+				if (length < 1)
+				{
+					return false;
+				}
+				padding = payload[0];
+				offset = 1;
+			}
+			if ((flags & HTTP2_FLAG_PRIORITY) != 0)
+			{
+				offset += 5; // stream dependency and weight aren't used
+			}
+			if (offset + padding > length)
+			{
+				return false;
+			}
+			this->headerBlock.clear();
+			if (length - offset - padding > 0)
+			{
+				this->headerBlock.writeRaw((void*)&payload[offset], length - offset - padding);
+			}
+			this->headerBlockEndStream = ((flags & HTTP2_FLAG_END_STREAM) != 0);
+			if ((flags & HTTP2_FLAG_END_HEADERS) != 0)
+			{
+				return this->_processHeaderBlock(streamId, this->headerBlockEndStream, output, finished);
+			}
+			this->headerBlockStreamId = streamId;
+			return true;
+		}
+		if (type == HTTP2_FRAME_CONTINUATION)
+		{
+			if (this->headerBlockStreamId == 0 || streamId != this->headerBlockStreamId)
+			{
+				return false;
+			}
+			if (length > 0)
+			{
+				this->headerBlock.writeRaw((void*)payload, length);
+			}
+			if ((flags & HTTP2_FLAG_END_HEADERS) != 0)
+			{
+				this->headerBlockStreamId = 0;
+				return this->_processHeaderBlock(streamId, this->headerBlockEndStream, output, finished);
+			}
+			return true;
+		}
+		if (type == HTTP2_FRAME_RST_STREAM)
+		{
+			if (streamId == 0 || length != 4)
+			{
+				return false;
+			}
+			stream = this->_findStream(streamId);
+			if (stream != NULL)
+			{
+				code = Http2Session::_readUInt32(payload);
+				if (code == HTTP2_ERROR_REFUSED_STREAM)
+				{
+					refused += stream->request;
+				}
+				else
+				{
+					hlog::warn(logTag, hsprintf("HTTP/2 stream was reset by the server, error code: %u", code));
+					failed += stream->request;
+				}
+				this->_closeStream(stream);
+			}
+			return true;
+		}
+		if (type == HTTP2_FRAME_SETTINGS)
+		{
+			if (streamId != 0)
+			{
+				return false;
+			}
+			return this->_processSettings(flags, payload, length, output);
+		}
+		if (type == HTTP2_FRAME_PUSH_PROMISE)
+		{
+			hlog::warn(logTag, "HTTP/2 server push was used even though it is disabled!");
+			return false;
+		}
+		if (type == HTTP2_FRAME_PING)
+		{
+			if (streamId != 0 || length != 8)
+			{
+				return false;
+			}
+			if ((flags & HTTP2_FLAG_ACK) == 0)
+			{
+				Http2Session::_writeFrameHeader(output, length, HTTP2_FRAME_PING, HTTP2_FLAG_ACK, 0);
+				output.writeRaw((void*)payload, length);
+			}
+			return true;
+		}
+		if (type == HTTP2_FRAME_GOAWAY)
+		{
+			if (streamId != 0 || length < 8)
+			{
+				return false;
+			}
+			int lastStreamId = (int)(Http2Session::_readUInt32(payload) & HTTP2_MAX_STREAM_ID);
+			code = Http2Session::_readUInt32(&payload[4]);
+			if (code != HTTP2_ERROR_NO_ERROR)
+			{
+				hlog::warn(logTag, hsprintf("HTTP/2 connection is being closed by the server, error code: %u", code));
+			}
+			this->goingAway = true;
+			// streams that weren't processed by the server can be sent again
+			harray<Stream*> streams = this->streams;
+			foreach (Stream*, it, streams)
+			{
+				if ((*it)->id > lastStreamId)
+				{
+					refused += (*it)->request;
+					this->_closeStream(*it);
+				}
+			}
+			return true;
+		}
+		if (type == HTTP2_FRAME_WINDOW_UPDATE)
+		{
+			if (length != 4)
+			{
+				return false;
+			}
+			int64_t increment = (int64_t)(Http2Session::_readUInt32(payload) & HTTP2_MAX_WINDOW_SIZE);
+			if (streamId == 0)
+			{
+				this->sendWindow += increment;
+				return (increment > 0 && this->sendWindow <= HTTP2_MAX_WINDOW_SIZE);
+			}
+			stream = this->_findStream(streamId);
+			if (stream != NULL)
+			{
+				stream->sendWindow += increment;
+				return (increment > 0 && stream->sendWindow <= HTTP2_MAX_WINDOW_SIZE);
+			}
+			return true;
+		}
+		// PRIORITY and unknown frames are ignored
+		return true;
+	}
+
+	bool Http2Session::_processSettings(unsigned char flags, const unsigned char* payload, int length, hstream& output)
+	{
+		if ((flags & HTTP2_FLAG_ACK) != 0)
+		{
+			return (length == 0);
+		}
+		if (length % 6 != 0)
+		{
+			return false;
+		}
+		int id = 0;
+		unsigned int value = 0;
+		for (int i = 0; i < length; i += 6)
+		{
+			id = (payload[i] << 8) | payload[i + 1];
+			value = Http2Session::_readUInt32(&payload[i + 2]);
+			if (id == HTTP2_SETTING_HEADER_TABLE_SIZE)
+			{
+				this->encoder.setMaxTableSize((int)hmin(value, (unsigned int)HPACK_DEFAULT_TABLE_SIZE));
+			}
+			else if (id == HTTP2_SETTING_MAX_CONCURRENT_STREAMS)
+			{
+				this->peerMaxConcurrentStreams = (int)hmin(value, (unsigned int)HTTP2_MAX_STREAM_ID);
+			}
+			else if (id == HTTP2_SETTING_INITIAL_WINDOW_SIZE)
+			{
+				if (value > HTTP2_MAX_WINDOW_SIZE)
+				{
+					return false;
+				}
+				// the change applies to the windows of all open streams
+				int64_t delta = (int64_t)value - this->peerInitialWindowSize;
+				foreach (Stream*, it, this->streams)
+				{
+					(*it)->sendWindow += delta;
+				}
+				this->peerInitialWindowSize = value;
+			}
+			else if (id == HTTP2_SETTING_MAX_FRAME_SIZE)
+			{
+				if (value < HTTP2_DEFAULT_MAX_FRAME_SIZE || value > HTTP2_MAX_FRAME_SIZE)
+				{
+					return false;
+				}
+				this->peerMaxFrameSize = (int)value;
+			}
+		}
+		Http2Session::_writeFrameHeader(output, 0, HTTP2_FRAME_SETTINGS, HTTP2_FLAG_ACK, 0);
+		return true;
+	}
+
+	bool Http2Session::_processHeaderBlock(int streamId, bool endStream, hstream& output, harray<HttpSocketThread::Request*>& finished)
+	{
+		harray<HpackField> fields;
+		// a block has to be decoded even if its stream is gone, otherwise the dynamic table gets out of sync
+		bool success = (this->headerBlock.size() == 0 || this->decoder.decode(&this->headerBlock[0], (int)this->headerBlock.size(), fields));
+		this->headerBlock.clear();
+		if (!success)
+		{
+			hlog::warn(logTag, "HTTP/2 header block could not be decoded!");
+			return false;
+		}
+		Stream* stream = this->_findStream(streamId);
+		if (stream == NULL)
+		{
+			return true;
+		}
+		HttpResponse* response = stream->request->response;
+		stream->request->timer.receive();
+		if (!response->headersComplete)
+		{
+			hstr status;
+			foreach (HpackField, it, fields)
+			{
+				if ((*it).name == ":status")
+				{
+					status = (*it).value;
+					break;
+				}
+			}
+			if (status == "")
+			{
+				hlog::warn(logTag, "HTTP/2 response is missing its status!");
+				return false;
+			}
+			int code = (int)status;
+			if (code >= 100 && code < 200)
+			{
+				return true; // informational, the final response follows in another header block
+			}
+			// the head is written in HTTP/1.1 form so the response is parsed just like any other
+			response->raw.seek(0, hseek::End);
+			int64_t position = response->raw.position();
+			hstr line = "HTTP/2 " + status + " " HTTP_DELIMITER;
+			response->raw.writeRaw((void*)line.cStr(), line.size());
+			foreach (HpackField, it, fields)
+			{
+				// pseudo-headers and connection-specific fields don't belong to the response
+				if ((*it).name.startsWith(":") || (*it).name == "connection" || (*it).name == "transfer-encoding")
+				{
+					continue;
+				}
+				line = (*it).name + ": " + (*it).value + HTTP_DELIMITER;
+				response->raw.writeRaw((void*)line.cStr(), line.size());
+			}
+			response->raw.writeRaw((void*)HTTP_DELIMITER, 2);
+			response->raw.seek(position, hseek::Start);
+			response->parseFromRaw();
+		}
+		// a second header block contains trailers which are ignored
+		if (endStream)
+		{
+			response->bodyComplete = true;
+		}
+		if (response->headersComplete && response->bodyComplete)
+		{
+			this->_completeStream(stream, output, finished);
+		}
+		return true;
+	}
+
+	bool Http2Session::_processData(unsigned char flags, int streamId, const unsigned char* payload, int length, hstream& output,
+		harray<HttpSocketThread::Request*>& finished, harray<HttpSocketThread::Request*>& failed)
+	{
+		if (streamId == 0)
+		{
+			return false;
+		}
+		int offset = 0;
+		int padding = 0;
+		if ((flags & HTTP2_FLAG_PADDED) != 0)
+		{
+			if (length < 1)
+			{
+				return false;
+			}
+			padding = payload[0];
+			offset = 1;
+		}
+		if (offset + padding > length)
+		{
+			return false;
+		}
+		// the whole frame counts against the windows, including the padding
+		this->receivedCount += length;
+		if (this->receivedCount > HTTP2_RECEIVE_WINDOW_SIZE)
+		{
+			hlog::warn(logTag, "HTTP/2 server exceeded the flow control window!");
+			return false;
+		}
+		if (this->receivedCount >= HTTP2_RECEIVE_WINDOW_SIZE / 2)
+		{
+			Http2Session::_writeWindowUpdate(output, 0, this->receivedCount);
+			this->receivedCount = 0;
+		}
+		Stream* stream = this->_findStream(streamId);
+		if (stream == NULL)
+		{
+			return true;
+		}
+		bool endStream = ((flags & HTTP2_FLAG_END_STREAM) != 0);
+		stream->receivedCount += length;
+		if (stream->receivedCount >= HTTP2_RECEIVE_WINDOW_SIZE / 2 && !endStream)
+		{
+			Http2Session::_writeWindowUpdate(output, stream->id, stream->receivedCount);
+			stream->receivedCount = 0;
+		}
+		HttpResponse* response = stream->request->response;
+		if (!response->headersComplete)
+		{
+			hlog::warn(logTag, "HTTP/2 response data was received before its headers!");
+			return false;
+		}
+		stream->request->timer.receive();
+		int count = length - offset - padding;
+		if (count > 0 && !response->bodyComplete)
+		{
+			response->raw.seek(0, hseek::End);
+			int64_t position = response->raw.position();
+			response->raw.writeRaw((void*)&payload[offset], count);
+			response->raw.seek(position, hseek::Start);
+			response->parseFromRaw();
+		}
+		if (response->bodyFailed)
+		{
+			// the rest of the response can't be decoded anyway
+			if (!endStream)
+			{
+				Http2Session::_writeFrameHeader(output, 4, HTTP2_FRAME_RST_STREAM, 0, stream->id);
+				Http2Session::_writeUInt32(output, HTTP2_ERROR_CANCEL);
+			}
+			failed += stream->request;
+			this->_closeStream(stream);
+			return true;
+		}
+		if (endStream)
+		{
+			response->bodyComplete = true;
+		}
+		if (response->bodyComplete)
+		{
+			this->_completeStream(stream, output, finished);
+		}
+		return true;
+	}
+
+	void Http2Session::_writeFrameHeader(hstream& output, int length, unsigned char type, unsigned char flags, int streamId)
+	{
+		unsigned char header[HTTP2_FRAME_HEADER_SIZE];
+		header[0] = (unsigned char)((length >> 16) & 0xFF);
+		header[1] = (unsigned char)((length >> 8) & 0xFF);
+		header[2] = (unsigned char)(length & 0xFF);
+		header[3] = type;
+		header[4] = flags;
+		output.writeRaw(header, 5);
+		Http2Session::_writeUInt32(output, (unsigned int)streamId & HTTP2_MAX_STREAM_ID);
+	}
+
+	void Http2Session::_writeWindowUpdate(hstream& output, int streamId, int increment)
+	{
+		Http2Session::_writeFrameHeader(output, 4, HTTP2_FRAME_WINDOW_UPDATE, 0, streamId);
+		Http2Session::_writeUInt32(output, (unsigned int)increment);
+	}
+
+	void Http2Session::_writeUInt32(hstream& output, unsigned int value)
+	{
+		unsigned char data[4];
+		data[0] = (unsigned char)((value >> 24) & 0xFF);
+		data[1] = (unsigned char)((value >> 16) & 0xFF);
+		data[2] = (unsigned char)((value >> 8) & 0xFF);
+		data[3] = (unsigned char)(value & 0xFF);
+		output.writeRaw(data, 4);
+	}
+
+	unsigned int Http2Session::_readUInt32(const unsigned char* data)
+	{
+		return (((unsigned int)data[0] << 24) | ((unsigned int)data[1] << 16) | ((unsigned int)data[2] << 8) | (unsigned int)data[3]);
+	}
+
+}
@@ -0,0 +1,109 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines the client side of an HTTP/2 connection.
+
+#ifndef SAKIT_HTTP2_SESSION_H
+#define SAKIT_HTTP2_SESSION_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hstream.h>
+#include <hltypes/hstring.h>
+
+#include "Hpack.h"
+#include "HttpSocketThread.h"
+
+namespace sakit
+{
+	/// @brief Multiplexes requests as streams over a single connection.
+	/// @note Only frames are produced and consumed here, the thread that owns the session does all the sending and receiving.
+	class Http2Session
+	{
+	public:
+		Http2Session();
+		~Http2Session();
+
+		HL_DEFINE_IS(goingAway, GoingAway);
+		/// @return True if no more streams can be opened and a new connection is required once all open streams are done.
+		bool isClosing() const;
+		bool canOpenStream() const;
+		int getStreamCount() const;
+
+		/// @brief Writes the connection preface and the initial settings to output.
+		void start(hstream& output);
+		void openStream(HttpSocketThread::Request* request, hstream& output);
+		/// @brief Writes as much of the pending request bodies as the flow control windows allow.
+		void sendData(hstream& output);
+		/// @brief Processes received data and writes any frames that have to be sent in reply to output.
+		/// @param finished Requests with a complete response.
+		/// @param failed Requests that were reset by the server.
+		/// @param refused Requests that weren't processed by the server and can be sent again on a new connection.
+		/// @return False if there was a connection error.
+		bool receive(const unsigned char* data, int size, hstream& output, harray<HttpSocketThread::Request*>& finished,
+			harray<HttpSocketThread::Request*>& failed, harray<HttpSocketThread::Request*>& refused);
+		/// @brief Forgets all streams and the state of the connection.
+		void reset();
+
+	protected:
+		class Stream
+		{
+		public:
+			int id;
+			HttpSocketThread::Request* request;
+			int64_t sendWindow;
+			int bodyOffset;
+			/// @note Received data that hasn't been given back to the server with a WINDOW_UPDATE yet.
+			int receivedCount;
+
+			Stream(int id, HttpSocketThread::Request* request, int64_t sendWindow);
+
+		};
+
+		harray<Stream*> streams;
+		HpackEncoder encoder;
+		HpackDecoder decoder;
+		hstream input;
+		int64_t nextStreamId;
+		bool goingAway;
+		int64_t sendWindow;
+		int receivedCount;
+		int peerMaxConcurrentStreams;
+		int64_t peerInitialWindowSize;
+		int peerMaxFrameSize;
+		/// @note A header block that is continued in CONTINUATION frames.
+		hstream headerBlock;
+		int headerBlockStreamId;
+		bool headerBlockEndStream;
+
+		Stream* _findStream(int id);
+		/// @brief Reports the request as finished and resets the stream if the server answered before the whole body was sent.
+		void _completeStream(Stream* stream, hstream& output, harray<HttpSocketThread::Request*>& finished);
+		void _closeStream(Stream* stream);
+
+		bool _processFrame(unsigned char type, unsigned char flags, int streamId, const unsigned char* payload, int length, hstream& output,
+			harray<HttpSocketThread::Request*>& finished, harray<HttpSocketThread::Request*>& failed, harray<HttpSocketThread::Request*>& refused);
+		bool _processSettings(unsigned char flags, const unsigned char* payload, int length, hstream& output);
+		bool _processHeaderBlock(int streamId, bool endStream, hstream& output, harray<HttpSocketThread::Request*>& finished);
+		bool _processData(unsigned char flags, int streamId, const unsigned char* payload, int length, hstream& output,
+			harray<HttpSocketThread::Request*>& finished, harray<HttpSocketThread::Request*>& failed);
+
+		static void _writeFrameHeader(hstream& output, int length, unsigned char type, unsigned char flags, int streamId);
+		static void _writeWindowUpdate(hstream& output, int streamId, int increment);
+		static void _writeUInt32(hstream& output, unsigned int value);
+		static unsigned int _readUInt32(const unsigned char* data);
+
+	private:
+		Http2Session(const Http2Session& other); // prevents copying
+
+	};
+
+}
+#endif
@@ -0,0 +1,623 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <hltypes/harray.h>
+#include <hltypes/hdir.h>
+#include <hltypes/hexception.h>
+#include <hltypes/hfile.h>
+#include <hltypes/hlog.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hstring.h>
+
+#include "HttpCache.h"
+#include "HttpResponse.h"
+#include "HttpSocket.h"
+#include "sakit.h"
+
+#define CACHE_FILE_EXTENSION ".cache"
+#define CACHE_FILE_VERSION 1
+#define CACHE_FILE_BUFFER_SIZE 16384
+
+namespace sakit
+{
+	static const char* _monthNames[] = {"jan", "feb", "mar", "apr", "may", "jun", "jul", "aug", "sep", "oct", "nov", "dec"};
+
+	static hstr _findHeader(const hmap<hstr, hstr>& headers, chstr name)
+	{
+		hstr lowerName = name.lowered();
+		foreachc_m (hstr, it, headers)
+		{
+			if (it->first.lowered() == lowerName)
+			{
+				return it->second;
+			}
+		}
+		return "";
+	}
+
+	int64_t HttpCache::DefaultMaxMemorySize = 16777216LL; // 16 MB
+
+	HttpCache::Entry::Entry(chstr key, HttpResponse* response) :
+		storedTime(0LL),
+		apparentAge(0LL),
+		freshnessLifetime(0LL)
+	{
+		this->key = key;
+		this->response = response;
+	}
+
+	HttpCache::Entry::~Entry()
+	{
+		delete this->response;
+	}
+
+	void HttpCache::Entry::update()
+	{
+		int64_t now = htime();
+		this->storedTime = now;
+		int64_t date = HttpCache::_parseHttpDate(this->response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_DATE, ""));
+		if (date < 0)
+		{
+			date = now;
+		}
+		int64_t age = (int64_t)(int)this->response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_AGE, "0");
+		this->apparentAge = hmax(hmax(now - date, (int64_t)0), age);
+		hstr cacheControl = this->response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_CACHE_CONTROLE, "").lowered();
+		this->freshnessLifetime = 0LL;
+		if (!HttpCache::_hasDirective(cacheControl, "no-cache"))
+		{
+			int64_t maxAge = HttpCache::_findDirectiveValue(cacheControl, "max-age");
+			if (maxAge >= 0)
+			{
+				this->freshnessLifetime = maxAge;
+			}
+			else
+			{
+				int64_t expires = HttpCache::_parseHttpDate(this->response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_EXPIRES, ""));
+				if (expires >= 0)
+				{
+					this->freshnessLifetime = hmax(expires - date, (int64_t)0);
+				}
+			}
+		}
+	}
+
+	bool HttpCache::Entry::isFresh(int64_t now) const
+	{
+		return (this->freshnessLifetime > this->apparentAge + hmax(now - this->storedTime, (int64_t)0));
+	}
+
+	int64_t HttpCache::Entry::getSize() const
+	{
+		return this->response->body.size();
+	}
+
+	HttpCache::HttpCache(chstr diskPath) :
+		memorySize(0LL)
+	{
+		this->maxMemorySize = HttpCache::DefaultMaxMemorySize;
+		this->setDiskPath(diskPath);
+	}
+
+	HttpCache::~HttpCache()
+	{
+		foreach (Entry*, it, this->entries)
+		{
+			delete (*it);
+		}
+	}
+
+	void HttpCache::setMaxMemorySize(int64_t value)
+	{
+		hmutex::ScopeLock lock(&this->mutex);
+		this->maxMemorySize = hmax(value, (int64_t)0);
+		this->_evict();
+	}
+
+	void HttpCache::setDiskPath(chstr value)
+	{
+		hmutex::ScopeLock lock(&this->mutex);
+		this->diskPath = value;
+		if (this->diskPath != "" && !hdir::exists(this->diskPath))
+		{
+			hdir::create(this->diskPath);
+		}
+	}
+
+	int64_t HttpCache::getMemorySize()
+	{
+		hmutex::ScopeLock lock(&this->mutex);
+		return this->memorySize;
+	}
+
+	int HttpCache::getEntryCount()
+	{
+		hmutex::ScopeLock lock(&this->mutex);
+		return this->entries.size();
+	}
+
+	void HttpCache::clear()
+	{
+		hmutex::ScopeLock lock(&this->mutex);
+		foreach (Entry*, it, this->entries)
+		{
+			delete (*it);
+		}
+		this->entries.clear();
+		this->memorySize = 0LL;
+		if (this->diskPath != "" && hdir::exists(this->diskPath))
+		{
+			harray<hstr> files = hdir::files(this->diskPath, true);
+			foreach (hstr, it, files)
+			{
+				if ((*it).endsWith(CACHE_FILE_EXTENSION))
+				{
+					hfile::remove(*it);
+				}
+			}
+		}
+	}
+
+	bool HttpCache::_lookup(const Url& url, const hmap<hstr, hstr>& requestHeaders, HttpResponse* response, hmap<hstr, hstr>& validators)
+	{
+		hmutex::ScopeLock lock(&this->mutex);
+		Entry* entry = this->_find(url.toString(), requestHeaders);
+		if (entry == NULL)
+		{
+			return false;
+		}
+		this->_touch(entry);
+		if (!HttpCache::_hasDirective(_findHeader(requestHeaders, SAKIT_HTTP_REQUEST_HEADER_CACHE_CONTROL).lowered(), "no-cache") && entry->isFresh(htime()))
+		{
+			this->_copyResponse(entry, response);
+			return true;
+		}
+		hstr value = entry->response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_E_TAG, "");
+		if (value != "")
+		{
+			validators[SAKIT_HTTP_REQUEST_HEADER_IF_NONE_MATCH] = value;
+		}
+		value = entry->response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_LAST_MODIFIED, "");
+		if (value != "")
+		{
+			validators[SAKIT_HTTP_REQUEST_HEADER_IF_MODIFIED_SINCE] = value;
+		}
+		return false;
+	}
+
+	void HttpCache::_store(const Url& url, const hmap<hstr, hstr>& requestHeaders, HttpResponse* response)
+	{
+		if (!HttpCache::_isCacheable(response))
+		{
+			return;
+		}
+		hmutex::ScopeLock lock(&this->mutex);
+		hstr key = url.toString();
+		Entry* entry = this->_find(key, requestHeaders);
+		if (entry != NULL)
+		{
+			this->_remove(entry);
+		}
+		entry = new Entry(key, response->clone());
+		entry->response->raw.clear(); // not needed anymore
+		entry->varyHeaders = HttpCache::_makeVaryHeaders(response, requestHeaders);
+		entry->update();
+		if (this->diskPath != "")
+		{
+			this->_saveToDisk(entry);
+		}
+		if (entry->getSize() > this->maxMemorySize)
+		{
+			delete entry;
+			return;
+		}
+		this->_add(entry);
+	}
+
+	bool HttpCache::_revalidate(const Url& url, const hmap<hstr, hstr>& requestHeaders, HttpResponse* response)
+	{
+		hmutex::ScopeLock lock(&this->mutex);
+		Entry* entry = this->_find(url.toString(), requestHeaders);
+		if (entry == NULL)
+		{
+			return false;
+		}
+		// the 304 response carries updated freshness information and validators
+		harray<hstr> names = response->headers.keys();
+		harray<hstr> values = response->headers.values();
+		hstr name;
+		for_iter (i, 0, names.size())
+		{
+			name = names[i].lowered();
+			if (name != "content-length" && name != "transfer-encoding" && name != "content-encoding" && name != "connection")
+			{
+				entry->response->headers.set(names[i], values[i]);
+			}
+		}
+		entry->update();
+		this->_touch(entry);
+		if (this->diskPath != "")
+		{
+			this->_saveToDisk(entry);
+		}
+		bool connectionClose = response->connectionClose;
+		this->_copyResponse(entry, response);
+		response->connectionClose = connectionClose;
+		return true;
+	}
+
+	HttpCache::Entry* HttpCache::_find(chstr key, const hmap<hstr, hstr>& requestHeaders)
+	{
+		bool matches = false;
+		for (int i = this->entries.size() - 1; i >= 0; --i)
+		{
+			if (this->entries[i]->key == key)
+			{
+				matches = true;
+				foreach_m (hstr, it, this->entries[i]->varyHeaders)
+				{
+					if (_findHeader(requestHeaders, it->first) != it->second)
+					{
+						matches = false;
+						break;
+					}
+				}
+				if (matches)
+				{
+					return this->entries[i];
+				}
+			}
+		}
+		if (this->diskPath == "")
+		{
+			return NULL;
+		}
+		Entry* entry = this->_loadFromDisk(key);
+		if (entry == NULL)
+		{
+			return NULL;
+		}
+		foreach_m (hstr, it, entry->varyHeaders)
+		{
+			if (_findHeader(requestHeaders, it->first) != it->second)
+			{
+				delete entry;
+				return NULL;
+			}
+		}
+		if (entry->getSize() > this->maxMemorySize)
+		{
+			delete entry;
+			return NULL;
+		}
+		this->_add(entry);
+		return entry;
+	}
+
+	void HttpCache::_add(Entry* entry)
+	{
+		this->entries += entry;
+		this->memorySize += entry->getSize();
+		this->_evict();
+	}
+
+	void HttpCache::_remove(Entry* entry)
+	{
+		this->entries -= entry;
+		this->memorySize -= entry->getSize();
+		delete entry;
+	}
+
+	void HttpCache::_touch(Entry* entry)
+	{
+		this->entries -= entry;
+		this->entries += entry;
+	}
+
+	void HttpCache::_evict()
+	{
+		// the most recently used entry is always kept
+		while (this->memorySize > this->maxMemorySize && this->entries.size() > 1)
+		{
+			this->_remove(this->entries.first());
+		}
+	}
+
+	void HttpCache::_copyResponse(Entry* entry, HttpResponse* response)
+	{
+		HttpResponse* cached = entry->response;
+		response->clear();
+		response->protocol = cached->protocol;
+		response->statusCode = cached->statusCode;
+		response->statusMessage = cached->statusMessage;
+		response->headers = cached->headers;
+		response->body = cached->body; // assignment operator is properly implemented for hstream
+		response->body.rewind();
+		response->headersComplete = true;
+		response->bodyComplete = true;
+		response->contentLength = cached->contentLength;
+		response->chunked = cached->chunked;
+	}
+
+	hstr HttpCache::_makeFilename(chstr key)
+	{
+		// FNV-1a is good enough to spread URLs over file names
+		uint64_t hash = 14695981039346656037ULL;
+		for_iter (i, 0, key.size())
+		{
+			hash ^= (unsigned char)key[i];
+			hash *= 1099511628211ULL;
+		}
+		return hdir::joinPath(this->diskPath, hsprintf("%08X%08X", (unsigned int)(hash >> 32), (unsigned int)(hash & 0xFFFFFFFF)) + CACHE_FILE_EXTENSION);
+	}
+
+	HttpCache::Entry* HttpCache::_loadFromDisk(chstr key)
+	{
+		hstr filename = this->_makeFilename(key);
+		if (!hfile::exists(filename))
+		{
+			return NULL;
+		}
+		Entry* entry = NULL;
+		try
+		{
+			hfile file;
+			file.open(filename);
+			// different URLs with the same hash replace each other's file
+			if (file.loadInt32() != CACHE_FILE_VERSION || file.loadString() != key)
+			{
+				return NULL;
+			}
+			entry = new Entry(key, new HttpResponse());
+			int count = file.loadInt32();
+			hstr name;
+			for_iter (i, 0, count)
+			{
+				name = file.loadString();
+				entry->varyHeaders[name] = file.loadString();
+			}
+			entry->storedTime = file.loadInt64();
+			entry->apparentAge = file.loadInt64();
+			entry->freshnessLifetime = file.loadInt64();
+			HttpResponse* response = entry->response;
+			response->protocol = file.loadString();
+			response->statusCode = HttpResponse::Code::fromInt(file.loadInt32());
+			response->statusMessage = file.loadString();
+			count = file.loadInt32();
+			hstr value;
+			for_iter (i, 0, count)
+			{
+				name = file.loadString();
+				value = file.loadString();
+				response->headers.add(name.cStr(), name.size(), value.cStr(), value.size());
+			}
+			response->contentLength = file.loadInt64();
+			response->chunked = file.loadBool();
+			int64_t size = file.loadInt64();
+			response->body.setCapacity(size);
+			unsigned char buffer[CACHE_FILE_BUFFER_SIZE];
+			int read = 0;
+			while (size > 0)
+			{
+				read = file.readRaw(buffer, (int)hmin(size, (int64_t)CACHE_FILE_BUFFER_SIZE));
+				if (read <= 0)
+				{
+					hlog::warn(logTag, "Cached response file is incomplete: " + filename);
+					delete entry;
+					return NULL;
+				}
+				response->body.writeRaw(buffer, read);
+				size -= read;
+			}
+			response->body.rewind();
+			response->headersComplete = true;
+			response->bodyComplete = true;
+		}
+		catch (hexception& e)
+		{
+			hlog::warn(logTag, "Could not load cached response: " + e.getMessage());
+			if (entry != NULL)
+			{
+				delete entry;
+			}
+			return NULL;
+		}
+		return entry;
+	}
+
+	void HttpCache::_saveToDisk(Entry* entry)
+	{
+		hstr filename = this->_makeFilename(entry->key);
+		try
+		{
+			hfile file;
+			file.open(filename, hfaccess::Write);
+			file.dump(CACHE_FILE_VERSION);
+			file.dump(entry->key);
+			file.dump(entry->varyHeaders.size());
+			foreach_m (hstr, it, entry->varyHeaders)
+			{
+				file.dump(it->first);
+				file.dump(it->second);
+			}
+			file.dump(entry->storedTime);
+			file.dump(entry->apparentAge);
+			file.dump(entry->freshnessLifetime);
+			HttpResponse* response = entry->response;
+			file.dump(response->protocol);
+			file.dump((int)response->statusCode.value);
+			file.dump(response->statusMessage);
+			harray<hstr> names = response->headers.keys();
+			harray<hstr> values = response->headers.values();
+			file.dump(names.size());
+			for_iter (i, 0, names.size())
+			{
+				file.dump(names[i]);
+				file.dump(values[i]);
+			}
+			file.dump(response->contentLength);
+			file.dump(response->chunked);
+			file.dump(response->body.size());
+			if (response->body.size() > 0)
+			{
+				file.writeRaw(&response->body[0], (int)response->body.size());
+			}
+		}
+		catch (hexception& e)
+		{
+			hlog::warn(logTag, "Could not save cached response: " + e.getMessage());
+			hfile::remove(filename);
+		}
+	}
+
+	bool HttpCache::_isCacheable(HttpResponse* response)
+	{
+		if (response->statusCode != HttpResponse::Code::Ok || !response->headersComplete || !response->bodyComplete || response->bodyFailed)
+		{
+			return false;
+		}
+		hstr cacheControl = response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_CACHE_CONTROLE, "").lowered();
+		if (HttpCache::_hasDirective(cacheControl, "no-store") || response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_VARY, "").trimmed() == "*")
+		{
+			return false;
+		}
+		// responses that can neither be fresh nor revalidated are useless
+		return (HttpCache::_findDirectiveValue(cacheControl, "max-age") > 0 || response->headers.hasKey(SAKIT_HTTP_RESPONSE_HEADER_EXPIRES) ||
+			response->headers.hasKey(SAKIT_HTTP_RESPONSE_HEADER_E_TAG) || response->headers.hasKey(SAKIT_HTTP_RESPONSE_HEADER_LAST_MODIFIED));
+	}
+
+	hmap<hstr, hstr> HttpCache::_makeVaryHeaders(HttpResponse* response, const hmap<hstr, hstr>& requestHeaders)
+	{
+		hmap<hstr, hstr> result;
+		harray<hstr> names = response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_VARY, "").split(',', -1, true);
+		hstr name;
+		foreach (hstr, it, names)
+		{
+			name = (*it).trimmed().lowered();
+			if (name != "")
+			{
+				result[name] = _findHeader(requestHeaders, name);
+			}
+		}
+		return result;
+	}
+
+	bool HttpCache::_hasDirective(chstr cacheControl, chstr directive)
+	{
+		harray<hstr> directives = cacheControl.split(',', -1, true);
+		hstr value;
+		foreach (hstr, it, directives)
+		{
+			value = (*it).trimmed();
+			if (value == directive || value.startsWith(directive + "="))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	int64_t HttpCache::_findDirectiveValue(chstr cacheControl, chstr directive)
+	{
+		harray<hstr> directives = cacheControl.split(',', -1, true);
+		hstr value;
+		foreach (hstr, it, directives)
+		{
+			value = (*it).trimmed();
+			if (value.startsWith(directive + "="))
+			{
+				value = value(directive.size() + 1, -1).trimmed('"');
+				return (value.isInt() ? (int64_t)value : -1LL);
+			}
+		}
+		return -1LL;
+	}
+
+	int64_t HttpCache::_parseHttpDate(chstr value)
+	{
+		// the tokens are inspected individually so the IMF-fixdate, RFC 850 and asctime formats are all accepted
+		int day = -1;
+		int month = -1;
+		int64_t year = -1;
+		int hour = -1;
+		int minute = -1;
+		int second = -1;
+		harray<hstr> tokens;
+		int start = 0;
+		for_iter (i, 0, value.size() + 1)
+		{
+			if (i == value.size() || value[i] == ' ' || value[i] == ',' || value[i] == '-')
+			{
+				if (i > start)
+				{
+					tokens += value(start, i - start);
+				}
+				start = i + 1;
+			}
+		}
+		harray<hstr> parts;
+		hstr name;
+		foreach (hstr, it, tokens)
+		{
+			if ((*it).contains(':'))
+			{
+				parts = (*it).split(':');
+				if (parts.size() == 3)
+				{
+					hour = (int)parts[0];
+					minute = (int)parts[1];
+					second = (int)parts[2];
+				}
+			}
+			else if ((*it).isInt())
+			{
+				if (day < 0 && (*it).size() <= 2)
+				{
+					day = (int)(*it);
+				}
+				else
+				{
+					year = (int)(*it);
+				}
+			}
+			else if ((*it).size() >= 3)
+			{
+				name = (*it)(0, 3).lowered();
+				for_iter (i, 0, 12)
+				{
+					if (name == _monthNames[i])
+					{
+						month = i + 1;
+						break;
+					}
+				}
+			}
+		}
+		if (year >= 0 && year < 70)
+		{
+			year += 2000;
+		}
+		else if (year >= 70 && year < 100)
+		{
+			year += 1900;
+		}
+		if (day < 1 || day > 31 || month < 1 || year < 1970 || hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60)
+		{
+			return -1LL;
+		}
+		// days since the epoch in the proleptic Gregorian calendar
+		int64_t y = year - (month <= 2 ? 1 : 0);
+		int64_t era = y / 400;
+		int64_t yearOfEra = y - era * 400;
+		int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+		int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+		int64_t days = era * 146097 + dayOfEra - 719468;
+		return (days * 86400 + hour * 3600 + minute * 60 + second);
+	}
+
+}
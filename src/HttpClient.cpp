@@ -0,0 +1,178 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <hltypes/harray.h>
+#include <hltypes/hlog.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hstring.h>
+
+#include "HttpClient.h"
+#include "HttpClientThread.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "HttpSocket.h"
+#include "HttpSocketDelegate.h"
+#include "HttpTiming.h"
+#include "sakit.h"
+
+namespace sakit
+{
+	int HttpClient::DefaultMaxConnections = 16;
+	int HttpClient::DefaultMaxHostConnections = 6;
+
+	HttpClient::HttpClient(HttpSocketDelegate* socketDelegate, int threadCount) :
+		Base(),
+		keepAlive(true),
+		reportProgress(false),
+		contentDecoding(false),
+		connectionCount(0),
+		executingCount(0)
+	{
+		this->socketDelegate = socketDelegate;
+		this->maxConnections = HttpClient::DefaultMaxConnections;
+		this->maxHostConnections = HttpClient::DefaultMaxHostConnections;
+		threadCount = hmax(threadCount, 1);
+		for_iter (i, 0, threadCount)
+		{
+			this->threads += new HttpClientThread(this, &this->timeout, &this->retryFrequency);
+		}
+		foreach (HttpClientThread*, it, this->threads)
+		{
+			(*it)->start();
+		}
+		this->__register();
+	}
+
+	HttpClient::~HttpClient()
+	{
+		this->__unregister();
+		foreach (HttpClientThread*, it, this->threads)
+		{
+			(*it)->executing = false;
+		}
+		foreach (HttpClientThread*, it, this->threads)
+		{
+			(*it)->join();
+			delete (*it);
+		}
+		this->clearQueue();
+	}
+
+	void HttpClient::setMaxConnections(int value)
+	{
+		hmutex::ScopeLock lock(&this->mutexQueue);
+		this->maxConnections = hmax(value, 1);
+	}
+
+	void HttpClient::setMaxHostConnections(int value)
+	{
+		hmutex::ScopeLock lock(&this->mutexQueue);
+		this->maxHostConnections = hmax(value, 1);
+	}
+
+	int HttpClient::getQueuedCount()
+	{
+		hmutex::ScopeLock lock(&this->mutexQueue);
+		return this->queuedRequests.size();
+	}
+
+	int HttpClient::getExecutingCount()
+	{
+		hmutex::ScopeLock lock(&this->mutexQueue);
+		return this->executingCount;
+	}
+
+	void HttpClient::update(float timeDelta)
+	{
+		harray<HttpClientThread::Result*> results;
+		harray<HttpSocket*> sockets;
+		harray<HttpSocket*> progressSockets;
+		harray<HttpResponse*> progressResponses;
+		harray<Url> progressUrls;
+		hmutex::ScopeLock lock;
+		foreach (HttpClientThread*, it, this->threads)
+		{
+			lock.acquire(&(*it)->responseMutex);
+			results += (*it)->finishedResults;
+			(*it)->finishedResults.clear();
+			sockets += (*it)->closedSockets;
+			(*it)->closedSockets.clear();
+			if (this->reportProgress)
+			{
+				foreach (HttpClientThread::Connection*, it2, (*it)->pool)
+				{
+					if ((*it2)->request != NULL && (*it2)->response->hasNewData())
+					{
+						progressSockets += (*it2)->socket;
+						progressResponses += (*it2)->response->clone();
+						progressUrls += (*it2)->request->url;
+						(*it2)->response->consumeNewData();
+					}
+				}
+			}
+			lock.release();
+		}
+		// results are reported before the progress of still running requests, because they were received earlier
+		foreach (HttpClientThread::Result*, it, results)
+		{
+			// some final data might be available
+			if (this->reportProgress && (*it)->response->hasNewData())
+			{
+				this->socketDelegate->onExecuteProgress((*it)->socket, (*it)->response, (*it)->request->url);
+			}
+			// the data can be rewinded after reporting progress
+			(*it)->response->raw.rewind();
+			(*it)->response->body.rewind();
+			if ((*it)->state == State::Finished)
+			{
+				HttpTiming::_record((*it)->request->url, (*it)->response->timing);
+				this->socketDelegate->onExecuteCompleted((*it)->socket, (*it)->response, (*it)->request->url);
+			}
+			else
+			{
+				this->socketDelegate->onExecuteFailed((*it)->socket, (*it)->response, (*it)->request->url);
+			}
+			delete (*it);
+		}
+		for_iter (i, 0, progressResponses.size())
+		{
+			this->socketDelegate->onExecuteProgress(progressSockets[i], progressResponses[i], progressUrls[i]);
+			delete progressResponses[i];
+		}
+		// closed connections are deleted last, because they could have been reported above
+		foreach (HttpSocket*, it, sockets)
+		{
+			delete (*it);
+		}
+	}
+
+	bool HttpClient::executeAsync(const HttpRequest& request)
+	{
+		if (!request.url.isValid())
+		{
+			hlog::warn(logTag, "Cannot execute, URL is not valid!");
+			return false;
+		}
+		hmutex::ScopeLock lock(&this->mutexQueue);
+		this->queuedRequests += request.clone();
+		return true;
+	}
+
+	void HttpClient::clearQueue()
+	{
+		hmutex::ScopeLock lock(&this->mutexQueue);
+		harray<HttpRequest*> requests = this->queuedRequests;
+		this->queuedRequests.clear();
+		lock.release();
+		foreach (HttpRequest*, it, requests)
+		{
+			delete (*it);
+		}
+	}
+
+}
@@ -0,0 +1,515 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <hltypes/harray.h>
+#include <hltypes/hlog.h>
+#include <hltypes/hstream.h>
+#include <hltypes/hthread.h>
+
+#include "HttpClient.h"
+#include "HttpClientThread.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "HttpSocket.h"
+#include "HttpSocketThread.h"
+#include "PlatformSocket.h"
+#include "Resolver.h"
+#include "sakit.h"
+#include "State.h"
+
+namespace sakit
+{
+	extern harray<Base*> connections;
+	extern hmutex connectionsMutex;
+	extern hmutex updateMutex;
+
+	/// @return True if sending the request a second time doesn't cause any additional side effects.
+	static bool _isIdempotent(chstr method)
+	{
+		return (method == SAKIT_HTTP_REQUEST_METHOD_GET || method == SAKIT_HTTP_REQUEST_METHOD_HEAD || method == SAKIT_HTTP_REQUEST_METHOD_OPTIONS ||
+			method == SAKIT_HTTP_REQUEST_METHOD_PUT || method == SAKIT_HTTP_REQUEST_METHOD_DELETE || method == SAKIT_HTTP_REQUEST_METHOD_TRACE);
+	}
+
+	HttpClientThread::Connection::Connection(chstr key, Host remoteHost, unsigned short remotePort) :
+		socket(NULL),
+		state(State::Idle),
+		request(NULL),
+		lastActivity(0LL),
+		resolving(false),
+		resolveDuration(0LL),
+		reused(false)
+	{
+		this->key = key;
+		this->remoteHost = remoteHost;
+		this->remotePort = remotePort;
+		this->stream = new hstream();
+		this->response = new HttpResponse();
+	}
+
+	HttpClientThread::Connection::~Connection()
+	{
+		if (this->request != NULL)
+		{
+			delete this->request;
+		}
+		delete this->stream;
+		delete this->response;
+	}
+
+	HttpClientThread::Result::Result(HttpSocket* socket, HttpRequest* request, HttpResponse* response, State state)
+	{
+		this->socket = socket;
+		this->request = request;
+		this->response = response;
+		this->state = state;
+	}
+
+	HttpClientThread::Result::~Result()
+	{
+		delete this->request;
+		delete this->response;
+	}
+
+	HttpClientThread::HttpClientThread(HttpClient* client, float* timeout, float* retryFrequency) :
+		TimedThread(NULL, timeout, retryFrequency)
+	{
+		this->name = "SAKit HTTP client";
+		this->client = client;
+	}
+
+	HttpClientThread::~HttpClientThread()
+	{
+		foreach (Connection*, it, this->pool)
+		{
+			if ((*it)->socket != NULL)
+			{
+				delete (*it)->socket;
+			}
+			delete (*it);
+		}
+		foreach (Result*, it, this->finishedResults)
+		{
+			delete (*it);
+		}
+		foreach (HttpSocket*, it, this->closedSockets)
+		{
+			delete (*it);
+		}
+	}
+
+	void HttpClientThread::_updateProcess()
+	{
+		harray<Connection*> pool;
+		bool active = false;
+		while (this->isRunning() && this->executing)
+		{
+			this->_assignRequests();
+			active = false;
+			pool = this->pool;
+			foreach (Connection*, it, pool)
+			{
+				if (this->_updateConnection(*it))
+				{
+					active = true;
+				}
+			}
+			// only waits if none of the connections made any progress
+			if (!active)
+			{
+				hthread::sleep(*this->retryFrequency * 1000.0f);
+			}
+		}
+		pool = this->pool;
+		foreach (Connection*, it, pool)
+		{
+			this->_closeConnection(*it);
+		}
+		hmutex::ScopeLock lock(&this->resultMutex);
+		this->result = State::Finished;
+	}
+
+	void HttpClientThread::_assignRequests()
+	{
+		hmutex::ScopeLock lock(&this->client->mutexQueue);
+		if (this->client->queuedRequests.size() == 0)
+		{
+			return;
+		}
+		// the connection limit is split between threads so requests are spread over all of them
+		int threadCount = this->client->threads.size();
+		int maxThreadConnections = (this->client->maxConnections + threadCount - 1) / threadCount;
+		harray<Connection*> started;
+		harray<Connection*> created;
+		harray<HttpRequest*> requests = this->client->queuedRequests;
+		hmutex::ScopeLock lockResponse;
+		Connection* connection = NULL;
+		unsigned short port = 0;
+		hstr key;
+		foreach (HttpRequest*, it, requests)
+		{
+			port = (*it)->url.getPort();
+			if (port == 0)
+			{
+				port = ((*it)->url.getscheme() == SAKIT_HTTPS_SCHEME ? HttpSocket::DefaultTlsPort : HttpSocket::DefaultPort);
+			}
+			// the scheme is part of the key since TLS and plain text connections can't be shared
+			key = (*it)->url.getscheme() + (*it)->url.getHost() + ":" + hstr(port);
+			connection = NULL;
+			foreach (Connection*, it2, this->pool)
+			{
+				if ((*it2)->request == NULL && (*it2)->key == key)
+				{
+					connection = (*it2);
+					break;
+				}
+			}
+			if (connection == NULL)
+			{
+				if (this->client->hostConnections.tryGet(key, 0) >= this->client->maxHostConnections)
+				{
+					continue;
+				}
+				if (this->client->connectionCount >= this->client->maxConnections || this->pool.size() >= maxThreadConnections)
+				{
+					// an idle connection to a different host has to make room
+					foreach (Connection*, it2, this->pool)
+					{
+						if ((*it2)->request == NULL)
+						{
+							connection = (*it2);
+							break;
+						}
+					}
+					if (connection == NULL)
+					{
+						continue;
+					}
+					// the queue is still locked here
+					this->_closeConnectionLocked(connection);
+				}
+				connection = new Connection(key, Host((*it)->url.getHost()), port);
+				this->client->hostConnections[key] = this->client->hostConnections.tryGet(key, 0) + 1;
+				++this->client->connectionCount;
+				lockResponse.acquire(&this->responseMutex);
+				this->pool += connection;
+				lockResponse.release();
+				created += connection;
+			}
+			this->client->queuedRequests -= (*it);
+			++this->client->executingCount;
+			lockResponse.acquire(&this->responseMutex);
+			connection->request = (*it);
+			lockResponse.release();
+			started += connection;
+		}
+		lock.release();
+		// the sockets are created outside of the queue lock, because they have to be unregistered from the global updates
+		hmutex::ScopeLock lockUpdate;
+		foreach (Connection*, it, created)
+		{
+			(*it)->socket = new HttpSocket(this->client->socketDelegate);
+			lockUpdate.acquire(&updateMutex);
+			lock.acquire(&connectionsMutex);
+			connections -= (*it)->socket;
+			lock.release();
+			lockUpdate.release();
+			(*it)->socket->setTimeout(*this->timeout, *this->retryFrequency);
+			(*it)->socket->remotePort = (*it)->remotePort;
+		}
+		foreach (Connection*, it, started)
+		{
+			this->_startRequest(*it);
+		}
+	}
+
+	void HttpClientThread::_startRequest(Connection* connection)
+	{
+		HttpRequest* request = connection->request;
+		connection->socket->keepAlive = this->client->keepAlive;
+		connection->socket->contentDecoding = this->client->contentDecoding;
+		// the host name has to be set since the connection is made to an already resolved address
+		connection->socket->socket->setTlsEnabled(request->url.getscheme() == SAKIT_HTTPS_SCHEME, request->url.getHost());
+		connection->stream->clear(connection->stream->getCapacity());
+		connection->socket->_processRequest(*connection->stream, request->method, request->url, request->body, request->headers);
+		connection->stream->rewind();
+		hmutex::ScopeLock lock(&this->responseMutex);
+		connection->response->clear();
+		connection->response->bodyExpected = (request->method != SAKIT_HTTP_REQUEST_METHOD_HEAD);
+		connection->response->decodeContent = this->client->contentDecoding;
+		lock.release();
+		// a persistent connection could have been closed by the server in the meantime so a failure can be retried once
+		connection->reused = connection->socket->socket->isConnected();
+		connection->state = (connection->reused ? State::Sending : State::Idle);
+		connection->lastActivity = htickCount();
+		connection->timer.reset();
+		if (connection->reused)
+		{
+			connection->timer.beginSend();
+		}
+	}
+
+	bool HttpClientThread::_updateConnection(Connection* connection)
+	{
+		if (connection->request == NULL)
+		{
+			if (connection->socket->socket->checkRemoteClosed())
+			{
+				this->_closeConnection(connection);
+				return true;
+			}
+			return false;
+		}
+		if (connection->state == State::Idle || connection->state == State::Connecting)
+		{
+			return this->_updateConnect(connection);
+		}
+		if (connection->state == State::Sending)
+		{
+			return this->_updateSend(connection);
+		}
+		return this->_updateReceive(connection);
+	}
+
+	bool HttpClientThread::_updateConnect(Connection* connection)
+	{
+		PlatformSocket* socket = connection->socket->socket;
+		if (connection->state == State::Idle)
+		{
+			if (!connection->resolving)
+			{
+				connection->lastActivity = htickCount();
+				connection->timer.beginConnect();
+				connection->resolving = true;
+			}
+			// the lookup runs in the background so a slow DNS server doesn't hold up the other connections
+			harray<Host> addresses;
+			bool finished = false;
+			if (!Resolver::poll(connection->remoteHost.toString(), addresses, finished))
+			{
+				connection->resolving = false;
+				this->_failRequest(connection);
+				return true;
+			}
+			if (!finished)
+			{
+				if (htickCount() - connection->lastActivity >= (int64_t)(*this->timeout * 1000.0f))
+				{
+					hlog::error(logTag, "Unable to resolve '" + connection->remoteHost.toString() + "', timed out.");
+					connection->resolving = false;
+					this->_failRequest(connection);
+					return true;
+				}
+				return false;
+			}
+			connection->resolving = false;
+			connection->resolveDuration = htickCount() - connection->lastActivity;
+			// the address is already known, startConnect() doesn't have to wait for anything
+			if (!socket->startConnect(Resolver::getPreferredAddress(addresses), connection->remotePort))
+			{
+				this->_failRequest(connection);
+				return true;
+			}
+			connection->state = State::Connecting;
+		}
+		bool finished = false;
+		if (!socket->pollConnect(finished, connection->socket->localHost, connection->socket->localPort))
+		{
+			this->_failRequest(connection);
+			return true;
+		}
+		if (!finished)
+		{
+			if (htickCount() - connection->lastActivity >= (int64_t)(*this->timeout * 1000.0f))
+			{
+				hlog::error(logTag, "Unable to connect, timed out.");
+				this->_failRequest(connection);
+				return true;
+			}
+			return false;
+		}
+		connection->state = State::Sending;
+		connection->lastActivity = htickCount();
+		connection->timer.endConnect(connection->resolveDuration);
+		connection->timer.beginSend();
+		return true;
+	}
+
+	bool HttpClientThread::_updateSend(Connection* connection)
+	{
+		int sent = 0;
+		int count = (int)(connection->stream->size() - connection->stream->position());
+		if (!connection->socket->socket->send(connection->stream, count, sent))
+		{
+			this->_failRequest(connection);
+			return true;
+		}
+		if (connection->stream->eof())
+		{
+			connection->state = State::Receiving;
+			connection->lastActivity = htickCount();
+			connection->timer.endSend();
+			return true;
+		}
+		if (sent > 0)
+		{
+			connection->lastActivity = htickCount();
+			return true;
+		}
+		if (htickCount() - connection->lastActivity >= (int64_t)(*this->timeout * 1000.0f))
+		{
+			this->_failRequest(connection);
+			return true;
+		}
+		return false;
+	}
+
+	bool HttpClientThread::_updateReceive(Connection* connection)
+	{
+		PlatformSocket* socket = connection->socket->socket;
+		HttpResponse* response = connection->response;
+		int maxCount = HTTP_SOCKET_THREAD_BUFFER_SIZE;
+		this->buffer.clear(maxCount);
+		bool connected = socket->receive(&this->buffer, maxCount);
+		hmutex::ScopeLock lock;
+		int64_t position = 0LL;
+		bool complete = false;
+		if (this->buffer.size() > 0)
+		{
+			connection->timer.receive();
+			this->buffer.rewind();
+			lock.acquire(&this->responseMutex);
+			position = response->raw.position();
+			response->raw.seek(0, hseek::End);
+			response->raw.writeRaw(this->buffer);
+			response->raw.seek(position, hseek::Start);
+			response->parseFromRaw();
+			complete = (response->headersComplete && response->bodyComplete);
+			lock.release();
+			connection->lastActivity = htickCount();
+			if (complete)
+			{
+				// a body that couldn't be decoded also closes the connection
+				bool close = (!this->client->keepAlive || response->connectionClose);
+				this->_finishRequest(connection, (response->bodyFailed ? State::Failed : State::Finished));
+				if (close)
+				{
+					this->_closeConnection(connection);
+				}
+				else
+				{
+					connection->state = State::Connected;
+				}
+			}
+			return true;
+		}
+		if (connected && !socket->checkRemoteClosed())
+		{
+			if (htickCount() - connection->lastActivity < (int64_t)(*this->timeout * 1000.0f))
+			{
+				return false;
+			}
+			hlog::warn(logTag, "Timed out while waiting for data.");
+		}
+		lock.acquire(&this->responseMutex);
+		if (response->headersComplete && response->contentLength < 0 && !response->chunked && response->body.size() > 0)
+		{
+			// let's say it's complete, we don't know its supposed length anyway
+			hlog::warn(logTag, "HttpSocket did not return header '" SAKIT_HTTP_RESPONSE_HEADER_CONTENT_LENGTH "'! Body might be incomplete, but will be considered complete.");
+			response->bodyComplete = true;
+		}
+		complete = (response->headersComplete && response->bodyComplete);
+		lock.release();
+		if (complete)
+		{
+			// the end of such a body can't be determined on a persistent connection
+			this->_finishRequest(connection, State::Finished);
+			this->_closeConnection(connection);
+		}
+		else
+		{
+			this->_failRequest(connection);
+		}
+		return true;
+	}
+
+	void HttpClientThread::_finishRequest(Connection* connection, State result)
+	{
+		hmutex::ScopeLock lock(&this->client->mutexQueue);
+		--this->client->executingCount;
+		lock.release();
+		lock.acquire(&this->responseMutex);
+		if (result == State::Finished)
+		{
+			connection->timer.finish(connection->response->timing);
+		}
+		this->finishedResults += new Result(connection->socket, connection->request, connection->response, result);
+		connection->request = NULL;
+		connection->response = new HttpResponse();
+	}
+
+	void HttpClientThread::_failRequest(Connection* connection)
+	{
+		connection->socket->socket->disconnect();
+		hmutex::ScopeLock lock(&this->responseMutex);
+		bool retry = (connection->reused && connection->response->raw.size() == 0);
+		lock.release();
+		// a request that might have reached the server is only sent again if that can't cause any additional side effects
+		if (retry && connection->stream->position() > 0 && !_isIdempotent(connection->request->method))
+		{
+			retry = false;
+		}
+		if (retry)
+		{
+			// the server closed the persistent connection before this request was processed
+			connection->reused = false;
+			connection->state = State::Idle;
+			connection->stream->rewind();
+			return;
+		}
+		this->_finishRequest(connection, State::Failed);
+		this->_closeConnection(connection);
+	}
+
+	void HttpClientThread::_closeConnection(Connection* connection)
+	{
+		hmutex::ScopeLock lock(&this->client->mutexQueue);
+		this->_closeConnectionLocked(connection);
+	}
+
+	void HttpClientThread::_closeConnectionLocked(Connection* connection)
+	{
+		if (connection->socket != NULL)
+		{
+			connection->socket->socket->disconnect();
+		}
+		--this->client->connectionCount;
+		int count = this->client->hostConnections.tryGet(connection->key, 0) - 1;
+		if (count > 0)
+		{
+			this->client->hostConnections[connection->key] = count;
+		}
+		else
+		{
+			this->client->hostConnections.removeKey(connection->key);
+		}
+		if (connection->request != NULL)
+		{
+			--this->client->executingCount;
+		}
+		hmutex::ScopeLock lock(&this->responseMutex);
+		this->pool -= connection;
+		if (connection->socket != NULL)
+		{
+			// deleted by HttpClient::update() after the last report that could use it
+			this->closedSockets += connection->socket;
+		}
+		lock.release();
+		delete connection;
+	}
+
+}
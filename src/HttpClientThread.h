@@ -0,0 +1,109 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a thread that drives multiple HTTP connections of an HttpClient.
+
+#ifndef SAKIT_HTTP_CLIENT_THREAD_H
+#define SAKIT_HTTP_CLIENT_THREAD_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hstream.h>
+#include <hltypes/hstring.h>
+
+#include "Host.h"
+#include "HttpPhaseTimer.h"
+#include "State.h"
+#include "TimedThread.h"
+
+namespace sakit
+{
+	class HttpClient;
+	class HttpRequest;
+	class HttpResponse;
+	class HttpSocket;
+
+	class HttpClientThread : public TimedThread
+	{
+	public:
+		friend class HttpClient;
+
+		/// @brief A pooled connection to one host.
+		class Connection
+		{
+		public:
+			HttpSocket* socket;
+			hstr key;
+			Host remoteHost;
+			unsigned short remotePort;
+			/// @note State::Idle, State::Connecting, State::Sending or State::Receiving.
+			State state;
+			HttpRequest* request;
+			hstream* stream;
+			HttpResponse* response;
+			int64_t lastActivity;
+			/// @note Set while waiting for the resolver before connecting.
+			bool resolving;
+			int64_t resolveDuration;
+			bool reused;
+			HttpPhaseTimer timer;
+
+			Connection(chstr key, Host remoteHost, unsigned short remotePort);
+			~Connection();
+
+		};
+
+		/// @brief A finished request that waits to be reported by HttpClient::update().
+		class Result
+		{
+		public:
+			HttpSocket* socket;
+			HttpRequest* request;
+			HttpResponse* response;
+			State state;
+
+			Result(HttpSocket* socket, HttpRequest* request, HttpResponse* response, State state);
+			~Result();
+
+		};
+
+		HttpClientThread(HttpClient* client, float* timeout, float* retryFrequency);
+		~HttpClientThread();
+
+	protected:
+		HttpClient* client;
+		/// @note Only accessed by this thread, except for the responses which are protected by responseMutex.
+		harray<Connection*> pool;
+		hmutex responseMutex;
+		/// @note Protected by responseMutex.
+		harray<Result*> finishedResults;
+		/// @note Protected by responseMutex.
+		harray<HttpSocket*> closedSockets;
+		hstream buffer;
+
+		void _updateProcess();
+
+		void _assignRequests();
+		bool _updateConnection(Connection* connection);
+		bool _updateConnect(Connection* connection);
+		bool _updateSend(Connection* connection);
+		bool _updateReceive(Connection* connection);
+		void _startRequest(Connection* connection);
+		void _finishRequest(Connection* connection, State result);
+		void _failRequest(Connection* connection);
+		void _closeConnection(Connection* connection);
+		/// @note Has to be called while client->mutexQueue is locked.
+		void _closeConnectionLocked(Connection* connection);
+
+	};
+
+}
+#endif
@@ -0,0 +1,368 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <string.h>
+
+#include <hltypes/harray.h>
+#include <hltypes/hlog.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hsbase.h>
+#include <hltypes/hstring.h>
+#include <hltypes/hthread.h>
+
+#include "HttpDownload.h"
+#include "HttpDownloadDelegate.h"
+#include "HttpDownloadThread.h"
+#include "HttpResponse.h"
+#include "HttpSocket.h"
+#include "sakit.h"
+#include "sakitUtil.h"
+#include "State.h"
+
+#define ALLOCATE_BUFFER_SIZE 16384
+
+namespace sakit
+{
+	int HttpDownload::DefaultConnectionCount = 4;
+	int64_t HttpDownload::DefaultMinSegmentSize = 1048576LL; // 1 MB
+	int64_t HttpDownload::DefaultMaxSegmentSize = 16777216LL; // 16 MB
+	int HttpDownload::DefaultMaxRetries = 3;
+
+	HttpDownload::Segment::Segment(int64_t offset, int64_t size) :
+		attempts(0)
+	{
+		this->offset = offset;
+		this->size = size;
+	}
+
+	HttpDownload::HttpDownload(HttpDownloadDelegate* downloadDelegate) :
+		Base(),
+		destination(NULL),
+		ranged(false),
+		thread(NULL),
+		activeSegments(0),
+		downloadedSize(0LL),
+		totalSize(-1LL),
+		failed(false)
+	{
+		this->downloadDelegate = downloadDelegate;
+		this->connectionCount = HttpDownload::DefaultConnectionCount;
+		this->minSegmentSize = HttpDownload::DefaultMinSegmentSize;
+		this->maxSegmentSize = HttpDownload::DefaultMaxSegmentSize;
+		this->maxRetries = HttpDownload::DefaultMaxRetries;
+		this->__register();
+	}
+
+	HttpDownload::~HttpDownload()
+	{
+		this->__unregister();
+		if (this->thread != NULL)
+		{
+			// segment threads stop after their current segment
+			hmutex::ScopeLock lock(&this->mutexSegments);
+			this->failed = true;
+			lock.release();
+			this->thread->join();
+		}
+		this->_destroyThreads();
+	}
+
+	void HttpDownload::setConnectionCount(int value)
+	{
+		this->connectionCount = hmax(value, 1);
+	}
+
+	bool HttpDownload::isExecuting()
+	{
+		hmutex::ScopeLock lock(&this->mutexState);
+		return (this->state == State::Running);
+	}
+
+	int64_t HttpDownload::getDownloadedSize()
+	{
+		hmutex::ScopeLock lock(&this->mutexSegments);
+		return this->downloadedSize;
+	}
+
+	int64_t HttpDownload::getTotalSize()
+	{
+		hmutex::ScopeLock lock(&this->mutexSegments);
+		return this->totalSize;
+	}
+
+	void HttpDownload::update(float timeDelta)
+	{
+		hmutex::ScopeLock lock(&this->mutexState);
+		if (this->thread == NULL)
+		{
+			return;
+		}
+		hmutex::ScopeLock lockThreadResult(&this->thread->resultMutex);
+		State result = this->thread->result;
+		if (result == State::Running || result == State::Idle)
+		{
+			return;
+		}
+		lockThreadResult.release();
+		this->thread->join();
+		this->_destroyThreads();
+		this->state = State::Idle;
+		Url url = this->url;
+		lock.release();
+		if (result == State::Finished)
+		{
+			this->downloadDelegate->onDownloadCompleted(this, url);
+		}
+		else
+		{
+			this->downloadDelegate->onDownloadFailed(this, url);
+		}
+	}
+
+	bool HttpDownload::execute(Url url, hsbase* destination, const hmap<hstr, hstr>& customHeaders)
+	{
+		if (!this->_start(url, destination, customHeaders))
+		{
+			return false;
+		}
+		bool result = this->_execute();
+		this->_destroyThreads();
+		hmutex::ScopeLock lock(&this->mutexState);
+		this->state = State::Idle;
+		return result;
+	}
+
+	bool HttpDownload::executeAsync(Url url, hsbase* destination, const hmap<hstr, hstr>& customHeaders)
+	{
+		if (!this->_start(url, destination, customHeaders))
+		{
+			return false;
+		}
+		hmutex::ScopeLock lock(&this->mutexState);
+		this->thread = new HttpDownloadThread(this, true, &this->timeout, &this->retryFrequency);
+		this->thread->start();
+		return true;
+	}
+
+	bool HttpDownload::_canExecute()
+	{
+		return _checkState(this->state, State::allowedHttpExecuteStates, "execute");
+	}
+
+	bool HttpDownload::_start(Url& url, hsbase* destination, const hmap<hstr, hstr>& customHeaders)
+	{
+		if (destination == NULL)
+		{
+			hlog::warn(logTag, "Cannot execute, destination is NULL!");
+			return false;
+		}
+		if (!url.isValid())
+		{
+			hlog::warn(logTag, "Cannot execute, URL is not valid!");
+			return false;
+		}
+		hmutex::ScopeLock lock(&this->mutexState);
+		if (!this->_canExecute())
+		{
+			return false;
+		}
+		this->state = State::Running;
+		lock.release();
+		this->url = url;
+		this->destination = destination;
+		this->customHeaders = customHeaders;
+		this->segmentHeaders.clear();
+		this->ranged = false;
+		lock.acquire(&this->mutexSegments);
+		this->queuedSegments.clear();
+		this->activeSegments = 0;
+		this->downloadedSize = 0LL;
+		this->totalSize = -1LL;
+		this->failed = false;
+		lock.release();
+		this->_createThreads();
+		return true;
+	}
+
+	void HttpDownload::_createThreads()
+	{
+		for_iter (i, 0, this->connectionCount)
+		{
+			this->threads += new HttpDownloadThread(this, false, &this->timeout, &this->retryFrequency);
+		}
+	}
+
+	void HttpDownload::_destroyThreads()
+	{
+		if (this->thread != NULL)
+		{
+			delete this->thread;
+			this->thread = NULL;
+		}
+		foreach (HttpDownloadThread*, it, this->threads)
+		{
+			delete (*it);
+		}
+		this->threads.clear();
+	}
+
+	bool HttpDownload::_execute()
+	{
+		if (!this->_prepare())
+		{
+			return false;
+		}
+		hmutex::ScopeLock lock(&this->mutexSegments);
+		if (this->failed)
+		{
+			return false;
+		}
+		int count = hmin(this->queuedSegments.size(), this->threads.size());
+		lock.release();
+		for_iter (i, 0, count)
+		{
+			this->threads[i]->start();
+		}
+		for_iter (i, 0, count)
+		{
+			this->threads[i]->join();
+		}
+		lock.acquire(&this->mutexSegments);
+		return !this->failed;
+	}
+
+	bool HttpDownload::_prepare()
+	{
+		// the first segment thread's connection is used so it can be reused for the first segment
+		HttpSocket* socket = this->threads.first()->httpSocket;
+		HttpResponse* response = this->threads.first()->response;
+		if (!socket->executeHead(response, this->url, "", this->customHeaders))
+		{
+			hlog::error(logTag, "Could not determine download size of: " + this->url.toString());
+			response->clear();
+			return false;
+		}
+		int64_t size = -1LL;
+		bool acceptsRanges = false;
+		hstr validator;
+		if (response->statusCode == HttpResponse::Code::Ok)
+		{
+			size = response->contentLength;
+			acceptsRanges = (size > 0 && response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_ACCEPT_RANGES, "").lowered().contains("bytes"));
+			// weak entity tags can't be used with If-Range
+			validator = response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_E_TAG, "");
+			if (validator == "" || validator.startsWith("W/"))
+			{
+				validator = response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_LAST_MODIFIED, "");
+			}
+		}
+		else
+		{
+			hlog::warn(logTag, "HEAD request returned " + response->statusCode.getName() + ", downloading with a single request: " + this->url.toString());
+		}
+		response->clear();
+		int64_t segmentSize = size;
+		if (acceptsRanges)
+		{
+			segmentSize = (size + this->connectionCount - 1) / this->connectionCount;
+			segmentSize = hmax(hmin(hmax(segmentSize, this->minSegmentSize), this->maxSegmentSize), (int64_t)1);
+		}
+		this->segmentHeaders = this->customHeaders;
+		this->ranged = (acceptsRanges && size > segmentSize);
+		hmutex::ScopeLock lock(&this->mutexSegments);
+		this->totalSize = size;
+		if (!this->ranged)
+		{
+			this->queuedSegments += Segment(0LL, size);
+			return true;
+		}
+		// if the resource changes while downloading, the server responds with the whole new body which is treated as a failure
+		if (validator != "")
+		{
+			this->segmentHeaders[SAKIT_HTTP_REQUEST_HEADER_IF_RANGE] = validator;
+		}
+		for (int64_t offset = 0LL; offset < size; offset += segmentSize)
+		{
+			this->queuedSegments += Segment(offset, hmin(segmentSize, size - offset));
+		}
+		lock.release();
+		return this->_allocateDestination(size);
+	}
+
+	bool HttpDownload::_allocateDestination(int64_t size)
+	{
+		// segments are written out of order so the destination has to be large enough beforehand
+		hmutex::ScopeLock lock(&this->mutexDestination);
+		int64_t current = this->destination->size();
+		if (current >= size)
+		{
+			return true;
+		}
+		unsigned char buffer[ALLOCATE_BUFFER_SIZE];
+		memset(buffer, 0, ALLOCATE_BUFFER_SIZE);
+		this->destination->seek(0, hseek::End);
+		int count = 0;
+		while (current < size)
+		{
+			count = (int)hmin((int64_t)ALLOCATE_BUFFER_SIZE, size - current);
+			if (this->destination->writeRaw(buffer, count) < count)
+			{
+				hlog::error(logTag, "Could not allocate download destination!");
+				return false;
+			}
+			current += count;
+		}
+		return true;
+	}
+
+	bool HttpDownload::_takeSegment(Segment& segment)
+	{
+		hmutex::ScopeLock lock(&this->mutexSegments);
+		while (true)
+		{
+			if (this->failed)
+			{
+				return false;
+			}
+			if (this->queuedSegments.size() > 0)
+			{
+				segment = this->queuedSegments.removeFirst();
+				++this->activeSegments;
+				return true;
+			}
+			// a segment that is still being downloaded could fail and be queued again
+			if (this->activeSegments == 0)
+			{
+				return false;
+			}
+			lock.release();
+			hthread::sleep(this->retryFrequency * 1000.0f);
+			lock.acquire(&this->mutexSegments);
+		}
+	}
+
+	void HttpDownload::_finishSegment(Segment& segment, bool success, int64_t size)
+	{
+		hmutex::ScopeLock lock(&this->mutexSegments);
+		--this->activeSegments;
+		if (success)
+		{
+			this->downloadedSize += size;
+			return;
+		}
+		++segment.attempts;
+		if (segment.attempts > this->maxRetries)
+		{
+			hlog::error(logTag, "Download segment at " + hstr(segment.offset) + " failed too many times: " + this->url.toString());
+			this->failed = true;
+			return;
+		}
+		this->queuedSegments += segment;
+	}
+
+}
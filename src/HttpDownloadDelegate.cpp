@@ -0,0 +1,29 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include "HttpDownloadDelegate.h"
+
+namespace sakit
+{
+	HttpDownloadDelegate::HttpDownloadDelegate()
+	{
+	}
+
+	HttpDownloadDelegate::~HttpDownloadDelegate()
+	{
+	}
+
+	void HttpDownloadDelegate::onDownloadCompleted(HttpDownload* download, Url url)
+	{
+	}
+
+	void HttpDownloadDelegate::onDownloadFailed(HttpDownload* download, Url url)
+	{
+	}
+
+}
@@ -0,0 +1,137 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <hltypes/harray.h>
+#include <hltypes/hlog.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hstring.h>
+#include <hltypes/hthread.h>
+
+#include "HttpDownload.h"
+#include "HttpDownloadThread.h"
+#include "HttpResponse.h"
+#include "HttpSocket.h"
+#include "sakit.h"
+#include "State.h"
+
+namespace sakit
+{
+	extern harray<Base*> connections;
+	extern hmutex connectionsMutex;
+	extern hmutex updateMutex;
+
+	HttpDownloadThread::HttpDownloadThread(HttpDownload* download, bool control, float* timeout, float* retryFrequency) :
+		TimedThread(NULL, timeout, retryFrequency),
+		httpSocket(NULL),
+		response(NULL)
+	{
+		this->name = (control ? "SAKit HTTP download" : "SAKit HTTP download segment");
+		this->download = download;
+		this->control = control;
+		if (!this->control)
+		{
+			// the connection is kept alive so following segments don't have to reconnect
+			this->httpSocket = new HttpSocket(NULL);
+			// the socket is only used synchronously by this thread and must not be updated by sakit::update()
+			hmutex::ScopeLock lockUpdate(&updateMutex);
+			hmutex::ScopeLock lock(&connectionsMutex);
+			connections -= this->httpSocket;
+			lock.release();
+			lockUpdate.release();
+			this->httpSocket->setKeepAlive(true);
+			this->httpSocket->setTimeout(*this->timeout, *this->retryFrequency);
+			this->response = new HttpResponse();
+		}
+	}
+
+	HttpDownloadThread::~HttpDownloadThread()
+	{
+		if (this->httpSocket != NULL)
+		{
+			delete this->httpSocket;
+		}
+		if (this->response != NULL)
+		{
+			delete this->response;
+		}
+	}
+
+	void HttpDownloadThread::_updateProcess()
+	{
+		if (this->control)
+		{
+			bool success = this->download->_execute();
+			hmutex::ScopeLock lock(&this->resultMutex);
+			this->result = (success ? State::Finished : State::Failed);
+			return;
+		}
+		HttpDownload::Segment segment;
+		bool success = false;
+		while (this->executing && this->download->_takeSegment(segment))
+		{
+			success = this->_downloadSegment(segment);
+			this->download->_finishSegment(segment, success, this->response->bodyDestinationOffset - segment.offset);
+			this->response->bodyDestination = NULL;
+			this->response->bodyDestinationMutex = NULL;
+			this->response->clear();
+		}
+		hmutex::ScopeLock lock(&this->resultMutex);
+		this->result = State::Finished;
+	}
+
+	bool HttpDownloadThread::_downloadSegment(HttpDownload::Segment& segment)
+	{
+		hmap<hstr, hstr> headers = this->download->segmentHeaders;
+		if (this->download->ranged)
+		{
+			headers[SAKIT_HTTP_REQUEST_HEADER_RANGE] = "bytes=" + hstr(segment.offset) + "-" + hstr(segment.offset + segment.size - 1);
+		}
+		// the body is written to the destination while it's being received so only a small part of it is kept in memory at once
+		this->response->bodyDestination = this->download->destination;
+		this->response->bodyDestinationMutex = &this->download->mutexDestination;
+		this->response->bodyDestinationOffset = segment.offset;
+		this->response->bodyDestinationEnd = (segment.size >= 0 ? segment.offset + segment.size : -1LL);
+		bool result = false;
+		if (this->httpSocket->isConnected())
+		{
+			result = this->httpSocket->executeGet(this->response, "", headers);
+		}
+		else
+		{
+			result = this->httpSocket->executeGet(this->response, this->download->url, "", headers);
+		}
+		if (!result)
+		{
+			hlog::warn(logTag, "Could not receive download segment at " + hstr(segment.offset) + " from: " + this->download->url.toString());
+			return false;
+		}
+		if (this->download->ranged)
+		{
+			// a server that ignores the Range header or a resource that was changed in the meantime returns 200 with the whole body
+			if (this->response->statusCode != HttpResponse::Code::PartialContent)
+			{
+				hlog::warn(logTag, "Download segment request returned " + this->response->statusCode.getName() + " instead of PartialContent!");
+				return false;
+			}
+		}
+		else if (this->response->statusCode != HttpResponse::Code::Ok)
+		{
+			hlog::warn(logTag, "Download request returned " + this->response->statusCode.getName() + "!");
+			return false;
+		}
+		int64_t size = this->response->bodyDestinationOffset - segment.offset;
+		if (segment.size >= 0 && size != segment.size)
+		{
+			hlog::warn(logTag, "Download segment at " + hstr(segment.offset) + " has " + hstr(size) + " bytes instead of " + hstr(segment.size) + "!");
+			return false;
+		}
+		return true;
+	}
+
+}
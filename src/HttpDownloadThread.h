@@ -0,0 +1,49 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a thread that downloads segments of an HttpDownload.
+
+#ifndef SAKIT_HTTP_DOWNLOAD_THREAD_H
+#define SAKIT_HTTP_DOWNLOAD_THREAD_H
+
+#include <hltypes/hltypesUtil.h>
+
+#include "HttpDownload.h"
+#include "TimedThread.h"
+
+namespace sakit
+{
+	class HttpResponse;
+	class HttpSocket;
+
+	class HttpDownloadThread : public TimedThread
+	{
+	public:
+		friend class HttpDownload;
+
+		/// @param control If true, the thread runs the whole download instead of downloading segments.
+		HttpDownloadThread(HttpDownload* download, bool control, float* timeout, float* retryFrequency);
+		~HttpDownloadThread();
+
+	protected:
+		HttpDownload* download;
+		bool control;
+		/// @note Only used by segment threads.
+		HttpSocket* httpSocket;
+		HttpResponse* response;
+
+		void _updateProcess();
+
+		bool _downloadSegment(HttpDownload::Segment& segment);
+
+	};
+
+}
+#endif
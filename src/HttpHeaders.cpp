@@ -0,0 +1,225 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <hltypes/harray.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hstring.h>
+
+#include "HttpHeaders.h"
+#include "HttpResponse.h"
+
+#define KNOWN_NAME(name) {name, sizeof(name) - 1}
+
+namespace sakit
+{
+	struct _KnownName
+	{
+		const char* name;
+		int length;
+	};
+
+	static const _KnownName _knownNames[] =
+	{
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_LENGTH),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_TRANSFER_ENCODING),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_CONNECTION),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_ENCODING),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_TYPE),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_DATE),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_SERVER),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_CACHE_CONTROLE),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_E_TAG),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_LAST_MODIFIED),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_EXPIRES),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_AGE),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_VARY),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_LOCATION),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_SET_COOKIE),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_ACCEPT_RANGES),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_RANGE),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_ACCESS_CONTROL_ALLOW_ORIGIN),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_ACCEPT_PATCH),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_ALLOW),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_ALT_SVC),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_DISPOSITION),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_LANGUAGE),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_LOCATION),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_MD5),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_LINK),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_P3P),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_PRAGMA),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_PROXY_AUTHENTICATE),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_PUBLIC_KEYS_PINS),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_REFRESH),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_RETRY_AFTER),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_STATUS),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_STRICT_TRANSPORT_SECURITY),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_TRAILER),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_TSV),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_UPGRADE),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_VIA),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_WARNING),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_WWW_AUTHENTICATE),
+		KNOWN_NAME(SAKIT_HTTP_RESPONSE_HEADER_X_FRAME_OPTIONS)
+	};
+
+	static inline char _toLower(char c)
+	{
+		return ((c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c);
+	}
+
+	static bool _equalsIgnoreCase(const char* a, const char* b, int length)
+	{
+		for_iter (i, 0, length)
+		{
+			if (_toLower(a[i]) != _toLower(b[i]))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	HttpHeaders::Entry::Entry(int id, int name, int nameLength, int value, int valueLength)
+	{
+		this->id = id;
+		this->name = name;
+		this->nameLength = nameLength;
+		this->value = value;
+		this->valueLength = valueLength;
+	}
+
+	HttpHeaders::HttpHeaders()
+	{
+	}
+
+	int HttpHeaders::size() const
+	{
+		return this->entries.size();
+	}
+
+	bool HttpHeaders::hasKey(chstr name) const
+	{
+		return (this->_indexOf(name.cStr(), name.size(), HttpHeaders::findId(name.cStr(), name.size())) >= 0);
+	}
+
+	hstr HttpHeaders::tryGet(chstr name, chstr defaultValue) const
+	{
+		int index = this->_indexOf(name.cStr(), name.size(), HttpHeaders::findId(name.cStr(), name.size()));
+		if (index < 0)
+		{
+			return defaultValue;
+		}
+		const Entry& entry = this->entries[index];
+		return hstr(&this->data.cStr()[entry.value], entry.valueLength);
+	}
+
+	hstr HttpHeaders::operator[](chstr name) const
+	{
+		return this->tryGet(name, "");
+	}
+
+	void HttpHeaders::set(chstr name, chstr value)
+	{
+		while (this->remove(name));
+		this->add(name.cStr(), name.size(), value.cStr(), value.size());
+	}
+
+	void HttpHeaders::add(const char* name, int nameLength, const char* value, int valueLength)
+	{
+		int nameOffset = (int)this->data.size();
+		this->data.append(name, nameLength);
+		int valueOffset = (int)this->data.size();
+		this->data.append(value, valueLength);
+		this->entries += Entry(HttpHeaders::findId(name, nameLength), nameOffset, nameLength, valueOffset, valueLength);
+	}
+
+	bool HttpHeaders::remove(chstr name)
+	{
+		int index = this->_indexOf(name.cStr(), name.size(), HttpHeaders::findId(name.cStr(), name.size()));
+		if (index < 0)
+		{
+			return false;
+		}
+		// the data stays in the buffer until the headers are cleared
+		this->entries.removeAt(index);
+		return true;
+	}
+
+	void HttpHeaders::clear()
+	{
+		this->entries.clear();
+		this->data.clear();
+	}
+
+	harray<hstr> HttpHeaders::keys() const
+	{
+		harray<hstr> result;
+		foreachc (Entry, it, this->entries)
+		{
+			result += hstr(&this->data.cStr()[(*it).name], (*it).nameLength);
+		}
+		return result;
+	}
+
+	harray<hstr> HttpHeaders::values() const
+	{
+		harray<hstr> result;
+		foreachc (Entry, it, this->entries)
+		{
+			result += hstr(&this->data.cStr()[(*it).value], (*it).valueLength);
+		}
+		return result;
+	}
+
+	hmap<hstr, hstr> HttpHeaders::toMap() const
+	{
+		hmap<hstr, hstr> result;
+		foreachc (Entry, it, this->entries)
+		{
+			result[hstr(&this->data.cStr()[(*it).name], (*it).nameLength)] = hstr(&this->data.cStr()[(*it).value], (*it).valueLength);
+		}
+		return result;
+	}
+
+	int HttpHeaders::_indexOf(const char* name, int length, int id) const
+	{
+		// searching backwards so the last of multiple fields with the same name is found
+		const Entry* entry = NULL;
+		for (int i = this->entries.size() - 1; i >= 0; --i)
+		{
+			entry = &this->entries[i];
+			if (id >= 0)
+			{
+				if (entry->id == id)
+				{
+					return i;
+				}
+			}
+			else if (entry->id < 0 && entry->nameLength == length && _equalsIgnoreCase(&this->data.cStr()[entry->name], name, length))
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	int HttpHeaders::findId(const char* name, int length)
+	{
+		int count = sizeof(_knownNames) / sizeof(_KnownName);
+		for_iter (i, 0, count)
+		{
+			if (_knownNames[i].length == length && _equalsIgnoreCase(_knownNames[i].name, name, length))
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+}
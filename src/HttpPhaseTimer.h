@@ -0,0 +1,102 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a helper that records when the phases of an HTTP request start and end.
+
+#ifndef SAKIT_HTTP_PHASE_TIMER_H
+#define SAKIT_HTTP_PHASE_TIMER_H
+
+#include <hltypes/hltypesUtil.h>
+
+#include "HttpTiming.h"
+
+namespace sakit
+{
+	/// @note All values are tick counts in milliseconds, -1 if the phase wasn't reached.
+	class HttpPhaseTimer
+	{
+	public:
+		int64_t start;
+		int64_t connecting;
+		int64_t resolved;
+		int64_t connected;
+		int64_t sending;
+		int64_t sent;
+		int64_t received;
+
+		inline HttpPhaseTimer()
+		{
+			this->reset();
+		}
+
+		inline void reset()
+		{
+			this->start = htickCount();
+			this->connecting = -1LL;
+			this->resolved = -1LL;
+			this->connected = -1LL;
+			this->sending = -1LL;
+			this->sent = -1LL;
+			this->received = -1LL;
+		}
+
+		inline void beginConnect()
+		{
+			this->connecting = htickCount();
+		}
+
+		/// @param resolveDuration How long resolving the host took while connecting.
+		inline void endConnect(int64_t resolveDuration)
+		{
+			this->connected = htickCount();
+			this->resolved = hmin(this->connecting + resolveDuration, this->connected);
+		}
+
+		inline void beginSend()
+		{
+			this->sending = htickCount();
+		}
+
+		inline void endSend()
+		{
+			this->sent = htickCount();
+		}
+
+		/// @brief Marks the first received data, later calls have no effect.
+		inline void receive()
+		{
+			if (this->received < 0)
+			{
+				this->received = htickCount();
+			}
+		}
+
+		inline void finish(HttpTiming& timing) const
+		{
+			int64_t now = htickCount();
+			timing.dns = HttpPhaseTimer::_seconds(this->connecting, this->resolved);
+			timing.connect = HttpPhaseTimer::_seconds(this->resolved, this->connected);
+			timing.send = HttpPhaseTimer::_seconds(this->sending, this->sent);
+			timing.firstByte = HttpPhaseTimer::_seconds(this->sent, this->received);
+			timing.download = HttpPhaseTimer::_seconds(this->received, now);
+			timing.total = HttpPhaseTimer::_seconds(this->start, now);
+			timing.connectionReused = (this->connecting < 0);
+		}
+
+	protected:
+		static inline float _seconds(int64_t begin, int64_t end)
+		{
+			return (begin >= 0 && end >= begin ? (end - begin) * 0.001f : 0.0f);
+		}
+
+	};
+
+}
+#endif
@@ -0,0 +1,307 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <hltypes/harray.h>
+#include <hltypes/hlog.h>
+#include <hltypes/hstring.h>
+
+#include "HttpPolicyClient.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "HttpSocket.h"
+#include "HttpSocketDelegate.h"
+#include "sakit.h"
+
+#define LATENCY_SAMPLE_COUNT 100
+#define MIN_LATENCY_SAMPLE_COUNT 20
+
+namespace sakit
+{
+	int HttpPolicyClient::DefaultMaxRetries = 3;
+	float HttpPolicyClient::DefaultRetryBaseDelay = 0.1f;
+	float HttpPolicyClient::DefaultRetryMaxDelay = 5.0f;
+	float HttpPolicyClient::DefaultHedgePercentile = 0.95f;
+	float HttpPolicyClient::DefaultHedgeDelay = 1.0f;
+
+	HttpPolicyClient::AttemptDelegate::AttemptDelegate(HttpPolicyClient* client) :
+		HttpSocketDelegate()
+	{
+		this->client = client;
+	}
+
+	void HttpPolicyClient::AttemptDelegate::onExecuteCompleted(HttpSocket* socket, HttpResponse* response, Url url)
+	{
+		this->client->_onAttemptCompleted(socket, response, url);
+	}
+
+	void HttpPolicyClient::AttemptDelegate::onExecuteFailed(HttpSocket* socket, HttpResponse* response, Url url)
+	{
+		this->client->_onAttemptFailed(socket, response, url);
+	}
+
+	HttpPolicyClient::Operation::Operation(HttpRequest* request) :
+		retries(0),
+		retryTime(-1LL),
+		hedgeTime(-1LL)
+	{
+		this->request = request;
+		this->idempotent = HttpPolicyClient::_isIdempotent(request->method);
+	}
+
+	HttpPolicyClient::Operation::~Operation()
+	{
+		delete this->request;
+	}
+
+	HttpPolicyClient::HttpPolicyClient(HttpSocketDelegate* socketDelegate) :
+		Base(),
+		attemptDelegate(this),
+		hedging(false)
+	{
+		this->socketDelegate = socketDelegate;
+		this->maxRetries = HttpPolicyClient::DefaultMaxRetries;
+		this->retryBaseDelay = HttpPolicyClient::DefaultRetryBaseDelay;
+		this->retryMaxDelay = HttpPolicyClient::DefaultRetryMaxDelay;
+		this->hedgePercentile = HttpPolicyClient::DefaultHedgePercentile;
+		this->hedgeDelay = HttpPolicyClient::DefaultHedgeDelay;
+		this->__register();
+	}
+
+	HttpPolicyClient::~HttpPolicyClient()
+	{
+		this->__unregister();
+		foreach (Operation*, it, this->operations)
+		{
+			foreach (HttpSocket*, it2, (*it)->sockets)
+			{
+				delete (*it2);
+			}
+			delete (*it);
+		}
+		foreach (HttpSocket*, it, this->drainingSockets)
+		{
+			delete (*it);
+		}
+		foreach (HttpSocket*, it, this->idleSockets)
+		{
+			delete (*it);
+		}
+	}
+
+	void HttpPolicyClient::setMaxRetries(int value)
+	{
+		this->maxRetries = hmax(value, 0);
+	}
+
+	void HttpPolicyClient::setHedgePercentile(float value)
+	{
+		this->hedgePercentile = hclamp(value, 0.0f, 1.0f);
+	}
+
+	float HttpPolicyClient::getCurrentHedgeDelay()
+	{
+		hmutex::ScopeLock lock(&this->mutexOperations);
+		return this->_calculateHedgeDelay();
+	}
+
+	int HttpPolicyClient::getExecutingCount()
+	{
+		hmutex::ScopeLock lock(&this->mutexOperations);
+		return this->operations.size();
+	}
+
+	void HttpPolicyClient::update(float timeDelta)
+	{
+		hmutex::ScopeLock lock(&this->mutexOperations);
+		int64_t now = htickCount();
+		harray<Operation*> failed;
+		harray<Operation*> operations = this->operations;
+		foreach (Operation*, it, operations)
+		{
+			if ((*it)->retryTime >= 0 && now >= (*it)->retryTime)
+			{
+				(*it)->retryTime = -1LL;
+				if (!this->_startAttempt(*it))
+				{
+					this->operations -= (*it);
+					failed += (*it);
+				}
+			}
+			else if ((*it)->hedgeTime >= 0 && now >= (*it)->hedgeTime)
+			{
+				(*it)->hedgeTime = -1LL;
+				// if the hedged attempt can't be started, the first one simply continues alone
+				if ((*it)->sockets.size() == 1)
+				{
+					this->_startAttempt(*it);
+				}
+			}
+		}
+		lock.release();
+		foreach (Operation*, it, failed)
+		{
+			HttpResponse response;
+			this->socketDelegate->onExecuteFailed(NULL, &response, (*it)->request->url);
+			delete (*it);
+		}
+	}
+
+	bool HttpPolicyClient::executeAsync(const HttpRequest& request)
+	{
+		if (!request.url.isValid())
+		{
+			hlog::warn(logTag, "Cannot execute, URL is not valid!");
+			return false;
+		}
+		hmutex::ScopeLock lock(&this->mutexOperations);
+		Operation* operation = new Operation(request.clone());
+		// all attempts are started in update() so the sockets are only used by one thread
+		operation->retryTime = htickCount();
+		this->operations += operation;
+		return true;
+	}
+
+	HttpPolicyClient::Operation* HttpPolicyClient::_findOperation(HttpSocket* socket)
+	{
+		foreach (Operation*, it, this->operations)
+		{
+			if ((*it)->sockets.has(socket))
+			{
+				return (*it);
+			}
+		}
+		return NULL;
+	}
+
+	HttpSocket* HttpPolicyClient::_acquireSocket()
+	{
+		HttpSocket* socket = NULL;
+		if (this->idleSockets.size() > 0)
+		{
+			socket = this->idleSockets.removeLast();
+		}
+		else
+		{
+			socket = new HttpSocket(&this->attemptDelegate);
+		}
+		socket->setTimeout(this->timeout, this->retryFrequency);
+		return socket;
+	}
+
+	bool HttpPolicyClient::_startAttempt(Operation* operation)
+	{
+		HttpSocket* socket = this->_acquireSocket();
+		Url url = operation->request->url;
+		if (!socket->_executeMethodAsync(operation->request->method, url, operation->request->body, operation->request->headers))
+		{
+			this->idleSockets += socket;
+			return false;
+		}
+		int64_t now = htickCount();
+		operation->sockets += socket;
+		operation->startTimes += now;
+		if (this->hedging && operation->idempotent && operation->sockets.size() == 1)
+		{
+			operation->hedgeTime = now + (int64_t)(this->_calculateHedgeDelay() * 1000.0f);
+		}
+		return true;
+	}
+
+	float HttpPolicyClient::_calculateBackoff(int retry)
+	{
+		float delay = hmin(this->retryBaseDelay * (float)(1 << hmin(retry, 16)), this->retryMaxDelay);
+		// full jitter keeps clients that failed at the same time from retrying at the same time
+		return (delay > 0.0f ? hrandf(0.0f, delay) : 0.0f);
+	}
+
+	float HttpPolicyClient::_calculateHedgeDelay()
+	{
+		if (this->latencies.size() < MIN_LATENCY_SAMPLE_COUNT)
+		{
+			return this->hedgeDelay;
+		}
+		harray<float> sorted = this->latencies.sorted();
+		int index = hclamp((int)(this->hedgePercentile * (sorted.size() - 1) + 0.5f), 0, sorted.size() - 1);
+		return sorted[index];
+	}
+
+	void HttpPolicyClient::_onAttemptCompleted(HttpSocket* socket, HttpResponse* response, Url url)
+	{
+		hmutex::ScopeLock lock(&this->mutexOperations);
+		Operation* operation = this->_findOperation(socket);
+		if (operation == NULL)
+		{
+			// a losing attempt that finished before it could be aborted
+			this->drainingSockets -= socket;
+			this->idleSockets += socket;
+			return;
+		}
+		int index = operation->sockets.indexOf(socket);
+		this->latencies += (htickCount() - operation->startTimes[index]) / 1000.0f;
+		if (this->latencies.size() > LATENCY_SAMPLE_COUNT)
+		{
+			this->latencies.removeFirst();
+		}
+		operation->sockets.removeAt(index);
+		operation->startTimes.removeAt(index);
+		this->operations -= operation;
+		this->idleSockets += socket;
+		harray<HttpSocket*> losers = operation->sockets;
+		this->drainingSockets += losers;
+		lock.release();
+		// the aborted attempts still report their failure which returns their sockets to the pool
+		foreach (HttpSocket*, it, losers)
+		{
+			(*it)->abort();
+		}
+		this->socketDelegate->onExecuteCompleted(socket, response, url);
+		delete operation;
+	}
+
+	void HttpPolicyClient::_onAttemptFailed(HttpSocket* socket, HttpResponse* response, Url url)
+	{
+		hmutex::ScopeLock lock(&this->mutexOperations);
+		Operation* operation = this->_findOperation(socket);
+		if (operation == NULL)
+		{
+			this->drainingSockets -= socket;
+			this->idleSockets += socket;
+			return;
+		}
+		int index = operation->sockets.indexOf(socket);
+		operation->sockets.removeAt(index);
+		operation->startTimes.removeAt(index);
+		this->idleSockets += socket;
+		// the other attempt could still succeed
+		if (operation->sockets.size() > 0)
+		{
+			return;
+		}
+		// HTTP error codes are reported as completed, so this is a connection failure or a timeout
+		if (operation->idempotent && operation->retries < this->maxRetries)
+		{
+			float delay = this->_calculateBackoff(operation->retries);
+			++operation->retries;
+			hlog::debugf(logTag, "Retrying request in %.3f seconds (%d/%d): %s", delay, operation->retries, this->maxRetries, url.toString().cStr());
+			operation->retryTime = htickCount() + (int64_t)(delay * 1000.0f);
+			operation->hedgeTime = -1LL;
+			return;
+		}
+		this->operations -= operation;
+		lock.release();
+		this->socketDelegate->onExecuteFailed(socket, response, url);
+		delete operation;
+	}
+
+	bool HttpPolicyClient::_isIdempotent(chstr method)
+	{
+		return (method == SAKIT_HTTP_REQUEST_METHOD_GET || method == SAKIT_HTTP_REQUEST_METHOD_HEAD || method == SAKIT_HTTP_REQUEST_METHOD_OPTIONS ||
+			method == SAKIT_HTTP_REQUEST_METHOD_PUT || method == SAKIT_HTTP_REQUEST_METHOD_DELETE || method == SAKIT_HTTP_REQUEST_METHOD_TRACE);
+	}
+
+}
@@ -0,0 +1,34 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <hltypes/hmap.h>
+#include <hltypes/hstring.h>
+
+#include "HttpRequest.h"
+
+namespace sakit
+{
+	HttpRequest::HttpRequest()
+	{
+		this->method = SAKIT_HTTP_REQUEST_METHOD_GET;
+	}
+
+	HttpRequest::HttpRequest(chstr method, Url url, chstr body, hmap<hstr, hstr> headers)
+	{
+		this->method = method;
+		this->url = url;
+		this->body = body;
+		this->headers = headers;
+	}
+
+	HttpRequest* HttpRequest::clone() const
+	{
+		return new HttpRequest(this->method, this->url, this->body, this->headers);
+	}
+
+}
@@ -10,11 +10,15 @@
 #include <hltypes/hmap.h>
 #include <hltypes/hstream.h>
 #include <hltypes/hstring.h>
+#ifdef _ZLIB
+#include <zlib.h>
+#endif
 
 #include "HttpResponse.h"
 #include "sakit.h"
 
 #define HTTP_DELIMITER "\r\n"
+#define DECODE_BUFFER_SIZE 16384
 
 namespace sakit
 {
@@ -44,6 +48,59 @@ namespace sakit
 		return -1;
 	}
 
+	/// @return False if the value isn't a valid non-negative decimal number or too large.
+	static bool _parseDecimal(const char* data, int size, int64_t& value)
+	{
+		if (size <= 0)
+		{
+			return false;
+		}
+		value = 0LL;
+		for_iter (i, 0, size)
+		{
+			if (data[i] < '0' || data[i] > '9' || value > (INT64_MAX - (data[i] - '0')) / 10)
+			{
+				return false;
+			}
+			value = value * 10 + (data[i] - '0');
+		}
+		return true;
+	}
+
+	/// @note Chunk extensions after the size are ignored.
+	/// @return False if the size isn't a valid hexadecimal number or too large.
+	static bool _parseChunkSize(const char* data, int size, int64_t& value)
+	{
+		value = 0LL;
+		int digit = 0;
+		int i = 0;
+		for (; i < size; ++i)
+		{
+			if (data[i] >= '0' && data[i] <= '9')
+			{
+				digit = data[i] - '0';
+			}
+			else if (data[i] >= 'a' && data[i] <= 'f')
+			{
+				digit = data[i] - 'a' + 10;
+			}
+			else if (data[i] >= 'A' && data[i] <= 'F')
+			{
+				digit = data[i] - 'A' + 10;
+			}
+			else
+			{
+				break;
+			}
+			if (value > (INT64_MAX - digit) / 16)
+			{
+				return false;
+			}
+			value = value * 16 + digit;
+		}
+		return (i > 0 && (i == size || data[i] == ';' || data[i] == ' ' || data[i] == '\t'));
+	}
+
 	HL_ENUM_CLASS_DEFINE(HttpResponse::Code,
 	(
 		HL_ENUM_DEFINE_VALUE(HttpResponse::Code, Undefined, 0);
@@ -89,17 +146,38 @@ namespace sakit
 		HL_ENUM_DEFINE_VALUE(HttpResponse::Code, HttpVersionNotSupported, 505);
 	));
 
+	int64_t HttpResponse::MaxReservedBodySize = 33554432; // 32 MB
+
 	HttpResponse::HttpResponse() :
 		statusCode(Code::Undefined),
 		headersComplete(false),
 		bodyComplete(false),
+		bodyFailed(false),
+		bodyExpected(true),
+		decodeContent(false),
+		contentLength(-1),
+		chunked(false),
+		connectionClose(false),
+		bodyDestination(NULL),
+		bodyDestinationMutex(NULL),
+		bodyDestinationOffset(0LL),
+		bodyDestinationEnd(-1LL),
 		chunkSize(0),
 		chunkRead(0),
-		newDataSize(0)
+		chunkTrailers(false),
+		chunkDelimiterPending(false),
+		newDataSize(0),
+		decoder(NULL),
+		decoderFinished(false)
 	{
 		this->clear();
 	}
 
+	HttpResponse::~HttpResponse()
+	{
+		this->_destroyDecoder();
+	}
+
 	void HttpResponse::clear()
 	{
 		this->protocol = "";
@@ -110,9 +188,21 @@ namespace sakit
 		this->raw.clear();
 		this->headersComplete = false;
 		this->bodyComplete = false;
+		this->bodyFailed = false;
+		this->bodyExpected = true;
 		this->chunkSize = 0;
 		this->chunkRead = 0;
+		this->chunkTrailers = false;
+		this->chunkDelimiterPending = false;
 		this->newDataSize = 0;
+		this->decodeContent = false;
+		this->contentLength = -1;
+		this->chunked = false;
+		this->connectionClose = false;
+		this->timing.clear();
+		this->contentEncoding = "";
+		this->_destroyDecoder();
+		this->decoderFinished = false;
 	}
 
 	void HttpResponse::parseFromRaw()
@@ -120,11 +210,23 @@ namespace sakit
 		if (!this->headersComplete)
 		{
 			this->_readHeaders();
+			if (this->headersComplete && (!this->bodyExpected || this->statusCode == Code::NoContent || this->statusCode == Code::NotModified))
+			{
+				this->bodyComplete = true;
+			}
+			else if (this->headersComplete)
+			{
+				this->_reserveBody();
+			}
 		}
 		if (this->headersComplete && !this->bodyComplete)
 		{
 			this->_readBody();
 		}
+		if (this->bodyDestination != NULL)
+		{
+			this->_writeBodyDestination();
+		}
 	}
 
 	bool HttpResponse::hasNewData()
@@ -145,77 +247,168 @@ namespace sakit
 
 	void HttpResponse::_readHeaders()
 	{
-		hstr data;
-		int size = 0;
-		this->_getRawData(data, size);
-		int index = 0;
-		int read = 0;
-		hstr line;
-		harray<hstr> lineData;
+		int position = (int)this->raw.position();
+		int size = (int)this->raw.size() - position;
+		if (size <= 0)
+		{
+			return;
+		}
+		// the fields are parsed directly from the received data without creating a string for every line
+		const char* data = (const char*)&this->raw[position];
+		int start = 0;
+		int end = 0;
+		int colon = 0;
+		int valueStart = 0;
+		int valueEnd = 0;
 		while (true)
 		{
-			index = data.indexOf(HTTP_DELIMITER);
-			if (index < 0)
+			end = start;
+			while (end < size - 1 && (data[end] != '\r' || data[end + 1] != '\n'))
 			{
-				this->raw.seek(read - size, hseek::End);
-				break;
+				++end;
 			}
-			line = (index > 0 ? data(0, index) : "");
-			data = data(index + 2, -1); // +2 is HTTP_DELIMITER's size
-			read += index + 2;
-			if (line == "")
+			if (end >= size - 1)
 			{
-				this->raw.seek(read - size, hseek::End);
+				break; // not enough bytes to read
+			}
+			if (end == start)
+			{
+				start += 2; // +2 is HTTP_DELIMITER's size
 				this->headersComplete = true;
+				this->_decodeHeaders();
 				break;
 			}
 			if (this->statusCode == HttpResponse::Code::Undefined)
 			{
-				index = line.indexOf(' ');
-				if (index >= 0)
-				{
-					this->protocol = line(0, index);
-					line = line(index + 1, -1);
-					index = line.indexOf(' ');
-					if (index >= 0)
-					{
-						this->statusCode = HttpResponse::Code::fromInt((int)line(0, index));
-						this->statusMessage = line(index + 1, -1);
-					}
-					else
-					{
-						this->statusMessage = line;
-					}
-				}
+				this->_readStatusLine(&data[start], end - start);
 			}
 			else
 			{
-				lineData = line.split(':', 1, true);
-				if (lineData.size() > 1)
+				colon = start;
+				while (colon < end && data[colon] != ':')
 				{
-					this->headers[lineData[0]] = lineData[1](1, -1); // because there's that space character
+					++colon;
 				}
-				else
+				valueStart = hmin(colon + 1, end);
+				while (valueStart < end && (data[valueStart] == ' ' || data[valueStart] == '\t'))
 				{
-					this->headers[lineData[0]] = "";
+					++valueStart;
 				}
+				valueEnd = end;
+				while (valueEnd > valueStart && (data[valueEnd - 1] == ' ' || data[valueEnd - 1] == '\t'))
+				{
+					--valueEnd;
+				}
+				this->headers.add(&data[start], colon - start, &data[valueStart], valueEnd - valueStart);
+			}
+			start = end + 2; // +2 is HTTP_DELIMITER's size
+		}
+		this->raw.seek(position + start, hseek::Start);
+	}
+
+	void HttpResponse::_readStatusLine(const char* data, int size)
+	{
+		hstr line(data, size);
+		int index = line.indexOf(' ');
+		if (index >= 0)
+		{
+			this->protocol = line(0, index);
+			line = line(index + 1, -1);
+			index = line.indexOf(' ');
+			if (index >= 0)
+			{
+				this->statusCode = HttpResponse::Code::fromInt((int)line(0, index));
+				this->statusMessage = line(index + 1, -1);
+			}
+			else
+			{
+				this->statusMessage = line;
+			}
+		}
+	}
+
+	void HttpResponse::_decodeHeaders()
+	{
+		this->contentLength = -1;
+		// chunked has to be the last of the transfer codings
+		this->chunked = this->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_TRANSFER_ENCODING, "").lowered().endsWith("chunked");
+		this->connectionClose = this->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_CONNECTION, "").lowered().contains("close");
+		hstr value = this->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_LENGTH, "").trimmed();
+		if (value != "" && !this->chunked)
+		{
+			int64_t contentLength = 0LL;
+			if (!_parseDecimal(value.cStr(), value.size(), contentLength))
+			{
+				// the end of the body can't be determined
+				hlog::error(logTag, "Invalid Content-Length in response: " + value);
+				this->_failBody();
+				return;
+			}
+			this->contentLength = contentLength;
+		}
+	}
+
+	void HttpResponse::_reserveBody()
+	{
+		if (this->bodyDestination != NULL || this->chunked || this->contentLength <= 0 || this->contentLength > HttpResponse::MaxReservedBodySize)
+		{
+			return;
+		}
+#ifdef _ZLIB
+		if (this->decodeContent)
+		{
+			// the size of decoded data isn't known in advance
+			hstr encoding = this->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_ENCODING, "identity").trimmed().lowered();
+			if (encoding != "identity" && encoding != "")
+			{
+				return;
 			}
 		}
+#endif
+		int64_t capacity = this->body.size() + this->contentLength;
+		if (this->body.getCapacity() < capacity)
+		{
+			this->body.setCapacity(capacity);
+		}
 	}
 
 	void HttpResponse::_readBody()
 	{
-		if (this->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_TRANSFER_ENCODING, "identity") != "chunked")
+#ifdef _ZLIB
+		if (this->decodeContent && this->contentEncoding == "")
 		{
-			this->chunkSize = (int)this->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_LENGTH, "0");
-			int written = this->body.writeRaw(this->raw);
-			this->raw.seek(written);
-			this->chunkRead += written;
-			if (written > 0)
+			this->contentEncoding = this->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_ENCODING, "identity").trimmed().lowered();
+			if (this->contentEncoding == "x-gzip")
+			{
+				this->contentEncoding = "gzip";
+			}
+			if (this->contentEncoding != "gzip" && this->contentEncoding != "deflate")
+			{
+				this->contentEncoding = "identity";
+			}
+		}
+#endif
+		if (!this->chunked)
+		{
+			bool hasLength = (this->contentLength >= 0);
+			this->chunkSize = hmax(this->contentLength, (int64_t)0);
+			int written = 0;
+			if (!hasLength)
 			{
-				this->newDataSize += written;
+				written = this->_writeBody((int)(this->raw.size() - this->raw.position()));
 			}
-			if (this->chunkSize > 0 && this->chunkSize == this->chunkRead)
+			else if (this->chunkSize > this->chunkRead && !this->raw.eof())
+			{
+				// anything beyond Content-Length is not part of this response (e.g. when pipelining)
+				written = this->_writeBody((int)hmin(this->chunkSize - this->chunkRead, this->raw.size() - this->raw.position()));
+			}
+			if (this->bodyFailed)
+			{
+				return;
+			}
+			this->raw.seek(written);
+			this->chunkRead += written;
+			if (hasLength && this->chunkSize <= this->chunkRead)
 			{
 				this->bodyComplete = true;
 			}
@@ -226,35 +419,74 @@ namespace sakit
 			int read = 0;
 			while (true)
 			{
-				if (this->chunkSize == 0)
+				if (this->chunkDelimiterPending)
+				{
+					// the CRLF after a chunk's data might not have been received yet
+					if (this->raw.size() - this->raw.position() < 2)
+					{
+						break; // not enough bytes to read
+					}
+					if (this->raw[(int)this->raw.position()] != '\r' || this->raw[(int)this->raw.position() + 1] != '\n')
+					{
+						hlog::error(logTag, "Missing delimiter after chunk in response.");
+						this->_failBody();
+						return;
+					}
+					this->raw.seek(2);
+					this->chunkDelimiterPending = false;
+				}
+				if (this->chunkTrailers)
 				{
+					// trailer fields are skipped until the terminating empty line
 					offset = _findSequence(this->raw, (unsigned char*)HTTP_DELIMITER, strlen(HTTP_DELIMITER));
 					if (offset < 0)
 					{
 						break; // not enough bytes to read
 					}
-					this->chunkSize = (int)hstr(this->raw.read(offset)).unhex();
-					this->raw.seek(2);
-					if (this->chunkSize == 0)
+					this->raw.seek(offset + 2);
+					if (offset == 0)
 					{
-						this->body.writeRaw(this->raw);
-						this->raw.seek(0, hseek::End);
+						this->chunkTrailers = false;
 						this->bodyComplete = true;
 						break;
 					}
+					continue;
+				}
+				if (this->chunkSize == 0)
+				{
+					offset = _findSequence(this->raw, (unsigned char*)HTTP_DELIMITER, strlen(HTTP_DELIMITER));
+					if (offset < 0)
+					{
+						break; // not enough bytes to read
+					}
+					if (!_parseChunkSize((const char*)&this->raw[(int)this->raw.position()], offset, this->chunkSize))
+					{
+						hlog::error(logTag, "Invalid chunk size in response: " + hstr((const char*)&this->raw[(int)this->raw.position()], offset));
+						this->_failBody();
+						return;
+					}
+					this->raw.seek(offset + 2);
+					if (this->chunkSize == 0)
+					{
+						this->chunkTrailers = true;
+						continue;
+					}
 				}
 				if (this->chunkSize > 0)
 				{
-					read = this->chunkSize - this->chunkRead;
-					read = this->body.writeRaw(this->raw, read);
+					read = (int)hmin(this->chunkSize - this->chunkRead, this->raw.size() - this->raw.position());
+					read = this->_writeBody(read);
+					if (this->bodyFailed)
+					{
+						return;
+					}
 					this->raw.seek(read);
 					this->chunkRead += read;
-					this->newDataSize += read;
 					if (this->chunkRead == this->chunkSize)
 					{
 						this->chunkSize = 0;
 						this->chunkRead = 0;
-						this->raw.seek(2);
+						this->chunkDelimiterPending = true;
 					}
 					if (this->raw.eof())
 					{
@@ -265,14 +497,163 @@ namespace sakit
 		}
 	}
 
-	void HttpResponse::_getRawData(hstr& data, int& size)
+	void HttpResponse::_writeBodyDestination()
 	{
-		size = (int)(this->raw.size() - this->raw.position());
-		char* buffer = new char[size + 1];
-		this->raw.readRaw(buffer, size);
-		buffer[size] = '\0'; // classic string terminating 0-character
-		data = hstr(buffer);
-		delete[] buffer;
+		if (!this->headersComplete || this->bodyFailed || this->statusCode.value < 200 || this->statusCode.value >= 300)
+		{
+			return;
+		}
+		int64_t size = this->body.size();
+		if (size > 0)
+		{
+			if (this->bodyDestinationEnd >= 0 && this->bodyDestinationOffset + size > this->bodyDestinationEnd)
+			{
+				hlog::error(logTag, "Response body is larger than expected!");
+				this->_failBody();
+				return;
+			}
+			// only what was decoded from the last received data is in the body so it always fits into an int
+			hmutex::ScopeLock lock(this->bodyDestinationMutex);
+			this->bodyDestination->seek(this->bodyDestinationOffset, hseek::Start);
+			int written = this->bodyDestination->writeRaw(&this->body[0], (int)size);
+			lock.release();
+			if (written < (int)size)
+			{
+				hlog::error(logTag, "Could not write response body to its destination!");
+				this->_failBody();
+				return;
+			}
+			this->bodyDestinationOffset += size;
+			this->body.clear(this->body.getCapacity());
+		}
+		// only an incomplete line could be left over which is moved to the front
+		int remaining = (int)(this->raw.size() - this->raw.position());
+		if (remaining == 0)
+		{
+			this->raw.clear(this->raw.getCapacity());
+		}
+		else if (this->raw.position() > 0)
+		{
+			hstream stream(remaining);
+			stream.writeRaw(this->raw, remaining);
+			stream.rewind();
+			this->raw.clear(this->raw.getCapacity());
+			this->raw.writeRaw(stream);
+			this->raw.rewind();
+		}
+	}
+
+	int HttpResponse::_writeBody(int count)
+	{
+		if (count <= 0)
+		{
+			return 0;
+		}
+		if (this->contentEncoding == "" || this->contentEncoding == "identity")
+		{
+			count = this->body.writeRaw(this->raw, count);
+			this->newDataSize += count;
+			return count;
+		}
+#ifdef _ZLIB
+		if (this->decoderFinished)
+		{
+			return count; // anything after the end of the encoded data is discarded
+		}
+		if (this->decoder == NULL && !this->_createDecoder())
+		{
+			return 0;
+		}
+		z_stream* stream = (z_stream*)this->decoder;
+		unsigned char buffer[DECODE_BUFFER_SIZE];
+		int size = 0;
+		int result = Z_OK;
+		stream->next_in = (Bytef*)&this->raw[(int)this->raw.position()];
+		stream->avail_in = (uInt)count;
+		while (true)
+		{
+			stream->next_out = (Bytef*)buffer;
+			stream->avail_out = (uInt)DECODE_BUFFER_SIZE;
+			result = inflate(stream, Z_NO_FLUSH);
+			if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR)
+			{
+				hlog::error(logTag, "Could not decode " + this->contentEncoding + " response body: " + (stream->msg != NULL ? hstr(stream->msg) : hstr(result)));
+				this->_failBody();
+				break;
+			}
+			size = DECODE_BUFFER_SIZE - (int)stream->avail_out;
+			if (size > 0)
+			{
+				this->body.writeRaw(buffer, size);
+				this->newDataSize += size;
+			}
+			if (result == Z_STREAM_END)
+			{
+				this->_destroyDecoder();
+				this->decoderFinished = true;
+				break;
+			}
+			// the output buffer wasn't filled so all input has been consumed
+			if (stream->avail_out > 0)
+			{
+				break;
+			}
+		}
+#endif
+		return count;
+	}
+
+	bool HttpResponse::_createDecoder()
+	{
+#ifdef _ZLIB
+		// +32 detects gzip and zlib headers automatically
+		int windowBits = MAX_WBITS + 32;
+		if (this->contentEncoding == "deflate")
+		{
+			// some servers send raw deflate data without the zlib header
+			unsigned char header = this->raw[(int)this->raw.position()];
+			if ((header & 0x0F) != Z_DEFLATED || (header >> 4) > 7)
+			{
+				windowBits = -MAX_WBITS;
+			}
+		}
+		z_stream* stream = new z_stream();
+		memset(stream, 0, sizeof(z_stream));
+		if (inflateInit2(stream, windowBits) != Z_OK)
+		{
+			hlog::error(logTag, "Could not initialize " + this->contentEncoding + " decoder!");
+			delete stream;
+			this->_failBody();
+			return false;
+		}
+		this->decoder = stream;
+		return true;
+#else
+		return false;
+#endif
+	}
+
+	void HttpResponse::_failBody()
+	{
+		this->_destroyDecoder();
+		this->decoderFinished = true;
+		this->bodyFailed = true;
+		this->bodyComplete = true;
+		// the end of the body is unknown so the connection can't be used for another response
+		this->connectionClose = true;
+	}
+
+	void HttpResponse::_destroyDecoder()
+	{
+#ifdef _ZLIB
+		if (this->decoder != NULL)
+		{
+			z_stream* stream = (z_stream*)this->decoder;
+			inflateEnd(stream);
+			delete stream;
+			this->decoder = NULL;
+		}
+#endif
 	}
 
 	HttpResponse* HttpResponse::clone() const
@@ -288,8 +669,20 @@ namespace sakit
 		result->raw.rewind();
 		result->headersComplete = this->headersComplete;
 		result->bodyComplete = this->bodyComplete;
+		result->bodyFailed = this->bodyFailed;
+		result->bodyExpected = this->bodyExpected;
+		result->decodeContent = this->decodeContent;
+		result->contentLength = this->contentLength;
+		result->chunked = this->chunked;
+		result->connectionClose = this->connectionClose;
+		result->timing = this->timing;
+		result->contentEncoding = this->contentEncoding;
+		// the decoder state isn't copied, a clone can't continue decoding
+		result->decoderFinished = true;
 		result->chunkSize = this->chunkSize;
 		result->chunkRead = this->chunkRead;
+		result->chunkTrailers = this->chunkTrailers;
+		result->chunkDelimiterPending = this->chunkDelimiterPending;
 		result->newDataSize = this->newDataSize;
 		return result;
 	}
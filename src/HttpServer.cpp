@@ -0,0 +1,903 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <string.h>
+
+#include <hltypes/harray.h>
+#include <hltypes/hlog.h>
+#include <hltypes/hstream.h>
+#include <hltypes/hstring.h>
+
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "HttpServer.h"
+#include "HttpServerDelegate.h"
+#include "HttpServerRequest.h"
+#include "HttpServerResponse.h"
+#include "HttpSocket.h"
+#include "sakit.h"
+#include "TcpSocket.h"
+
+#define HTTP_DELIMITER "\r\n"
+#define HTTP_PROTOCOL "HTTP/1.1"
+#define HTTP_CONTINUE "HTTP/1.1 100 Continue\r\n\r\n"
+
+namespace sakit
+{
+	static const char* _findLineEnd(const char* data, const char* end)
+	{
+		for (const char* c = data; c < end - 1; ++c)
+		{
+			if (c[0] == '\r' && c[1] == '\n')
+			{
+				return c;
+			}
+		}
+		return NULL;
+	}
+
+	float HttpServer::DefaultKeepAliveTimeout = 15.0f;
+	int HttpServer::DefaultMaxBufferSize = 1048576;
+
+	HttpServer::ConnectionDelegate::ConnectionDelegate(HttpServer* server) :
+		TcpSocketDelegate()
+	{
+		this->server = server;
+	}
+
+	void HttpServer::ConnectionDelegate::onReceived(TcpSocket* socket, hstream* stream)
+	{
+		this->server->_onReceived(socket, stream);
+	}
+
+	void HttpServer::ConnectionDelegate::onReceiveFailed(TcpSocket* socket)
+	{
+		this->server->_onReceiveFailed(socket);
+	}
+
+	HttpServer::Connection::Connection(TcpSocket* socket) :
+		position(0),
+		openResponse(NULL),
+		closing(false),
+		resume(false),
+		continueSent(false),
+		sendFileOffset(0),
+		sendFileSize(0),
+		sendFileClose(false),
+		headScanPosition(0),
+		request(NULL),
+		bodyStart(0),
+		bodyLength(0),
+		chunkedPosition(0),
+		chunkedTrailers(false)
+	{
+		this->socket = socket;
+		this->lastActivity = htickCount();
+	}
+
+	HttpServer::Connection::~Connection()
+	{
+		if (this->request != NULL)
+		{
+			delete this->request;
+		}
+	}
+
+	HttpServer::Route::Route(chstr method, chstr path, HttpServerDelegate* delegate) :
+		prefix(false)
+	{
+		this->method = method;
+		this->path = path;
+		if (this->path.endsWith("*"))
+		{
+			this->path = this->path(0, this->path.size() - 1);
+			this->prefix = true;
+		}
+		this->delegate = delegate;
+	}
+
+	HttpServer::HttpServer(HttpServerDelegate* serverDelegate) :
+		TcpServer(serverDelegate, &this->connectionDelegate),
+		connectionDelegate(this),
+		keepAlive(true)
+	{
+		this->httpServerDelegate = serverDelegate;
+		this->keepAliveTimeout = HttpServer::DefaultKeepAliveTimeout;
+		this->maxBufferSize = HttpServer::DefaultMaxBufferSize;
+	}
+
+	HttpServer::~HttpServer()
+	{
+		this->__unregister();
+		foreach (Connection*, it, this->httpConnections)
+		{
+			if ((*it)->openResponse != NULL)
+			{
+				delete (*it)->openResponse;
+			}
+			delete (*it);
+		}
+		foreach (HttpServerResponse*, it, this->orphanedResponses)
+		{
+			delete (*it);
+		}
+		foreach (HttpServerResponse*, it, this->finishedResponses)
+		{
+			delete (*it);
+		}
+	}
+
+	int HttpServer::getConnectionCount()
+	{
+		return this->httpConnections.size();
+	}
+
+	void HttpServer::update(float timeDelta)
+	{
+		TcpServer::update(timeDelta);
+		this->_removeClosedConnections();
+		foreach (HttpServerResponse*, it, this->finishedResponses)
+		{
+			delete (*it);
+		}
+		this->finishedResponses.clear();
+		int64_t now = htickCount();
+		harray<Connection*> connections = this->httpConnections;
+		foreach (Connection*, it, connections)
+		{
+			if ((*it)->closing)
+			{
+				continue;
+			}
+			// files are sent piece by piece whenever the socket can take more data
+			if ((*it)->sendFileSize > 0 && this->_sendFilePiece(*it))
+			{
+				(*it)->resume = true;
+			}
+			// requests that waited for a finished chunked response or file
+			if ((*it)->resume)
+			{
+				(*it)->resume = false;
+				this->_processRequests(*it);
+			}
+			if (!(*it)->closing && (*it)->openResponse == NULL && now - (*it)->lastActivity >= (int64_t)(this->keepAliveTimeout * 1000.0f))
+			{
+				this->_closeConnection(*it);
+			}
+		}
+	}
+
+	void HttpServer::addRoute(chstr method, chstr path, HttpServerDelegate* delegate)
+	{
+		this->removeRoute(method, path);
+		this->routes += Route(method, path, delegate);
+	}
+
+	bool HttpServer::removeRoute(chstr method, chstr path)
+	{
+		Route route(method, path);
+		for_iter (i, 0, this->routes.size())
+		{
+			if (this->routes[i].method == route.method && this->routes[i].path == route.path && this->routes[i].prefix == route.prefix)
+			{
+				this->routes.removeAt(i);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void HttpServer::clearRoutes()
+	{
+		this->routes.clear();
+	}
+
+	void HttpServer::_onAccepted(TcpSocket* socket)
+	{
+		Connection* connection = this->_findConnection(socket);
+		if (connection != NULL)
+		{
+			// a previous socket with the same address was deleted in the meantime
+			this->httpConnections -= connection;
+			if (connection->openResponse != NULL)
+			{
+				this->orphanedResponses += connection->openResponse;
+			}
+			delete connection;
+		}
+		this->httpConnections += new Connection(socket);
+		socket->startReceiveAsync();
+	}
+
+	void HttpServer::_onReceived(TcpSocket* socket, hstream* stream)
+	{
+		Connection* connection = this->_findConnection(socket);
+		if (connection == NULL || connection->closing || stream->size() == 0)
+		{
+			return;
+		}
+		connection->lastActivity = htickCount();
+		connection->buffer += hstr((char*)&(*stream)[(int)stream->position()], (int)(stream->size() - stream->position()));
+		if (connection->buffer.size() - connection->position > this->maxBufferSize)
+		{
+			this->_respondError(connection, HttpResponse::Code::RequestEntityTooLarge);
+			return;
+		}
+		this->_processRequests(connection);
+	}
+
+	void HttpServer::_onReceiveFailed(TcpSocket* socket)
+	{
+		Connection* connection = this->_findConnection(socket);
+		if (connection != NULL && !connection->closing)
+		{
+			// the client closed the connection
+			connection->closing = true;
+			socket->disconnect();
+		}
+	}
+
+	HttpServer::Connection* HttpServer::_findConnection(TcpSocket* socket)
+	{
+		foreach (Connection*, it, this->httpConnections)
+		{
+			if ((*it)->socket == socket)
+			{
+				return (*it);
+			}
+		}
+		return NULL;
+	}
+
+	HttpServer::Connection* HttpServer::_findConnection(HttpServerResponse* response)
+	{
+		foreach (Connection*, it, this->httpConnections)
+		{
+			if ((*it)->openResponse == response)
+			{
+				return (*it);
+			}
+		}
+		return NULL;
+	}
+
+	void HttpServer::_removeClosedConnections()
+	{
+		// TcpServer deletes disconnected sockets so only the pointers are compared here
+		harray<Connection*> connections = this->httpConnections;
+		foreach (Connection*, it, connections)
+		{
+			if (!this->sockets.has((*it)->socket))
+			{
+				this->httpConnections -= (*it);
+				if ((*it)->openResponse != NULL)
+				{
+					this->orphanedResponses += (*it)->openResponse;
+				}
+				delete (*it);
+			}
+		}
+	}
+
+	void HttpServer::_processRequests(Connection* connection)
+	{
+		// pipelined requests are handled one after another so their responses are sent in the same order
+		HttpServerRequest* request = NULL;
+		while (!connection->closing && connection->openResponse == NULL && connection->sendFileSize == 0 && connection->position < connection->buffer.size())
+		{
+			if (this->_parseRequest(connection) <= 0)
+			{
+				break;
+			}
+			request = connection->request;
+			connection->request = NULL;
+			this->_dispatch(connection, *request);
+			delete request;
+		}
+		if (connection->position > 0)
+		{
+			connection->buffer = connection->buffer(connection->position, -1);
+			connection->position = 0;
+		}
+	}
+
+	int HttpServer::_parseRequest(Connection* connection)
+	{
+		if (connection->request == NULL)
+		{
+			int result = this->_parseHead(connection);
+			if (result <= 0)
+			{
+				return result;
+			}
+		}
+		HttpServerRequest* request = connection->request;
+		const char* data = connection->buffer.cStr() + connection->position + connection->bodyStart;
+		int size = connection->buffer.size() - connection->position - connection->bodyStart;
+		int consumed = connection->bodyStart;
+		bool bodyMissing = false;
+		if (connection->bodyLength < 0)
+		{
+			int result = HttpServer::_decodeChunkedBody(data, size, connection->chunkedPosition, connection->chunkedTrailers, request->body);
+			if (result < 0)
+			{
+				this->_respondError(connection, HttpResponse::Code::BadRequest);
+				return -1;
+			}
+			bodyMissing = (result == 0);
+			consumed += connection->chunkedPosition;
+		}
+		else if (connection->bodyLength > 0)
+		{
+			bodyMissing = (size < connection->bodyLength);
+			if (!bodyMissing)
+			{
+				request->body = hstr(data, (int)connection->bodyLength);
+				consumed += (int)connection->bodyLength;
+			}
+		}
+		if (bodyMissing)
+		{
+			if (!connection->continueSent && request->headers.tryGet(SAKIT_HTTP_REQUEST_HEADER_EXPECT, "").lowered() == "100-continue")
+			{
+				connection->continueSent = true;
+				this->_send(connection, HTTP_CONTINUE);
+			}
+			return 0;
+		}
+		connection->position += consumed;
+		connection->continueSent = false;
+		connection->headScanPosition = 0;
+		int queryStart = request->target.indexOf('?');
+		request->path = (queryStart >= 0 ? request->target(0, queryStart) : request->target);
+		if (request->target.contains("://"))
+		{
+			request->url = Url(request->target);
+			request->path = request->url.getPath();
+		}
+		else if (request->headers.hasKey(SAKIT_HTTP_REQUEST_HEADER_HOST))
+		{
+			request->url = Url(SAKIT_HTTP_SCHEME "://" + request->headers[SAKIT_HTTP_REQUEST_HEADER_HOST] + request->target);
+		}
+		request->remoteHost = connection->socket->getRemoteHost();
+		request->remotePort = connection->socket->getRemotePort();
+		return 1;
+	}
+
+	int HttpServer::_parseHead(Connection* connection)
+	{
+		const char* data = connection->buffer.cStr() + connection->position;
+		int size = connection->buffer.size() - connection->position;
+		// empty lines before the request line are ignored (RFC 7230, 3.5), e.g. a CRLF that a client sent after the previous body
+		int skipped = 0;
+		while (skipped < size && (data[skipped] == '\n' || (data[skipped] == '\r' && skipped + 1 < size && data[skipped + 1] == '\n')))
+		{
+			skipped += (data[skipped] == '\r' ? 2 : 1);
+		}
+		if (skipped > 0)
+		{
+			connection->position += skipped;
+			connection->headScanPosition = hmax(connection->headScanPosition - skipped, 0);
+			data += skipped;
+			size -= skipped;
+		}
+		// the delimiter could have been split between the data that was already searched and the new data
+		int headerEnd = connection->buffer.indexOf(HTTP_DELIMITER HTTP_DELIMITER, connection->position + hmax(connection->headScanPosition - 3, 0));
+		if (headerEnd < 0)
+		{
+			connection->headScanPosition = size;
+			return 0;
+		}
+		headerEnd -= connection->position;
+		const char* headersEnd = data + headerEnd + 2;
+		const char* lineEnd = _findLineEnd(data, headersEnd);
+		harray<hstr> requestLine = hstr(data, (int)(lineEnd - data)).split(' ');
+		if (requestLine.size() != 3 || requestLine[0] == "" || (!requestLine[1].startsWith("/") && !requestLine[1].contains("://") && requestLine[1] != "*"))
+		{
+			this->_respondError(connection, HttpResponse::Code::BadRequest);
+			return -1;
+		}
+		HttpServerRequest* request = new HttpServerRequest();
+		connection->request = request;
+		request->method = requestLine[0];
+		request->target = requestLine[1];
+		request->protocol = requestLine[2];
+		if (!request->protocol.startsWith("HTTP/1."))
+		{
+			this->_respondError(connection, HttpResponse::Code::HttpVersionNotSupported);
+			return -1;
+		}
+		const char* line = lineEnd + 2;
+		const char* colon = NULL;
+		const char* name = NULL;
+		const char* nameEnd = NULL;
+		const char* value = NULL;
+		const char* valueEnd = NULL;
+		while (line < headersEnd)
+		{
+			lineEnd = _findLineEnd(line, headersEnd);
+			colon = (const char*)memchr(line, ':', lineEnd - line);
+			// obsolete line folding and whitespace before the colon aren't allowed in requests
+			if (colon == NULL || colon == line || line[0] == ' ' || line[0] == '\t' || colon[-1] == ' ' || colon[-1] == '\t')
+			{
+				this->_respondError(connection, HttpResponse::Code::BadRequest);
+				return -1;
+			}
+			name = line;
+			nameEnd = colon;
+			value = colon + 1;
+			valueEnd = lineEnd;
+			while (value < valueEnd && (*value == ' ' || *value == '\t'))
+			{
+				++value;
+			}
+			while (valueEnd > value && (valueEnd[-1] == ' ' || valueEnd[-1] == '\t'))
+			{
+				--valueEnd;
+			}
+			request->headers.add(name, (int)(nameEnd - name), value, (int)(valueEnd - value));
+			line = lineEnd + 2;
+		}
+		connection->bodyStart = headerEnd + 4;
+		connection->bodyLength = 0;
+		connection->chunkedPosition = 0;
+		connection->chunkedTrailers = false;
+		hstr transferEncoding = request->headers.tryGet(SAKIT_HTTP_REQUEST_HEADER_TRANSFER_ENCODING, "");
+		hstr contentLength = request->headers.tryGet(SAKIT_HTTP_REQUEST_HEADER_CONTENT_LENGTH, "");
+		if (transferEncoding != "")
+		{
+			// other transfer codings like gzip aren't supported so chunked has to be the only one
+			if (transferEncoding.lowered() != "chunked")
+			{
+				this->_respondError(connection, HttpResponse::Code::NotImplemented);
+				return -1;
+			}
+			connection->bodyLength = -1;
+		}
+		else if (contentLength != "")
+		{
+			bool valid = (contentLength.size() <= 18); // can't overflow int64_t
+			for_iter (i, 0, contentLength.size())
+			{
+				if (contentLength[i] < '0' || contentLength[i] > '9')
+				{
+					valid = false;
+					break;
+				}
+			}
+			if (!valid)
+			{
+				this->_respondError(connection, HttpResponse::Code::BadRequest);
+				return -1;
+			}
+			connection->bodyLength = (int64_t)contentLength;
+			if (connection->bodyLength > this->maxBufferSize)
+			{
+				this->_respondError(connection, HttpResponse::Code::RequestEntityTooLarge);
+				return -1;
+			}
+		}
+		return 1;
+	}
+
+	void HttpServer::_dispatch(Connection* connection, HttpServerRequest& request)
+	{
+		hstr connectionHeader = request.headers.tryGet(SAKIT_HTTP_REQUEST_HEADER_CONNECTION, "").lowered();
+		bool close = (request.protocol == "HTTP/1.0" ? !connectionHeader.contains("keep-alive") : connectionHeader.contains("close"));
+		HttpServerResponse* response = new HttpServerResponse(this, (request.method == SAKIT_HTTP_REQUEST_METHOD_HEAD), (close || !this->keepAlive));
+		harray<hstr> allowedMethods;
+		HttpServerDelegate* delegate = this->_findDelegate(request, allowedMethods);
+		if (delegate != NULL)
+		{
+			// allows the delegate to already send chunks
+			connection->openResponse = response;
+			delegate->onRequest(this, &request, response);
+			if (connection->openResponse == response)
+			{
+				connection->openResponse = NULL;
+			}
+		}
+		else
+		{
+			response->statusCode = HttpResponse::Code::MethodNotAllowed;
+			response->headers.set(SAKIT_HTTP_RESPONSE_HEADER_ALLOW, allowedMethods.joined(", "));
+		}
+		if (response->headers.tryGet(SAKIT_HTTP_RESPONSE_HEADER_CONNECTION, "").lowered().contains("close"))
+		{
+			response->connectionClose = true;
+		}
+		if (response->finished)
+		{
+			// the delegate already finished the chunked response
+			return;
+		}
+		if (connection->closing)
+		{
+			if (response->chunked)
+			{
+				// the delegate might still use it
+				this->orphanedResponses += response;
+			}
+			else
+			{
+				this->finishedResponses += response;
+			}
+			return;
+		}
+		if (!response->chunked)
+		{
+			response->body.rewind();
+			if (response->bodyData != NULL)
+			{
+				this->_sendHead(connection, response, response->bodyDataSize);
+				if (!connection->closing && !response->headRequest && response->bodyDataSize > 0 &&
+					connection->socket->send(response->bodyData, response->bodyDataSize) < response->bodyDataSize)
+				{
+					this->_closeConnection(connection);
+				}
+			}
+			else if (response->bodyFilename != "")
+			{
+				this->_sendHead(connection, response, response->bodyFileSize);
+				if (!connection->closing && !response->headRequest && response->bodyFileSize > 0)
+				{
+					// the rest is sent from update() so a slow client doesn't hold up the other connections
+					connection->sendFilename = response->bodyFilename;
+					connection->sendFileOffset = response->bodyFileOffset;
+					connection->sendFileSize = response->bodyFileSize;
+					connection->sendFileClose = response->connectionClose;
+					response->finished = true;
+					this->finishedResponses += response;
+					this->_sendFilePiece(connection);
+					return;
+				}
+			}
+			else
+			{
+				this->_sendHead(connection, response, response->body.size());
+				if (!connection->closing && !response->headRequest && response->body.size() > 0)
+				{
+					response->body.rewind();
+					if (connection->socket->send(&response->body) < response->body.size())
+					{
+						this->_closeConnection(connection);
+					}
+				}
+			}
+			response->finished = true;
+			this->finishedResponses += response;
+		}
+		else
+		{
+			connection->openResponse = response;
+			this->_sendChunk(response, "");
+			return;
+		}
+		if (response->connectionClose)
+		{
+			this->_closeConnection(connection);
+		}
+	}
+
+	HttpServerDelegate* HttpServer::_findDelegate(HttpServerRequest& request, harray<hstr>& allowedMethods)
+	{
+		const Route* result = NULL;
+		bool pathMatched = false;
+		foreachc (Route, it, this->routes)
+		{
+			if ((*it).prefix ? !request.path.startsWith((*it).path) : request.path != (*it).path)
+			{
+				continue;
+			}
+			pathMatched = true;
+			if ((*it).method != SAKIT_HTTP_SERVER_ANY_METHOD && (*it).method != request.method)
+			{
+				if (!allowedMethods.has((*it).method))
+				{
+					allowedMethods += (*it).method;
+				}
+				continue;
+			}
+			// exact paths are preferred over prefixes and longer prefixes over shorter ones
+			if (result == NULL || (result->prefix && (!(*it).prefix || (*it).path.size() > result->path.size())))
+			{
+				result = &(*it);
+			}
+		}
+		if (result != NULL)
+		{
+			return result->delegate;
+		}
+		// only a path that doesn't exist for any method is handled by the server's own delegate
+		return (pathMatched ? NULL : this->httpServerDelegate);
+	}
+
+	void HttpServer::_respondError(Connection* connection, HttpResponse::Code statusCode)
+	{
+		hstr statusLine = HttpServer::_makeStatusLine(statusCode);
+		// e.g. "400 Bad Request"
+		hstr body = statusLine(9, statusLine.size() - 11);
+		hstr data = statusLine + SAKIT_HTTP_RESPONSE_HEADER_CONTENT_LENGTH ": " + hstr(body.size()) + HTTP_DELIMITER +
+			SAKIT_HTTP_RESPONSE_HEADER_CONNECTION ": close" HTTP_DELIMITER HTTP_DELIMITER + body;
+		this->_send(connection, data);
+		this->_closeConnection(connection);
+	}
+
+	bool HttpServer::_send(Connection* connection, chstr data)
+	{
+		if (connection->closing)
+		{
+			return false;
+		}
+		hstream stream(data.size());
+		stream.writeRaw((void*)data.cStr(), data.size());
+		stream.rewind();
+		if (connection->socket->send(&stream) < data.size())
+		{
+			this->_closeConnection(connection);
+			return false;
+		}
+		connection->lastActivity = htickCount();
+		return true;
+	}
+
+	void HttpServer::_sendHead(Connection* connection, HttpServerResponse* response, int64_t contentLength)
+	{
+		response->headers.remove(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_LENGTH);
+		response->headers.remove(SAKIT_HTTP_RESPONSE_HEADER_TRANSFER_ENCODING);
+		response->headers.remove(SAKIT_HTTP_RESPONSE_HEADER_CONNECTION);
+		hstr head = HttpServer::_makeStatusLine(response->statusCode);
+		harray<hstr> keys = response->headers.keys();
+		harray<hstr> values = response->headers.values();
+		for_iter (i, 0, keys.size())
+		{
+			head += keys[i] + ": " + values[i] + HTTP_DELIMITER;
+		}
+		if (contentLength < 0)
+		{
+			head += SAKIT_HTTP_RESPONSE_HEADER_TRANSFER_ENCODING ": chunked" HTTP_DELIMITER;
+		}
+		// these responses never have a body
+		else if (response->statusCode != HttpResponse::Code::NotModified && response->statusCode != HttpResponse::Code::NoContent)
+		{
+			head += SAKIT_HTTP_RESPONSE_HEADER_CONTENT_LENGTH ": " + hstr(contentLength) + HTTP_DELIMITER;
+		}
+		if (response->connectionClose)
+		{
+			head += SAKIT_HTTP_RESPONSE_HEADER_CONNECTION ": close" HTTP_DELIMITER;
+		}
+		head += HTTP_DELIMITER;
+		response->headSent = true;
+		this->_send(connection, head);
+	}
+
+	bool HttpServer::_sendChunk(HttpServerResponse* response, chstr data)
+	{
+		Connection* connection = this->_findConnection(response);
+		if (connection == NULL || connection->closing || !response->chunked || response->finished)
+		{
+			return false;
+		}
+		if (!response->headSent)
+		{
+			this->_sendHead(connection, response, -1);
+		}
+		if (response->headRequest)
+		{
+			return !connection->closing;
+		}
+		hstr chunk;
+		if (response->body.size() > 0)
+		{
+			response->body.rewind();
+			chunk = hstr((char*)&response->body[0], (int)response->body.size());
+			response->body.clear();
+		}
+		chunk += data;
+		if (chunk.size() == 0)
+		{
+			return !connection->closing;
+		}
+		return this->_send(connection, hsprintf("%x" HTTP_DELIMITER, chunk.size()) + chunk + HTTP_DELIMITER);
+	}
+
+	void HttpServer::_finishResponse(HttpServerResponse* response)
+	{
+		// a response that isn't chunked is sent when its delegate call returns
+		if (response->finished || !response->chunked)
+		{
+			return;
+		}
+		Connection* connection = this->_findConnection(response);
+		if (connection != NULL)
+		{
+			this->_sendChunk(response, "");
+			if (!response->headRequest)
+			{
+				this->_send(connection, "0" HTTP_DELIMITER HTTP_DELIMITER); // last chunk without any trailers
+			}
+			connection->openResponse = NULL;
+			connection->resume = true;
+			if (response->connectionClose)
+			{
+				this->_closeConnection(connection);
+			}
+		}
+		response->finished = true;
+		this->orphanedResponses -= response;
+		this->finishedResponses += response;
+	}
+
+	bool HttpServer::_sendFilePiece(Connection* connection)
+	{
+		int64_t sent = connection->socket->sendFileNonBlocking(connection->sendFilename, connection->sendFileOffset, connection->sendFileSize);
+		if (sent < 0)
+		{
+			this->_closeConnection(connection);
+			return false;
+		}
+		if (sent > 0)
+		{
+			connection->sendFileOffset += sent;
+			connection->sendFileSize -= sent;
+			connection->lastActivity = htickCount();
+		}
+		if (connection->sendFileSize > 0)
+		{
+			return false;
+		}
+		connection->sendFilename = "";
+		if (connection->sendFileClose)
+		{
+			this->_closeConnection(connection);
+		}
+		return true;
+	}
+
+	void HttpServer::_closeConnection(Connection* connection)
+	{
+		if (connection->closing)
+		{
+			return;
+		}
+		connection->closing = true;
+		if (connection->socket->isReceiving())
+		{
+			connection->socket->stopReceive();
+		}
+		connection->socket->disconnect();
+	}
+
+	int HttpServer::_decodeChunkedBody(const char* data, int size, int& position, bool& trailers, hstr& body)
+	{
+		int lineEnd = 0;
+		int chunkSize = 0;
+		hstr sizeLine;
+		while (!trailers)
+		{
+			lineEnd = -1;
+			for_iter (i, position, size - 1)
+			{
+				if (data[i] == '\r' && data[i + 1] == '\n')
+				{
+					lineEnd = i;
+					break;
+				}
+			}
+			if (lineEnd < 0)
+			{
+				return 0;
+			}
+			sizeLine = hstr(data + position, lineEnd - position);
+			// chunk extensions are ignored
+			if (sizeLine.contains(';'))
+			{
+				sizeLine = sizeLine(0, sizeLine.indexOf(';'));
+			}
+			sizeLine = sizeLine.trimmed();
+			if (sizeLine == "" || !sizeLine.isHex() || sizeLine.size() > 7)
+			{
+				return -1;
+			}
+			chunkSize = (int)sizeLine.unhex();
+			if (chunkSize == 0)
+			{
+				position = lineEnd + 2;
+				trailers = true;
+				break;
+			}
+			// the chunk is decoded only once it has been received completely
+			if (size - (lineEnd + 2) < chunkSize + 2)
+			{
+				return 0;
+			}
+			position = lineEnd + 2;
+			if (data[position + chunkSize] != '\r' || data[position + chunkSize + 1] != '\n')
+			{
+				return -1;
+			}
+			body += hstr(data + position, chunkSize);
+			position += chunkSize + 2;
+		}
+		// trailers are skipped until the empty line
+		while (true)
+		{
+			lineEnd = -1;
+			for_iter (i, position, size - 1)
+			{
+				if (data[i] == '\r' && data[i + 1] == '\n')
+				{
+					lineEnd = i;
+					break;
+				}
+			}
+			if (lineEnd < 0)
+			{
+				return 0;
+			}
+			if (lineEnd == position)
+			{
+				position += 2;
+				break;
+			}
+			position = lineEnd + 2;
+		}
+		return 1;
+	}
+
+	hstr HttpServer::_makeStatusLine(HttpResponse::Code statusCode)
+	{
+		hstr reason;
+		switch (statusCode.value)
+		{
+		case 100: reason = "Continue";							break;
+		case 101: reason = "Switching Protocols";				break;
+		case 200: reason = "OK";								break;
+		case 201: reason = "Created";							break;
+		case 202: reason = "Accepted";							break;
+		case 203: reason = "Non-Authoritative Information";		break;
+		case 204: reason = "No Content";						break;
+		case 205: reason = "Reset Content";						break;
+		case 206: reason = "Partial Content";					break;
+		case 300: reason = "Multiple Choices";					break;
+		case 301: reason = "Moved Permanently";					break;
+		case 302: reason = "Found";								break;
+		case 303: reason = "See Other";							break;
+		case 304: reason = "Not Modified";						break;
+		case 305: reason = "Use Proxy";							break;
+		case 307: reason = "Temporary Redirect";				break;
+		case 400: reason = "Bad Request";						break;
+		case 401: reason = "Unauthorized";						break;
+		case 402: reason = "Payment Required";					break;
+		case 403: reason = "Forbidden";							break;
+		case 404: reason = "Not Found";							break;
+		case 405: reason = "Method Not Allowed";				break;
+		case 406: reason = "Not Acceptable";					break;
+		case 407: reason = "Proxy Authentication Required";		break;
+		case 408: reason = "Request Timeout";					break;
+		case 409: reason = "Conflict";							break;
+		case 410: reason = "Gone";								break;
+		case 411: reason = "Length Required";					break;
+		case 412: reason = "Precondition Failed";				break;
+		case 413: reason = "Payload Too Large";					break;
+		case 414: reason = "URI Too Long";						break;
+		case 415: reason = "Unsupported Media Type";			break;
+		case 416: reason = "Range Not Satisfiable";				break;
+		case 417: reason = "Expectation Failed";				break;
+		case 500: reason = "Internal Server Error";				break;
+		case 501: reason = "Not Implemented";					break;
+		case 502: reason = "Bad Gateway";						break;
+		case 503: reason = "Service Unavailable";				break;
+		case 504: reason = "Gateway Timeout";					break;
+		case 505: reason = "HTTP Version Not Supported";		break;
+		default:  reason = statusCode.getName();				break;
+		}
+		return hsprintf(HTTP_PROTOCOL " %d %s" HTTP_DELIMITER, statusCode.value, reason.cStr());
+	}
+
+}
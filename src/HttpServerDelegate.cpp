@@ -0,0 +1,25 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include "HttpResponse.h"
+#include "HttpServerDelegate.h"
+#include "HttpServerResponse.h"
+
+namespace sakit
+{
+	HttpServerDelegate::HttpServerDelegate() :
+		TcpServerDelegate()
+	{
+	}
+
+	void HttpServerDelegate::onRequest(HttpServer* server, HttpServerRequest* request, HttpServerResponse* response)
+	{
+		response->statusCode = HttpResponse::Code::NotFound;
+	}
+
+}
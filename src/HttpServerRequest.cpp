@@ -0,0 +1,18 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include "HttpServerRequest.h"
+
+namespace sakit
+{
+	HttpServerRequest::HttpServerRequest() :
+		remotePort(0)
+	{
+	}
+
+}
@@ -0,0 +1,61 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include "HttpServer.h"
+#include "HttpServerResponse.h"
+
+namespace sakit
+{
+	HttpServerResponse::HttpServerResponse(HttpServer* server, bool headRequest, bool connectionClose) :
+		statusCode(HttpResponse::Code::Ok),
+		chunked(false),
+		finished(false),
+		headSent(false),
+		bodyFileOffset(0LL),
+		bodyFileSize(0LL),
+		bodyData(NULL),
+		bodyDataSize(0)
+	{
+		this->server = server;
+		this->headRequest = headRequest;
+		this->connectionClose = connectionClose;
+	}
+
+	HttpServerResponse::~HttpServerResponse()
+	{
+	}
+
+	void HttpServerResponse::setBodyFile(chstr filename, int64_t offset, int64_t size)
+	{
+		this->bodyFilename = filename;
+		this->bodyFileOffset = offset;
+		this->bodyFileSize = size;
+		this->bodyData = NULL;
+		this->bodyDataSize = 0;
+	}
+
+	void HttpServerResponse::setBodyData(const char* data, int size)
+	{
+		this->bodyData = data;
+		this->bodyDataSize = size;
+		this->bodyFilename = "";
+		this->bodyFileOffset = 0LL;
+		this->bodyFileSize = 0LL;
+	}
+
+	bool HttpServerResponse::sendChunk(chstr data)
+	{
+		return this->server->_sendChunk(this, data);
+	}
+
+	void HttpServerResponse::finish()
+	{
+		this->server->_finishResponse(this);
+	}
+
+}
@@ -10,10 +10,14 @@
 #include <hltypes/hmap.h>
 #include <hltypes/hstring.h>
 
+#include "Hpack.h"
+#include "HttpCache.h"
+#include "HttpPhaseTimer.h"
 #include "HttpResponse.h"
 #include "HttpSocket.h"
 #include "HttpSocketDelegate.h"
 #include "HttpSocketThread.h"
+#include "HttpTiming.h"
 #include "PlatformSocket.h"
 #include "sakit.h"
 #include "sakitUtil.h"
@@ -28,41 +32,98 @@
 #define REQUEST_DELETE "DELETE"
 #define REQUEST_TRACE "TRACE"
 #define REQUEST_CONNECT "CONNECT"
+#ifdef _ZLIB
+#define DECODED_CONTENT_ENCODINGS "gzip, deflate"
+#else
+#define DECODED_CONTENT_ENCODINGS "identity"
+#endif
 
 #define NORMAL_EXECUTE(name, constant) \
-	bool HttpSocket::execute ## name(HttpResponse* response, Url url, chstr customBody, hmap<hstr, hstr> customHeaders) \
+	bool HttpSocket::execute ## name(HttpResponse* response, Url url, chstr customBody, const hmap<hstr, hstr>& customHeaders) \
 	{ \
 		return this->_executeMethod(response, REQUEST_ ## constant, url, customBody, customHeaders); \
 	}
 #define NORMAL_EXECUTE_ASYNC(name, constant) \
-	bool HttpSocket::execute ## name ## Async(Url url, chstr customBody, hmap<hstr, hstr> customHeaders) \
+	bool HttpSocket::execute ## name ## Async(Url url, chstr customBody, const hmap<hstr, hstr>& customHeaders) \
 	{ \
 		return this->_executeMethodAsync(REQUEST_ ## constant, url, customBody, customHeaders); \
 	}
 #define CONNECTED_EXECUTE(name, constant) \
-	bool HttpSocket::execute ## name(HttpResponse* response, chstr customBody, hmap<hstr, hstr> customHeaders) \
+	bool HttpSocket::execute ## name(HttpResponse* response, chstr customBody, const hmap<hstr, hstr>& customHeaders) \
 	{ \
 		return this->_executeMethod(response, REQUEST_ ## constant, customBody, customHeaders); \
 	}
+#define STREAM_EXECUTE(name, constant) \
+	bool HttpSocket::execute ## name(HttpResponse* response, Url url, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders, bool chunked) \
+	{ \
+		return this->_executeMethodStream(response, REQUEST_ ## constant, url, bodyStream, customHeaders, chunked); \
+	}
+#define STREAM_EXECUTE_ASYNC(name, constant) \
+	bool HttpSocket::execute ## name ## Async(Url url, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders, bool chunked) \
+	{ \
+		return this->_executeMethodStreamAsync(REQUEST_ ## constant, url, bodyStream, customHeaders, chunked); \
+	}
 #define CONNECTED_EXECUTE_ASYNC(name, constant) \
-	bool HttpSocket::execute ## name ## Async(chstr customBody, hmap<hstr, hstr> customHeaders) \
+	bool HttpSocket::execute ## name ## Async(chstr customBody, const hmap<hstr, hstr>& customHeaders) \
 	{ \
 		return this->_executeMethodAsync(REQUEST_ ## constant, customBody, customHeaders); \
 	}
 
 namespace sakit
 {
+	static inline void _writeString(hstream& stream, chstr string)
+	{
+		stream.writeRaw((void*)string.cStr(), string.size());
+	}
+
+	static inline void _writeHeader(hstream& stream, chstr name, chstr value)
+	{
+		_writeString(stream, name);
+		_writeString(stream, ": ");
+		_writeString(stream, value);
+		_writeString(stream, HTTP_DELIMITER);
+	}
+
 	HL_ENUM_CLASS_DEFINE(HttpSocket::Protocol,
 	(
 		HL_ENUM_DEFINE(HttpSocket::Protocol, Http11);
+		HL_ENUM_DEFINE(HttpSocket::Protocol, Http20);
 	));
 
 	unsigned short HttpSocket::DefaultPort = 80;
+	unsigned short HttpSocket::DefaultTlsPort = 443;
+	hmap<hstr, HttpSocket::Flight*> HttpSocket::flights;
+	hmutex HttpSocket::flightsMutex;
+
+	HttpSocket::Flight::Flight(chstr key) :
+		response(NULL),
+		result(State::Idle),
+		finished(false),
+		references(1)
+	{
+		this->key = key;
+	}
+
+	HttpSocket::Flight::~Flight()
+	{
+		if (this->response != NULL)
+		{
+			delete this->response;
+		}
+	}
 
 	HttpSocket::HttpSocket(HttpSocketDelegate* socketDelegate, Protocol protocol) :
 		SocketBase(),
 		keepAlive(false),
-		reportProgress(false)
+		reportProgress(false),
+		pipelining(false),
+		contentDecoding(false),
+		coalescing(false),
+		flight(NULL),
+		flightFollower(false),
+		cache(NULL),
+		cacheRequest(false),
+		cacheRevalidating(false)
 	{
 		this->socketDelegate = socketDelegate;
 		this->protocol = protocol;
@@ -77,6 +138,11 @@ namespace sakit
 		this->__unregister();
 		this->thread->join();
 		delete this->thread;
+		this->_leaveFlight();
+		foreach (HttpResponse*, it, this->cachedResponses)
+		{
+			delete (*it);
+		}
 	}
 
 	bool HttpSocket::isConnected()
@@ -93,6 +159,16 @@ namespace sakit
 
 	void HttpSocket::update(float timeDelta)
 	{
+		this->_updateCached();
+		if (this->_updateFollower())
+		{
+			return;
+		}
+		if (this->_isQueuing())
+		{
+			this->_updatePipelined();
+			return;
+		}
 		hmutex::ScopeLock lock(&this->mutexState);
 		hmutex::ScopeLock lockThreadResult(&this->thread->resultMutex);
 		hmutex::ScopeLock lockThreadResponse;
@@ -122,8 +198,20 @@ namespace sakit
 		response = this->thread->response->clone();
 		this->thread->response->clear();
 		lockThreadResponse.release();
+		if (result == State::Finished)
+		{
+			HttpTiming::_record(this->url, response->timing);
+			this->_updateCache(response, this->url);
+		}
+		this->cacheRequest = false;
+		// waiting sockets receive the same response, so it's only deleted when the last of them is done with it
+		Flight* flight = this->flight;
+		if (flight != NULL)
+		{
+			this->_finishFlight(response, result);
+		}
 		Url url = this->url; // _terminateConnection() deletes this, but it's needed for the delegate call ahead
-		if (!this->keepAlive || response->headers.tryGet(SAKIT_HTTP_REQUEST_HEADER_CONNECTION, "") == "close" || !this->socket->isConnected())
+		if (!this->keepAlive || response->connectionClose || !this->socket->isConnected())
 		{
 			this->_terminateConnection();
 			this->state = State::Idle;
@@ -150,7 +238,140 @@ namespace sakit
 		{
 			this->socketDelegate->onExecuteFailed(this, response, url);
 		}
-		delete response;
+		if (flight != NULL)
+		{
+			HttpSocket::_releaseFlight(flight);
+		}
+		else
+		{
+			delete response;
+		}
+	}
+
+	bool HttpSocket::_updateFollower()
+	{
+		hmutex::ScopeLock lock(&this->mutexState);
+		if (this->flight == NULL || !this->flightFollower)
+		{
+			return false;
+		}
+		hmutex::ScopeLock lockFlights(&HttpSocket::flightsMutex);
+		if (!this->flight->finished)
+		{
+			return true;
+		}
+		Flight* flight = this->flight;
+		this->flight = NULL;
+		this->flightFollower = false;
+		State result = flight->result;
+		HttpResponse* response = flight->response;
+		lockFlights.release();
+		this->state = State::Idle;
+		Url url = this->url;
+		lock.release();
+		// previous delegate calls could have read from the shared response
+		response->raw.rewind();
+		response->body.rewind();
+		if (result == State::Finished)
+		{
+			this->socketDelegate->onExecuteCompleted(this, response, url);
+		}
+		else
+		{
+			this->socketDelegate->onExecuteFailed(this, response, url);
+		}
+		HttpSocket::_releaseFlight(flight);
+		return true;
+	}
+
+	void HttpSocket::_updateCached()
+	{
+		hmutex::ScopeLock lock(&this->mutexState);
+		if (this->cachedResponses.size() == 0)
+		{
+			return;
+		}
+		harray<HttpResponse*> responses = this->cachedResponses;
+		harray<Url> urls = this->cachedUrls;
+		this->cachedResponses.clear();
+		this->cachedUrls.clear();
+		lock.release();
+		for_iter (i, 0, responses.size())
+		{
+			this->socketDelegate->onExecuteCompleted(this, responses[i], urls[i]);
+			delete responses[i];
+		}
+	}
+
+	void HttpSocket::_updatePipelined()
+	{
+		hmutex::ScopeLock lock(&this->mutexState);
+		hmutex::ScopeLock lockThreadResponse(&this->thread->responseMutex);
+		harray<HttpSocketThread::Request*> requests = this->thread->finishedRequests;
+		this->thread->finishedRequests.clear();
+		harray<HttpResponse*> responses;
+		harray<Url> urls;
+		if (this->reportProgress)
+		{
+			// only the first request receives data when pipelining, but all of them can when multiplexing
+			foreach (HttpSocketThread::Request*, it, this->thread->queuedRequests)
+			{
+				if ((*it)->response->hasNewData())
+				{
+					responses += (*it)->response->clone();
+					(*it)->response->consumeNewData();
+					urls += (*it)->url;
+				}
+			}
+		}
+		lockThreadResponse.release();
+		hmutex::ScopeLock lockThreadResult(&this->thread->resultMutex);
+		State result = this->thread->result;
+		if (result != State::Running && result != State::Idle)
+		{
+			this->thread->result = State::Idle;
+			if (this->state == State::Running)
+			{
+				if (!this->keepAlive || !this->socket->isConnected())
+				{
+					this->_terminateConnection();
+					this->state = State::Idle;
+				}
+				else
+				{
+					this->state = State::Connected;
+				}
+			}
+		}
+		lockThreadResult.release();
+		lock.release();
+		// pipelined responses are delivered in the same order as the requests were queued, multiplexed ones as they finish
+		foreach (HttpSocketThread::Request*, it, requests)
+		{
+			// some final data might be available
+			if (this->reportProgress && (*it)->response->hasNewData())
+			{
+				this->socketDelegate->onExecuteProgress(this, (*it)->response, (*it)->url);
+			}
+			// the data can be rewinded after reporting progress
+			(*it)->response->raw.rewind();
+			(*it)->response->body.rewind();
+			if ((*it)->result == State::Finished)
+			{
+				HttpTiming::_record((*it)->url, (*it)->response->timing);
+				this->socketDelegate->onExecuteCompleted(this, (*it)->response, (*it)->url);
+			}
+			else
+			{
+				this->socketDelegate->onExecuteFailed(this, (*it)->response, (*it)->url);
+			}
+			delete (*it);
+		}
+		for_iter (i, 0, responses.size())
+		{
+			this->socketDelegate->onExecuteProgress(this, responses[i], urls[i]);
+			delete responses[i];
+		}
 	}
 
 	NORMAL_EXECUTE(Options, OPTIONS);
@@ -189,7 +410,13 @@ namespace sakit
 	CONNECTED_EXECUTE_ASYNC(Trace, TRACE);
 	CONNECTED_EXECUTE_ASYNC(Connect, CONNECT);
 
-	bool HttpSocket::_executeMethodInternal(HttpResponse* response, chstr method, Url& url, chstr customBody, hmap<hstr, hstr>& customHeaders)
+	STREAM_EXECUTE(Post, POST);
+	STREAM_EXECUTE(Put, PUT);
+
+	STREAM_EXECUTE_ASYNC(Post, POST);
+	STREAM_EXECUTE_ASYNC(Put, PUT);
+
+	bool HttpSocket::_executeMethodInternal(HttpResponse* response, chstr method, Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders, hsbase* bodyStream, bool chunked)
 	{
 		if (response == NULL)
 		{
@@ -206,10 +433,24 @@ namespace sakit
 		{
 			return false;
 		}
+		hmap<hstr, hstr> requestHeaders = customHeaders;
+		if (this->_lookupCache(method, url, customBody, bodyStream, requestHeaders, response))
+		{
+			return true;
+		}
 		this->state = State::Running;
 		lock.release();
-		hstr request = this->_processRequest(method, url, customBody, customHeaders);
-		unsigned short port = (this->url.getPort() == 0 ? this->remotePort : this->url.getPort());
+		HttpPhaseTimer timer;
+		// the request buffer keeps its capacity so it doesn't have to be reallocated for every request
+		this->requestStream.clear(this->requestStream.getCapacity());
+		this->_processRequest(this->requestStream, method, url, customBody, requestHeaders, bodyStream, chunked);
+		this->requestStream.rewind();
+		unsigned short port = this->_prepareConnection();
+		bool reused = this->socket->isConnected();
+		if (!reused)
+		{
+			timer.beginConnect();
+		}
 		bool result = this->socket->connect(this->remoteHost, port, this->localHost, this->localPort, this->timeout, this->retryFrequency);
 		if (!result)
 		{
@@ -218,15 +459,23 @@ namespace sakit
 			this->state = State::Idle;
 			return false;
 		}
-		if (SocketBase::_send(request) == 0)
+		if (!reused)
+		{
+			timer.endConnect(this->socket->getResolveDuration());
+		}
+		timer.beginSend();
+		if (this->_send(&this->requestStream, (int)this->requestStream.size()) == 0 || (bodyStream != NULL && !this->_sendBodyStream(bodyStream, chunked)))
 		{
 			this->_terminateConnection();
 			lock.acquire(&this->mutexState);
 			this->state = State::Idle;
 			return false;
 		}
+		timer.endSend();
 		response->clear();
-		if (this->_receiveHttpDirect(response) == 0)
+		response->bodyExpected = (method != REQUEST_HEAD);
+		response->decodeContent = this->contentDecoding;
+		if (this->_receiveHttpDirect(response, &timer) == 0)
 		{
 			this->_terminateConnection();
 			lock.acquire(&this->mutexState);
@@ -235,7 +484,15 @@ namespace sakit
 		}
 		response->body.rewind();
 		response->raw.rewind();
-		if (!this->keepAlive || response->headers.tryGet(SAKIT_HTTP_REQUEST_HEADER_CONNECTION, "") == "close")
+		bool complete = (response->headersComplete && response->bodyComplete && !response->bodyFailed);
+		if (complete)
+		{
+			timer.finish(response->timing);
+			HttpTiming::_record(url, response->timing);
+			this->_updateCache(response, url);
+		}
+		this->cacheRequest = false;
+		if (!this->keepAlive || response->connectionClose)
 		{
 			this->_terminateConnection();
 			lock.acquire(&this->mutexState);
@@ -246,10 +503,10 @@ namespace sakit
 			lock.acquire(&this->mutexState);
 			this->state = State::Connected;
 		}
-		return (response->headersComplete && response->bodyComplete);
+		return complete;
 	}
 
-	bool HttpSocket::_executeMethod(HttpResponse* response, chstr method, Url& url, chstr customBody, hmap<hstr, hstr>& customHeaders)
+	bool HttpSocket::_executeMethod(HttpResponse* response, chstr method, Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders)
 	{
 		if (this->isConnected())
 		{
@@ -259,7 +516,7 @@ namespace sakit
 		return this->_executeMethodInternal(response, method, url, customBody, customHeaders);
 	}
 
-	bool HttpSocket::_executeMethod(HttpResponse* response, chstr method, chstr customBody, hmap<hstr, hstr>& customHeaders)
+	bool HttpSocket::_executeMethod(HttpResponse* response, chstr method, chstr customBody, const hmap<hstr, hstr>& customHeaders)
 	{
 		if (!this->isConnected())
 		{
@@ -269,7 +526,22 @@ namespace sakit
 		return this->_executeMethodInternal(response, method, this->url, customBody, customHeaders);
 	}
 
-	bool HttpSocket::_executeMethodInternalAsync(chstr method, Url& url, chstr customBody, hmap<hstr, hstr>& customHeaders)
+	bool HttpSocket::_executeMethodStream(HttpResponse* response, chstr method, Url& url, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders, bool chunked)
+	{
+		if (bodyStream == NULL)
+		{
+			hlog::warn(logTag, "Cannot execute, body stream is NULL!");
+			return false;
+		}
+		if (this->isConnected())
+		{
+			hlog::warn(logTag, "Already existing connection will be closed!");
+			this->_terminateConnection();
+		}
+		return this->_executeMethodInternal(response, method, url, "", customHeaders, bodyStream, chunked);
+	}
+
+	bool HttpSocket::_executeMethodInternalAsync(chstr method, Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders, hsbase* bodyStream, bool chunked)
 	{
 		if (!url.isValid())
 		{
@@ -282,20 +554,127 @@ namespace sakit
 		{
 			return false;
 		}
-		hstr request = this->_processRequest(method, url, customBody, customHeaders);
+		hmap<hstr, hstr> requestHeaders = customHeaders;
+		HttpResponse* cachedResponse = (this->cache != NULL ? new HttpResponse() : NULL);
+		if (this->_lookupCache(method, url, customBody, bodyStream, requestHeaders, cachedResponse))
+		{
+			// reported in the next update() without touching the connection
+			this->cachedResponses += cachedResponse;
+			this->cachedUrls += url;
+			return true;
+		}
+		if (cachedResponse != NULL)
+		{
+			delete cachedResponse;
+		}
+		if (this->_joinFlight(method, url, customBody, bodyStream, customHeaders))
+		{
+			this->url = url;
+			this->state = State::Running;
+			return true;
+		}
 		this->thread->response->clear();
-		this->thread->stream->clear();
-		this->thread->stream->writeRaw((void*)request.cStr(), request.size());
+		this->thread->response->bodyExpected = (method != REQUEST_HEAD);
+		this->thread->response->decodeContent = this->contentDecoding;
+		this->thread->stream->clear(this->thread->stream->getCapacity());
+		this->_processRequest(*this->thread->stream, method, url, customBody, requestHeaders, bodyStream, chunked);
 		this->thread->stream->rewind();
+		this->thread->bodyStream = bodyStream;
+		this->thread->bodyChunked = chunked;
 		this->thread->host = this->remoteHost;
-		this->thread->port = (this->url.getPort() == 0 ? this->remotePort : this->url.getPort());
+		this->thread->port = this->_prepareConnection();
+		this->thread->pipelining = false;
 		this->state = State::Running;
 		this->thread->start();
 		return true;
 	}
 
-	bool HttpSocket::_executeMethodAsync(chstr method, Url& url, chstr customBody, hmap<hstr, hstr>& customHeaders)
+	bool HttpSocket::_executeMethodPipelinedAsync(chstr method, Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders)
+	{
+		if (!url.isValid())
+		{
+			hlog::warn(logTag, "Cannot execute, URL is not valid!");
+			return false;
+		}
+		bool multiplexing = (this->protocol == Protocol::Http20);
+		if (!this->keepAlive && !multiplexing)
+		{
+			hlog::warn(logTag, "Cannot execute pipelined, keep-alive is not enabled!");
+			return false;
+		}
+		hmutex::ScopeLock lock(&this->mutexState);
+		if (!this->_canExecutePipelined(this->state))
+		{
+			return false;
+		}
+		if (this->state != State::Idle && (url.getscheme() != this->url.getscheme() || url.getHost() != this->url.getHost() || url.getPort() != this->url.getPort()))
+		{
+			hlog::warn(logTag, "Cannot execute pipelined, URL does not match the existing connection: " + url.toString());
+			return false;
+		}
+		HttpSocketThread::Request* request = new HttpSocketThread::Request(method, url);
+		request->decodeContent = this->contentDecoding;
+		if (multiplexing)
+		{
+			this->_processRequestHttp2(request->headerFields, request->body, method, url, customBody, customHeaders);
+		}
+		else
+		{
+			this->_processRequest(*request->stream, method, url, customBody, customHeaders);
+			request->stream->rewind();
+		}
+		hmutex::ScopeLock lockThreadResponse(&this->thread->responseMutex);
+		this->thread->queuedRequests += request;
+		if (this->thread->pipelineActive)
+		{
+			return true;
+		}
+		this->thread->pipelineActive = true;
+		lockThreadResponse.release();
+		this->thread->join(); // the previous run could still be finishing up
+		hmutex::ScopeLock lockThreadResult(&this->thread->resultMutex);
+		this->thread->host = this->remoteHost;
+		this->thread->port = this->_prepareConnection(multiplexing);
+		this->thread->pipelining = true;
+		this->thread->multiplexing = multiplexing;
+		this->thread->result = State::Running;
+		this->state = State::Running;
+		this->thread->start();
+		return true;
+	}
+
+	bool HttpSocket::_isQueuing()
+	{
+		return (this->pipelining || this->protocol == Protocol::Http20);
+	}
+
+	bool HttpSocket::_executeMethodStreamAsync(chstr method, Url& url, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders, bool chunked)
+	{
+		if (bodyStream == NULL)
+		{
+			hlog::warn(logTag, "Cannot execute, body stream is NULL!");
+			return false;
+		}
+		if (this->_isQueuing())
+		{
+			// a streamed body can't be sent again when a pipelined or multiplexed connection has to be reestablished
+			hlog::warn(logTag, "Cannot execute pipelined or multiplexed with a streamed body!");
+			return false;
+		}
+		if (this->isConnected())
+		{
+			hlog::warn(logTag, "Already existing connection will be closed!");
+			this->_terminateConnection();
+		}
+		return this->_executeMethodInternalAsync(method, url, "", customHeaders, bodyStream, chunked);
+	}
+
+	bool HttpSocket::_executeMethodAsync(chstr method, Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders)
 	{
+		if (this->_isQueuing())
+		{
+			return this->_executeMethodPipelinedAsync(method, url, customBody, customHeaders);
+		}
 		if (this->isConnected())
 		{
 			hlog::warn(logTag, "Already existing connection will be closed!");
@@ -304,34 +683,46 @@ namespace sakit
 		return this->_executeMethodInternalAsync(method, url, customBody, customHeaders);
 	}
 
-	bool HttpSocket::_executeMethodAsync(chstr method, chstr customBody, hmap<hstr, hstr>& customHeaders)
+	bool HttpSocket::_executeMethodAsync(chstr method, chstr customBody, const hmap<hstr, hstr>& customHeaders)
 	{
 		if (!this->isConnected())
 		{
 			hlog::warn(logTag, "Cannot execute, there is no existing connection!");
 			return false;
 		}
+		if (this->_isQueuing())
+		{
+			Url url = this->url;
+			return this->_executeMethodPipelinedAsync(method, url, customBody, customHeaders);
+		}
 		return this->_executeMethodInternalAsync(method, this->url, customBody, customHeaders);
 	}
 
-	int HttpSocket::_receiveHttpDirect(HttpResponse* response)
+	int HttpSocket::_receiveHttpDirect(HttpResponse* response, HttpPhaseTimer* timer)
 	{
 		int maxCount = 0;
 		hstream stream(maxCount);
 		float time = 0.0f;
+		// raw doesn't keep everything when the body is written to a destination so received data is counted separately
+		int64_t receivedSize = 0LL;
 		int64_t size = 0LL;
-		int64_t lastSize = 0LL;
 		int64_t position = 0LL;
 		bool hasMoreData = false;
 		while (true)
 		{
 			maxCount = HTTP_SOCKET_THREAD_BUFFER_SIZE;
 			hasMoreData = this->socket->receive(&stream, maxCount);
-			if (stream.size() > 0)
+			size = stream.size();
+			if (size > 0)
 			{
+				receivedSize += size;
+				if (timer != NULL)
+				{
+					timer->receive();
+				}
 				stream.rewind();
-				response->raw.seek(0, hseek::End);
 				position = response->raw.position();
+				response->raw.seek(0, hseek::End);
 				response->raw.writeRaw(stream);
 				response->raw.seek(position, hseek::Start);
 				response->parseFromRaw();
@@ -341,10 +732,8 @@ namespace sakit
 				break;
 			}
 			stream.clear(maxCount);
-			size = response->raw.size();
-			if (lastSize != size)
+			if (size > 0)
 			{
-				lastSize = size;
 				// retry attempts are reset after a successful read
 				time = 0.0f;
 				continue;
@@ -359,18 +748,18 @@ namespace sakit
 		// if timed out, has no predefined length, all headers were received and there is a body
 		if (time >= this->timeout && response->headersComplete)
 		{
-			if (!response->headers.hasKey(SAKIT_HTTP_REQUEST_HEADER_CONTENT_LENGTH) && response->body.size() > 0)
+			if (response->contentLength < 0 && (response->body.size() > 0 || response->bodyDestination != NULL))
 			{
 				// let's say it's complete, we don't know its supposed length anyway
 				hlog::warn(logTag, "HttpSocket did not return header Content-Length! Body might be incomplete, but will be considered complete.");
 				response->bodyComplete = true;
 			}
-			else if ((int)response->headers[SAKIT_HTTP_REQUEST_HEADER_CONTENT_LENGTH] == 0) // empty body
+			else if (response->contentLength == 0) // empty body
 			{
 				response->bodyComplete = true;
 			}
 		}
-		return (int)response->raw.size();
+		return (int)hmin(receivedSize, (int64_t)INT_MAX);
 	}
 
 	int HttpSocket::_send(hstream* stream, int count)
@@ -384,6 +773,25 @@ namespace sakit
 		return false;
 	}
 
+	bool HttpSocket::_sendBodyStream(hsbase* bodyStream, bool chunked)
+	{
+		hstream piece(HTTP_SOCKET_THREAD_BODY_PIECE_SIZE + 16);
+		int64_t remaining = (chunked ? -1LL : bodyStream->size() - bodyStream->position());
+		int result = 0;
+		while (true)
+		{
+			result = HttpSocketThread::_makeBodyPiece(bodyStream, chunked, remaining, piece);
+			if (result <= 0)
+			{
+				return (result == 0);
+			}
+			if (this->_sendDirect(&piece, (int)piece.size()) < (int)piece.size())
+			{
+				return false;
+			}
+		}
+	}
+
 	bool HttpSocket::abort()
 	{
 		hmutex::ScopeLock lock(&this->mutexState);
@@ -391,9 +799,27 @@ namespace sakit
 		{
 			return false;
 		}
+		if (this->flight != NULL && this->flightFollower)
+		{
+			// there is no connection, the socket only stops waiting
+			this->_leaveFlight();
+			this->state = State::Idle;
+			this->url = Url();
+			return true;
+		}
 		this->state = State::Disconnecting;
 		lock.release();
+		bool queuing = this->_isQueuing();
+		if (queuing)
+		{
+			// all queued requests fail, they are reported in update()
+			this->thread->executing = false;
+		}
 		bool result = this->socket->disconnect();
+		if (queuing)
+		{
+			this->thread->join();
+		}
 		lock.acquire(&this->mutexState);
 		if (result)
 		{
@@ -417,37 +843,257 @@ namespace sakit
 		this->url = Url();
 	}
 
+	unsigned short HttpSocket::_prepareConnection(bool multiplexing)
+	{
+		bool tlsEnabled = (this->url.getscheme() == SAKIT_HTTPS_SCHEME);
+		if (this->socket->isConnected() && this->socket->isTlsEnabled() != tlsEnabled)
+		{
+			this->socket->disconnect();
+		}
+		this->socket->setTlsEnabled(tlsEnabled, this->url.getHost());
+		// HTTP/2 over TLS has to be negotiated during the handshake
+		this->socket->setTlsApplicationProtocol(tlsEnabled && multiplexing ? "h2" : "");
+		if (this->url.getPort() != 0)
+		{
+			return this->url.getPort();
+		}
+		return (tlsEnabled ? HttpSocket::DefaultTlsPort : this->remotePort);
+	}
+
 	bool HttpSocket::_canExecute(State state)
 	{
 		return _checkState(state, State::allowedHttpExecuteStates, "execute");
 	}
 
+	bool HttpSocket::_canExecutePipelined(State state)
+	{
+		return _checkState(state, State::allowedHttpExecutePipelinedStates, "execute pipelined");
+	}
+
 	bool HttpSocket::_canAbort(State state)
 	{
 		return _checkState(state, State::allowedHttpAbortStates, "abort");
 	}
 
-	hstr HttpSocket::_processRequest(chstr method, Url url, chstr customBody, hmap<hstr, hstr> customHeaders)
+	bool HttpSocket::_lookupCache(chstr method, const Url& url, chstr customBody, hsbase* bodyStream, hmap<hstr, hstr>& requestHeaders, HttpResponse* response)
+	{
+		this->cacheRequest = (this->cache != NULL && response != NULL && method == REQUEST_GET && customBody == "" && bodyStream == NULL);
+		this->cacheRevalidating = false;
+		this->cacheRequestHeaders.clear();
+		if (!this->cacheRequest)
+		{
+			return false;
+		}
+		// the cache has to see the same Accept-Encoding that is actually sent in case the response varies by it
+		this->cacheRequestHeaders = requestHeaders;
+		if (!this->cacheRequestHeaders.hasKey(SAKIT_HTTP_REQUEST_HEADER_ACCEPT_ENCODING))
+		{
+			this->cacheRequestHeaders[SAKIT_HTTP_REQUEST_HEADER_ACCEPT_ENCODING] = (this->contentDecoding ? DECODED_CONTENT_ENCODINGS : "identity");
+		}
+		hmap<hstr, hstr> validators;
+		if (this->cache->_lookup(url, this->cacheRequestHeaders, response, validators))
+		{
+			this->cacheRequest = false;
+			return true;
+		}
+		// conditional headers set by the caller are left alone and the 304 is passed on unchanged
+		foreach_m (hstr, it, validators)
+		{
+			if (!requestHeaders.hasKey(it->first))
+			{
+				requestHeaders[it->first] = it->second;
+				this->cacheRevalidating = true;
+			}
+		}
+		return false;
+	}
+
+	void HttpSocket::_updateCache(HttpResponse* response, const Url& url)
+	{
+		if (!this->cacheRequest)
+		{
+			return;
+		}
+		this->cacheRequest = false;
+		if (response->statusCode == HttpResponse::Code::NotModified)
+		{
+			if (this->cacheRevalidating)
+			{
+				this->cache->_revalidate(url, this->cacheRequestHeaders, response);
+			}
+			return;
+		}
+		this->cache->_store(url, this->cacheRequestHeaders, response);
+	}
+
+	bool HttpSocket::_joinFlight(chstr method, const Url& url, chstr customBody, hsbase* bodyStream, const hmap<hstr, hstr>& customHeaders)
+	{
+		this->_leaveFlight();
+		if (!this->coalescing || method != REQUEST_GET || customBody != "" || bodyStream != NULL)
+		{
+			return false;
+		}
+		// all headers are part of the key, because any of them could change the response
+		hstr key = url.toString() + HTTP_DELIMITER + (this->contentDecoding ? DECODED_CONTENT_ENCODINGS : "identity");
+		foreachc_m (hstr, it, customHeaders)
+		{
+			key += HTTP_DELIMITER + it->first + ": " + it->second;
+		}
+		hmutex::ScopeLock lock(&HttpSocket::flightsMutex);
+		Flight* flight = HttpSocket::flights.tryGet(key, NULL);
+		if (flight != NULL)
+		{
+			++flight->references;
+			this->flight = flight;
+			this->flightFollower = true;
+			return true;
+		}
+		this->flight = new Flight(key);
+		this->flightFollower = false;
+		HttpSocket::flights[key] = this->flight;
+		return false;
+	}
+
+	void HttpSocket::_finishFlight(HttpResponse* response, State result)
+	{
+		hmutex::ScopeLock lock(&HttpSocket::flightsMutex);
+		this->flight->response = response;
+		this->flight->result = result;
+		this->flight->finished = true;
+		// new requests can't join anymore and have to be executed again
+		HttpSocket::flights.removeKey(this->flight->key);
+		this->flight = NULL;
+	}
+
+	void HttpSocket::_leaveFlight()
+	{
+		if (this->flight == NULL)
+		{
+			return;
+		}
+		Flight* flight = this->flight;
+		this->flight = NULL;
+		hmutex::ScopeLock lock(&HttpSocket::flightsMutex);
+		if (!this->flightFollower && !flight->finished)
+		{
+			// the waiting sockets fail, because the request won't be finished
+			flight->response = new HttpResponse();
+			flight->result = State::Failed;
+			flight->finished = true;
+			HttpSocket::flights.removeKey(flight->key);
+		}
+		this->flightFollower = false;
+		lock.release();
+		HttpSocket::_releaseFlight(flight);
+	}
+
+	void HttpSocket::_releaseFlight(Flight* flight)
+	{
+		hmutex::ScopeLock lock(&HttpSocket::flightsMutex);
+		--flight->references;
+		if (flight->references > 0)
+		{
+			return;
+		}
+		lock.release();
+		delete flight;
+	}
+
+	void HttpSocket::_processRequest(hstream& output, chstr method, const Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders, hsbase* bodyStream, bool chunked)
 	{
 		this->url = url;
 		this->remoteHost = Host(this->url.getHost());
-		customHeaders[SAKIT_HTTP_REQUEST_HEADER_HOST] = this->remoteHost.toString();
-		customHeaders[SAKIT_HTTP_REQUEST_HEADER_CONNECTION] = (this->keepAlive ? "keep-alive" : "close");
+		bool urlEncoded = (bodyStream == NULL && customBody == "" && (method == REQUEST_GET || method == REQUEST_HEAD || method == REQUEST_OPTIONS));
+		hstr absolutePath;
+		hstr body = customBody;
+		hstr contentLength;
+		if (bodyStream != NULL)
+		{
+			// the body itself is sent separately after the request headers
+			absolutePath = this->url.getRelativePath();
+			if (!chunked)
+			{
+				contentLength = hstr(bodyStream->size() - bodyStream->position());
+			}
+		}
+		else if (!urlEncoded)
+		{
+			absolutePath = this->url.getRelativePath();
+			if (customBody == "")
+			{
+				body = this->url.getBody();
+			}
+			if (body != "")
+			{
+				contentLength = hstr(body.size());
+			}
+		}
+		else
+		{
+			absolutePath = this->url.toString(false, true);
+		}
+		int64_t start = output.size();
+		output.seek(0, hseek::End);
+		// everything is written directly into the output stream to avoid building temporary strings
+		_writeString(output, method);
+		_writeString(output, " ");
+		_writeString(output, absolutePath);
+		_writeString(output, " ");
+		_writeString(output, this->_makeProtocol());
+		_writeString(output, HTTP_DELIMITER);
+		_writeHeader(output, SAKIT_HTTP_REQUEST_HEADER_HOST, this->remoteHost.toString());
+		_writeHeader(output, SAKIT_HTTP_REQUEST_HEADER_CONNECTION, (this->keepAlive ? "keep-alive" : "close"));
 		if (!customHeaders.hasKey(SAKIT_HTTP_REQUEST_HEADER_ACCEPT_ENCODING))
 		{
-			customHeaders[SAKIT_HTTP_REQUEST_HEADER_ACCEPT_ENCODING] = "identity";
+			_writeHeader(output, SAKIT_HTTP_REQUEST_HEADER_ACCEPT_ENCODING, (this->contentDecoding ? DECODED_CONTENT_ENCODINGS : "identity"));
 		}
 		if (!customHeaders.hasKey(SAKIT_HTTP_REQUEST_HEADER_CONTENT_TYPE))
 		{
-			customHeaders[SAKIT_HTTP_REQUEST_HEADER_CONTENT_TYPE] = "application/x-www-form-urlencoded";
+			_writeHeader(output, SAKIT_HTTP_REQUEST_HEADER_CONTENT_TYPE, "application/x-www-form-urlencoded");
 		}
 		if (!customHeaders.hasKey(SAKIT_HTTP_REQUEST_HEADER_ACCEPT))
 		{
-			customHeaders[SAKIT_HTTP_REQUEST_HEADER_ACCEPT] = "*/*";
+			_writeHeader(output, SAKIT_HTTP_REQUEST_HEADER_ACCEPT, "*/*");
 		}
+		bool streamChunked = (bodyStream != NULL && chunked);
+		if (streamChunked)
+		{
+			_writeHeader(output, SAKIT_HTTP_REQUEST_HEADER_TRANSFER_ENCODING, "chunked");
+		}
+		if (contentLength != "")
+		{
+			_writeHeader(output, SAKIT_HTTP_REQUEST_HEADER_CONTENT_LENGTH, contentLength);
+		}
+		foreachc_m (hstr, it, customHeaders)
+		{
+			// these are always determined by the socket itself
+			if (it->first == SAKIT_HTTP_REQUEST_HEADER_HOST || it->first == SAKIT_HTTP_REQUEST_HEADER_CONNECTION ||
+				((contentLength != "" || streamChunked) && it->first == SAKIT_HTTP_REQUEST_HEADER_CONTENT_LENGTH) ||
+				(streamChunked && it->first == SAKIT_HTTP_REQUEST_HEADER_TRANSFER_ENCODING))
+			{
+				continue;
+			}
+			_writeHeader(output, it->first, it->second);
+		}
+		_writeString(output, HTTP_DELIMITER);
+		if (body != "")
+		{
+			// nothing follows the body since Content-Length doesn't count it and it would end up in front of the next pipelined request
+			_writeString(output, body);
+		}
+		if (hlog::isLevelDebug())
+		{
+			hlog::debug(logTag, "Processed request generated:\n" + hstr((char*)&output[(int)start], (int)(output.size() - start)));
+		}
+	}
+
+	void HttpSocket::_processRequestHttp2(harray<HpackField>& fields, hstr& body, chstr method, const Url& url, chstr customBody, const hmap<hstr, hstr>& customHeaders)
+	{
+		this->url = url;
+		this->remoteHost = Host(this->url.getHost());
 		bool urlEncoded = (customBody == "" && (method == REQUEST_GET || method == REQUEST_HEAD || method == REQUEST_OPTIONS));
 		hstr absolutePath;
-		hstr body = customBody;
+		body = customBody;
 		if (!urlEncoded)
 		{
 			absolutePath = this->url.getRelativePath();
@@ -455,28 +1101,59 @@ namespace sakit
 			{
 				body = this->url.getBody();
 			}
-			if (body != "")
-			{
-				customHeaders[SAKIT_HTTP_REQUEST_HEADER_CONTENT_LENGTH] = hstr(body.size());
-			}
 		}
 		else
 		{
 			absolutePath = this->url.toString(false, true);
 		}
-		hstr request;
-		request += method + " " + absolutePath + " " + this->_makeProtocol() + HTTP_DELIMITER;
-		foreach_m (hstr, it, customHeaders)
+		hstr authority = this->remoteHost.toString();
+		if (this->url.getPort() != 0)
 		{
-			request += it->first + ": " + it->second + HTTP_DELIMITER;
+			authority += ":" + hstr(this->url.getPort());
+		}
+		// pseudo-headers have to come first and all names are lowercase
+		fields.clear();
+		fields += HpackField(":method", method);
+		fields += HpackField(":scheme", (this->url.getscheme() == SAKIT_HTTPS_SCHEME ? "https" : "http"));
+		fields += HpackField(":authority", authority);
+		fields += HpackField(":path", absolutePath);
+		if (!customHeaders.hasKey(SAKIT_HTTP_REQUEST_HEADER_ACCEPT_ENCODING))
+		{
+			fields += HpackField("accept-encoding", (this->contentDecoding ? DECODED_CONTENT_ENCODINGS : "identity"));
+		}
+		if (!customHeaders.hasKey(SAKIT_HTTP_REQUEST_HEADER_CONTENT_TYPE))
+		{
+			fields += HpackField("content-type", "application/x-www-form-urlencoded");
+		}
+		if (!customHeaders.hasKey(SAKIT_HTTP_REQUEST_HEADER_ACCEPT))
+		{
+			fields += HpackField("accept", "*/*");
 		}
-		request += HTTP_DELIMITER;
 		if (body != "")
 		{
-			request += body + HTTP_DELIMITER;
+			fields += HpackField("content-length", hstr(body.size()));
+		}
+		hstr name;
+		foreachc_m (hstr, it, customHeaders)
+		{
+			name = it->first.lowered();
+			// the host is sent as :authority, the framing is done by HTTP/2 and connection-specific fields aren't allowed
+			if (name == "host" || name == "connection" || name == "keep-alive" || name == "transfer-encoding" || name == "upgrade" ||
+				(body != "" && name == "content-length"))
+			{
+				continue;
+			}
+			fields += HpackField(name, it->second);
+		}
+		if (hlog::isLevelDebug())
+		{
+			hstr request;
+			foreach (HpackField, it, fields)
+			{
+				request += (*it).name + ": " + (*it).value + "\n";
+			}
+			hlog::debug(logTag, "Processed HTTP/2 request generated:\n" + request + body);
 		}
-		hlog::debug(logTag, "Processed request generated:\n" + request);
-		return request;
 	}
 
 	hstr HttpSocket::_makeProtocol()
@@ -491,12 +1168,11 @@ namespace sakit
 		{
 			return "HTTP/1.1";
 		}
-		/*
 		if (this->protocol == Protocol::Http20)
 		{
-			return "HTTP/2.0";
+			// only used by requests that aren't multiplexed and fall back to HTTP/1.1
+			return "HTTP/1.1";
 		}
-		*/
 		hlog::error(logTag, "Invalid HTTP protocol version!");
 		return ""; // invalid
 	}
@@ -12,6 +12,7 @@
 #include <hltypes/hstream.h>
 #include <hltypes/hthread.h>
 
+#include "Http2Session.h"
 #include "HttpResponse.h"
 #include "HttpSocket.h"
 #include "HttpSocketThread.h"
@@ -20,57 +21,181 @@
 #include "SocketDelegate.h"
 #include "State.h"
 
+#define HTTP_DELIMITER "\r\n"
+#define REQUEST_OPTIONS "OPTIONS"
+#define REQUEST_GET "GET"
+#define REQUEST_HEAD "HEAD"
+#define REQUEST_TRACE "TRACE"
+
 namespace sakit
 {
+	HttpSocketThread::Request::Request(chstr method, Url url) :
+		result(State::Idle),
+		sent(false),
+		attempts(0),
+		decodeContent(false)
+	{
+		this->method = method;
+		this->url = url;
+		this->stream = new hstream();
+		this->response = new HttpResponse();
+	}
+
+	HttpSocketThread::Request::~Request()
+	{
+		delete this->stream;
+		delete this->response;
+	}
+
 	HttpSocketThread::HttpSocketThread(PlatformSocket* socket, float* timeout, float* retryFrequency) :
-		TimedThread(socket, timeout, retryFrequency)
+		TimedThread(socket, timeout, retryFrequency),
+		bodyStream(NULL),
+		bodyChunked(false),
+		pipelining(false),
+		multiplexing(false),
+		pipelineActive(false)
 	{
 		this->name = "SAKit HTTP Socket";
 		this->stream = new hstream();
 		this->response = new HttpResponse();
+		this->session = new Http2Session();
 	}
 
 	HttpSocketThread::~HttpSocketThread()
 	{
 		delete this->stream;
 		delete this->response;
+		delete this->session;
+		foreach (Request*, it, this->queuedRequests)
+		{
+			delete (*it);
+		}
+		foreach (Request*, it, this->finishedRequests)
+		{
+			delete (*it);
+		}
 	}
 
 	void HttpSocketThread::_updateConnect()
 	{
 		Host localHost;
 		unsigned short localPort = 0;
-		if (!this->socket->isConnected() && !this->socket->connect(this->host, this->port, localHost, localPort, *this->timeout, *this->retryFrequency))
+		if (this->socket->isConnected())
+		{
+			return;
+		}
+		this->timer.beginConnect();
+		if (!this->socket->connect(this->host, this->port, localHost, localPort, *this->timeout, *this->retryFrequency))
 		{
 			hmutex::ScopeLock lock(&this->resultMutex);
 			this->result = State::Failed;
 			lock.release();
 			this->executing = false;
+			return;
 		}
+		this->timer.endConnect(this->socket->getResolveDuration());
 	}
 
 	void HttpSocketThread::_updateSend()
+	{
+		this->timer.beginSend();
+		bool success = this->_sendStream(this->stream);
+		this->stream->clear();
+		if (success && this->bodyStream != NULL)
+		{
+			// the body is read and sent in pieces so it never has to be in memory as a whole
+			hstream piece(HTTP_SOCKET_THREAD_BODY_PIECE_SIZE + 16);
+			int64_t remaining = (this->bodyChunked ? -1LL : this->bodyStream->size() - this->bodyStream->position());
+			int result = 1;
+			while (success && this->isRunning() && this->executing)
+			{
+				result = HttpSocketThread::_makeBodyPiece(this->bodyStream, this->bodyChunked, remaining, piece);
+				if (result <= 0)
+				{
+					success = (result == 0);
+					break;
+				}
+				success = this->_sendStream(&piece);
+			}
+		}
+		this->bodyStream = NULL;
+		this->timer.endSend();
+		if (!success)
+		{
+			hmutex::ScopeLock lock(&this->resultMutex);
+			this->result = State::Failed;
+			lock.release();
+			this->executing = false;
+			this->socket->disconnect();
+		}
+	}
+
+	bool HttpSocketThread::_sendStream(hstream* stream)
 	{
 		int sentCount = 0;
-		int count = (int)this->stream->size();
+		int count = (int)(stream->size() - stream->position());
 		while (this->isRunning() && this->executing)
 		{
-			if (!this->socket->send(this->stream, count, sentCount))
+			if (!this->socket->send(stream, count, sentCount))
 			{
-				hmutex::ScopeLock lock(&this->resultMutex);
-				this->result = State::Failed;
-				lock.release();
-				this->executing = false;
-				this->socket->disconnect();
-				break;
+				return false;
 			}
-			if (this->stream->eof())
+			if (stream->eof())
 			{
-				break;
+				return true;
 			}
 			hthread::sleep(*this->retryFrequency * 1000.0f);
 		}
-		this->stream->clear();
+		return false;
+	}
+
+	int HttpSocketThread::_makeBodyPiece(hsbase* bodyStream, bool chunked, int64_t& remaining, hstream& piece)
+	{
+		// the piece keeps its buffer so it isn't reallocated for every piece
+		piece.clear(piece.getCapacity());
+		if (remaining == 0)
+		{
+			return 0;
+		}
+		unsigned char data[HTTP_SOCKET_THREAD_BODY_PIECE_SIZE];
+		int count = HTTP_SOCKET_THREAD_BODY_PIECE_SIZE;
+		if (remaining > 0)
+		{
+			count = (int)hmin((int64_t)count, remaining);
+		}
+		count = bodyStream->readRaw(data, count);
+		hstr framing;
+		if (count > 0)
+		{
+			if (chunked)
+			{
+				framing = hsprintf("%x" HTTP_DELIMITER, count);
+				piece.writeRaw((void*)framing.cStr(), framing.size());
+			}
+			piece.writeRaw(data, count);
+			if (chunked)
+			{
+				piece.writeRaw((void*)HTTP_DELIMITER, 2);
+			}
+			else
+			{
+				remaining -= count;
+			}
+		}
+		else
+		{
+			if (!chunked)
+			{
+				// the server would wait forever for the rest of the declared body
+				hlog::error(logTag, hsprintf("Request body stream ended %lld bytes before the declared Content-Length!", (long long)remaining));
+				return -1;
+			}
+			remaining = 0;
+			framing = "0" HTTP_DELIMITER HTTP_DELIMITER; // last chunk without any trailers
+			piece.writeRaw((void*)framing.cStr(), framing.size());
+		}
+		piece.rewind();
+		return 1;
 	}
 
 	void HttpSocketThread::_updateReceive()
@@ -90,10 +215,11 @@ namespace sakit
 			{
 				if (stream.size() > 0)
 				{
+					this->timer.receive();
 					stream.rewind();
 					lock.acquire(&this->responseMutex);
-					this->response->raw.seek(0, hseek::End);
 					position = this->response->raw.position();
+					this->response->raw.seek(0, hseek::End);
 					this->response->raw.writeRaw(stream);
 					this->response->raw.seek(position, hseek::Start);
 					this->response->parseFromRaw();
@@ -101,10 +227,14 @@ namespace sakit
 				}
 				break;
 			}
+			if (stream.size() > 0)
+			{
+				this->timer.receive();
+			}
 			stream.rewind();
 			lock.acquire(&this->responseMutex);
-			this->response->raw.seek(0, hseek::End);
 			position = this->response->raw.position();
+			this->response->raw.seek(0, hseek::End);
 			this->response->raw.writeRaw(stream);
 			this->response->raw.seek(position, hseek::Start);
 			this->response->parseFromRaw();
@@ -132,21 +262,25 @@ namespace sakit
 		}
 		lock.acquire(&this->responseMutex);
 		// if timed out, has no predefined length, all headers were received and there is a body
-		if (time >= *this->timeout && !this->response->headers.hasKey(SAKIT_HTTP_REQUEST_HEADER_CONTENT_LENGTH) && this->response->headersComplete && this->response->body.size() > 0)
+		if (time >= *this->timeout && this->response->contentLength < 0 && this->response->headersComplete && this->response->body.size() > 0)
 		{
-			if (!this->response->headers.hasKey(SAKIT_HTTP_REQUEST_HEADER_CONTENT_LENGTH) && this->response->body.size() > 0)
+			if (this->response->contentLength < 0 && this->response->body.size() > 0)
 			{
 				// let's say it's complete, we don't know its supposed length anyway
 				hlog::warn(logTag, "HttpSocket did not return header '" SAKIT_HTTP_REQUEST_HEADER_CONTENT_LENGTH "'! Body might be incomplete, but will be considered complete.");
 				this->response->bodyComplete = true;
 			}
-			else if ((int)this->response->headers[SAKIT_HTTP_REQUEST_HEADER_CONTENT_LENGTH] == 0) // empty body
+			else if (this->response->contentLength == 0) // empty body
 			{
 				this->response->bodyComplete = true;
 			}
 		}
-		bool completeHeaders = (this->response->headersComplete && this->response->bodyComplete);
-		if (!completeHeaders)
+		bool completeHeaders = (this->response->headersComplete && this->response->bodyComplete && !this->response->bodyFailed);
+		if (completeHeaders)
+		{
+			this->timer.finish(this->response->timing);
+		}
+		else
 		{
 			this->response->clear();
 		}
@@ -166,6 +300,19 @@ namespace sakit
 
 	void HttpSocketThread::_updateProcess()
 	{
+		if (this->pipelining)
+		{
+			if (this->multiplexing)
+			{
+				this->_updateMultiplexed();
+			}
+			else
+			{
+				this->_updatePipelined();
+			}
+			return;
+		}
+		this->timer.reset();
 		this->_updateConnect();
 		if (this->isRunning() && this->executing)
 		{
@@ -177,4 +324,425 @@ namespace sakit
 		}
 	}
 
+	void HttpSocketThread::_updatePipelined()
+	{
+		hmutex::ScopeLock lock;
+		harray<Request*> unsent;
+		Request* request = NULL;
+		hstream leftover;
+		State result = State::Idle;
+		Host localHost;
+		unsigned short localPort = 0;
+		while (true)
+		{
+			lock.acquire(&this->responseMutex);
+			if (!this->isRunning() || !this->executing)
+			{
+				// aborted, every request that is still queued fails
+				while (this->queuedRequests.size() > 0)
+				{
+					this->_finishPipelined(this->queuedRequests.first(), State::Failed);
+				}
+			}
+			if (this->queuedRequests.size() == 0)
+			{
+				this->pipelineActive = false;
+				break;
+			}
+			unsent.clear();
+			foreach (Request*, it, this->queuedRequests)
+			{
+				if (!(*it)->sent)
+				{
+					unsent += (*it);
+				}
+			}
+			request = this->queuedRequests.first();
+			lock.release();
+			if (!this->socket->isConnected())
+			{
+				leftover.clear();
+				foreach (Request*, it, unsent)
+				{
+					(*it)->timer.beginConnect();
+				}
+				if (!this->socket->connect(this->host, this->port, localHost, localPort, *this->timeout, *this->retryFrequency))
+				{
+					// nothing can be executed without a connection
+					lock.acquire(&this->responseMutex);
+					while (this->queuedRequests.size() > 0)
+					{
+						this->_finishPipelined(this->queuedRequests.first(), State::Failed);
+					}
+					lock.release();
+					continue;
+				}
+				// the requests sent on a new connection all waited for it
+				foreach (Request*, it, unsent)
+				{
+					(*it)->timer.endConnect(this->socket->getResolveDuration());
+				}
+			}
+			// all requests are sent back-to-back before waiting for the first response
+			foreach (Request*, it, unsent)
+			{
+				if (!this->_sendPipelined(*it))
+				{
+					break;
+				}
+			}
+			if (!this->socket->isConnected())
+			{
+				lock.acquire(&this->responseMutex);
+				this->_resetPipelined();
+				lock.release();
+				continue;
+			}
+			result = this->_receivePipelined(request, leftover);
+			lock.acquire(&this->responseMutex);
+			this->_finishPipelined(request, result);
+			if (result != State::Finished || !this->socket->isConnected() || request->response->connectionClose)
+			{
+				// responses can't be matched to requests anymore on this connection
+				leftover.clear();
+				this->socket->disconnect();
+				this->_resetPipelined();
+			}
+			lock.release();
+		}
+		lock.release();
+		lock.acquire(&this->resultMutex);
+		this->result = State::Finished;
+	}
+
+	bool HttpSocketThread::_sendPipelined(Request* request)
+	{
+		int sentCount = 0;
+		int count = (int)request->stream->size();
+		request->stream->rewind();
+		request->sent = true;
+		request->timer.beginSend();
+		while (this->isRunning() && this->executing)
+		{
+			if (!this->socket->send(request->stream, count, sentCount))
+			{
+				this->socket->disconnect();
+				return false;
+			}
+			if (request->stream->eof())
+			{
+				request->timer.endSend();
+				return true;
+			}
+			hthread::sleep(*this->retryFrequency * 1000.0f);
+		}
+		return false;
+	}
+
+	State HttpSocketThread::_receivePipelined(Request* request, hstream& leftover)
+	{
+		hmutex::ScopeLock lock;
+		HttpResponse* response = request->response;
+		int maxCount = 0;
+		hstream stream(maxCount);
+		float time = 0.0f;
+		int64_t position = 0LL;
+		bool complete = false;
+		bool hasMoreData = true;
+		lock.acquire(&this->responseMutex);
+		response->clear();
+		response->bodyExpected = (request->method != REQUEST_HEAD);
+		response->decodeContent = request->decodeContent;
+		// data of this response might have already been received together with the previous one
+		if (leftover.size() > 0)
+		{
+			request->timer.receive();
+			leftover.rewind();
+			response->raw.writeRaw(leftover);
+			response->raw.rewind();
+			response->parseFromRaw();
+		}
+		leftover.clear();
+		complete = (response->headersComplete && response->bodyComplete);
+		lock.release();
+		// the stall timeout is measured separately for each response
+		while (!complete && this->isRunning() && this->executing)
+		{
+			maxCount = HTTP_SOCKET_THREAD_BUFFER_SIZE;
+			hasMoreData = this->socket->receive(&stream, maxCount);
+			if (stream.size() > 0)
+			{
+				request->timer.receive();
+				stream.rewind();
+				lock.acquire(&this->responseMutex);
+				position = response->raw.position();
+				response->raw.seek(0, hseek::End);
+				response->raw.writeRaw(stream);
+				response->raw.seek(position, hseek::Start);
+				response->parseFromRaw();
+				complete = (response->headersComplete && response->bodyComplete);
+				lock.release();
+				stream.clear(maxCount);
+				// retry attempts are reset after a successful read
+				time = 0.0f;
+				continue;
+			}
+			if (!hasMoreData)
+			{
+				break;
+			}
+			time += *this->retryFrequency;
+			if (time >= *this->timeout)
+			{
+				break;
+			}
+			hthread::sleep(*this->retryFrequency * 1000.0f);
+		}
+		lock.acquire(&this->responseMutex);
+		if (!complete && time >= *this->timeout && response->headersComplete && response->contentLength < 0 && !response->chunked && response->body.size() > 0)
+		{
+			// let's say it's complete, we don't know its supposed length anyway
+			hlog::warn(logTag, "HttpSocket did not return header '" SAKIT_HTTP_RESPONSE_HEADER_CONTENT_LENGTH "'! Body might be incomplete, but will be considered complete.");
+			// the end of such a body can't be determined on a persistent connection
+			response->headers.set(SAKIT_HTTP_RESPONSE_HEADER_CONNECTION, "close");
+			response->connectionClose = true;
+			response->bodyComplete = true;
+			complete = true;
+		}
+		if (!complete || response->bodyFailed)
+		{
+			return State::Failed;
+		}
+		// anything after this response belongs to the next one
+		position = response->raw.position();
+		if (position < response->raw.size())
+		{
+			leftover.writeRaw(response->raw);
+			hstream raw;
+			response->raw.rewind();
+			raw.writeRaw(response->raw, (int)position);
+			response->raw = raw;
+		}
+		request->timer.finish(response->timing);
+		return State::Finished;
+	}
+
+	void HttpSocketThread::_finishPipelined(Request* request, State result)
+	{
+		request->result = result;
+		this->queuedRequests -= request;
+		this->finishedRequests += request;
+	}
+
+	void HttpSocketThread::_resetPipelined()
+	{
+		// requests that were sent, but not answered, have to be sent again on a new connection
+		harray<Request*> requests = this->queuedRequests;
+		foreach (Request*, it, requests)
+		{
+			if ((*it)->sent)
+			{
+				// the server could have processed it already so anything with side effects can't be sent again
+				if (!HttpSocketThread::_isRetryable((*it)->method))
+				{
+					hlog::warn(logTag, "Connection was lost after sending a " + (*it)->method + " request, it is not sent again: " + (*it)->url.toString());
+					this->_finishPipelined((*it), State::Failed);
+					continue;
+				}
+				(*it)->sent = false;
+				++(*it)->attempts;
+				if ((*it)->attempts >= HTTP_SOCKET_THREAD_PIPELINE_ATTEMPTS)
+				{
+					this->_finishPipelined((*it), State::Failed);
+				}
+			}
+		}
+	}
+
+	void HttpSocketThread::_resetMultiplexed()
+	{
+		// streams that were refused or above the last stream ID of a GOAWAY have already been reported as refused by the session,
+		// the server could have processed any stream that is still open
+		this->session->reset();
+		this->_resetPipelined();
+	}
+
+	bool HttpSocketThread::_isRetryable(chstr method)
+	{
+		return (method == REQUEST_GET || method == REQUEST_HEAD || method == REQUEST_OPTIONS || method == REQUEST_TRACE);
+	}
+
+	void HttpSocketThread::_updateMultiplexed()
+	{
+		hmutex::ScopeLock lock;
+		harray<Request*> unsent;
+		harray<Request*> opened;
+		harray<Request*> finished;
+		harray<Request*> failed;
+		harray<Request*> refused;
+		hstream output;
+		int maxCount = 0;
+		hstream stream(maxCount);
+		bool hasMoreData = true;
+		bool success = true;
+		float time = 0.0f;
+		Host localHost;
+		unsigned short localPort = 0;
+		while (true)
+		{
+			lock.acquire(&this->responseMutex);
+			if (!this->isRunning() || !this->executing)
+			{
+				// aborted, every request that is still queued fails
+				while (this->queuedRequests.size() > 0)
+				{
+					this->_finishPipelined(this->queuedRequests.first(), State::Failed);
+				}
+				this->session->reset();
+			}
+			if (this->queuedRequests.size() == 0)
+			{
+				this->pipelineActive = false;
+				break;
+			}
+			unsent.clear();
+			foreach (Request*, it, this->queuedRequests)
+			{
+				if (!(*it)->sent)
+				{
+					unsent += (*it);
+				}
+			}
+			lock.release();
+			if (!this->socket->isConnected())
+			{
+				foreach (Request*, it, unsent)
+				{
+					(*it)->timer.beginConnect();
+				}
+				if (!this->socket->connect(this->host, this->port, localHost, localPort, *this->timeout, *this->retryFrequency))
+				{
+					// nothing can be executed without a connection
+					lock.acquire(&this->responseMutex);
+					while (this->queuedRequests.size() > 0)
+					{
+						this->_finishPipelined(this->queuedRequests.first(), State::Failed);
+					}
+					lock.release();
+					continue;
+				}
+				foreach (Request*, it, unsent)
+				{
+					(*it)->timer.endConnect(this->socket->getResolveDuration());
+				}
+				// prior knowledge is assumed, the connection starts with HTTP/2 right away
+				this->session->reset();
+				output.clear();
+				this->session->start(output);
+				time = 0.0f;
+			}
+			// new requests are opened as streams while the server allows more of them
+			opened.clear();
+			foreach (Request*, it, unsent)
+			{
+				if (!this->session->canOpenStream())
+				{
+					break;
+				}
+				(*it)->sent = true;
+				(*it)->timer.beginSend();
+				this->session->openStream((*it), output);
+				opened += (*it);
+			}
+			this->session->sendData(output);
+			success = this->_sendMultiplexed(output);
+			foreach (Request*, it, opened)
+			{
+				(*it)->timer.endSend();
+			}
+			if (success)
+			{
+				maxCount = HTTP_SOCKET_THREAD_BUFFER_SIZE;
+				hasMoreData = this->socket->receive(&stream, maxCount);
+				if (stream.size() > 0)
+				{
+					finished.clear();
+					failed.clear();
+					refused.clear();
+					lock.acquire(&this->responseMutex);
+					success = this->session->receive(&stream[0], (int)stream.size(), output, finished, failed, refused);
+					foreach (Request*, it, finished)
+					{
+						(*it)->timer.finish((*it)->response->timing);
+						this->_finishPipelined((*it), State::Finished);
+					}
+					foreach (Request*, it, failed)
+					{
+						this->_finishPipelined((*it), State::Failed);
+					}
+					// refused requests weren't processed at all and are opened again
+					foreach (Request*, it, refused)
+					{
+						(*it)->sent = false;
+						++(*it)->attempts;
+						if ((*it)->attempts >= HTTP_SOCKET_THREAD_PIPELINE_ATTEMPTS)
+						{
+							this->_finishPipelined((*it), State::Failed);
+						}
+					}
+					lock.release();
+					stream.clear(maxCount);
+					// retry attempts are reset after a successful read
+					time = 0.0f;
+					if (success)
+					{
+						continue;
+					}
+				}
+				else if (!hasMoreData)
+				{
+					success = false;
+				}
+			}
+			if (success && this->session->getStreamCount() > 0)
+			{
+				time += *this->retryFrequency;
+				// the streams stalled, the connection is considered broken
+				success = (time < *this->timeout);
+			}
+			if (success && this->session->isClosing() && this->session->getStreamCount() == 0)
+			{
+				// remaining requests continue on a new connection
+				this->socket->disconnect();
+				continue;
+			}
+			if (!success)
+			{
+				// the streams can't be matched to requests anymore on a new connection
+				output.clear();
+				this->socket->disconnect();
+				lock.acquire(&this->responseMutex);
+				this->_resetMultiplexed();
+				lock.release();
+				continue;
+			}
+			hthread::sleep(*this->retryFrequency * 1000.0f);
+		}
+		lock.release();
+		lock.acquire(&this->resultMutex);
+		this->result = State::Finished;
+	}
+
+	bool HttpSocketThread::_sendMultiplexed(hstream& output)
+	{
+		if (output.size() == 0)
+		{
+			return true;
+		}
+		output.rewind();
+		bool result = this->_sendStream(&output);
+		output.clear();
+		return result;
+	}
+
 }
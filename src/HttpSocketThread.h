@@ -13,16 +13,24 @@
 #ifndef SAKIT_HTTP_SOCKET_THREAD_H
 #define SAKIT_HTTP_SOCKET_THREAD_H
 
+#include <hltypes/harray.h>
 #include <hltypes/hltypesUtil.h>
 #include <hltypes/hstream.h>
+#include <hltypes/hstring.h>
 
+#include "Hpack.h"
+#include "HttpPhaseTimer.h"
 #include "Socket.h"
 #include "TimedThread.h"
+#include "Url.h"
 
 #define HTTP_SOCKET_THREAD_BUFFER_SIZE 4096
+#define HTTP_SOCKET_THREAD_BODY_PIECE_SIZE 16384
+#define HTTP_SOCKET_THREAD_PIPELINE_ATTEMPTS 2
 
 namespace sakit
 {
+	class Http2Session;
 	class PlatformSocket;
 	class HttpResponse;
 	class HttpSocket;
@@ -32,18 +40,76 @@ namespace sakit
 	public:
 		friend class HttpSocket;
 
+		/// @brief A request that has been queued on a pipelined or multiplexed connection.
+		class Request
+		{
+		public:
+			hstr method;
+			Url url;
+			hstream* stream;
+			/// @note Used instead of stream when multiplexing, including the pseudo-headers.
+			harray<HpackField> headerFields;
+			/// @note Used instead of stream when multiplexing.
+			hstr body;
+			HttpResponse* response;
+			State result;
+			bool sent;
+			int attempts;
+			bool decodeContent;
+			/// @note Started when the request is queued.
+			HttpPhaseTimer timer;
+
+			Request(chstr method, Url url);
+			~Request();
+
+		};
+
 		HttpSocketThread(PlatformSocket* socket, float* timeout, float* retryFrequency);
 		~HttpSocketThread();
 
 	protected:
 		hstream* stream;
+		/// @note Streamed request body that is sent after the request headers in stream. Not owned by the thread.
+		hsbase* bodyStream;
+		bool bodyChunked;
 		HttpResponse* response;
+		HttpPhaseTimer timer;
 		hmutex responseMutex;
+		bool pipelining;
+		/// @note Queued requests are sent as concurrent HTTP/2 streams instead of being pipelined.
+		bool multiplexing;
+		Http2Session* session;
+		/// @note Protected by responseMutex, the same as both request queues.
+		bool pipelineActive;
+		harray<Request*> queuedRequests;
+		harray<Request*> finishedRequests;
 
 		void _updateConnect();
 		void _updateSend();
 		void _updateReceive();
 		void _updateProcess();
+		bool _sendStream(hstream* stream);
+
+		void _updatePipelined();
+		bool _sendPipelined(Request* request);
+		State _receivePipelined(Request* request, hstream& leftover);
+		void _finishPipelined(Request* request, State result);
+		/// @brief Prepares unanswered requests to be sent again on a new connection.
+		/// @note Requests that could have side effects on the server fail instead.
+		void _resetPipelined();
+
+		void _updateMultiplexed();
+		bool _sendMultiplexed(hstream& output);
+		/// @brief Forgets all streams after a connection error so their requests can continue on a new connection.
+		/// @note Only requests the server can't have processed yet or that have no side effects are sent again, the others fail.
+		void _resetMultiplexed();
+
+		/// @return True if the method has no side effects so a request can be sent again after it might have been processed already.
+		static bool _isRetryable(chstr method);
+		/// @brief Reads the next piece of a streamed request body into piece.
+		/// @param remaining What is left of the declared Content-Length or -1 for a chunked body that hasn't been terminated yet.
+		/// @return 1 if a piece was read, 0 if there is nothing left to send or -1 if the stream ended before the declared Content-Length.
+		static int _makeBodyPiece(hsbase* bodyStream, bool chunked, int64_t& remaining, hstream& piece);
 
 	};
 
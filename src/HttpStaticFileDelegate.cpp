@@ -0,0 +1,452 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include <hltypes/harray.h>
+#include <hltypes/hdir.h>
+#include <hltypes/hexception.h>
+#include <hltypes/hfile.h>
+#include <hltypes/hlog.h>
+#include <hltypes/hstring.h>
+
+#include "HttpCache.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "HttpServerRequest.h"
+#include "HttpServerResponse.h"
+#include "HttpSocket.h"
+#include "HttpStaticFileDelegate.h"
+#include "sakit.h"
+
+namespace sakit
+{
+	static const char* _dayNames[] = {"Thu", "Fri", "Sat", "Sun", "Mon", "Tue", "Wed"}; // 1970-01-01 was a Thursday
+	static const char* _monthNames[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+	struct _ContentType
+	{
+		const char* extension;
+		const char* type;
+	};
+
+	static const _ContentType _contentTypes[] =
+	{
+		{"7z",		"application/x-7z-compressed"},
+		{"apk",		"application/vnd.android.package-archive"},
+		{"bin",		"application/octet-stream"},
+		{"css",		"text/css"},
+		{"gif",		"image/gif"},
+		{"gz",		"application/gzip"},
+		{"htm",		"text/html"},
+		{"html",	"text/html"},
+		{"ico",		"image/x-icon"},
+		{"jpeg",	"image/jpeg"},
+		{"jpg",		"image/jpeg"},
+		{"js",		"application/javascript"},
+		{"json",	"application/json"},
+		{"mp3",		"audio/mpeg"},
+		{"mp4",		"video/mp4"},
+		{"ogg",		"audio/ogg"},
+		{"pdf",		"application/pdf"},
+		{"png",		"image/png"},
+		{"svg",		"image/svg+xml"},
+		{"tar",		"application/x-tar"},
+		{"txt",		"text/plain"},
+		{"wasm",	"application/wasm"},
+		{"webp",	"image/webp"},
+		{"woff",	"font/woff"},
+		{"woff2",	"font/woff2"},
+		{"xml",		"application/xml"},
+		{"zip",		"application/zip"},
+		{NULL,		NULL}
+	};
+
+	static hstr _decodePath(chstr path)
+	{
+		hstr result;
+		int size = path.size();
+		for_iter (i, 0, size)
+		{
+			if (path[i] == '%' && i + 2 < size && path(i + 1, 2).isHex())
+			{
+				result += (char)path(i + 1, 2).unhex();
+				i += 2;
+			}
+			else
+			{
+				result += path[i];
+			}
+		}
+		return result;
+	}
+
+	int64_t HttpStaticFileDelegate::DefaultMaxCacheSize = 16777216LL;
+	int64_t HttpStaticFileDelegate::DefaultMaxCachedFileSize = 262144LL;
+
+	HttpStaticFileDelegate::CachedFile::CachedFile(chstr filename, int64_t size, int64_t modificationTime) :
+		data(NULL)
+	{
+		this->filename = filename;
+		this->size = size;
+		this->modificationTime = modificationTime;
+	}
+
+	HttpStaticFileDelegate::CachedFile::~CachedFile()
+	{
+		if (this->data != NULL)
+		{
+			delete[] this->data;
+		}
+	}
+
+	bool HttpStaticFileDelegate::CachedFile::load()
+	{
+		hfile file;
+		try
+		{
+			file.open(this->filename);
+		}
+		catch (hexception&)
+		{
+			return false;
+		}
+		this->data = new char[(unsigned int)this->size];
+		if (file.readRaw(this->data, (int)this->size) < (int)this->size)
+		{
+			delete[] this->data;
+			this->data = NULL;
+			return false;
+		}
+		return true;
+	}
+
+	HttpStaticFileDelegate::HttpStaticFileDelegate(chstr rootPath, chstr urlPrefix) :
+		HttpServerDelegate(),
+		indexFilename("index.html"),
+		cacheSize(0LL)
+	{
+		this->rootPath = rootPath;
+		this->urlPrefix = urlPrefix;
+		this->maxCacheSize = HttpStaticFileDelegate::DefaultMaxCacheSize;
+		this->maxCachedFileSize = HttpStaticFileDelegate::DefaultMaxCachedFileSize;
+	}
+
+	HttpStaticFileDelegate::~HttpStaticFileDelegate()
+	{
+		this->clearCache();
+	}
+
+	void HttpStaticFileDelegate::setMaxCacheSize(int64_t value)
+	{
+		this->maxCacheSize = value;
+		this->_evict();
+	}
+
+	int HttpStaticFileDelegate::getCachedFileCount()
+	{
+		return this->cachedFiles.size();
+	}
+
+	void HttpStaticFileDelegate::clearCache()
+	{
+		foreach (CachedFile*, it, this->cachedFiles)
+		{
+			delete (*it);
+		}
+		this->cachedFiles.clear();
+		this->cacheSize = 0LL;
+	}
+
+	void HttpStaticFileDelegate::onRequest(HttpServer* server, HttpServerRequest* request, HttpServerResponse* response)
+	{
+		if (request->method != SAKIT_HTTP_REQUEST_METHOD_GET && request->method != SAKIT_HTTP_REQUEST_METHOD_HEAD)
+		{
+			response->statusCode = HttpResponse::Code::MethodNotAllowed;
+			response->headers.set(SAKIT_HTTP_RESPONSE_HEADER_ALLOW, SAKIT_HTTP_REQUEST_METHOD_GET ", " SAKIT_HTTP_REQUEST_METHOD_HEAD);
+			return;
+		}
+		hstr filename = this->_resolveFilename(request->path);
+		int64_t size = 0LL;
+		int64_t modificationTime = 0LL;
+		bool directory = false;
+		if (filename == "" || !HttpStaticFileDelegate::_getFileInfo(filename, size, modificationTime, directory))
+		{
+			response->statusCode = HttpResponse::Code::NotFound;
+			return;
+		}
+		if (directory)
+		{
+			if (this->indexFilename == "")
+			{
+				response->statusCode = HttpResponse::Code::NotFound;
+				return;
+			}
+			filename = hdir::joinPath(filename, this->indexFilename);
+			if (!HttpStaticFileDelegate::_getFileInfo(filename, size, modificationTime, directory) || directory)
+			{
+				response->statusCode = HttpResponse::Code::NotFound;
+				return;
+			}
+		}
+		hstr lastModified = HttpStaticFileDelegate::_makeHttpDate(modificationTime);
+		response->headers.set(SAKIT_HTTP_RESPONSE_HEADER_LAST_MODIFIED, lastModified);
+		response->headers.set(SAKIT_HTTP_RESPONSE_HEADER_ACCEPT_RANGES, "bytes");
+		response->headers.set(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_TYPE, HttpStaticFileDelegate::_findContentType(filename));
+		hstr ifModifiedSince = request->headers.tryGet(SAKIT_HTTP_REQUEST_HEADER_IF_MODIFIED_SINCE, "");
+		if (ifModifiedSince != "")
+		{
+			int64_t time = HttpCache::_parseHttpDate(ifModifiedSince);
+			if (time >= 0 && modificationTime <= time)
+			{
+				response->statusCode = HttpResponse::Code::NotModified;
+				return;
+			}
+		}
+		int64_t start = 0LL;
+		int64_t end = size - 1;
+		hstr range = request->headers.tryGet(SAKIT_HTTP_REQUEST_HEADER_RANGE, "");
+		hstr ifRange = request->headers.tryGet(SAKIT_HTTP_REQUEST_HEADER_IF_RANGE, "");
+		// a range of an older version of the file would be useless to the client
+		if (range != "" && (ifRange == "" || ifRange == lastModified))
+		{
+			int result = HttpStaticFileDelegate::_parseRange(range, size, start, end);
+			if (result < 0)
+			{
+				response->statusCode = HttpResponse::Code::RequestedRangeNotSatisfiable;
+				response->headers.set(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_RANGE, hsprintf("bytes */%lld", (long long)size));
+				return;
+			}
+			if (result > 0)
+			{
+				response->statusCode = HttpResponse::Code::PartialContent;
+				response->headers.set(SAKIT_HTTP_RESPONSE_HEADER_CONTENT_RANGE, hsprintf("bytes %lld-%lld/%lld", (long long)start, (long long)end, (long long)size));
+			}
+		}
+		CachedFile* cachedFile = this->_getCachedFile(filename, size, modificationTime);
+		if (cachedFile != NULL)
+		{
+			response->setBodyData(cachedFile->data + start, (int)(end - start + 1));
+		}
+		else
+		{
+			response->setBodyFile(filename, start, end - start + 1);
+		}
+	}
+
+	hstr HttpStaticFileDelegate::_resolveFilename(chstr path)
+	{
+		hstr relativePath = path;
+		if (this->urlPrefix != "")
+		{
+			if (!relativePath.startsWith(this->urlPrefix))
+			{
+				return "";
+			}
+			// the prefix has to end at a segment boundary
+			if (!this->urlPrefix.endsWith("/") && relativePath.size() > this->urlPrefix.size() && relativePath[this->urlPrefix.size()] != '/')
+			{
+				return "";
+			}
+			relativePath = relativePath(this->urlPrefix.size(), -1);
+		}
+		harray<hstr> segments = _decodePath(relativePath).split('/', -1, true);
+		harray<hstr> result;
+		foreach (hstr, it, segments)
+		{
+			// anything that could leave the root directory is rejected
+			if ((*it) == ".." || (*it).contains('\\') || (*it).contains(':') || (*it).contains('\0'))
+			{
+				return "";
+			}
+			if ((*it) != ".")
+			{
+				result += (*it);
+			}
+		}
+		if (result.size() == 0)
+		{
+			return this->rootPath;
+		}
+		return hdir::joinPath(this->rootPath, result.joined('/'));
+	}
+
+	HttpStaticFileDelegate::CachedFile* HttpStaticFileDelegate::_getCachedFile(chstr filename, int64_t size, int64_t modificationTime)
+	{
+		CachedFile* cachedFile = NULL;
+		foreach (CachedFile*, it, this->cachedFiles)
+		{
+			if ((*it)->filename == filename)
+			{
+				cachedFile = (*it);
+				break;
+			}
+		}
+		if (cachedFile != NULL)
+		{
+			this->cachedFiles -= cachedFile;
+			if (cachedFile->size == size && cachedFile->modificationTime == modificationTime)
+			{
+				this->cachedFiles += cachedFile;
+				return cachedFile;
+			}
+			this->cacheSize -= cachedFile->size;
+			delete cachedFile;
+		}
+		if (size == 0 || size > this->maxCachedFileSize || size > this->maxCacheSize)
+		{
+			return NULL;
+		}
+		cachedFile = new CachedFile(filename, size, modificationTime);
+		if (!cachedFile->load())
+		{
+			delete cachedFile;
+			return NULL;
+		}
+		this->cachedFiles += cachedFile;
+		this->cacheSize += size;
+		this->_evict();
+		return cachedFile;
+	}
+
+	void HttpStaticFileDelegate::_evict()
+	{
+		CachedFile* cachedFile = NULL;
+		while (this->cacheSize > this->maxCacheSize && this->cachedFiles.size() > 0)
+		{
+			cachedFile = this->cachedFiles.removeFirst();
+			this->cacheSize -= cachedFile->size;
+			delete cachedFile;
+		}
+	}
+
+	bool HttpStaticFileDelegate::_getFileInfo(chstr filename, int64_t& size, int64_t& modificationTime, bool& directory)
+	{
+#ifndef _WIN32
+		struct stat info;
+		if (stat(filename.cStr(), &info) != 0)
+		{
+			return false;
+		}
+		directory = S_ISDIR(info.st_mode);
+		if (!directory && !S_ISREG(info.st_mode))
+		{
+			return false;
+		}
+#else
+		struct _stat64 info;
+		if (_wstat64(filename.wStr().c_str(), &info) != 0)
+		{
+			return false;
+		}
+		directory = ((info.st_mode & _S_IFDIR) != 0);
+		if (!directory && (info.st_mode & _S_IFREG) == 0)
+		{
+			return false;
+		}
+#endif
+		size = (int64_t)info.st_size;
+		modificationTime = (int64_t)info.st_mtime;
+		return true;
+	}
+
+	int HttpStaticFileDelegate::_parseRange(chstr value, int64_t size, int64_t& start, int64_t& end)
+	{
+		hstr range = value.trimmed();
+		// other units and multiple ranges aren't supported so the whole file is sent instead
+		if (!range.startsWith("bytes=") || range.contains(','))
+		{
+			return 0;
+		}
+		range = range(6, -1).trimmed();
+		int dash = range.indexOf('-');
+		if (dash < 0)
+		{
+			return 0;
+		}
+		hstr first = range(0, dash).trimmed();
+		hstr last = range(dash + 1, -1).trimmed();
+		if ((first != "" && (!first.isInt() || first.startsWith("-") || first.startsWith("+"))) ||
+			(last != "" && (!last.isInt() || last.startsWith("-") || last.startsWith("+"))))
+		{
+			return 0;
+		}
+		if (first == "")
+		{
+			// the last N bytes
+			if (last == "")
+			{
+				return 0;
+			}
+			int64_t suffix = (int64_t)last;
+			if (suffix == 0 || size == 0)
+			{
+				return -1;
+			}
+			start = hmax(size - suffix, (int64_t)0);
+			end = size - 1;
+			return 1;
+		}
+		start = (int64_t)first;
+		end = (last != "" ? hmin((int64_t)last, size - 1) : size - 1);
+		if (last != "" && (int64_t)last < start)
+		{
+			return 0;
+		}
+		if (start >= size)
+		{
+			return -1;
+		}
+		return 1;
+	}
+
+	hstr HttpStaticFileDelegate::_makeHttpDate(int64_t time)
+	{
+		int64_t days = time / 86400;
+		int64_t seconds = time % 86400;
+		if (seconds < 0)
+		{
+			seconds += 86400;
+			--days;
+		}
+		int dayOfWeek = (int)(((days % 7) + 7) % 7);
+		// civil date from days since the epoch in the proleptic Gregorian calendar
+		int64_t z = days + 719468;
+		int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+		int64_t dayOfEra = z - era * 146097;
+		int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+		int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+		int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+		int day = (int)(dayOfYear - (153 * monthIndex + 2) / 5 + 1);
+		int month = (int)(monthIndex < 10 ? monthIndex + 3 : monthIndex - 9);
+		int year = (int)(yearOfEra + era * 400 + (month <= 2 ? 1 : 0));
+		return hsprintf("%s, %02d %s %04d %02d:%02d:%02d GMT", _dayNames[dayOfWeek], day, _monthNames[month - 1], year,
+			(int)(seconds / 3600), (int)(seconds / 60 % 60), (int)(seconds % 60));
+	}
+
+	hstr HttpStaticFileDelegate::_findContentType(chstr filename)
+	{
+		hstr name = hdir::baseName(filename);
+		int dot = name.rindexOf('.');
+		if (dot < 0)
+		{
+			return "application/octet-stream";
+		}
+		hstr extension = name(dot + 1, -1).lowered();
+		for (const _ContentType* it = _contentTypes; it->extension != NULL; ++it)
+		{
+			if (extension == it->extension)
+			{
+				return it->type;
+			}
+		}
+		return "application/octet-stream";
+	}
+
+}
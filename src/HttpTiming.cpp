@@ -0,0 +1,132 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <hltypes/harray.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hstring.h>
+
+#include "HttpSocket.h"
+#include "HttpTiming.h"
+#include "Url.h"
+
+namespace sakit
+{
+	const float HttpTimingHistogram::BucketBounds[SAKIT_HTTP_TIMING_BUCKET_COUNT - 1] =
+	{
+		0.001f, 0.002f, 0.005f, 0.01f, 0.02f, 0.05f, 0.1f, 0.2f, 0.5f, 1.0f, 2.0f, 5.0f, 10.0f
+	};
+
+	HttpTimingHistogram::HttpTimingHistogram() :
+		count(0),
+		dns(0, SAKIT_HTTP_TIMING_BUCKET_COUNT),
+		connect(0, SAKIT_HTTP_TIMING_BUCKET_COUNT),
+		send(0, SAKIT_HTTP_TIMING_BUCKET_COUNT),
+		firstByte(0, SAKIT_HTTP_TIMING_BUCKET_COUNT),
+		download(0, SAKIT_HTTP_TIMING_BUCKET_COUNT),
+		total(0, SAKIT_HTTP_TIMING_BUCKET_COUNT)
+	{
+	}
+
+	void HttpTimingHistogram::add(const HttpTiming& timing)
+	{
+		++this->count;
+		HttpTimingHistogram::_add(this->dns, timing.dns);
+		HttpTimingHistogram::_add(this->connect, timing.connect);
+		HttpTimingHistogram::_add(this->send, timing.send);
+		HttpTimingHistogram::_add(this->firstByte, timing.firstByte);
+		HttpTimingHistogram::_add(this->download, timing.download);
+		HttpTimingHistogram::_add(this->total, timing.total);
+	}
+
+	void HttpTimingHistogram::_add(harray<int>& buckets, float value)
+	{
+		for_iter (i, 0, SAKIT_HTTP_TIMING_BUCKET_COUNT - 1)
+		{
+			if (value <= HttpTimingHistogram::BucketBounds[i])
+			{
+				++buckets[i];
+				return;
+			}
+		}
+		++buckets.last();
+	}
+
+	float HttpTimingHistogram::getPercentile(const harray<int>& buckets, float percentile)
+	{
+		int count = 0;
+		foreachc (int, it, buckets)
+		{
+			count += (*it);
+		}
+		if (count == 0)
+		{
+			return 0.0f;
+		}
+		int target = hmax((int)hceil(hclamp(percentile, 0.0f, 1.0f) * count), 1);
+		int sum = 0;
+		for_iter (i, 0, buckets.size())
+		{
+			sum += buckets[i];
+			if (sum >= target)
+			{
+				return HttpTimingHistogram::BucketBounds[hmin(i, SAKIT_HTTP_TIMING_BUCKET_COUNT - 2)];
+			}
+		}
+		return HttpTimingHistogram::BucketBounds[SAKIT_HTTP_TIMING_BUCKET_COUNT - 2];
+	}
+
+	hmap<hstr, HttpTimingHistogram> HttpTiming::histograms;
+	hmutex HttpTiming::histogramsMutex;
+
+	HttpTiming::HttpTiming()
+	{
+		this->clear();
+	}
+
+	void HttpTiming::clear()
+	{
+		this->dns = 0.0f;
+		this->connect = 0.0f;
+		this->send = 0.0f;
+		this->firstByte = 0.0f;
+		this->download = 0.0f;
+		this->total = 0.0f;
+		this->connectionReused = false;
+	}
+
+	hmap<hstr, HttpTimingHistogram> HttpTiming::getHistograms()
+	{
+		hmutex::ScopeLock lock(&HttpTiming::histogramsMutex);
+		return HttpTiming::histograms;
+	}
+
+	HttpTimingHistogram HttpTiming::getHistogram(chstr origin)
+	{
+		hmutex::ScopeLock lock(&HttpTiming::histogramsMutex);
+		return HttpTiming::histograms.tryGet(origin, HttpTimingHistogram());
+	}
+
+	void HttpTiming::clearHistograms()
+	{
+		hmutex::ScopeLock lock(&HttpTiming::histogramsMutex);
+		HttpTiming::histograms.clear();
+	}
+
+	void HttpTiming::_record(const Url& url, const HttpTiming& timing)
+	{
+		unsigned short port = url.getPort();
+		if (port == 0)
+		{
+			port = (url.getscheme() == SAKIT_HTTPS_SCHEME ? HttpSocket::DefaultTlsPort : HttpSocket::DefaultPort);
+		}
+		hstr origin = url.getHost() + ":" + hstr(port);
+		hmutex::ScopeLock lock(&HttpTiming::histogramsMutex);
+		HttpTiming::histograms[origin].add(timing);
+	}
+
+}
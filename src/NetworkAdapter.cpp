@@ -25,21 +25,22 @@ namespace sakit
 
 	Host NetworkAdapter::getBroadcastIp() const
 	{
-		if (!this->address.isIp())
+		if (!this->address.isIpv4())
 		{
 			return Host("255.255.255.255");
 		}
-		if (!this->mask.isIp())
+		if (!this->mask.isIpv4())
 		{
 			return Host("255.255.255.255");
 		}
-		harray<int> numerics = this->address.toString().split('.').cast<int>();
-		harray<int> maskNumerics = this->mask.toString().split('.').cast<int>();
+		const unsigned char* numerics = this->address.getBinaryAddress();
+		const unsigned char* maskNumerics = this->mask.getBinaryAddress();
+		unsigned char result[4];
 		for_iter (i, 0, 4)
 		{
-			numerics[i] = ((numerics[i] & maskNumerics[i]) | (~maskNumerics[i])) & 0xFF;
+			result[i] = (unsigned char)((numerics[i] & maskNumerics[i]) | (~maskNumerics[i] & 0xFF));
 		}
-		return Host((unsigned char)numerics[0], (unsigned char)numerics[1], (unsigned char)numerics[2], (unsigned char)numerics[3]);
+		return Host(result, 4);
 	}
 	
 }
@@ -17,8 +17,16 @@
 
 #ifndef _WIN32
 #include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <io.h>
 #endif
 
+// used when the platform can't send directly from a file
+#define SAKIT_SEND_FILE_BUFFER_SIZE 16384
+
 namespace sakit
 {
 	// making this thread-safe, you never know
@@ -30,6 +38,75 @@ namespace sakit
 		delete[] this->receiveBuffer;
 	}
 	
+	void PlatformSocket::setTlsEnabled(bool value, chstr serverName)
+	{
+		this->tlsEnabled = value;
+		this->tlsServerName = serverName;
+	}
+
+	int PlatformSocket::openFile(chstr filename)
+	{
+#ifdef _WIN32
+		return _wopen(filename.wStr().c_str(), _O_RDONLY | _O_BINARY);
+#else
+		return open(filename.cStr(), O_RDONLY);
+#endif
+	}
+
+	void PlatformSocket::closeFile(int fileDescriptor)
+	{
+		if (fileDescriptor >= 0)
+		{
+#ifdef _WIN32
+			_close(fileDescriptor);
+#else
+			close(fileDescriptor);
+#endif
+		}
+	}
+
+	bool PlatformSocket::_sendFileBuffered(int fileDescriptor, int64_t& offset, int64_t& count, int64_t& sent)
+	{
+		char buffer[SAKIT_SEND_FILE_BUFFER_SIZE];
+#ifdef _WIN32
+		if (_lseeki64(fileDescriptor, offset, SEEK_SET) < 0)
+		{
+			return false;
+		}
+		int readCount = _read(fileDescriptor, buffer, (unsigned int)hmin(count, (int64_t)SAKIT_SEND_FILE_BUFFER_SIZE));
+#else
+		if (lseek(fileDescriptor, (off_t)offset, SEEK_SET) < 0)
+		{
+			return false;
+		}
+		int readCount = (int)read(fileDescriptor, buffer, (size_t)hmin(count, (int64_t)SAKIT_SEND_FILE_BUFFER_SIZE));
+#endif
+		if (readCount <= 0)
+		{
+			hlog::warn(logTag, "File ended before all data was sent!");
+			return false;
+		}
+		int remaining = readCount;
+		int sentCount = 0;
+		int lastSentCount = 0;
+		bool success = true;
+		// the file is read again from offset the next time so a partial send doesn't lose anything
+		while (remaining > 0)
+		{
+			lastSentCount = sentCount;
+			success = this->send(buffer + sentCount, remaining, sentCount);
+			// the socket can't take any more data at the moment
+			if (!success || sentCount == lastSentCount)
+			{
+				break;
+			}
+		}
+		offset += sentCount;
+		sent += sentCount;
+		count -= sentCount;
+		return (success || sentCount > 0);
+	}
+
 	bool PlatformSocket::_printLastError(chstr basicMessage, int code)
 	{
 		hstr message;
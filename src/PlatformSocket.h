@@ -29,6 +29,9 @@
 #ifdef __APPLE__
 #include <netinet/in.h>
 #endif
+
+/// @note In milliseconds, how long connect() waits for an address before it starts a parallel attempt with the next one (as recommended by RFC 8305).
+#define SAKIT_CONNECTION_ATTEMPT_DELAY 250
 #ifdef _WINRT
 using namespace Windows::Foundation;
 using namespace Windows::Networking;
@@ -39,6 +42,7 @@ using namespace Windows::Storage::Streams;
 namespace sakit
 {
 	class Socket;
+	class TlsSession;
 
 	class PlatformSocket
 	{
@@ -49,15 +53,45 @@ namespace sakit
 		HL_DEFINE_IS(connected, Connected);
 		HL_DEFINE_ISSET(connectionLess, ConnectionLess);
 		HL_DEFINE_ISSET(serverMode, ServerMode); // actually used only in WinRT
+		/// @note In milliseconds, how long resolving the address took in the last call to setRemoteAddress(), connect() or startConnect().
+		HL_DEFINE_GET(int64_t, resolveDuration, ResolveDuration);
+		HL_DEFINE_IS(tlsEnabled, TlsEnabled);
+		/// @brief Encrypts the connection with TLS after connecting.
+		/// @param serverName Used for SNI and certificate verification. If empty, the host passed to connect() is used.
+		/// @note Requires SAKit to be built with _OPENSSL. Takes effect on the next connect.
+		void setTlsEnabled(bool value, chstr serverName = "");
+		HL_DEFINE_ISSET(tlsVerifyingPeer, TlsVerifyingPeer);
+		/// @note Offered with ALPN during the handshake, empty to not use ALPN.
+		HL_DEFINE_GETSET(hstr, tlsApplicationProtocol, TlsApplicationProtocol);
+		/// @return True if the current TLS connection resumed a cached session.
+		bool isTlsResumed() const;
+		/// @brief Makes a listening socket encrypt all connections it accepts with TLS.
+		/// @note Empty filenames disable TLS again.
+		bool setTlsCertificate(chstr certificateFilename, chstr privateKeyFilename);
 
 		bool tryCreateSocket();
 		bool setRemoteAddress(Host remoteHost, unsigned short remotePort);
 		bool setLocalAddress(Host localHost, unsigned short localPort);
 		bool connect(Host remoteHost, unsigned short remotePort, Host& localHost, unsigned short& localPort, float timeout, float retryFrequency);
+		/// @brief Starts connecting without waiting for the connection to be established.
+		/// @note pollConnect() has to be called until it reports that connecting has finished.
+		bool startConnect(Host remoteHost, unsigned short remotePort);
+		/// @return False if connecting failed.
+		bool pollConnect(bool& finished, Host& localHost, unsigned short& localPort);
+		/// @return True if the remote side has closed the connection.
+		bool checkRemoteClosed();
 		/// @note Since binding can be done on "any IP" and "any port", the set values are returned.
 		bool bind(Host localHost, unsigned short& localPort);
 		bool disconnect();
 		bool send(hstream* stream, int& sent, int& count);
+		/// @note Sends straight from memory without copying the data into a stream.
+		bool send(const char* data, int& count, int& sent);
+		/// @brief Sends data from a file opened with openFile().
+		/// @note Uses sendfile() where available so the data is never copied into user space.
+		bool sendFile(int fileDescriptor, int64_t& offset, int64_t& count, int64_t& sent);
+		/// @brief Like sendFile(), but only sends what the socket can take right away.
+		/// @note Returns true with nothing sent if the socket can't take any data at the moment.
+		bool sendFileNonBlocking(int fileDescriptor, int64_t& offset, int64_t& count, int64_t& sent);
 		bool receive(hstream* stream, int& maxCount, hmutex* mutex = NULL);
 		bool receiveFrom(hstream* stream, Host& remoteHost, unsigned short& remotePort);
 		bool listen();
@@ -73,10 +107,17 @@ namespace sakit
 		bool setMulticastLoopback(bool value);
 
 		static Host resolveHost(Host domain);
+		/// @brief Looks up all addresses of a host name with the system resolver.
+		/// @note Blocks until the lookup has finished, the Resolver calls this on its own threads.
+		static bool lookupHost(chstr hostname, harray<Host>& addresses);
 		static Host resolveIp(Host ip);
 		static unsigned short resolveServiceName(chstr serviceName);
 		static harray<NetworkAdapter> getNetworkAdapters();
 		
+		/// @return A read-only file descriptor or -1 if the file couldn't be opened.
+		static int openFile(chstr filename);
+		static void closeFile(int fileDescriptor);
+
 		static void platformInit();
 		static void platformDestroy();
 
@@ -86,6 +127,13 @@ namespace sakit
 		char* receiveBuffer;
 		int bufferSize;
 		bool serverMode;
+		int64_t resolveDuration;
+		bool tlsEnabled;
+		hstr tlsServerName;
+		bool tlsVerifyingPeer;
+		hstr tlsApplicationProtocol;
+		hstr tlsCertificateFilename;
+		hstr tlsPrivateKeyFilename;
 
 #if !defined(_WIN32) || !defined(_WINRT)
 		unsigned int sock;
@@ -93,8 +141,16 @@ namespace sakit
 		struct addrinfo* localInfo;
 		struct addrinfo* remoteInfo;
 		struct sockaddr_storage* address;
+		TlsSession* tls;
 
 		bool _setAddress(Host& host, unsigned short& port, addrinfo** info);
+		/// @brief Does the TLS handshake on a connected socket if TLS is enabled.
+		bool _startTls(chstr serverName, unsigned short port, float timeout);
+		/// @brief Continues the handshake of an accepted connection which is done by whichever thread sends or receives first.
+		/// @note Waits until the handshake is done or the global timeout has passed unless blocking is false.
+		bool _continueTls(bool blocking);
+		/// @brief Connects to the addresses in staggered parallel attempts and keeps the first socket that succeeds.
+		bool _connectParallel(const harray<Host>& addresses, unsigned short remotePort, Host& localHost, unsigned short& localPort, float timeout);
 		bool _checkReceivedCount(unsigned long* receivedCount);
 		bool _checkResult(int result, chstr functionName, bool disconnectOnError = true);
 		void _getLocalHostPort(Host& host, unsigned short& port);
@@ -179,6 +235,7 @@ namespace sakit
 #endif
 
 		bool _setNonBlocking(bool value);
+		bool _sendFileBuffered(int fileDescriptor, int64_t& offset, int64_t& count, int64_t& sent);
 
 		static bool _printLastError(chstr basicMessage, int code = 0);
 
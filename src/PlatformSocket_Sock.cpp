@@ -44,6 +44,11 @@ typedef int socklen_t;
 #include <fcntl.h>
 #include <netdb.h>
 #include <errno.h>
+#ifdef __APPLE__
+#include <sys/uio.h>
+#else
+#include <sys/sendfile.h>
+#endif
 
 extern int h_errno;
 
@@ -62,6 +67,9 @@ extern int h_errno;
 #define EWOULDBLOCK EAGAIN
 #endif
 
+// Linux never transfers more than this in one sendfile() call
+#define SAKIT_SEND_FILE_MAX_COUNT 0x7FFFF000
+
 #include <hltypes/hlog.h>
 #include <hltypes/hltypesUtil.h>
 #include <hltypes/hstream.h>
@@ -69,9 +77,11 @@ extern int h_errno;
 
 #include "Host.h"
 #include "PlatformSocket.h"
+#include "Resolver.h"
 #include "sakit.h"
 #include "Server.h"
 #include "Socket.h"
+#include "TlsSession.h"
 
 #ifdef _IOS
 	#define FAMILY_INET AF_INET6
@@ -88,11 +98,7 @@ extern int h_errno;
 namespace sakit
 {
 	extern int bufferSize;
-	// even though by standard definition these functions should be thread-safe, practice has shown otherwise
-	static hmutex mutexGetaddrinfo;
-	static hmutex mutexFreeaddrinfo;
-	static hmutex mutexGetnameinfo;
-	static hmutex mutexGetsockname;
+	extern float timeout;
 
 	// utility functions
 #ifdef _WIN32
@@ -123,34 +129,81 @@ namespace sakit
 	#define __inet_pton inet_pton
 #endif
 
-	// wrappers for thread-unsafe functions
-	static hmutex mutexInetNtoa;
-	static hmutex mutexInetAddr;
-	static hmutex mutexHtons;
-	static hmutex mutexNtohs;
-
-	static char* __inet_ntoa(struct in_addr in)
+	// uses the binary form of the host so no string has to be parsed, INADDR_NONE if the host isn't an IPv4 address
+	static unsigned long __getIpv4(const Host& host)
 	{
-		hmutex::ScopeLock lock(&mutexInetNtoa);
-		return inet_ntoa(in);
+		if (!host.isIpv4())
+		{
+			return INADDR_NONE;
+		}
+		in_addr address;
+		memcpy(&address, host.getBinaryAddress(), 4);
+		return address.s_addr;
 	}
 
-	static unsigned long __inet_addr(const char* cp)
+	// keeps the address in binary form instead of going through getnameinfo(), it's only formatted when needed
+	static void __getHostPort(const sockaddr* address, socklen_t size, Host& host, unsigned short& port)
 	{
-		hmutex::ScopeLock lock(&mutexInetAddr);
-		return inet_addr(cp);
+		if (address->sa_family == AF_INET)
+		{
+			host = Host((const unsigned char*)&((const sockaddr_in*)address)->sin_addr, 4);
+			port = ntohs(((const sockaddr_in*)address)->sin_port);
+			return;
+		}
+		if (address->sa_family == AF_INET6)
+		{
+			host = Host((const unsigned char*)&((const sockaddr_in6*)address)->sin6_addr, 16);
+			port = ntohs(((const sockaddr_in6*)address)->sin6_port);
+			return;
+		}
+		char hostString[NI_MAXHOST] = {'\0'};
+		getnameinfo(address, size, hostString, NI_MAXHOST, NULL, 0, NI_NUMERICHOST);
+		host = Host(hostString);
+		port = 0;
 	}
 
-	static unsigned short __htons(unsigned hostshort)
+	// the address of an addrinfo is stored in the same allocation so it can be released with a single free()
+	struct __AddressInfo
 	{
-		hmutex::ScopeLock lock(&mutexHtons);
-		return htons(hostshort);
+		addrinfo info;
+		sockaddr_storage address;
+	};
+
+	static addrinfo* __createAddressInfo(int family, int socketType, int protocol, const sockaddr* address, socklen_t addressSize)
+	{
+		__AddressInfo* result = (__AddressInfo*)malloc(sizeof(__AddressInfo));
+		memset(result, 0, sizeof(__AddressInfo));
+		memcpy(&result->address, address, hmin((int)addressSize, (int)sizeof(sockaddr_storage)));
+		result->info.ai_family = family;
+		result->info.ai_socktype = socketType;
+		result->info.ai_protocol = protocol;
+		result->info.ai_addr = (sockaddr*)&result->address;
+		result->info.ai_addrlen = addressSize;
+		return &result->info;
 	}
 
-	static unsigned short __ntohs(unsigned netshort)
+	// IP literals are filled in directly instead of going through the system resolver
+	static addrinfo* __createNumericAddressInfo(const Host& host, unsigned short port, int socketType)
 	{
-		hmutex::ScopeLock lock(&mutexNtohs);
-		return ntohs(netshort);
+		if (host.isIpv4())
+		{
+			sockaddr_in address;
+			memset(&address, 0, sizeof(sockaddr_in));
+			address.sin_family = AF_INET;
+			address.sin_port = htons(port);
+			memcpy(&address.sin_addr, host.getBinaryAddress(), 4);
+			return __createAddressInfo(AF_INET, socketType, IPPROTO_IP, (sockaddr*)&address, (socklen_t)sizeof(sockaddr_in));
+		}
+		if (host.isIpv6())
+		{
+			sockaddr_in6 address;
+			memset(&address, 0, sizeof(sockaddr_in6));
+			address.sin6_family = AF_INET6;
+			address.sin6_port = htons(port);
+			memcpy(&address.sin6_addr, host.getBinaryAddress(), 16);
+			return __createAddressInfo(AF_INET6, socketType, IPPROTO_IP, (sockaddr*)&address, (socklen_t)sizeof(sockaddr_in6));
+		}
+		return NULL;
 	}
 
 	// normal methods
@@ -180,9 +233,13 @@ namespace sakit
 
 	PlatformSocket::PlatformSocket() :
 		connected(false),
-		connectionLess(false)
+		connectionLess(false),
+		resolveDuration(0LL),
+		tlsEnabled(false),
+		tlsVerifyingPeer(true)
 	{
 		this->sock = -1;
+		this->tls = NULL;
 		this->socketInfo = NULL;
 		this->localInfo = NULL;
 		this->remoteInfo = NULL;
@@ -192,11 +249,41 @@ namespace sakit
 		memset(this->receiveBuffer, 0, this->bufferSize);
 	}
 
+	static int __setNonBlocking(unsigned int sock, bool value)
+	{
+		int setValue = (value ? 1 : 0);
+		return ioctlsocket(sock, FIONBIO, (unsigned long*)&setValue);
+	}
+
+	static void __setLastError(int value)
+	{
+#ifdef _WIN32
+		WSASetLastError(value);
+#else
+		errno = value;
+#endif
+	}
+
+	static bool __isWouldBlock()
+	{
+#ifdef _WIN32
+		return (WSAGetLastError() == WSAEWOULDBLOCK);
+#else
+		return (errno == EAGAIN || errno == EWOULDBLOCK);
+#endif
+	}
+
 	bool PlatformSocket::_setNonBlocking(bool value)
 	{
+#ifdef _OPENSSL
+		// another thread could be using the TLS session at the same time, OpenSSL reports a socket that would block by itself
+		if (this->tls != NULL)
+		{
+			value = true;
+		}
+#endif
 		// set to blocking or non-blocking
-		int setValue = (value ? 1 : 0);
-		return this->_checkResult(ioctlsocket(this->sock, FIONBIO, (unsigned long*)&setValue), "ioctlsocket()");
+		return this->_checkResult(__setNonBlocking(this->sock, value), "ioctlsocket()");
 	}
 
 	bool PlatformSocket::tryCreateSocket()
@@ -227,35 +314,60 @@ namespace sakit
 			this->socketInfo = (addrinfo*)malloc(sizeof(addrinfo));
 			memset(this->socketInfo, 0, sizeof(addrinfo));
 		}
-		hmutex::ScopeLock lock;
 		if (*info != NULL)
 		{
-			lock.acquire(&mutexFreeaddrinfo);
-			freeaddrinfo(*info);
-			lock.release();
+			free(*info);
 			*info = NULL;
 		}
 		this->socketInfo->ai_family = FAMILY_INET;
 		this->socketInfo->ai_socktype = (!this->connectionLess ? SOCK_STREAM : SOCK_DGRAM);
 		this->socketInfo->ai_protocol = IPPROTO_IP;
 		this->socketInfo->ai_flags = 0;
-		lock.acquire(&mutexGetaddrinfo);
-		int result = getaddrinfo(host.toString().cStr(), hstr(port).cStr(), this->socketInfo, info);
-#ifdef USE_FALLBACK
-		if (result != 0)
+		int64_t resolveStart = htickCount();
+		Host address = host;
+		if (address.toString() != "" && !address.isIp())
 		{
-			this->socketInfo->ai_family = AF_INET;
-			result = getaddrinfo(host.toString().cStr(), hstr(port).cStr(), this->socketInfo, info);
+			// the name is looked up by the resolver so the result is cached and a slow lookup doesn't block other sockets
+			harray<Host> addresses;
+			if (!Resolver::resolve(address.toString(), addresses, sakit::timeout))
+			{
+				this->resolveDuration = htickCount() - resolveStart;
+				this->disconnect();
+				return false;
+			}
+			address = Resolver::getPreferredAddress(addresses);
+			this->socketInfo->ai_flags = AI_NUMERICHOST;
 		}
+#ifdef _IOS // getaddrinfo() has to synthesize IPv6 addresses for IPv4 literals in NAT64 networks
+		if (!address.isIpv4())
 #endif
-		if (result != 0)
 		{
-			hlog::error(logTag, "getaddrinfo() " + __gai_strerror(result));
-			lock.release();
-			this->disconnect();
-			return false;
+			*info = __createNumericAddressInfo(address, port, this->socketInfo->ai_socktype);
 		}
-		lock.release();
+		if (*info == NULL)
+		{
+			addrinfo* result = NULL;
+			hstr addressString = address.toString();
+			int error = getaddrinfo(addressString.cStr(), hstr(port).cStr(), this->socketInfo, &result);
+#ifdef USE_FALLBACK
+			if (error != 0)
+			{
+				this->socketInfo->ai_family = AF_INET;
+				error = getaddrinfo(addressString.cStr(), hstr(port).cStr(), this->socketInfo, &result);
+			}
+#endif
+			if (error != 0)
+			{
+				this->resolveDuration = htickCount() - resolveStart;
+				hlog::error(logTag, "getaddrinfo() " + __gai_strerror(error));
+				this->disconnect();
+				return false;
+			}
+			// only the first result is used so it's copied and all infos can be released the same way
+			*info = __createAddressInfo(result->ai_family, result->ai_socktype, result->ai_protocol, result->ai_addr, (socklen_t)result->ai_addrlen);
+			freeaddrinfo(result);
+		}
+		this->resolveDuration = htickCount() - resolveStart;
 		this->socketInfo->ai_family = (*info)->ai_family;
 		this->socketInfo->ai_socktype = (*info)->ai_socktype;
 		this->socketInfo->ai_protocol = (*info)->ai_protocol;
@@ -264,10 +376,35 @@ namespace sakit
 
 	bool PlatformSocket::connect(Host remoteHost, unsigned short remotePort, Host& localHost, unsigned short& localPort, float timeout, float retryFrequency)
 	{
+		// the name has to be kept for TLS before it's replaced by an address
+		hstr serverName = (this->tlsServerName != "" ? this->tlsServerName : remoteHost.toString());
+		int64_t resolveDuration = -1LL;
+		if (!this->connectionLess && remoteHost.toString() != "" && !remoteHost.isIp())
+		{
+			int64_t resolveStart = htickCount();
+			harray<Host> addresses;
+			bool result = Resolver::resolve(remoteHost.toString(), addresses, timeout);
+			this->resolveDuration = htickCount() - resolveStart;
+			if (!result)
+			{
+				this->disconnect();
+				return false;
+			}
+			if (addresses.size() > 1)
+			{
+				return (this->_connectParallel(addresses, remotePort, localHost, localPort, timeout) && this->_startTls(serverName, remotePort, timeout));
+			}
+			remoteHost = addresses.first();
+			resolveDuration = this->resolveDuration;
+		}
 		if (!this->setRemoteAddress(remoteHost, remotePort))
 		{
 			return false;
 		}
+		if (resolveDuration >= 0LL)
+		{
+			this->resolveDuration = resolveDuration;
+		}
 		if (!this->tryCreateSocket())
 		{
 			return false;
@@ -330,9 +467,387 @@ namespace sakit
 			}
 		}
 		this->_getLocalHostPort(localHost, localPort);
+		return this->_startTls(serverName, remotePort, timeout);
+	}
+
+	bool PlatformSocket::_startTls(chstr serverName, unsigned short port, float timeout)
+	{
+		if (!this->tlsEnabled)
+		{
+			return true;
+		}
+#ifdef _OPENSSL
+		if (this->tls != NULL && this->tls->isConnected())
+		{
+			return true;
+		}
+		if (this->tls != NULL)
+		{
+			delete this->tls;
+		}
+		this->tls = new TlsSession(this->sock, serverName, serverName + ":" + hstr(port), this->tlsVerifyingPeer, this->tlsApplicationProtocol);
+		// the socket stays non-blocking from now on so the handshake can time out
+		this->_setNonBlocking(true);
+		if (!this->tls->handshake(timeout))
+		{
+			this->disconnect();
+			return false;
+		}
+		return true;
+#else
+		hlog::error(logTag, "TLS is not available, SAKit was built without _OPENSSL!");
+		this->disconnect();
+		return false;
+#endif
+	}
+
+	bool PlatformSocket::isTlsResumed() const
+	{
+#ifdef _OPENSSL
+		return (this->tls != NULL && this->tls->isResumed());
+#else
+		return false;
+#endif
+	}
+
+	bool PlatformSocket::setTlsCertificate(chstr certificateFilename, chstr privateKeyFilename)
+	{
+		if (certificateFilename == "" || privateKeyFilename == "")
+		{
+			this->tlsEnabled = false;
+			this->tlsCertificateFilename = "";
+			this->tlsPrivateKeyFilename = "";
+			return true;
+		}
+#ifdef _OPENSSL
+		if (!TlsSession::loadServerCertificate(certificateFilename, privateKeyFilename))
+		{
+			return false;
+		}
+		this->tlsEnabled = true;
+		this->tlsCertificateFilename = certificateFilename;
+		this->tlsPrivateKeyFilename = privateKeyFilename;
+		return true;
+#else
+		hlog::error(logTag, "TLS is not available, SAKit was built without _OPENSSL!");
+		return false;
+#endif
+	}
+
+#ifdef _OPENSSL
+	bool PlatformSocket::_continueTls(bool blocking)
+	{
+		if (this->tls->isConnected())
+		{
+			return true;
+		}
+		// the socket is always non-blocking so a single step never waits and a blocking call waits in select() with a deadline
+		bool result = (blocking ? this->tls->handshake(sakit::getGlobalTimeout()) : this->tls->handshake());
+		if (!result)
+		{
+			hlog::error(logTag, "TLS handshake with accepted connection failed.");
+			this->disconnect();
+		}
+		return result;
+	}
+#endif
+
+	bool PlatformSocket::_connectParallel(const harray<Host>& addresses, unsigned short remotePort, Host& localHost, unsigned short& localPort, float timeout)
+	{
+		// the address families alternate, starting with the one the system resolver sorted first
+		harray<Host> preferred;
+		harray<Host> other;
+		bool ipv6 = addresses[0].isIpv6();
+		foreachc (Host, it, addresses)
+		{
+			if ((*it).isIpv6() == ipv6)
+			{
+				preferred += (*it);
+			}
+			else
+			{
+				other += (*it);
+			}
+		}
+		harray<Host> ordered;
+		while (preferred.size() > 0 || other.size() > 0)
+		{
+			if (preferred.size() > 0)
+			{
+				ordered += preferred.removeFirst();
+			}
+			if (other.size() > 0)
+			{
+				ordered += other.removeFirst();
+			}
+		}
+		if (this->remoteInfo != NULL)
+		{
+			free(this->remoteInfo);
+			this->remoteInfo = NULL;
+		}
+		harray<unsigned int> sockets;
+		harray<addrinfo*> infos;
+		int winner = -1;
+		int index = 0;
+		int64_t start = htickCount();
+		int64_t timeoutTime = start + (int64_t)(timeout * 1000.0f);
+		int64_t nextAttemptTime = start;
+		int64_t time = start;
+		int64_t waitTime = 0LL;
+		unsigned int sock = (unsigned int)-1;
+		unsigned int maxSock = 0;
+		addrinfo* info = NULL;
+		int result = 0;
+		int error = 0;
+		socklen_t size = 0;
+		timeval interval = {0, 0};
+		fd_set writeSet;
+		fd_set errorSet;
+		while (winner < 0)
+		{
+			time = htickCount();
+			if (time >= timeoutTime)
+			{
+				hlog::error(logTag, "Unable to connect, timed out.");
+				break;
+			}
+			// the next attempt starts when the delay has passed or when all previous attempts have already failed
+			if (index < ordered.size() && (time >= nextAttemptTime || sockets.size() == 0))
+			{
+				info = __createNumericAddressInfo(ordered[index], remotePort, SOCK_STREAM);
+				++index;
+				if (info == NULL)
+				{
+					continue;
+				}
+				sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol);
+				if (sock == (unsigned int)-1)
+				{
+					PlatformSocket::_printLastError("socket()");
+					free(info);
+					continue;
+				}
+				__setNonBlocking(sock, true);
+				result = ::connect(sock, info->ai_addr, info->ai_addrlen);
+				if (result != 0 && PlatformSocket::_printLastError("connect()")) // failed and actual error
+				{
+					closesocket(sock);
+					free(info);
+					continue;
+				}
+				sockets += sock;
+				infos += info;
+				if (result == 0)
+				{
+					winner = sockets.size() - 1;
+					break;
+				}
+				nextAttemptTime = htickCount() + SAKIT_CONNECTION_ATTEMPT_DELAY;
+			}
+			if (sockets.size() == 0)
+			{
+				if (index >= ordered.size())
+				{
+					break;
+				}
+				continue;
+			}
+			waitTime = timeoutTime - time;
+			if (index < ordered.size())
+			{
+				waitTime = hclamp(nextAttemptTime - time, (int64_t)0, waitTime);
+			}
+			interval.tv_sec = (long)(waitTime / 1000);
+			interval.tv_usec = (long)((waitTime % 1000) * 1000);
+			FD_ZERO(&writeSet);
+			FD_ZERO(&errorSet);
+			maxSock = 0;
+			foreach (unsigned int, it, sockets)
+			{
+				FD_SET((*it), &writeSet);
+				FD_SET((*it), &errorSet); // Windows reports failed connects only here
+				maxSock = hmax(maxSock, (*it));
+			}
+			result = select(maxSock + 1, NULL, &writeSet, &errorSet, &interval);
+			if (result < 0)
+			{
+				PlatformSocket::_printLastError("select()");
+				break;
+			}
+			for_iter (i, 0, sockets.size())
+			{
+				if (!FD_ISSET(sockets[i], &writeSet) && !FD_ISSET(sockets[i], &errorSet))
+				{
+					continue;
+				}
+				error = 0;
+				size = sizeof(error);
+				result = getsockopt(sockets[i], SOL_SOCKET, SO_ERROR, (char*)&error, &size);
+				if (result == 0 && error == 0 && FD_ISSET(sockets[i], &writeSet))
+				{
+					winner = i;
+					break;
+				}
+				PlatformSocket::_printLastError("connect()", error);
+				closesocket(sockets.removeAt(i));
+				free(infos.removeAt(i));
+				--i;
+				nextAttemptTime = htickCount(); // a failed attempt doesn't have to wait for the delay
+			}
+		}
+		// all other attempts are abandoned
+		for_iter (i, 0, sockets.size())
+		{
+			if (i != winner)
+			{
+				closesocket(sockets[i]);
+				free(infos[i]);
+			}
+		}
+		if (winner < 0)
+		{
+			this->disconnect();
+			return false;
+		}
+		if (this->socketInfo == NULL)
+		{
+			this->socketInfo = (addrinfo*)malloc(sizeof(addrinfo));
+			memset(this->socketInfo, 0, sizeof(addrinfo));
+		}
+		this->remoteInfo = infos[winner];
+		this->socketInfo->ai_family = this->remoteInfo->ai_family;
+		this->socketInfo->ai_socktype = this->remoteInfo->ai_socktype;
+		this->socketInfo->ai_protocol = this->remoteInfo->ai_protocol;
+		this->sock = sockets[winner];
+		this->connected = true;
+		this->_setNonBlocking(false);
+		if (!this->setNagleAlgorithmActive(false))
+		{
+			return false;
+		}
+		this->_getLocalHostPort(localHost, localPort);
 		return true;
 	}
 
+	bool PlatformSocket::startConnect(Host remoteHost, unsigned short remotePort)
+	{
+		if (!this->setRemoteAddress(remoteHost, remotePort))
+		{
+			return false;
+		}
+		if (!this->tryCreateSocket())
+		{
+			return false;
+		}
+		if (this->tlsEnabled)
+		{
+#ifdef _OPENSSL
+			// the handshake is continued by pollConnect() once the connection has been established
+			hstr serverName = (this->tlsServerName != "" ? this->tlsServerName : remoteHost.toString());
+			if (this->tls != NULL)
+			{
+				delete this->tls;
+			}
+			this->tls = new TlsSession(this->sock, serverName, serverName + ":" + hstr(remotePort), this->tlsVerifyingPeer, this->tlsApplicationProtocol);
+#else
+			hlog::error(logTag, "TLS is not available, SAKit was built without _OPENSSL!");
+			this->disconnect();
+			return false;
+#endif
+		}
+		if (!this->setNagleAlgorithmActive(false))
+		{
+			return false;
+		}
+		this->_setNonBlocking(true);
+		int result = ::connect(this->sock, this->remoteInfo->ai_addr, this->remoteInfo->ai_addrlen);
+		this->_setNonBlocking(false);
+		if (result != 0 && PlatformSocket::_printLastError("connect()")) // failed and actual error
+		{
+			this->disconnect();
+			return false;
+		}
+		return true;
+	}
+
+	bool PlatformSocket::pollConnect(bool& finished, Host& localHost, unsigned short& localPort)
+	{
+		finished = false;
+		timeval interval = {0, 0};
+		fd_set writeSet;
+		FD_ZERO(&writeSet);
+		FD_SET(this->sock, &writeSet);
+		int result = select(this->sock + 1, NULL, &writeSet, NULL, &interval);
+		if (!this->_checkResult(result, "select()"))
+		{
+			return false;
+		}
+		if (result == 0)
+		{
+			return true;
+		}
+		int error;
+		socklen_t size = sizeof(error);
+		result = getsockopt(this->sock, SOL_SOCKET, SO_ERROR, (char*)&error, &size);
+		if (!this->_checkResult(result, "getsockopt()"))
+		{
+			return false;
+		}
+		if (PlatformSocket::_printLastError("", error))
+		{
+			this->disconnect();
+			return false;
+		}
+#ifdef _OPENSSL
+		if (this->tls != NULL && !this->tls->isConnected())
+		{
+			bool success = this->tls->handshake();
+			if (!success)
+			{
+				this->disconnect();
+				return false;
+			}
+			if (!this->tls->isConnected())
+			{
+				return true;
+			}
+		}
+#endif
+		this->_getLocalHostPort(localHost, localPort);
+		finished = true;
+		return true;
+	}
+
+	bool PlatformSocket::checkRemoteClosed()
+	{
+		if (this->sock == (unsigned int)-1)
+		{
+			return true;
+		}
+#ifdef _OPENSSL
+		if (this->tls != NULL && this->tls->isRemoteClosed())
+		{
+			return true;
+		}
+#endif
+		timeval interval = {0, 0};
+		fd_set readSet;
+		FD_ZERO(&readSet);
+		FD_SET(this->sock, &readSet);
+		int result = select(this->sock + 1, &readSet, NULL, NULL, &interval);
+		if (result <= 0)
+		{
+			return (result < 0);
+		}
+		// readable without any queued data means that the other side has shut down the connection
+		char data = 0;
+		this->_setNonBlocking(true);
+		result = (int)recv(this->sock, &data, 1, MSG_PEEK);
+		this->_setNonBlocking(false);
+		return (result == 0 || (result < 0 && PlatformSocket::_printLastError("recv()")));
+	}
+
 	bool PlatformSocket::bind(Host localHost, unsigned short& localPort)
 	{
 		if (!this->setLocalAddress(localHost, localPort))
@@ -357,32 +872,31 @@ namespace sakit
 
 	void PlatformSocket::_getLocalHostPort(Host& host, unsigned short& port)
 	{
-		sockaddr_in address;
-		socklen_t addressSize = (socklen_t)sizeof(sockaddr_in);
-		memset(&address, 0, addressSize);
-		address.sin_family = AF_INET;
-		address.sin_addr.s_addr = IN_ADDRT_T_TYPECAST __inet_addr(host.toString().cStr());
-		address.sin_port = __htons(port);
-		hmutex::ScopeLock lock(&mutexGetsockname);
-		getsockname(this->sock, (sockaddr*)&address, &addressSize);
-		lock.release();
-		host = Host(__inet_ntoa(address.sin_addr));
-		port = __ntohs(address.sin_port);
+		// large enough for IPv6 sockets
+		sockaddr_storage storage;
+		socklen_t addressSize = (socklen_t)sizeof(sockaddr_storage);
+		memset(&storage, 0, addressSize);
+		sockaddr_in* address = (sockaddr_in*)&storage;
+		address->sin_family = AF_INET;
+		address->sin_addr.s_addr = IN_ADDRT_T_TYPECAST __getIpv4(host);
+		address->sin_port = htons(port);
+		getsockname(this->sock, (sockaddr*)&storage, &addressSize);
+		__getHostPort((sockaddr*)&storage, addressSize, host, port);
 	}
 
 	bool PlatformSocket::joinMulticastGroup(Host interfaceHost, Host groupAddress)
 	{
 		ip_mreq group;
-		group.imr_interface.s_addr = IN_ADDRT_T_TYPECAST __inet_addr(interfaceHost.toString().cStr());
-		group.imr_multiaddr.s_addr = IN_ADDRT_T_TYPECAST __inet_addr(groupAddress.toString().cStr());
+		group.imr_interface.s_addr = IN_ADDRT_T_TYPECAST __getIpv4(interfaceHost);
+		group.imr_multiaddr.s_addr = IN_ADDRT_T_TYPECAST __getIpv4(groupAddress);
 		return this->_checkResult(setsockopt(this->sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, (char*)&group, sizeof(ip_mreq)), "setsockopt()");
 	}
 
 	bool PlatformSocket::leaveMulticastGroup(Host interfaceHost, Host groupAddress)
 	{
 		ip_mreq group;
-		group.imr_interface.s_addr = IN_ADDRT_T_TYPECAST __inet_addr(interfaceHost.toString().cStr());
-		group.imr_multiaddr.s_addr = IN_ADDRT_T_TYPECAST __inet_addr(groupAddress.toString().cStr());
+		group.imr_interface.s_addr = IN_ADDRT_T_TYPECAST __getIpv4(interfaceHost);
+		group.imr_multiaddr.s_addr = IN_ADDRT_T_TYPECAST __getIpv4(groupAddress);
 		return this->_checkResult(setsockopt(this->sock, IPPROTO_IP, IP_DROP_MEMBERSHIP, (char*)&group, sizeof(ip_mreq)), "setsockopt()");
 	}
 
@@ -395,7 +909,7 @@ namespace sakit
 	bool PlatformSocket::setMulticastInterface(Host interfaceHost)
 	{
 		in_addr local;
-		local.s_addr = IN_ADDRT_T_TYPECAST __inet_addr(interfaceHost.toString().cStr());
+		local.s_addr = IN_ADDRT_T_TYPECAST __getIpv4(interfaceHost);
 		return this->_checkResult(setsockopt(this->sock, IPPROTO_IP, IP_MULTICAST_IF, (char*)&local, sizeof(in_addr)), "setsockopt()");
 	}
 
@@ -417,23 +931,29 @@ namespace sakit
 			free(this->socketInfo);
 			this->socketInfo = NULL;
 		}
-		hmutex::ScopeLock lock(&mutexFreeaddrinfo);
 		if (this->localInfo != NULL)
 		{
-			freeaddrinfo(this->localInfo);
+			free(this->localInfo);
 			this->localInfo = NULL;
 		}
 		if (this->remoteInfo != NULL)
 		{
-			freeaddrinfo(this->remoteInfo);
+			free(this->remoteInfo);
 			this->remoteInfo = NULL;
 		}
-		lock.release();
 		if (this->address != NULL)
 		{
 			free(this->address);
 			this->address = NULL;
 		}
+#ifdef _OPENSSL
+		if (this->tls != NULL)
+		{
+			this->tls->shutdown();
+			delete this->tls;
+			this->tls = NULL;
+		}
+#endif
 		if (this->sock != (unsigned int)-1)
 		{
 			closesocket(this->sock);
@@ -446,9 +966,33 @@ namespace sakit
 
 	bool PlatformSocket::send(hstream* stream, int& count, int& sent)
 	{
-		const char* data = (const char*)&(*stream)[(int)stream->position()];
 		int size = hmin((int)(stream->size() - stream->position()), count);
+		int sentCount = 0;
+		if (!this->send((const char*)&(*stream)[(int)stream->position()], size, sentCount))
+		{
+			return false;
+		}
+		stream->seek(sentCount);
+		sent += sentCount;
+		count -= sentCount;
+		return true;
+	}
+
+	bool PlatformSocket::send(const char* data, int& count, int& sent)
+	{
+		int size = count;
 		int result = 0;
+#ifdef _OPENSSL
+		if (this->tls != NULL)
+		{
+			if (!this->_continueTls(true))
+			{
+				return false;
+			}
+			result = this->tls->send(data, size);
+		}
+		else
+#endif
 		if (!this->connectionLess)
 		{
 			result = (int)::send(this->sock, data, size, 0);
@@ -467,7 +1011,6 @@ namespace sakit
 		}
 		if (result >= 0)
 		{
-			stream->seek(result);
 			sent += result;
 			count -= result;
 			return true;
@@ -475,9 +1018,129 @@ namespace sakit
 		return false;
 	}
 
+	bool PlatformSocket::sendFile(int fileDescriptor, int64_t& offset, int64_t& count, int64_t& sent)
+	{
+#ifdef _OPENSSL
+		if (this->tls != NULL)
+		{
+			if (!this->_continueTls(true))
+			{
+				return false;
+			}
+			// without kernel TLS the data has to be encrypted in user space
+			if (!this->tls->isKernelSendActive())
+			{
+				return this->_sendFileBuffered(fileDescriptor, offset, count, sent);
+			}
+			int64_t sentCount = this->tls->sendFile(fileDescriptor, offset, hmin(count, (int64_t)SAKIT_SEND_FILE_MAX_COUNT));
+			if (sentCount < 0)
+			{
+				return false;
+			}
+			// nothing could be sent because the socket would block
+			if (sentCount == 0 && this->tls->isWaitingForWrite())
+			{
+				return true;
+			}
+			if (sentCount == 0 && count > 0)
+			{
+				hlog::warn(logTag, "File ended before all data was sent!");
+				return false;
+			}
+			offset += sentCount;
+			sent += sentCount;
+			count -= sentCount;
+			return true;
+		}
+#endif
+#ifdef _WIN32
+		return this->_sendFileBuffered(fileDescriptor, offset, count, sent);
+#else
+		// the kernel copies straight from the page cache, the data never passes through user space
+		size_t size = (size_t)hmin(count, (int64_t)SAKIT_SEND_FILE_MAX_COUNT);
+#ifdef __APPLE__
+		off_t length = (off_t)size;
+		int result = ::sendfile(fileDescriptor, this->sock, (off_t)offset, &length, NULL, 0);
+		// a partial transfer can still report an error
+		if (result < 0 && length <= 0)
+		{
+			return this->_checkResult(result, "sendfile()", false);
+		}
+		int64_t sentCount = (int64_t)length;
+#else
+		off_t position = (off_t)offset;
+		socketret_t result = ::sendfile(this->sock, fileDescriptor, &position, size);
+		if (result < 0)
+		{
+			return this->_checkResult((int)result, "sendfile()", false);
+		}
+		int64_t sentCount = (int64_t)result;
+#endif
+		if (sentCount == 0 && count > 0)
+		{
+			hlog::warn(logTag, "File ended before all data was sent!");
+			return false;
+		}
+		offset += sentCount;
+		sent += sentCount;
+		count -= sentCount;
+		return true;
+#endif
+	}
+
+	bool PlatformSocket::sendFileNonBlocking(int fileDescriptor, int64_t& offset, int64_t& count, int64_t& sent)
+	{
+		timeval interval = {0, 0};
+		fd_set writeSet;
+		FD_ZERO(&writeSet);
+		FD_SET(this->sock, &writeSet);
+		int result = select(this->sock + 1, NULL, &writeSet, NULL, &interval);
+		if (!this->_checkResult(result, "select()", false))
+		{
+			return false;
+		}
+		if (result == 0)
+		{
+			return true;
+		}
+#ifdef _OPENSSL
+		if (this->tls != NULL)
+		{
+			return this->sendFile(fileDescriptor, offset, count, sent);
+		}
+#endif
+		// a full socket buffer is reported as an error that isn't one
+		int64_t lastSent = sent;
+		this->_setNonBlocking(true);
+		__setLastError(0);
+		bool success = this->sendFile(fileDescriptor, offset, count, sent);
+		bool wouldBlock = __isWouldBlock();
+		this->_setNonBlocking(false);
+		return (success || (sent == lastSent && wouldBlock));
+	}
+
 	bool PlatformSocket::receive(hstream* stream, int& maxCount, hmutex* mutex)
 	{
 		unsigned long receivedCount = 0;
+#ifdef _OPENSSL
+		if (this->tls != NULL)
+		{
+			if (!this->_continueTls(false))
+			{
+				return false;
+			}
+			if (!this->tls->isConnected())
+			{
+				return true;
+			}
+		}
+		// the socket only holds encrypted data so its size doesn't say how much can be read
+		if (this->tls != NULL && this->tls->hasPendingData())
+		{
+			receivedCount = (unsigned long)this->bufferSize;
+		}
+		else
+#endif
 		if (!this->_checkReceivedCount(&receivedCount))
 		{
 			return false;
@@ -487,6 +1150,29 @@ namespace sakit
 			return true;
 		}
 		int readCount = hmin((int)receivedCount, this->bufferSize);
+#ifdef _OPENSSL
+		if (this->tls != NULL)
+		{
+			readCount = this->bufferSize;
+			if (maxCount > 0)
+			{
+				readCount = hmin(readCount, maxCount);
+			}
+			readCount = this->tls->receive(this->receiveBuffer, readCount);
+			if (readCount <= 0)
+			{
+				return (readCount == 0);
+			}
+			hmutex::ScopeLock lock(mutex);
+			stream->writeRaw(this->receiveBuffer, readCount);
+			lock.release();
+			if (maxCount > 0)
+			{
+				maxCount -= readCount;
+			}
+			return true;
+		}
+#endif
 		if (maxCount > 0) // if don't read everything
 		{
 			readCount = hmin(readCount, maxCount);
@@ -531,14 +1217,8 @@ namespace sakit
 		if (read > 0)
 		{
 			stream->writeRaw(this->receiveBuffer, read);
-			// get the IP and port of the connected client
-			char hostString[NI_MAXHOST] = {'\0'};
-			char portString[NI_MAXSERV] = {'\0'};
-			hmutex::ScopeLock lock(&mutexGetnameinfo);
-			getnameinfo((sockaddr*)&address, size, hostString, NI_MAXHOST, portString, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
-			lock.release();
-			remoteHost = Host(hostString);
-			remotePort = (unsigned short)(int)hstr(portString);
+			// get the IP and port of the sender
+			__getHostPort((sockaddr*)&address, size, remoteHost, remotePort);
 		}
 		return true;
 	}
@@ -583,16 +1263,23 @@ namespace sakit
 		}
 		this->_setNonBlocking(false);
 		// get the IP and port of the connected client
-		char hostString[NI_MAXHOST] = {'\0'};
-		char portString[NI_MAXSERV] = {'\0'};
-		hmutex::ScopeLock lock(&mutexGetnameinfo);
-		getnameinfo((sockaddr*)other->address, size, hostString, NI_MAXHOST, portString, NI_MAXSERV, NI_NUMERICHOST | NI_NUMERICSERV);
-		lock.release();
+		Host remoteHost;
+		unsigned short remotePort = 0;
+		__getHostPort((sockaddr*)other->address, size, remoteHost, remotePort);
 		Host localHost;
 		unsigned short localPort = 0;
 		this->_getLocalHostPort(localHost, localPort);
-		((SocketBase*)socket)->_activateConnection(Host(hostString), (unsigned short)(int)hstr(portString), localHost, localPort);
+		((SocketBase*)socket)->_activateConnection(remoteHost, remotePort, localHost, localPort);
 		other->connected = true;
+#ifdef _OPENSSL
+		if (this->tlsEnabled)
+		{
+			// only prepared here, the accepting thread would be held up by slow clients if it did the handshake
+			other->tlsEnabled = true;
+			other->tls = new TlsSession(other->sock, this->tlsCertificateFilename, this->tlsPrivateKeyFilename);
+			other->_setNonBlocking(true);
+		}
+#endif
 		return true;
 	}
 
@@ -622,7 +1309,7 @@ namespace sakit
 		sockaddr_in address;
 		memset(&address, 0, sizeof(sockaddr_in));
 		address.sin_family = FAMILY_CONNECT_INET;
-		address.sin_port = __htons(port);
+		address.sin_port = htons(port);
 		int result = 0;
 		int maxResult = 0;
 		socklen_t addrSize = sizeof(sockaddr_in);
@@ -632,7 +1319,7 @@ namespace sakit
 		ips.removeDuplicates(); // to avoid broadcasting on the same IP twice, just to be sure
 		foreach (Host, it, ips)
 		{
-			address.sin_addr.s_addr = IN_ADDRT_T_TYPECAST __inet_addr((*it).toString().cStr());
+			address.sin_addr.s_addr = IN_ADDRT_T_TYPECAST __getIpv4(*it);
 			result = (int)sendto(this->sock, data, size, 0, (sockaddr*)&address, addrSize);
 			if (this->_checkResult(result, "sendto", false) && result > 0)
 			{
@@ -654,25 +1341,41 @@ namespace sakit
 	}
 
 	Host PlatformSocket::resolveHost(Host domain)
+	{
+		harray<Host> addresses;
+		if (!PlatformSocket::lookupHost(domain.toString(), addresses))
+		{
+			return Host();
+		}
+		return Resolver::getPreferredAddress(addresses);
+	}
+
+	bool PlatformSocket::lookupHost(chstr hostname, harray<Host>& addresses)
 	{
 		addrinfo hints;
-		addrinfo* info;
+		addrinfo* info = NULL;
 		memset(&hints, 0, sizeof(hints));
-		hints.ai_family = FAMILY_CONNECT_INET;
-		hmutex::ScopeLock lock(&mutexGetaddrinfo);
-		int result = getaddrinfo(domain.toString().cStr(), NULL, &hints, &info);
+		hints.ai_family = AF_UNSPEC; // both IPv4 and IPv6 addresses so connect() can try them in parallel
+		hints.ai_socktype = SOCK_STREAM; // otherwise every address is listed once for each socket type
+		// lookups run in parallel on the resolver threads
+		int result = getaddrinfo(hostname.cStr(), NULL, &hints, &info);
 		if (result != 0)
 		{
-			hlog::error(logTag, __gai_strerror(result));
-			return Host();
+			hlog::error(logTag, "getaddrinfo() " + __gai_strerror(result));
+			return false;
+		}
+		Host address;
+		unsigned short port = 0;
+		for (addrinfo* current = info; current != NULL; current = current->ai_next)
+		{
+			__getHostPort(current->ai_addr, (socklen_t)current->ai_addrlen, address, port);
+			if (address.toString() != "" && !addresses.has(address))
+			{
+				addresses += address;
+			}
 		}
-		lock.release();
-		in_addr address;
-		address.s_addr = ((sockaddr_in*)(info->ai_addr))->sin_addr.s_addr;
-		lock.acquire(&mutexFreeaddrinfo);
 		freeaddrinfo(info);
-		lock.release();
-		return Host(__inet_ntoa(address));
+		return (addresses.size() > 0);
 	}
 
 	Host PlatformSocket::resolveIp(Host ip)
@@ -681,7 +1384,6 @@ namespace sakit
 		address.sin_family = FAMILY_CONNECT_INET;
 		__inet_pton(address.sin_family, ip.toString().cStr(), &address.sin_addr);
 		char hostName[NI_MAXHOST] = {'\0'};
-		hmutex::ScopeLock lock(&mutexGetnameinfo);
 		int result = getnameinfo((sockaddr*)&address, sizeof(address), hostName, sizeof(hostName), NULL, 0, NI_NUMERICHOST);
 		if (result != 0)
 		{
@@ -697,16 +1399,13 @@ namespace sakit
 		addrinfo* info;
 		memset(&hints, 0, sizeof(hints));
 		hints.ai_family = FAMILY_CONNECT_INET;
-		hmutex::ScopeLock lock(&mutexGetaddrinfo);
 		int result = getaddrinfo(NULL, serviceName.cStr(), &hints, &info);
 		if (result != 0)
 		{
 			hlog::error(logTag, __gai_strerror(result));
 			return 0;
 		}
-		lock.release();
 		unsigned short port = ((sockaddr_in*)(info->ai_addr))->sin_port;
-		lock.acquire(&mutexFreeaddrinfo);
 		freeaddrinfo(info);
 		return port;
 	}
@@ -805,11 +1504,11 @@ namespace sakit
 					family = ifa->ifa_addr->sa_family;
 					if (family == AF_INET)// || family == AF_INET6) // sakit only supports IPV4 for now
 					{
-						host = __inet_ntoa(((sockaddr_in*)ifa->ifa_addr)->sin_addr);
-						mask = __inet_ntoa(((sockaddr_in*)ifa->ifa_netmask)->sin_addr);
+						host = Host((const unsigned char*)&((sockaddr_in*)ifa->ifa_addr)->sin_addr, 4);
+						mask = Host((const unsigned char*)&((sockaddr_in*)ifa->ifa_netmask)->sin_addr, 4);
 						if (ifa->ifa_dstaddr != NULL)
 						{
-							gateway = __inet_ntoa(((sockaddr_in*)ifa->ifa_dstaddr)->sin_addr);
+							gateway = Host((const unsigned char*)&((sockaddr_in*)ifa->ifa_dstaddr)->sin_addr, 4);
 						}
 						else // when it's localhost, gateway can be NULL
 						{
@@ -42,6 +42,9 @@ namespace sakit
 		connected(false),
 		connectionLess(false),
 		serverMode(false),
+		resolveDuration(0LL),
+		tlsEnabled(false),
+		tlsVerifyingPeer(true),
 		_receiveStream(this->bufferSize)
 	{
 		this->sSock = nullptr;
@@ -149,6 +152,11 @@ namespace sakit
 	{
 		// TODOsock - assign local host/port if possible
 		// TODOsock - implement usage of timeout and retryFrequency in this method
+		if (this->tlsEnabled)
+		{
+			hlog::error(logTag, "TLS is not supported on WinRT!");
+			return false;
+		}
 		if (!this->tryCreateSocket())
 		{
 			return false;
@@ -208,6 +216,36 @@ namespace sakit
 		return _asyncResult;
 	}
 
+	bool PlatformSocket::startConnect(Host remoteHost, unsigned short remotePort)
+	{
+		// WinRT sockets only provide an awaited connect so it is already finished here
+		Host localHost;
+		unsigned short localPort = 0;
+		return this->connect(remoteHost, remotePort, localHost, localPort, sakit::getGlobalTimeout(), sakit::getGlobalRetryFrequency());
+	}
+
+	bool PlatformSocket::pollConnect(bool& finished, Host& localHost, unsigned short& localPort)
+	{
+		finished = this->connected;
+		return this->connected;
+	}
+
+	bool PlatformSocket::checkRemoteClosed()
+	{
+		return !this->connected;
+	}
+
+	bool PlatformSocket::isTlsResumed() const
+	{
+		return false;
+	}
+
+	bool PlatformSocket::setTlsCertificate(chstr certificateFilename, chstr privateKeyFilename)
+	{
+		hlog::error(logTag, "TLS is not supported on WinRT!");
+		return false;
+	}
+
 	bool PlatformSocket::_setUdpHost(HostName^ hostName, unsigned short remotePort)
 	{
 		// open socket
@@ -414,16 +452,28 @@ namespace sakit
 	}
 
 	bool PlatformSocket::send(hstream* stream, int& count, int& sent)
+	{
+		int size = hmin((int)(stream->size() - stream->position()), count);
+		int sentCount = 0;
+		if (!this->send((const char*)&(*stream)[(int)stream->position()], size, sentCount))
+		{
+			return false;
+		}
+		stream->seek(sentCount);
+		sent += sentCount;
+		count -= sentCount;
+		return true;
+	}
+
+	bool PlatformSocket::send(const char* data, int& count, int& sent)
 	{
 		bool _asyncResult = false;
 		State _asyncState = State::Running;
 		hmutex _mutex;
 		hmutex::ScopeLock _lock;
 		int _asyncResultSize = 0;
-		unsigned char* data = (unsigned char*)&(*stream)[(int)stream->position()];
-		int size = hmin((int)(stream->size() - stream->position()), count);
 		DataWriter^ writer = ref new DataWriter();
-		writer->WriteBytes(ref new Platform::Array<unsigned char>(data, size));
+		writer->WriteBytes(ref new Platform::Array<unsigned char>((unsigned char*)data, count));
 		IAsyncOperationWithProgress<unsigned int, unsigned int>^ operation = nullptr;
 		try
 		{
@@ -463,7 +513,6 @@ namespace sakit
 		}
 		if (_asyncResultSize > 0)
 		{
-			stream->seek(_asyncResultSize);
 			sent += _asyncResultSize;
 			count -= _asyncResultSize;
 			return true;
@@ -471,6 +520,16 @@ namespace sakit
 		return _asyncResult;
 	}
 
+	bool PlatformSocket::sendFile(int fileDescriptor, int64_t& offset, int64_t& count, int64_t& sent)
+	{
+		return this->_sendFileBuffered(fileDescriptor, offset, count, sent);
+	}
+
+	bool PlatformSocket::sendFileNonBlocking(int fileDescriptor, int64_t& offset, int64_t& count, int64_t& sent)
+	{
+		return this->_sendFileBuffered(fileDescriptor, offset, count, sent);
+	}
+
 	bool PlatformSocket::receive(hstream* stream, int& maxCount, hmutex* mutex)
 	{
 		if (this->sSock != nullptr)
@@ -646,7 +705,19 @@ namespace sakit
 		return Host(PlatformSocket::_resolve(domain.toString(), "0", true, false));
 	}
 
-	Host PlatformSocket::resolveIp(Host ip)
+	bool PlatformSocket::lookupHost(chstr hostname, harray<Host>& addresses)
+	{
+		// only the first address is available here
+		hstr address = PlatformSocket::_resolve(hostname, "0", true, false);
+		if (address == "")
+		{
+			return false;
+		}
+		addresses += Host(address);
+		return true;
+	}
+
+		Host PlatformSocket::resolveIp(Host ip)
 	{
 		// wow, Microsoft, just wow
 		hlog::warn(logTag, "WinRT does not support resolving an IP address to a host name. Attempting anyway, but don't count on it.");
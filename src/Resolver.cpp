@@ -0,0 +1,231 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#include <hltypes/harray.h>
+#include <hltypes/hlog.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hstring.h>
+#include <hltypes/hthread.h>
+
+#include "Host.h"
+#include "PlatformSocket.h"
+#include "Resolver.h"
+#include "sakit.h"
+
+namespace sakit
+{
+	extern float retryFrequency;
+
+	float Resolver::CacheTtl = 60.0f;
+	float Resolver::NegativeCacheTtl = 5.0f;
+	hmap<hstr, Resolver::Entry*> Resolver::entries;
+	harray<hstr> Resolver::queuedHostnames;
+	harray<hthread*> Resolver::threads;
+	harray<hthread*> Resolver::finishedThreads;
+	hmutex Resolver::mutex;
+	bool (*Resolver::lookupFunction)(chstr hostname, harray<Host>& addresses) = NULL;
+
+	Resolver::Entry::Entry() :
+		finished(false),
+		failed(false),
+		expirationTime(0LL)
+	{
+	}
+
+	void Resolver::prefetch(chstr hostname)
+	{
+		if (hostname == "" || Host(hostname).isIp())
+		{
+			return;
+		}
+		hmutex::ScopeLock lock(&Resolver::mutex);
+		Resolver::_request(hostname);
+	}
+
+	bool Resolver::poll(chstr hostname, harray<Host>& addresses, bool& finished)
+	{
+		addresses.clear();
+		finished = false;
+		if (Host(hostname).isIp())
+		{
+			// nothing to look up
+			addresses += Host(hostname);
+			finished = true;
+			return true;
+		}
+		hmutex::ScopeLock lock(&Resolver::mutex);
+		Entry* entry = Resolver::_request(hostname);
+		if (!entry->finished)
+		{
+			return true;
+		}
+		finished = true;
+		if (entry->failed)
+		{
+			return false;
+		}
+		addresses = entry->addresses;
+		return true;
+	}
+
+	bool Resolver::resolve(chstr hostname, harray<Host>& addresses, float timeout)
+	{
+		bool finished = false;
+		float time = 0.0f;
+		while (true)
+		{
+			if (!Resolver::poll(hostname, addresses, finished))
+			{
+				return false;
+			}
+			if (finished)
+			{
+				return true;
+			}
+			time += retryFrequency;
+			if (time >= timeout)
+			{
+				hlog::error(logTag, "Unable to resolve '" + hostname + "', timed out.");
+				return false;
+			}
+			hthread::sleep(retryFrequency * 1000.0f);
+		}
+		return false;
+	}
+
+	Host Resolver::getPreferredAddress(const harray<Host>& addresses)
+	{
+		foreachc (Host, it, addresses)
+		{
+			if ((*it).isIpv4())
+			{
+				return (*it);
+			}
+		}
+		return (addresses.size() > 0 ? addresses[0] : Host());
+	}
+
+	void Resolver::setLookupFunction(bool (*function)(chstr hostname, harray<Host>& addresses))
+	{
+		hmutex::ScopeLock lock(&Resolver::mutex);
+		Resolver::lookupFunction = function;
+	}
+
+	void Resolver::clearCache()
+	{
+		hmutex::ScopeLock lock(&Resolver::mutex);
+		harray<hstr> hostnames = Resolver::entries.keys();
+		Entry* entry = NULL;
+		foreach (hstr, it, hostnames)
+		{
+			entry = Resolver::entries[*it];
+			if (entry->finished)
+			{
+				Resolver::entries.removeKey(*it);
+				delete entry;
+			}
+		}
+	}
+
+	void Resolver::destroy()
+	{
+		hmutex::ScopeLock lock(&Resolver::mutex);
+		// lookups that haven't started yet are dropped
+		Resolver::queuedHostnames.clear();
+		while (Resolver::threads.size() > 0)
+		{
+			lock.release();
+			hthread::sleep(retryFrequency * 1000.0f);
+			lock.acquire(&Resolver::mutex);
+		}
+		Resolver::_joinFinishedThreads();
+		foreach_m (Entry*, it, Resolver::entries)
+		{
+			delete it->second;
+		}
+		Resolver::entries.clear();
+	}
+
+	Resolver::Entry* Resolver::_request(chstr hostname)
+	{
+		Entry* entry = Resolver::entries.tryGet(hostname, NULL);
+		if (entry == NULL)
+		{
+			entry = new Entry();
+			Resolver::entries[hostname] = entry;
+		}
+		else if (!entry->finished || htickCount() < entry->expirationTime)
+		{
+			return entry;
+		}
+		// expired entries are looked up again
+		entry->finished = false;
+		entry->failed = false;
+		entry->addresses.clear();
+		Resolver::queuedHostnames += hostname;
+		Resolver::_joinFinishedThreads();
+		if (Resolver::threads.size() < SAKIT_RESOLVER_MAX_THREADS)
+		{
+			hthread* thread = new hthread(&Resolver::_process, "SAKit resolver");
+			Resolver::threads += thread;
+			thread->start();
+		}
+		return entry;
+	}
+
+	void Resolver::_joinFinishedThreads()
+	{
+		// these don't access anything protected by the mutex anymore so they can be joined while it's locked
+		foreach (hthread*, it, Resolver::finishedThreads)
+		{
+			(*it)->join();
+			delete (*it);
+		}
+		Resolver::finishedThreads.clear();
+	}
+
+	void Resolver::_process(hthread* thread)
+	{
+		hmutex::ScopeLock lock;
+		hstr hostname;
+		harray<Host> addresses;
+		bool success = false;
+		Entry* entry = NULL;
+		bool (*function)(chstr hostname, harray<Host>& addresses) = NULL;
+		while (true)
+		{
+			lock.acquire(&Resolver::mutex);
+			if (Resolver::queuedHostnames.size() == 0)
+			{
+				break;
+			}
+			hostname = Resolver::queuedHostnames.removeFirst();
+			function = Resolver::lookupFunction;
+			lock.release();
+			addresses.clear();
+			success = (function != NULL ? (*function)(hostname, addresses) : PlatformSocket::lookupHost(hostname, addresses));
+			lock.acquire(&Resolver::mutex);
+			entry = Resolver::entries.tryGet(hostname, NULL);
+			// the entry could have been removed by destroy() in the meantime
+			if (entry != NULL)
+			{
+				entry->addresses = addresses;
+				entry->failed = (!success || addresses.size() == 0);
+				entry->finished = true;
+				entry->expirationTime = htickCount() + (int64_t)((entry->failed ? Resolver::NegativeCacheTtl : Resolver::CacheTtl) * 1000.0f);
+			}
+			lock.release();
+		}
+		// the thread ends while still holding the lock so no new work can be queued for it
+		Resolver::threads -= thread;
+		Resolver::finishedThreads += thread;
+	}
+
+}
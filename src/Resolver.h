@@ -0,0 +1,89 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a resolver that looks up host names in the background and caches the results.
+
+#ifndef SAKIT_RESOLVER_H
+#define SAKIT_RESOLVER_H
+
+#include <hltypes/harray.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hstring.h>
+#include <hltypes/hthread.h>
+
+#include "Host.h"
+
+#define SAKIT_RESOLVER_MAX_THREADS 4
+
+namespace sakit
+{
+	/// @brief Runs lookups on a small pool of threads so a slow DNS server only delays the sockets that actually wait for that name.
+	/// @note Concurrent requests for the same name share a single lookup.
+	class Resolver
+	{
+	public:
+		/// @note In seconds. The system resolver doesn't report the TTL of records so successful lookups are cached for this long.
+		static float CacheTtl;
+		/// @note In seconds. Failed lookups are cached for this long so an unknown name isn't looked up again by every request.
+		static float NegativeCacheTtl;
+
+		/// @brief Starts a lookup in the background if there is no cached result yet.
+		static void prefetch(chstr hostname);
+		/// @brief Starts a lookup if necessary without waiting for it.
+		/// @return False if the lookup failed. If finished is false, the lookup is still running and addresses is empty.
+		static bool poll(chstr hostname, harray<Host>& addresses, bool& finished);
+		/// @brief Waits until the lookup has finished.
+		/// @note Other lookups keep running while this one is waited for.
+		static bool resolve(chstr hostname, harray<Host>& addresses, float timeout);
+		/// @return The address to use when only a single one can be tried.
+		/// @note IPv4 is preferred since broadcasting and multicasting only work with IPv4.
+		static Host getPreferredAddress(const harray<Host>& addresses);
+		/// @note NULL uses the system resolver.
+		static void setLookupFunction(bool (*function)(chstr hostname, harray<Host>& addresses));
+		/// @note Lookups that are still running are kept.
+		static void clearCache();
+		/// @brief Waits for all running lookups and removes all cached results.
+		static void destroy();
+
+	protected:
+		class Entry
+		{
+		public:
+			harray<Host> addresses;
+			bool finished;
+			bool failed;
+			int64_t expirationTime;
+
+			Entry();
+
+		};
+
+		/// @note Protected by mutex, just like all entries and both thread lists.
+		static hmap<hstr, Entry*> entries;
+		static harray<hstr> queuedHostnames;
+		static harray<hthread*> threads;
+		/// @note Threads that ran out of work and have to be joined.
+		static harray<hthread*> finishedThreads;
+		static hmutex mutex;
+		static bool (*lookupFunction)(chstr hostname, harray<Host>& addresses);
+
+		/// @brief Returns the entry of the host name and queues a lookup if there is no valid entry.
+		/// @note Has to be called while mutex is locked.
+		static Entry* _request(chstr hostname);
+		/// @note Has to be called while mutex is locked.
+		static void _joinFinishedThreads();
+
+		static void _process(hthread* thread);
+
+	};
+
+}
+#endif
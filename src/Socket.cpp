@@ -118,23 +118,52 @@ namespace sakit
 		return this->sendAsync(&stream, (int)stream.size());
 	}
 
+	int Socket::send(const char* data, int count)
+	{
+		if (data == NULL || count <= 0)
+		{
+			hlog::warn(logTag, "Cannot send, no data to send!");
+			return 0;
+		}
+		if (!this->_prepareSend())
+		{
+			return 0;
+		}
+		int result = this->_sendDirect(data, count);
+		this->_finishSend();
+		return result;
+	}
+
 	int Socket::_send(hstream* stream, int count)
 	{
 		if (!this->_checkSendParameters(stream, count))
 		{
 			return false;
 		}
+		if (!this->_prepareSend())
+		{
+			return false;
+		}
+		int result = this->_sendDirect(stream, count);
+		this->_finishSend();
+		return result;
+	}
+
+	bool Socket::_prepareSend()
+	{
 		hmutex::ScopeLock lock(&this->mutexState);
 		if (!this->_canSend(this->state))
 		{
 			return false;
 		}
 		this->state = (this->state == State::Receiving ? State::SendingReceiving : State::Sending);
-		lock.release();
-		int result = this->_sendDirect(stream, count);
-		lock.acquire(&this->mutexState);
+		return true;
+	}
+
+	void Socket::_finishSend()
+	{
+		hmutex::ScopeLock lock(&this->mutexState);
 		this->state = (this->state == State::SendingReceiving ? State::Receiving : this->idleState);
-		return result;
 	}
 
 	bool Socket::sendAsync(hstream* stream, int count)
@@ -39,6 +39,7 @@ namespace sakit
 		harray<State> State::allowedServerStartStates;
 		harray<State> State::allowedServerStopStates;
 		harray<State> State::allowedHttpExecuteStates;
+		harray<State> State::allowedHttpExecutePipelinedStates;
 		harray<State> State::allowedHttpAbortStates;
 
 	));
@@ -24,7 +24,7 @@ namespace sakit
 	TcpServer::TcpServer(TcpServerDelegate* tcpServerDelegate, TcpSocketDelegate* acceptedDelegate) :
 		Server(dynamic_cast<ServerDelegate*>(tcpServerDelegate))
 	{
-		this->serverThread = this->tcpServerThread = new TcpServerThread(this->socket, this->acceptedDelegate, &this->timeout, &this->retryFrequency);
+		this->serverThread = this->tcpServerThread = new TcpServerThread(this->socket, acceptedDelegate, &this->timeout, &this->retryFrequency);
 		this->tcpServerDelegate = tcpServerDelegate;
 		this->acceptedDelegate = acceptedDelegate;
 		this->socket->setConnectionLess(false);
@@ -46,6 +46,16 @@ namespace sakit
 		return this->sockets;
 	}
 
+	bool TcpServer::isTlsEnabled() const
+	{
+		return this->socket->isTlsEnabled();
+	}
+
+	bool TcpServer::setTlsCertificate(chstr certificateFilename, chstr privateKeyFilename)
+	{
+		return this->socket->setTlsCertificate(certificateFilename, privateKeyFilename);
+	}
+
 	void TcpServer::update(float timeDelta)
 	{
 		foreach (TcpSocket*, it, this->sockets)
@@ -68,6 +78,7 @@ namespace sakit
 		lock.release();
 		foreach (TcpSocket*, it, sockets)
 		{
+			this->_onAccepted(*it);
 			this->tcpServerDelegate->onAccepted(this, (*it));
 		}
 		Server::update(timeDelta);
@@ -100,6 +111,7 @@ namespace sakit
 			if (this->socket->accept(tcpSocket))
 			{
 				this->sockets += tcpSocket;
+				this->_onAccepted(tcpSocket);
 				break;
 			}
 			time += this->retryFrequency;
@@ -116,6 +128,10 @@ namespace sakit
 		return tcpSocket;
 	}
 
+	void TcpServer::_onAccepted(TcpSocket* socket)
+	{
+	}
+
 	void TcpServer::_updateSockets()
 	{
 		harray<TcpSocket*> sockets = this->sockets;
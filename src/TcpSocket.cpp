@@ -43,6 +43,72 @@ namespace sakit
 		return this->socket->setNagleAlgorithmActive(value);
 	}
 
+	bool TcpSocket::isTlsEnabled() const
+	{
+		return this->socket->isTlsEnabled();
+	}
+
+	void TcpSocket::setTlsEnabled(bool value, chstr serverName)
+	{
+		this->socket->setTlsEnabled(value, serverName);
+	}
+
+	bool TcpSocket::isTlsVerifyingPeer() const
+	{
+		return this->socket->isTlsVerifyingPeer();
+	}
+
+	void TcpSocket::setTlsVerifyingPeer(bool value)
+	{
+		this->socket->setTlsVerifyingPeer(value);
+	}
+
+	bool TcpSocket::isTlsResumed() const
+	{
+		return this->socket->isTlsResumed();
+	}
+
+	int64_t TcpSocket::sendFile(chstr filename, int64_t offset, int64_t count)
+	{
+		if (offset < 0 || count <= 0)
+		{
+			hlog::warn(logTag, "Cannot send file, invalid range!");
+			return 0;
+		}
+		if (!this->_prepareSend())
+		{
+			return 0;
+		}
+		int64_t result = this->_sendFileDirect(filename, offset, count);
+		this->_finishSend();
+		return result;
+	}
+
+	int64_t TcpSocket::sendFileNonBlocking(chstr filename, int64_t offset, int64_t count)
+	{
+		if (offset < 0 || count <= 0)
+		{
+			hlog::warn(logTag, "Cannot send file, invalid range!");
+			return 0;
+		}
+		if (!this->_prepareSend())
+		{
+			return -1;
+		}
+		int fileDescriptor = PlatformSocket::openFile(filename);
+		if (fileDescriptor < 0)
+		{
+			hlog::error(logTag, "Could not open file for sending: " + filename);
+			this->_finishSend();
+			return -1;
+		}
+		int64_t sent = 0;
+		bool result = this->socket->sendFileNonBlocking(fileDescriptor, offset, count, sent);
+		PlatformSocket::closeFile(fileDescriptor);
+		this->_finishSend();
+		return (result || sent > 0 ? sent : -1);
+	}
+
 	void TcpSocket::update(float timeDelta)
 	{
 		Socket::update(timeDelta);
@@ -0,0 +1,481 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+
+#ifdef _OPENSSL
+#ifdef _WIN32
+#include <winsock2.h>
+#else
+#include <sys/select.h>
+#include <sys/time.h>
+#endif
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <openssl/x509v3.h>
+
+#include <hltypes/hlog.h>
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hstring.h>
+
+#include "Host.h"
+#include "sakit.h"
+#include "TlsSession.h"
+
+namespace sakit
+{
+	bool TlsSession::KernelOffload = false;
+	SSL_CTX* TlsSession::clientContext = NULL;
+	hstr TlsSession::certificateAuthorityFile;
+	hmap<hstr, SSL_SESSION*> TlsSession::sessions;
+	hmap<hstr, SSL_CTX*> TlsSession::serverContexts;
+	hmutex TlsSession::mutex;
+
+	TlsSession::TlsSession(unsigned int sock, chstr serverName, chstr cacheKey, bool verifyingPeer, chstr applicationProtocol) :
+		ssl(NULL),
+		connected(false),
+		waitingForWrite(false)
+	{
+		this->cacheKey = cacheKey;
+		hmutex::ScopeLock lock(&TlsSession::mutex);
+		SSL_CTX* context = TlsSession::_getClientContext();
+		if (context == NULL)
+		{
+			return;
+		}
+		this->ssl = SSL_new(context);
+		if (this->ssl == NULL)
+		{
+			TlsSession::_printErrors("SSL_new()");
+			return;
+		}
+		SSL_set_app_data(this->ssl, this);
+		if (this->cacheKey != "")
+		{
+			SSL_SESSION* session = TlsSession::sessions.tryGet(this->cacheKey, NULL);
+			if (session != NULL)
+			{
+				SSL_set_session(this->ssl, session);
+			}
+		}
+		lock.release();
+		SSL_set_fd(this->ssl, (int)sock);
+		SSL_set_mode(this->ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef SAKIT_KTLS
+		if (TlsSession::KernelOffload)
+		{
+			SSL_set_options(this->ssl, SSL_OP_ENABLE_KTLS);
+		}
+#endif
+		if (serverName != "")
+		{
+			if (!Host(serverName).isIp())
+			{
+				SSL_set_tlsext_host_name(this->ssl, serverName.cStr());
+				SSL_set1_host(this->ssl, serverName.cStr());
+			}
+			else
+			{
+				X509_VERIFY_PARAM_set1_ip_asc(SSL_get0_param(this->ssl), serverName.cStr());
+			}
+		}
+		SSL_set_verify(this->ssl, (verifyingPeer ? SSL_VERIFY_PEER : SSL_VERIFY_NONE), NULL);
+		if (applicationProtocol != "")
+		{
+			// ALPN expects a list of length-prefixed names
+			hstr protocols = hstr((char)applicationProtocol.size()) + applicationProtocol;
+			SSL_set_alpn_protos(this->ssl, (const unsigned char*)protocols.cStr(), (unsigned int)protocols.size());
+		}
+		SSL_set_connect_state(this->ssl);
+	}
+
+	TlsSession::TlsSession(unsigned int sock, chstr certificateFilename, chstr privateKeyFilename) :
+		ssl(NULL),
+		connected(false),
+		waitingForWrite(false)
+	{
+		hmutex::ScopeLock lock(&TlsSession::mutex);
+		SSL_CTX* context = TlsSession::_getServerContext(certificateFilename, privateKeyFilename);
+		if (context == NULL)
+		{
+			return;
+		}
+		this->ssl = SSL_new(context);
+		lock.release();
+		if (this->ssl == NULL)
+		{
+			TlsSession::_printErrors("SSL_new()");
+			return;
+		}
+		SSL_set_app_data(this->ssl, this);
+		SSL_set_fd(this->ssl, (int)sock);
+		SSL_set_mode(this->ssl, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+#ifdef SAKIT_KTLS
+		if (TlsSession::KernelOffload)
+		{
+			SSL_set_options(this->ssl, SSL_OP_ENABLE_KTLS);
+		}
+#endif
+		SSL_set_accept_state(this->ssl);
+	}
+
+	TlsSession::~TlsSession()
+	{
+		if (this->ssl != NULL)
+		{
+			SSL_free(this->ssl);
+		}
+	}
+
+	bool TlsSession::isResumed() const
+	{
+		return (this->ssl != NULL && SSL_session_reused(this->ssl) != 0);
+	}
+
+	bool TlsSession::isKernelSendActive() const
+	{
+#ifdef SAKIT_KTLS
+		return (this->ssl != NULL && this->connected && BIO_get_ktls_send(SSL_get_wbio(this->ssl)) != 0);
+#else
+		return false;
+#endif
+	}
+
+	bool TlsSession::isRemoteClosed() const
+	{
+		return (this->ssl == NULL || (SSL_get_shutdown(this->ssl) & SSL_RECEIVED_SHUTDOWN) != 0);
+	}
+
+	bool TlsSession::hasPendingData() const
+	{
+		return (this->ssl != NULL && SSL_pending(this->ssl) > 0);
+	}
+
+	hstr TlsSession::getApplicationProtocol() const
+	{
+		if (this->ssl == NULL)
+		{
+			return "";
+		}
+		const unsigned char* data = NULL;
+		unsigned int size = 0;
+		SSL_get0_alpn_selected(this->ssl, &data, &size);
+		return (data != NULL ? hstr((const char*)data, (int)size) : hstr());
+	}
+
+	bool TlsSession::handshake()
+	{
+		if (this->ssl == NULL)
+		{
+			return false;
+		}
+		hmutex::ScopeLock lock(&this->sslMutex);
+		return this->_continueHandshake();
+	}
+
+	bool TlsSession::handshake(float timeout)
+	{
+		if (this->ssl == NULL)
+		{
+			return false;
+		}
+		hmutex::ScopeLock lock(&this->sslMutex);
+		int sock = SSL_get_fd(this->ssl);
+		int64_t timeoutTime = htickCount() + (int64_t)(timeout * 1000.0f);
+		int64_t waitTime = 0LL;
+		timeval interval = {0, 0};
+		fd_set readSet;
+		fd_set writeSet;
+		while (true)
+		{
+			if (!this->_continueHandshake())
+			{
+				return false;
+			}
+			if (this->connected)
+			{
+				return true;
+			}
+			waitTime = timeoutTime - htickCount();
+			if (waitTime <= 0LL)
+			{
+				hlog::error(logTag, "Unable to finish the TLS handshake, timed out.");
+				return false;
+			}
+			interval.tv_sec = (long)(waitTime / 1000);
+			interval.tv_usec = (long)((waitTime % 1000) * 1000);
+			FD_ZERO(&readSet);
+			FD_ZERO(&writeSet);
+			FD_SET(sock, (this->waitingForWrite ? &writeSet : &readSet));
+			if (select(sock + 1, &readSet, &writeSet, NULL, &interval) < 0)
+			{
+				hlog::error(logTag, "Unable to finish the TLS handshake, select() failed.");
+				return false;
+			}
+		}
+	}
+
+	bool TlsSession::_continueHandshake()
+	{
+		if (this->connected)
+		{
+			return true;
+		}
+		int result = SSL_do_handshake(this->ssl);
+		if (result == 1)
+		{
+			this->connected = true;
+			return true;
+		}
+		if (this->_checkResult(result, "SSL_do_handshake()"))
+		{
+			return true;
+		}
+		long verifyResult = SSL_get_verify_result(this->ssl);
+		if (verifyResult != X509_V_OK)
+		{
+			hlog::error(logTag, "TLS certificate verification failed: " + hstr(X509_verify_cert_error_string(verifyResult)));
+		}
+		// a session that failed once isn't offered again
+		if (this->cacheKey != "")
+		{
+			hmutex::ScopeLock lockSessions(&TlsSession::mutex);
+			SSL_SESSION* session = TlsSession::sessions.tryGet(this->cacheKey, NULL);
+			if (session != NULL)
+			{
+				SSL_SESSION_free(session);
+				TlsSession::sessions.removeKey(this->cacheKey);
+			}
+		}
+		return false;
+	}
+
+	int TlsSession::send(const char* data, int size)
+	{
+		if (this->ssl == NULL)
+		{
+			return -1;
+		}
+		if (size <= 0)
+		{
+			return 0;
+		}
+		hmutex::ScopeLock lock(&this->sslMutex);
+		int result = SSL_write(this->ssl, data, size);
+		if (result > 0)
+		{
+			return result;
+		}
+		return (this->_checkResult(result, "SSL_write()") ? 0 : -1);
+	}
+
+	int TlsSession::receive(char* data, int size)
+	{
+		if (this->ssl == NULL)
+		{
+			return -1;
+		}
+		hmutex::ScopeLock lock(&this->sslMutex);
+		int result = SSL_read(this->ssl, data, size);
+		if (result > 0)
+		{
+			return result;
+		}
+		// a closed connection simply has nothing left to receive
+		if (SSL_get_error(this->ssl, result) == SSL_ERROR_ZERO_RETURN)
+		{
+			return 0;
+		}
+		return (this->_checkResult(result, "SSL_read()") ? 0 : -1);
+	}
+
+	int64_t TlsSession::sendFile(int fileDescriptor, int64_t offset, int64_t size)
+	{
+#ifdef SAKIT_KTLS
+		hmutex::ScopeLock lock(&this->sslMutex);
+		ossl_ssize_t result = SSL_sendfile(this->ssl, fileDescriptor, (off_t)offset, (size_t)size, 0);
+		if (result < 0)
+		{
+			return (this->_checkResult((int)result, "SSL_sendfile()") ? 0 : -1);
+		}
+		this->waitingForWrite = false;
+		return (int64_t)result;
+#else
+		hlog::error(logTag, "Kernel TLS is not available!");
+		return -1;
+#endif
+	}
+
+	void TlsSession::shutdown()
+	{
+		hmutex::ScopeLock lock(&this->sslMutex);
+		if (this->ssl != NULL && this->connected)
+		{
+			SSL_shutdown(this->ssl);
+		}
+		this->connected = false;
+	}
+
+	bool TlsSession::_checkResult(int result, chstr functionName)
+	{
+		int error = SSL_get_error(this->ssl, result);
+		if (error == SSL_ERROR_WANT_READ || error == SSL_ERROR_WANT_WRITE)
+		{
+			this->waitingForWrite = (error == SSL_ERROR_WANT_WRITE);
+			ERR_clear_error();
+			return true;
+		}
+		TlsSession::_printErrors(functionName);
+		return false;
+	}
+
+	hstr TlsSession::getCertificateAuthorityFile()
+	{
+		hmutex::ScopeLock lock(&TlsSession::mutex);
+		return TlsSession::certificateAuthorityFile;
+	}
+
+	void TlsSession::setCertificateAuthorityFile(chstr value)
+	{
+		hmutex::ScopeLock lock(&TlsSession::mutex);
+		TlsSession::certificateAuthorityFile = value;
+		// recreated with the new certificates when it's needed the next time, existing sessions keep a reference to the old one
+		if (TlsSession::clientContext != NULL)
+		{
+			SSL_CTX_free(TlsSession::clientContext);
+			TlsSession::clientContext = NULL;
+		}
+	}
+
+	bool TlsSession::loadServerCertificate(chstr certificateFilename, chstr privateKeyFilename)
+	{
+		hmutex::ScopeLock lock(&TlsSession::mutex);
+		return (TlsSession::_getServerContext(certificateFilename, privateKeyFilename) != NULL);
+	}
+
+	void TlsSession::clearSessionCache()
+	{
+		hmutex::ScopeLock lock(&TlsSession::mutex);
+		foreach_m (SSL_SESSION*, it, TlsSession::sessions)
+		{
+			SSL_SESSION_free(it->second);
+		}
+		TlsSession::sessions.clear();
+	}
+
+	void TlsSession::destroy()
+	{
+		TlsSession::clearSessionCache();
+		hmutex::ScopeLock lock(&TlsSession::mutex);
+		if (TlsSession::clientContext != NULL)
+		{
+			SSL_CTX_free(TlsSession::clientContext);
+			TlsSession::clientContext = NULL;
+		}
+		foreach_m (SSL_CTX*, it, TlsSession::serverContexts)
+		{
+			SSL_CTX_free(it->second);
+		}
+		TlsSession::serverContexts.clear();
+	}
+
+	SSL_CTX* TlsSession::_getClientContext()
+	{
+		if (TlsSession::clientContext != NULL)
+		{
+			return TlsSession::clientContext;
+		}
+		SSL_CTX* context = SSL_CTX_new(TLS_client_method());
+		if (context == NULL)
+		{
+			TlsSession::_printErrors("SSL_CTX_new()");
+			return NULL;
+		}
+		SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+		SSL_CTX_set_default_verify_paths(context);
+		if (TlsSession::certificateAuthorityFile != "" && SSL_CTX_load_verify_locations(context, TlsSession::certificateAuthorityFile.cStr(), NULL) != 1)
+		{
+			TlsSession::_printErrors("SSL_CTX_load_verify_locations()");
+		}
+		// sessions are only kept in the cache here so they can be looked up by server instead of by session ID
+		SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+		SSL_CTX_sess_set_new_cb(context, &TlsSession::_onNewSession);
+		TlsSession::clientContext = context;
+		return context;
+	}
+
+	SSL_CTX* TlsSession::_getServerContext(chstr certificateFilename, chstr privateKeyFilename)
+	{
+		hstr key = certificateFilename + "\n" + privateKeyFilename;
+		SSL_CTX* context = TlsSession::serverContexts.tryGet(key, NULL);
+		if (context != NULL)
+		{
+			return context;
+		}
+		context = SSL_CTX_new(TLS_server_method());
+		if (context == NULL)
+		{
+			TlsSession::_printErrors("SSL_CTX_new()");
+			return NULL;
+		}
+		SSL_CTX_set_min_proto_version(context, TLS1_2_VERSION);
+		if (SSL_CTX_use_certificate_chain_file(context, certificateFilename.cStr()) != 1)
+		{
+			TlsSession::_printErrors("SSL_CTX_use_certificate_chain_file()");
+			SSL_CTX_free(context);
+			return NULL;
+		}
+		if (SSL_CTX_use_PrivateKey_file(context, privateKeyFilename.cStr(), SSL_FILETYPE_PEM) != 1 || SSL_CTX_check_private_key(context) != 1)
+		{
+			TlsSession::_printErrors("SSL_CTX_use_PrivateKey_file()");
+			SSL_CTX_free(context);
+			return NULL;
+		}
+		// the internal cache and the session ticket keys belong to the context, every server that uses it can resume the sessions of the others
+		SSL_CTX_set_session_cache_mode(context, SSL_SESS_CACHE_SERVER);
+		SSL_CTX_set_session_id_context(context, (const unsigned char*)"sakit", 5);
+		TlsSession::serverContexts[key] = context;
+		return context;
+	}
+
+	int TlsSession::_onNewSession(SSL* ssl, SSL_SESSION* session)
+	{
+		TlsSession* tlsSession = (TlsSession*)SSL_get_app_data(ssl);
+		if (tlsSession == NULL || tlsSession->cacheKey == "")
+		{
+			return 0;
+		}
+		hmutex::ScopeLock lock(&TlsSession::mutex);
+		SSL_SESSION* previous = TlsSession::sessions.tryGet(tlsSession->cacheKey, NULL);
+		if (previous != NULL)
+		{
+			SSL_SESSION_free(previous);
+		}
+		TlsSession::sessions[tlsSession->cacheKey] = session;
+		return 1; // the cache keeps the reference
+	}
+
+	void TlsSession::_printErrors(chstr functionName)
+	{
+		char message[256] = {'\0'};
+		unsigned long error = ERR_get_error();
+		if (error == 0)
+		{
+			hlog::error(logTag, functionName + " failed.");
+			return;
+		}
+		while (error != 0)
+		{
+			ERR_error_string_n(error, message, sizeof(message));
+			hlog::error(logTag, functionName + " " + hstr(message));
+			error = ERR_get_error();
+		}
+	}
+
+}
+#endif
@@ -0,0 +1,127 @@
+/// @file
+/// @version 1.2
+/// 
+/// @section LICENSE
+/// 
+/// This program is free software; you can redistribute it and/or modify it under
+/// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
+/// 
+/// @section DESCRIPTION
+/// 
+/// Defines a TLS session on top of a connected socket.
+
+#ifndef SAKIT_TLS_SESSION_H
+#define SAKIT_TLS_SESSION_H
+
+#ifdef _OPENSSL
+#include <openssl/ssl.h>
+
+#include <hltypes/hltypesUtil.h>
+#include <hltypes/hmap.h>
+#include <hltypes/hmutex.h>
+#include <hltypes/hstring.h>
+
+// kernel TLS is only available with OpenSSL 3.0 or newer that has been built with it
+#if OPENSSL_VERSION_NUMBER >= 0x30000000L && !defined(OPENSSL_NO_KTLS) && defined(SSL_OP_ENABLE_KTLS)
+#define SAKIT_KTLS
+#endif
+
+namespace sakit
+{
+	/// @brief Encrypts the data of a socket with OpenSSL.
+	/// @note The socket stays owned by the PlatformSocket, this only reads and writes through it. It has to be non-blocking for as long as the session exists.
+	/// @note All calls that use the connection are serialized so the sender and receiver threads of a socket can use it at the same time.
+	class TlsSession
+	{
+	public:
+		/// @param serverName Sent as SNI and checked against the certificate if it's a domain, otherwise the certificate has to match the IP.
+		/// @param cacheKey Identifies the server in the session cache, empty to always do a full handshake.
+		/// @param applicationProtocol Offered with ALPN, empty to not use ALPN.
+		TlsSession(unsigned int sock, chstr serverName, chstr cacheKey, bool verifyingPeer, chstr applicationProtocol);
+		/// @brief Creates the server side of an accepted connection.
+		/// @note The context is shared by all servers with the same certificate so they also share the session cache and the ticket keys.
+		TlsSession(unsigned int sock, chstr certificateFilename, chstr privateKeyFilename);
+		~TlsSession();
+
+		/// @return True if the handshake has finished.
+		HL_DEFINE_IS(connected, Connected);
+		/// @return True if the handshake is waiting until the socket can be written to rather than read from.
+		HL_DEFINE_IS(waitingForWrite, WaitingForWrite);
+		/// @return True if a cached session was resumed instead of doing a full handshake.
+		bool isResumed() const;
+		/// @return True if the kernel encrypts sent data so files can be sent without copying them into user space.
+		bool isKernelSendActive() const;
+		/// @return True if the other side has closed the TLS connection.
+		bool isRemoteClosed() const;
+		/// @return True if decrypted data can be read without touching the socket.
+		bool hasPendingData() const;
+		/// @return The protocol that was selected with ALPN.
+		hstr getApplicationProtocol() const;
+
+		/// @brief Continues the handshake on a non-blocking socket.
+		/// @return False if the handshake failed.
+		bool handshake();
+		/// @brief Drives the handshake until it has finished, waiting with select() whenever the socket isn't ready.
+		/// @param timeout In seconds.
+		/// @return False if the handshake failed or didn't finish in time.
+		/// @note The session stays locked the whole time so no other thread can use the connection before the handshake is done.
+		bool handshake(float timeout);
+		/// @return How many bytes have been sent, 0 if the socket would block and -1 on errors.
+		int send(const char* data, int size);
+		/// @return How many bytes have been received, 0 if nothing is available yet and -1 on errors.
+		int receive(char* data, int size);
+		/// @note Only possible if isKernelSendActive() is true.
+		/// @return How many bytes have been sent, 0 if the socket would block and -1 on errors.
+		int64_t sendFile(int fileDescriptor, int64_t offset, int64_t size);
+		/// @brief Tells the other side that the connection is being closed.
+		void shutdown();
+
+		/// @note Loaded in addition to the default certificate authorities of the system, e.g. for self-signed certificates.
+		static hstr getCertificateAuthorityFile();
+		static void setCertificateAuthorityFile(chstr value);
+		/// @note Has no effect if OpenSSL was built without kernel TLS.
+		static bool KernelOffload;
+
+		/// @brief Loads the certificate and private key for servers so errors are reported before any connection is accepted.
+		static bool loadServerCertificate(chstr certificateFilename, chstr privateKeyFilename);
+		static void clearSessionCache();
+		/// @brief Releases the shared context and all cached sessions.
+		static void destroy();
+
+	protected:
+		SSL* ssl;
+		hstr cacheKey;
+		bool connected;
+		bool waitingForWrite;
+		/// @note The sender and receiver threads of a socket can use the connection at the same time.
+		hmutex sslMutex;
+
+		/// @note Has to be called while sslMutex is locked.
+		bool _continueHandshake();
+		/// @return False if the error is not caused by a socket that would block.
+		bool _checkResult(int result, chstr functionName);
+
+		/// @note Protected by mutex, just like the session cache.
+		static SSL_CTX* clientContext;
+		static hstr certificateAuthorityFile;
+		/// @note Sessions are stored when the server sends them, which happens after the handshake with TLS 1.3.
+		static hmap<hstr, SSL_SESSION*> sessions;
+		/// @note Mapped by the certificate and private key files.
+		static hmap<hstr, SSL_CTX*> serverContexts;
+		static hmutex mutex;
+
+		/// @note Has to be called while mutex is locked.
+		static SSL_CTX* _getClientContext();
+		/// @note Has to be called while mutex is locked.
+		static SSL_CTX* _getServerContext(chstr certificateFilename, chstr privateKeyFilename);
+		static int _onNewSession(SSL* ssl, SSL_SESSION* session);
+		static void _printErrors(chstr functionName);
+
+	private:
+		TlsSession(const TlsSession& other); // prevents copying
+
+	};
+
+}
+#endif
+#endif
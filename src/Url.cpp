@@ -6,6 +6,8 @@
 /// This program is free software; you can redistribute it and/or modify it under
 /// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
 
+#include <string.h>
+
 #include <hltypes/harray.h>
 #include <hltypes/hdir.h>
 #include <hltypes/hlog.h>
@@ -25,19 +27,67 @@
 #define QUERY_ALLOWED PATH_ALLOWED "/?"
 #define FRAGMENT_ALLOWED QUERY_ALLOWED
 
+// bits in the charset lookup table
+#define CHARSET_HOST 0x1
+#define CHARSET_PATH 0x2
+#define CHARSET_QUERY 0x4
+#define CHARSET_FRAGMENT CHARSET_QUERY
+
 namespace sakit
 {
+	// generated from HOST_ALLOWED, PATH_ALLOWED and QUERY_ALLOWED so each character needs a single lookup instead of a search
+	static const unsigned char charsets[256] =
+	{
+		0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+		0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+		0x0, 0x7, 0x0, 0x0, 0x7, 0x0, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x4,
+		0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x6, 0x7, 0x0, 0x7, 0x0, 0x4,
+		0x6, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7,
+		0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x0, 0x0, 0x0, 0x0, 0x7,
+		0x0, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7,
+		0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x7, 0x0, 0x0, 0x0, 0x7, 0x0,
+		0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+		0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+		0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+		0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+		0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+		0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+		0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+		0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0, 0x0,
+	};
+
+	static const char hexDigits[] = "0123456789ABCDEF";
+
+	static inline int __hexValue(unsigned char c)
+	{
+		if (c >= '0' && c <= '9')
+		{
+			return (c - '0');
+		}
+		if (c >= 'A' && c <= 'F')
+		{
+			return (c - 'A' + 10);
+		}
+		if (c >= 'a' && c <= 'f')
+		{
+			return (c - 'a' + 10);
+		}
+		return -1;
+	}
+
 	Url::Url() :
 		valid(false),
 		port(0),
-		queryDelimiter('&')
+		queryOffset(0),
+		querySize(0)
 	{
 	}
 
 	Url::Url(chstr url) :
 		valid(false),
 		port(0),
-		queryDelimiter('&')
+		queryOffset(0),
+		querySize(0)
 	{
 		this->set(url);
 	}
@@ -45,117 +95,162 @@ namespace sakit
 	Url::Url(chstr host, chstr path, hmap<hstr, hstr> query, chstr fragment, chstr scheme) :
 		valid(false),
 		port(0),
-		queryDelimiter('&')
+		queryOffset(0),
+		querySize(0)
 	{
 		this->set(host, path, query, fragment, scheme);
 	}
 
-	void Url::set(chstr url)
+	hmap<hstr, hstr> Url::getQuery() const
 	{
-		if (url == "")
+		// not cached so a const Url can be used by several threads at once
+		if (this->querySize > 0)
 		{
-			hlog::warn(logTag, "URL cannot be empty! Ignoring call.");
-			return;
+			return Url::decodeWwwForm(this->data(this->queryOffset, this->querySize));
 		}
-		// reset first
+		return this->query;
+	}
+
+	void Url::_reset()
+	{
 		this->valid = false;
+		this->host = "";
 		this->port = 0;
 		this->path = "";
-		this->query.clear();
 		this->fragment = "";
-		this->queryDelimiter = '&';
+		this->data = "";
+		this->queryOffset = 0;
+		this->querySize = 0;
+		this->query.clear();
 		this->scheme = SAKIT_HTTP_SCHEME;
-		// set new
-		hstr newUrl = url;
+	}
+
+	void Url::set(chstr url)
+	{
+		if (url == "")
+		{
+			hlog::warn(logTag, "URL cannot be empty! Ignoring call.");
+			return;
+		}
+		this->_reset();
+		this->data = url;
+		const char* data = this->data.cStr();
+		int size = this->data.size();
+		int start = 0;
 		if (url.startsWith(SAKIT_HTTP_SCHEME))
 		{
-			newUrl = newUrl(strlen(SAKIT_HTTP_SCHEME), -1);
-			this->scheme = SAKIT_HTTP_SCHEME;
+			start = (int)strlen(SAKIT_HTTP_SCHEME);
 		}
 		else if (url.startsWith(SAKIT_HTTPS_SCHEME))
 		{
-			newUrl = newUrl(strlen(SAKIT_HTTPS_SCHEME), -1);
+			start = (int)strlen(SAKIT_HTTPS_SCHEME);
 			this->scheme = SAKIT_HTTPS_SCHEME;
-			hlog::warn(logTag, "URL uses HTTPS, but SSL isn't properly supported in SAKit yet: " + url);
+#ifndef _OPENSSL
+			hlog::warn(logTag, "URL uses HTTPS, but SAKit was built without TLS support: " + url);
+#endif
 		}
-		this->host = newUrl;
-		int index = 0;
-		hstr query;
-		hstr* current = &this->host;
-		hstr* next = NULL;
-		harray<hstr*> parts;
-		parts += &this->path;
-		parts += &query;
-		parts += &this->fragment;
-		harray<char> chars;
-		chars += '/';
-		chars += '?';
-		chars += '#';
-		while (parts.size() > 0)
-		{
-			index = newUrl.indexOf(chars.removeFirst());
-			next = parts.removeFirst();
-			if (index >= 0)
+		// a single pass finds the ends of all components
+		int hostEnd = size;
+		int pathEnd = size;
+		int queryEnd = size;
+		for_iter (i, start, size)
+		{
+			if (data[i] == '#')
+			{
+				hostEnd = hmin(hostEnd, i);
+				pathEnd = hmin(pathEnd, i);
+				queryEnd = i;
+				break;
+			}
+			if (data[i] == '?' && pathEnd == size)
+			{
+				hostEnd = hmin(hostEnd, i);
+				pathEnd = i;
+			}
+			else if (data[i] == '/' && hostEnd == size)
 			{
-				*current = newUrl(0, index);
-				*next = newUrl = newUrl(index, -1);
-				current = next;
+				hostEnd = i;
 			}
 		}
-		this->_checkValues(query);
+		if (pathEnd < queryEnd)
+		{
+			this->queryOffset = pathEnd + 1; // skips the ? character
+			this->querySize = queryEnd - this->queryOffset;
+		}
+		int fragmentStart = hmin(queryEnd + 1, size); // skips the # character
+		this->valid = this->_checkValues(&data[start], hostEnd - start, &data[hostEnd], pathEnd - hostEnd, &data[fragmentStart], size - fragmentStart);
 	}
 
 	void Url::set(chstr host, chstr path, hmap<hstr, hstr> query, chstr fragment, chstr scheme)
 	{
-		// reset
-		this->valid = false;
-		this->port = 0;
-		this->queryDelimiter = '&';
-		// set new
-		this->host = host;
-		this->path = path;
+		this->_reset();
 		this->query = query;
-		this->fragment = fragment;
 		this->scheme = scheme;
-		this->_checkValues("");
+		this->valid = this->_checkValues(host.cStr(), host.size(), path.cStr(), path.size(), fragment.cStr(), fragment.size());
 	}
 
-	void Url::_checkValues(chstr query)
+	bool Url::_checkValues(const char* host, int hostSize, const char* path, int pathSize, const char* fragment, int fragmentSize)
 	{
-		int index = this->host.indexOf(':');
-		if (index >= 0)
+		for_iter (i, 0, hostSize)
 		{
-			hstr port = this->host(index + 1, -1);
-			this->host = this->host(0, index);
-			if (!port.isNumber())
+			if (host[i] != ':')
+			{
+				continue;
+			}
+			if (i == hostSize - 1)
 			{
-				hlog::warn(logTag, "Malformed URL host: " + this->host);
-				return;
+				hlog::warn(logTag, "Malformed URL host: " + hstr(host, i));
+				return false;
 			}
-			unsigned int portValue = (unsigned int)port;
-			if (portValue > USHRT_MAX)
+			unsigned int portValue = 0;
+			for_iter (j, i + 1, hostSize)
 			{
-				hlog::warn(logTag, "Malformed URL host: " + this->host);
-				return;
+				if (host[j] < '0' || host[j] > '9')
+				{
+					hlog::warn(logTag, "Malformed URL host: " + hstr(host, i));
+					return false;
+				}
+				portValue = portValue * 10 + (host[j] - '0');
+				if (portValue > USHRT_MAX)
+				{
+					hlog::warn(logTag, "Malformed URL host: " + hstr(host, i));
+					return false;
+				}
 			}
 			this->port = (unsigned short)portValue;
+			hostSize = i;
+			break;
 		}
-		if (!Url::_checkCharset(this->host, HOST_ALLOWED))
+		this->host = hstr(host, hostSize);
+		if (!Url::_checkCharset(this->host, CHARSET_HOST))
 		{
 			hlog::warn(logTag, "Malformed URL host: " + this->host);
-			return;
+			return false;
 		}
-		this->host = Url::_decodeWwwFormComponent(this->host);
-		harray<hstr> paths = this->path.split('/', -1, true);
-		this->path = "";
-		foreach (hstr, it, paths)
+		if (this->host.contains('%'))
 		{
-			if (!Url::_checkCharset((*it), PATH_ALLOWED))
+			this->host = Url::_decodeWwwFormComponent(this->host);
+		}
+		int segmentStart = 0;
+		hstr segment;
+		for_iter (i, 0, pathSize + 1)
+		{
+			if (i < pathSize && path[i] != '/')
+			{
+				continue;
+			}
+			// empty segments are skipped
+			if (i > segmentStart)
 			{
-				hlog::warn(logTag, "Malformed URL path segment: " + (*it));
-				return;
+				segment = hstr(&path[segmentStart], i - segmentStart);
+				if (!Url::_checkCharset(segment, CHARSET_PATH))
+				{
+					hlog::warn(logTag, "Malformed URL path segment: " + segment);
+					return false;
+				}
+				this->path += "/" + (segment.contains('%') ? Url::_decodeWwwFormComponent(segment) : segment);
 			}
-			this->path += "/" + Url::_decodeWwwFormComponent(*it);
+			segmentStart = i + 1;
 		}
 		// resolving "." and ".." in path
 		this->path = hdir::normalize(this->path);
@@ -177,26 +272,25 @@ namespace sakit
 			}
 			break;
 		}
-		if (query != "" && query != "?")
-		{
-			this->query = Url::decodeWwwForm(query(1, -1)); // also removes the ? caracter
-		}
-		if (this->fragment != "")
+		if (fragmentSize > 0)
 		{
-			this->fragment = this->fragment(1, -1); // remove the # caracter
-			if (!Url::_checkCharset(this->fragment, FRAGMENT_ALLOWED))
+			this->fragment = hstr(fragment, fragmentSize);
+			if (!Url::_checkCharset(this->fragment, CHARSET_FRAGMENT))
 			{
 				hlog::warn(logTag, "Malformed URL fragment: " + this->fragment);
-				return;
+				return false;
+			}
+			if (this->fragment.contains('%'))
+			{
+				this->fragment = Url::_decodeWwwFormComponent(this->fragment);
 			}
-			this->fragment = Url::_decodeWwwFormComponent(this->fragment);
 		}
-		this->valid = true;
+		return true;
 	}
 
 	hstr Url::getAbsolutePath(bool withPort) const
 	{
-		hstr result = (this->scheme != "" ? this->scheme : SAKIT_HTTP_SCHEME) + this->_encodeWwwFormComponent(this->host, HOST_ALLOWED);
+		hstr result = (this->scheme != "" ? this->scheme : SAKIT_HTTP_SCHEME) + this->_encodeWwwFormComponent(this->host, CHARSET_HOST);
 		if (withPort && this->port > 0)
 		{
 			result += ":" + hstr(this->port);
@@ -204,14 +298,14 @@ namespace sakit
 		harray<hstr> paths = this->path.split('/', -1, true);
 		foreach (hstr, it, paths)
 		{
-			result += "/" + this->_encodeWwwFormComponent((*it), PATH_ALLOWED);
+			result += "/" + this->_encodeWwwFormComponent((*it), CHARSET_PATH);
 		}
 		return result;
 	}
 
 	hstr Url::getRelativePath(bool withPort) const
 	{
-		hstr result = this->_encodeWwwFormComponent("", HOST_ALLOWED);
+		hstr result = this->_encodeWwwFormComponent("", CHARSET_HOST);
 		if (withPort && this->port > 0)
 		{
 			result += ":" + hstr(this->port);
@@ -219,7 +313,7 @@ namespace sakit
 		harray<hstr> paths = this->path.split('/', -1, true);
 		foreach (hstr, it, paths)
 		{
-			result += "/" + this->_encodeWwwFormComponent((*it), PATH_ALLOWED);
+			result += "/" + this->_encodeWwwFormComponent((*it), CHARSET_PATH);
 		}
 		return result;
 	}
@@ -227,14 +321,30 @@ namespace sakit
 	hstr Url::getBody() const
 	{
 		hstr result;
-		hstr query = Url::encodeWwwForm(this->query, this->queryDelimiter);
+		hstr query;
+		if (this->querySize > 0)
+		{
+			// the original query that is already properly encoded is used as it is
+			query = this->data(this->queryOffset, this->querySize);
+			if (!Url::_checkCharset(query, CHARSET_QUERY))
+			{
+				// encoded again with the same delimiter the query was set with
+				char delimiter = '&';
+				hmap<hstr, hstr> values = Url::decodeWwwForm(query, &delimiter);
+				query = Url::encodeWwwForm(values, delimiter);
+			}
+		}
+		else
+		{
+			query = Url::encodeWwwForm(this->query);
+		}
 		if (query != "")
 		{
 			result += query;
 		}
 		if (this->fragment != "")
 		{
-			result += "#" + Url::_encodeWwwFormComponent(this->fragment, FRAGMENT_ALLOWED);
+			result += "#" + Url::_encodeWwwFormComponent(this->fragment, CHARSET_FRAGMENT);
 		}
 		return result;
 	}
@@ -254,70 +364,126 @@ namespace sakit
 		return result;
 	}
 
-	bool Url::_checkCharset(chstr string, chstr allowed)
+	bool Url::_checkCharset(chstr string, unsigned char charset)
 	{
-		if (string == "")
-		{
-			return true;
-		}
-		harray<char> allAllowed = (allowed + "%0123456789ABCDEFabcdef").split().removedDuplicates();
-		hstr checked = string;
-		foreach (char, it, allAllowed)
+		const unsigned char* data = (const unsigned char*)string.cStr();
+		int size = string.size();
+		for_iter (i, 0, size)
 		{
-			checked.replace((*it), "");
-			if (checked == "")
+			if ((charsets[data[i]] & charset) == 0 && data[i] != '%')
 			{
-				return true;
+				return false;
 			}
 		}
-		return false;
+		return true;
 	}
 
-	hstr Url::_encodeWwwFormComponent(chstr string, chstr allowed)
+	hstr Url::_encodeWwwFormComponent(chstr string, unsigned char charset)
 	{
-		harray<hstr> result;
-		for_iter (i, 0, string.size())
+		int size = string.size();
+		if (size == 0)
 		{
-			if (allowed.contains(string[i]))
+			return string;
+		}
+		char* output = new char[size * 3];
+		hstr result(output, Url::_encodeWwwFormComponent(string.cStr(), size, charset, output));
+		delete[] output;
+		return result;
+	}
+
+	int Url::_encodeWwwFormComponent(const char* string, int size, unsigned char charset, char* output)
+	{
+		const unsigned char* data = (const unsigned char*)string;
+		int written = 0;
+		int start = 0;
+		int i = 0;
+		while (i < size)
+		{
+			// runs of characters that don't need encoding are copied at once
+			start = i;
+			while (i < size && (charsets[data[i]] & charset) != 0)
 			{
-				result += string[i];
+				++i;
 			}
-			else
+			if (i > start)
+			{
+				memcpy(&output[written], &data[start], i - start);
+				written += i - start;
+			}
+			if (i < size)
 			{
-				result += hsprintf("%%%02X", string[i]);
+				output[written] = '%';
+				output[written + 1] = hexDigits[data[i] >> 4];
+				output[written + 2] = hexDigits[data[i] & 0xF];
+				written += 3;
+				++i;
 			}
 		}
-		return result.joined("");
+		return written;
 	}
 
 	hstr Url::_decodeWwwFormComponent(chstr string)
 	{
-		hstr current = string;
-		harray<hstr> result;
-		int index = 0;
-		while (true)
+		const char* data = string.cStr();
+		int size = string.size();
+		const char* percent = (const char*)memchr(data, '%', size);
+		if (percent == NULL)
+		{
+			return string;
+		}
+		// decoding never makes the string longer
+		char* output = new char[size];
+		int written = (int)(percent - data);
+		memcpy(output, data, written);
+		int high = 0;
+		int low = 0;
+		for_iter (i, written, size)
 		{
-			index = current.indexOf('%');
-			if (index < 0)
+			if (data[i] == '%' && i + 2 < size && (high = __hexValue(data[i + 1])) >= 0 && (low = __hexValue(data[i + 2])) >= 0)
 			{
-				result += current;
-				break;
+				output[written] = (char)((high << 4) | low);
+				i += 2;
 			}
-			result += current(0, index);
-			result += (char)current(index + 1, 2).unhex();
-			current = current(index + 3, -1);
+			else
+			{
+				output[written] = data[i];
+			}
+			++written;
 		}
-		return result.joined("");
+		hstr result(output, written);
+		delete[] output;
+		return result;
 	}
 
 	hstr Url::encodeWwwForm(hmap<hstr, hstr> query, char delimiter)
 	{
-		harray<hstr> parameters;
+		if (query.size() == 0)
+		{
+			return "";
+		}
+		// everything is encoded into a single buffer that is large enough for the worst case
+		int size = 0;
 		foreach_m (hstr, it, query)
 		{
-			parameters += Url::_encodeWwwFormComponent(it->first, QUERY_ALLOWED) + "=" + Url::_encodeWwwFormComponent(it->second, QUERY_ALLOWED);
+			size += (it->first.size() + it->second.size()) * 3 + 2;
 		}
-		return parameters.joined(delimiter);
+		char* output = new char[size];
+		int written = 0;
+		foreach_m (hstr, it, query)
+		{
+			if (written > 0)
+			{
+				output[written] = delimiter;
+				++written;
+			}
+			written += Url::_encodeWwwFormComponent(it->first.cStr(), it->first.size(), CHARSET_QUERY, &output[written]);
+			output[written] = '=';
+			++written;
+			written += Url::_encodeWwwFormComponent(it->second.cStr(), it->second.size(), CHARSET_QUERY, &output[written]);
+		}
+		hstr result(output, written);
+		delete[] output;
+		return result;
 	}
 
 	hmap<hstr, hstr> Url::decodeWwwForm(chstr string, char* usedDelimiter)
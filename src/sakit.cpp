@@ -6,16 +6,21 @@
 /// This program is free software; you can redistribute it and/or modify it under
 /// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
 
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
 #define __HL_INCLUDE_PLATFORM_HEADERS
 #include <hltypes/hlog.h>
-#include <hltypes/hmap.h>
 #include <hltypes/hplatform.h>
 #include <hltypes/hstring.h>
 
 #include "PlatformSocket.h"
+#include "Resolver.h"
 #include "sakit.h"
 #include "Socket.h"
 #include "State.h"
+#include "TlsSession.h"
 
 #ifndef _WIN32
 #include <unistd.h>
@@ -32,17 +37,539 @@ namespace sakit
 	harray<Base*> connections;
 	hmutex connectionsMutex;
 	hmutex updateMutex;
-	hmap<unsigned int, hstr> mapping;
-	/// @note Used for optimization to avoid hstr::fromUnicode() calls.
-	hmap<hstr, hstr> reverseMapping;
+	bool initialized = false;
 	hthread* _updateThread;
 
+	struct HtmlEntity
+	{
+		unsigned int code;
+		const char* name;
+	};
+
+	// all 254 HTML entities as per HTML 4.0 specification, ordered by code for encoding
+	static const HtmlEntity htmlEntitiesByCode[] =
+	{
+		{0x22U, "quot"},
+		{0x26U, "amp"},
+		{0x27U, "apos"},
+		{0x3CU, "lt"},
+		{0x3EU, "gt"},
+		{0xA0U, "nbsp"},
+		{0xA1U, "iexcl"},
+		{0xA2U, "cent"},
+		{0xA3U, "pound"},
+		{0xA4U, "curren"},
+		{0xA5U, "yen"},
+		{0xA6U, "brvbar"},
+		{0xA7U, "sect"},
+		{0xA8U, "uml"},
+		{0xA9U, "copy"},
+		{0xAAU, "ordf"},
+		{0xABU, "laquo"},
+		{0xACU, "not"},
+		{0xADU, "shy"},
+		{0xAEU, "reg"},
+		{0xAFU, "macr"},
+		{0xB0U, "deg"},
+		{0xB1U, "plusmn"},
+		{0xB2U, "sup2"},
+		{0xB3U, "sup3"},
+		{0xB4U, "acute"},
+		{0xB5U, "micro"},
+		{0xB6U, "para"},
+		{0xB7U, "middot"},
+		{0xB8U, "cedil"},
+		{0xB9U, "sup1"},
+		{0xBAU, "ordm"},
+		{0xBBU, "raquo"},
+		{0xBCU, "frac14"},
+		{0xBDU, "frac12"},
+		{0xBEU, "frac34"},
+		{0xBFU, "iquest"},
+		{0xC0U, "Agrave"},
+		{0xC1U, "Aacute"},
+		{0xC2U, "Acirc"},
+		{0xC3U, "Atilde"},
+		{0xC4U, "Auml"},
+		{0xC5U, "Aring"},
+		{0xC6U, "AElig"},
+		{0xC7U, "Ccedil"},
+		{0xC8U, "Egrave"},
+		{0xC9U, "Eacute"},
+		{0xCAU, "Ecirc"},
+		{0xCBU, "Euml"},
+		{0xCCU, "Igrave"},
+		{0xCDU, "Iacute"},
+		{0xCEU, "Icirc"},
+		{0xCFU, "Iuml"},
+		{0xD0U, "ETH"},
+		{0xD1U, "Ntilde"},
+		{0xD2U, "Ograve"},
+		{0xD3U, "Oacute"},
+		{0xD4U, "Ocirc"},
+		{0xD5U, "Otilde"},
+		{0xD6U, "Ouml"},
+		{0xD7U, "times"},
+		{0xD8U, "Oslash"},
+		{0xD9U, "Ugrave"},
+		{0xDAU, "Uacute"},
+		{0xDBU, "Ucirc"},
+		{0xDCU, "Uuml"},
+		{0xDDU, "Yacute"},
+		{0xDEU, "THORN"},
+		{0xDFU, "szlig"},
+		{0xE0U, "agrave"},
+		{0xE1U, "aacute"},
+		{0xE2U, "acirc"},
+		{0xE3U, "atilde"},
+		{0xE4U, "auml"},
+		{0xE5U, "aring"},
+		{0xE6U, "aelig"},
+		{0xE7U, "ccedil"},
+		{0xE8U, "egrave"},
+		{0xE9U, "eacute"},
+		{0xEAU, "ecirc"},
+		{0xEBU, "euml"},
+		{0xECU, "igrave"},
+		{0xEDU, "iacute"},
+		{0xEEU, "icirc"},
+		{0xEFU, "iuml"},
+		{0xF0U, "eth"},
+		{0xF1U, "ntilde"},
+		{0xF2U, "ograve"},
+		{0xF3U, "oacute"},
+		{0xF4U, "ocirc"},
+		{0xF5U, "otilde"},
+		{0xF6U, "ouml"},
+		{0xF7U, "divide"},
+		{0xF8U, "oslash"},
+		{0xF9U, "ugrave"},
+		{0xFAU, "uacute"},
+		{0xFBU, "ucirc"},
+		{0xFCU, "uuml"},
+		{0xFDU, "yacute"},
+		{0xFEU, "thorn"},
+		{0xFFU, "yuml"},
+		{0x152U, "OElig"},
+		{0x153U, "oelig"},
+		{0x160U, "Scaron"},
+		{0x161U, "scaron"},
+		{0x178U, "Yuml"},
+		{0x192U, "fnof"},
+		{0x2C6U, "circ"},
+		{0x2DCU, "tilde"},
+		{0x391U, "Alpha"},
+		{0x392U, "Beta"},
+		{0x393U, "Gamma"},
+		{0x394U, "Delta"},
+		{0x395U, "Epsilon"},
+		{0x396U, "Zeta"},
+		{0x397U, "Eta"},
+		{0x398U, "Theta"},
+		{0x399U, "Iota"},
+		{0x39AU, "Kappa"},
+		{0x39BU, "Lambda"},
+		{0x39CU, "Mu"},
+		{0x39DU, "Nu"},
+		{0x39EU, "Xi"},
+		{0x39FU, "Omicron"},
+		{0x3A0U, "Pi"},
+		{0x3A1U, "Rho"},
+		{0x3A3U, "Sigma"},
+		{0x3A4U, "Tau"},
+		{0x3A5U, "Upsilon"},
+		{0x3A6U, "Phi"},
+		{0x3A7U, "Chi"},
+		{0x3A8U, "Psi"},
+		{0x3A9U, "Omega"},
+		{0x3B1U, "alpha"},
+		{0x3B2U, "beta"},
+		{0x3B3U, "gamma"},
+		{0x3B4U, "delta"},
+		{0x3B5U, "epsilon"},
+		{0x3B6U, "zeta"},
+		{0x3B7U, "eta"},
+		{0x3B8U, "theta"},
+		{0x3B9U, "iota"},
+		{0x3BAU, "kappa"},
+		{0x3BBU, "lambda"},
+		{0x3BCU, "mu"},
+		{0x3BDU, "nu"},
+		{0x3BEU, "xi"},
+		{0x3BFU, "omicron"},
+		{0x3C0U, "pi"},
+		{0x3C1U, "rho"},
+		{0x3C2U, "sigmaf"},
+		{0x3C3U, "sigma"},
+		{0x3C4U, "tau"},
+		{0x3C5U, "upsilon"},
+		{0x3C6U, "phi"},
+		{0x3C7U, "chi"},
+		{0x3C8U, "psi"},
+		{0x3C9U, "omega"},
+		{0x3D1U, "thetasym"},
+		{0x3D2U, "upsih"},
+		{0x3D6U, "piv"},
+		{0x2002U, "ensp"},
+		{0x2003U, "emsp"},
+		{0x2009U, "thinsp"},
+		{0x200CU, "zwnj"},
+		{0x200DU, "zwj"},
+		{0x200EU, "lrm"},
+		{0x200FU, "rlm"},
+		{0x2013U, "ndash"},
+		{0x2014U, "mdash"},
+		{0x2018U, "lsquo"},
+		{0x2019U, "rsquo"},
+		{0x201AU, "sbquo"},
+		{0x201CU, "ldquo"},
+		{0x201DU, "rdquo"},
+		{0x201EU, "bdquo"},
+		{0x2020U, "dagger"},
+		{0x2021U, "Dagger"},
+		{0x2022U, "bull"},
+		{0x2026U, "hellip"},
+		{0x2030U, "permil"},
+		{0x2032U, "prime"},
+		{0x2033U, "Prime"},
+		{0x2039U, "lsaquo"},
+		{0x203AU, "rsaquo"},
+		{0x203EU, "oline"},
+		{0x2044U, "frasl"},
+		{0x20ACU, "euro"},
+		{0x2111U, "image"},
+		{0x2118U, "weierp"},
+		{0x211CU, "real"},
+		{0x2122U, "trade"},
+		{0x2135U, "alefsym"},
+		{0x2190U, "larr"},
+		{0x2191U, "uarr"},
+		{0x2192U, "rarr"},
+		{0x2193U, "darr"},
+		{0x2194U, "harr"},
+		{0x21B5U, "crarr"},
+		{0x21D0U, "lArr"},
+		{0x21D1U, "uArr"},
+		{0x21D2U, "rArr"},
+		{0x21D3U, "dArr"},
+		{0x21D4U, "hArr"},
+		{0x2200U, "forall"},
+		{0x2202U, "part"},
+		{0x2203U, "exist"},
+		{0x2205U, "empty"},
+		{0x2207U, "nabla"},
+		{0x2208U, "isin"},
+		{0x2209U, "notin"},
+		{0x220BU, "ni"},
+		{0x220FU, "prod"},
+		{0x2211U, "sum"},
+		{0x2212U, "minus"},
+		{0x2217U, "lowast"},
+		{0x221AU, "radic"},
+		{0x221DU, "prop"},
+		{0x221EU, "infin"},
+		{0x2220U, "ang"},
+		{0x2227U, "and"},
+		{0x2228U, "or"},
+		{0x2229U, "cap"},
+		{0x222AU, "cup"},
+		{0x222BU, "int"},
+		{0x2234U, "there4"},
+		{0x223CU, "sim"},
+		{0x2245U, "cong"},
+		{0x2248U, "asymp"},
+		{0x2260U, "ne"},
+		{0x2261U, "equiv"},
+		{0x2264U, "le"},
+		{0x2265U, "ge"},
+		{0x2282U, "sub"},
+		{0x2283U, "sup"},
+		{0x2284U, "nsub"},
+		{0x2286U, "sube"},
+		{0x2287U, "supe"},
+		{0x2295U, "oplus"},
+		{0x2297U, "otimes"},
+		{0x22A5U, "perp"},
+		{0x22C5U, "sdot"},
+		{0x22EEU, "vellip"},
+		{0x2308U, "lceil"},
+		{0x2309U, "rceil"},
+		{0x230AU, "lfloor"},
+		{0x230BU, "rfloor"},
+		{0x2329U, "lang"},
+		{0x232AU, "rang"},
+		{0x25CAU, "loz"},
+		{0x2660U, "spades"},
+		{0x2663U, "clubs"},
+		{0x2665U, "hearts"},
+		{0x2666U, "diams"},
+	};
+	// the same entities ordered by name for decoding
+	static const HtmlEntity htmlEntitiesByName[] =
+	{
+		{0xC6U, "AElig"},
+		{0xC1U, "Aacute"},
+		{0xC2U, "Acirc"},
+		{0xC0U, "Agrave"},
+		{0x391U, "Alpha"},
+		{0xC5U, "Aring"},
+		{0xC3U, "Atilde"},
+		{0xC4U, "Auml"},
+		{0x392U, "Beta"},
+		{0xC7U, "Ccedil"},
+		{0x3A7U, "Chi"},
+		{0x2021U, "Dagger"},
+		{0x394U, "Delta"},
+		{0xD0U, "ETH"},
+		{0xC9U, "Eacute"},
+		{0xCAU, "Ecirc"},
+		{0xC8U, "Egrave"},
+		{0x395U, "Epsilon"},
+		{0x397U, "Eta"},
+		{0xCBU, "Euml"},
+		{0x393U, "Gamma"},
+		{0xCDU, "Iacute"},
+		{0xCEU, "Icirc"},
+		{0xCCU, "Igrave"},
+		{0x399U, "Iota"},
+		{0xCFU, "Iuml"},
+		{0x39AU, "Kappa"},
+		{0x39BU, "Lambda"},
+		{0x39CU, "Mu"},
+		{0xD1U, "Ntilde"},
+		{0x39DU, "Nu"},
+		{0x152U, "OElig"},
+		{0xD3U, "Oacute"},
+		{0xD4U, "Ocirc"},
+		{0xD2U, "Ograve"},
+		{0x3A9U, "Omega"},
+		{0x39FU, "Omicron"},
+		{0xD8U, "Oslash"},
+		{0xD5U, "Otilde"},
+		{0xD6U, "Ouml"},
+		{0x3A6U, "Phi"},
+		{0x3A0U, "Pi"},
+		{0x2033U, "Prime"},
+		{0x3A8U, "Psi"},
+		{0x3A1U, "Rho"},
+		{0x160U, "Scaron"},
+		{0x3A3U, "Sigma"},
+		{0xDEU, "THORN"},
+		{0x3A4U, "Tau"},
+		{0x398U, "Theta"},
+		{0xDAU, "Uacute"},
+		{0xDBU, "Ucirc"},
+		{0xD9U, "Ugrave"},
+		{0x3A5U, "Upsilon"},
+		{0xDCU, "Uuml"},
+		{0x39EU, "Xi"},
+		{0xDDU, "Yacute"},
+		{0x178U, "Yuml"},
+		{0x396U, "Zeta"},
+		{0xE1U, "aacute"},
+		{0xE2U, "acirc"},
+		{0xB4U, "acute"},
+		{0xE6U, "aelig"},
+		{0xE0U, "agrave"},
+		{0x2135U, "alefsym"},
+		{0x3B1U, "alpha"},
+		{0x26U, "amp"},
+		{0x2227U, "and"},
+		{0x2220U, "ang"},
+		{0x27U, "apos"},
+		{0xE5U, "aring"},
+		{0x2248U, "asymp"},
+		{0xE3U, "atilde"},
+		{0xE4U, "auml"},
+		{0x201EU, "bdquo"},
+		{0x3B2U, "beta"},
+		{0xA6U, "brvbar"},
+		{0x2022U, "bull"},
+		{0x2229U, "cap"},
+		{0xE7U, "ccedil"},
+		{0xB8U, "cedil"},
+		{0xA2U, "cent"},
+		{0x3C7U, "chi"},
+		{0x2C6U, "circ"},
+		{0x2663U, "clubs"},
+		{0x2245U, "cong"},
+		{0xA9U, "copy"},
+		{0x21B5U, "crarr"},
+		{0x222AU, "cup"},
+		{0xA4U, "curren"},
+		{0x21D3U, "dArr"},
+		{0x2020U, "dagger"},
+		{0x2193U, "darr"},
+		{0xB0U, "deg"},
+		{0x3B4U, "delta"},
+		{0x2666U, "diams"},
+		{0xF7U, "divide"},
+		{0xE9U, "eacute"},
+		{0xEAU, "ecirc"},
+		{0xE8U, "egrave"},
+		{0x2205U, "empty"},
+		{0x2003U, "emsp"},
+		{0x2002U, "ensp"},
+		{0x3B5U, "epsilon"},
+		{0x2261U, "equiv"},
+		{0x3B7U, "eta"},
+		{0xF0U, "eth"},
+		{0xEBU, "euml"},
+		{0x20ACU, "euro"},
+		{0x2203U, "exist"},
+		{0x192U, "fnof"},
+		{0x2200U, "forall"},
+		{0xBDU, "frac12"},
+		{0xBCU, "frac14"},
+		{0xBEU, "frac34"},
+		{0x2044U, "frasl"},
+		{0x3B3U, "gamma"},
+		{0x2265U, "ge"},
+		{0x3EU, "gt"},
+		{0x21D4U, "hArr"},
+		{0x2194U, "harr"},
+		{0x2665U, "hearts"},
+		{0x2026U, "hellip"},
+		{0xEDU, "iacute"},
+		{0xEEU, "icirc"},
+		{0xA1U, "iexcl"},
+		{0xECU, "igrave"},
+		{0x2111U, "image"},
+		{0x221EU, "infin"},
+		{0x222BU, "int"},
+		{0x3B9U, "iota"},
+		{0xBFU, "iquest"},
+		{0x2208U, "isin"},
+		{0xEFU, "iuml"},
+		{0x3BAU, "kappa"},
+		{0x21D0U, "lArr"},
+		{0x3BBU, "lambda"},
+		{0x2329U, "lang"},
+		{0xABU, "laquo"},
+		{0x2190U, "larr"},
+		{0x2308U, "lceil"},
+		{0x201CU, "ldquo"},
+		{0x2264U, "le"},
+		{0x230AU, "lfloor"},
+		{0x2217U, "lowast"},
+		{0x25CAU, "loz"},
+		{0x200EU, "lrm"},
+		{0x2039U, "lsaquo"},
+		{0x2018U, "lsquo"},
+		{0x3CU, "lt"},
+		{0xAFU, "macr"},
+		{0x2014U, "mdash"},
+		{0xB5U, "micro"},
+		{0xB7U, "middot"},
+		{0x2212U, "minus"},
+		{0x3BCU, "mu"},
+		{0x2207U, "nabla"},
+		{0xA0U, "nbsp"},
+		{0x2013U, "ndash"},
+		{0x2260U, "ne"},
+		{0x220BU, "ni"},
+		{0xACU, "not"},
+		{0x2209U, "notin"},
+		{0x2284U, "nsub"},
+		{0xF1U, "ntilde"},
+		{0x3BDU, "nu"},
+		{0xF3U, "oacute"},
+		{0xF4U, "ocirc"},
+		{0x153U, "oelig"},
+		{0xF2U, "ograve"},
+		{0x203EU, "oline"},
+		{0x3C9U, "omega"},
+		{0x3BFU, "omicron"},
+		{0x2295U, "oplus"},
+		{0x2228U, "or"},
+		{0xAAU, "ordf"},
+		{0xBAU, "ordm"},
+		{0xF8U, "oslash"},
+		{0xF5U, "otilde"},
+		{0x2297U, "otimes"},
+		{0xF6U, "ouml"},
+		{0xB6U, "para"},
+		{0x2202U, "part"},
+		{0x2030U, "permil"},
+		{0x22A5U, "perp"},
+		{0x3C6U, "phi"},
+		{0x3C0U, "pi"},
+		{0x3D6U, "piv"},
+		{0xB1U, "plusmn"},
+		{0xA3U, "pound"},
+		{0x2032U, "prime"},
+		{0x220FU, "prod"},
+		{0x221DU, "prop"},
+		{0x3C8U, "psi"},
+		{0x22U, "quot"},
+		{0x21D2U, "rArr"},
+		{0x221AU, "radic"},
+		{0x232AU, "rang"},
+		{0xBBU, "raquo"},
+		{0x2192U, "rarr"},
+		{0x2309U, "rceil"},
+		{0x201DU, "rdquo"},
+		{0x211CU, "real"},
+		{0xAEU, "reg"},
+		{0x230BU, "rfloor"},
+		{0x3C1U, "rho"},
+		{0x200FU, "rlm"},
+		{0x203AU, "rsaquo"},
+		{0x2019U, "rsquo"},
+		{0x201AU, "sbquo"},
+		{0x161U, "scaron"},
+		{0x22C5U, "sdot"},
+		{0xA7U, "sect"},
+		{0xADU, "shy"},
+		{0x3C3U, "sigma"},
+		{0x3C2U, "sigmaf"},
+		{0x223CU, "sim"},
+		{0x2660U, "spades"},
+		{0x2282U, "sub"},
+		{0x2286U, "sube"},
+		{0x2211U, "sum"},
+		{0x2283U, "sup"},
+		{0xB9U, "sup1"},
+		{0xB2U, "sup2"},
+		{0xB3U, "sup3"},
+		{0x2287U, "supe"},
+		{0xDFU, "szlig"},
+		{0x3C4U, "tau"},
+		{0x2234U, "there4"},
+		{0x3B8U, "theta"},
+		{0x3D1U, "thetasym"},
+		{0x2009U, "thinsp"},
+		{0xFEU, "thorn"},
+		{0x2DCU, "tilde"},
+		{0xD7U, "times"},
+		{0x2122U, "trade"},
+		{0x21D1U, "uArr"},
+		{0xFAU, "uacute"},
+		{0x2191U, "uarr"},
+		{0xFBU, "ucirc"},
+		{0xF9U, "ugrave"},
+		{0xA8U, "uml"},
+		{0x3D2U, "upsih"},
+		{0x3C5U, "upsilon"},
+		{0xFCU, "uuml"},
+		{0x22EEU, "vellip"},
+		{0x2118U, "weierp"},
+		{0x3BEU, "xi"},
+		{0xFDU, "yacute"},
+		{0xA5U, "yen"},
+		{0xFFU, "yuml"},
+		{0x3B6U, "zeta"},
+		{0x200DU, "zwj"},
+		{0x200CU, "zwnj"},
+	};
+	static const int htmlEntityCount = (int)(sizeof(htmlEntitiesByCode) / sizeof(HtmlEntity));
+
 	void _asyncUpdate(hthread* thread);
 	void _internalUpdate(float timeDelta);
 
 	bool isInitialized()
 	{
-		return mapping.size() > 0;
+		return initialized;
 	}
 	
 	void init(bool threadedUpdate)
@@ -50,265 +577,7 @@ namespace sakit
 		hlog::write(logTag, "Initializing Socket Abstraction Kit: " + version.toString());
 		bufferSize = 65536;
 		PlatformSocket::platformInit();
-		// all 254 HTML entities as per HTML 4.0 specification
-		mapping[0x22u] = "quot";
-		mapping[0x26u] = "amp";
-		mapping[0x27u] = "apos";
-		mapping[0x3Cu] = "lt";
-		mapping[0x3Eu] = "gt";
-		mapping[0xA0u] = "nbsp";
-		mapping[0xA1u] = "iexcl";
-		mapping[0xA2u] = "cent";
-		mapping[0xA3u] = "pound";
-		mapping[0xA4u] = "curren";
-		mapping[0xA5u] = "yen";
-		mapping[0xA6u] = "brvbar";
-		mapping[0xA7u] = "sect";
-		mapping[0xA8u] = "uml";
-		mapping[0xA9u] = "copy";
-		mapping[0xAAu] = "ordf";
-		mapping[0xABu] = "laquo";
-		mapping[0xACu] = "not";
-		mapping[0xADu] = "shy";
-		mapping[0xAEu] = "reg";
-		mapping[0xAFu] = "macr";
-		mapping[0xB0u] = "deg";
-		mapping[0xB1u] = "plusmn";
-		mapping[0xB2u] = "sup2";
-		mapping[0xB3u] = "sup3";
-		mapping[0xB4u] = "acute";
-		mapping[0xB5u] = "micro";
-		mapping[0xB6u] = "para";
-		mapping[0xB7u] = "middot";
-		mapping[0xB8u] = "cedil";
-		mapping[0xB9u] = "sup1";
-		mapping[0xBAu] = "ordm";
-		mapping[0xBBu] = "raquo";
-		mapping[0xBCu] = "frac14";
-		mapping[0xBDu] = "frac12";
-		mapping[0xBEu] = "frac34";
-		mapping[0xBFu] = "iquest";
-		mapping[0xC0u] = "Agrave";
-		mapping[0xC1u] = "Aacute";
-		mapping[0xC2u] = "Acirc";
-		mapping[0xC3u] = "Atilde";
-		mapping[0xC4u] = "Auml";
-		mapping[0xC5u] = "Aring";
-		mapping[0xC6u] = "AElig";
-		mapping[0xC7u] = "Ccedil";
-		mapping[0xC8u] = "Egrave";
-		mapping[0xC9u] = "Eacute";
-		mapping[0xCAu] = "Ecirc";
-		mapping[0xCBu] = "Euml";
-		mapping[0xCCu] = "Igrave";
-		mapping[0xCDu] = "Iacute";
-		mapping[0xCEu] = "Icirc";
-		mapping[0xCFu] = "Iuml";
-		mapping[0xD0u] = "ETH";
-		mapping[0xD1u] = "Ntilde";
-		mapping[0xD2u] = "Ograve";
-		mapping[0xD3u] = "Oacute";
-		mapping[0xD4u] = "Ocirc";
-		mapping[0xD5u] = "Otilde";
-		mapping[0xD6u] = "Ouml";
-		mapping[0xD7u] = "times";
-		mapping[0xD8u] = "Oslash";
-		mapping[0xD9u] = "Ugrave";
-		mapping[0xDAu] = "Uacute";
-		mapping[0xDBu] = "Ucirc";
-		mapping[0xDCu] = "Uuml";
-		mapping[0xDDu] = "Yacute";
-		mapping[0xDEu] = "THORN";
-		mapping[0xDFu] = "szlig";
-		mapping[0xE0u] = "agrave";
-		mapping[0xE1u] = "aacute";
-		mapping[0xE2u] = "acirc";
-		mapping[0xE3u] = "atilde";
-		mapping[0xE4u] = "auml";
-		mapping[0xE5u] = "aring";
-		mapping[0xE6u] = "aelig";
-		mapping[0xE7u] = "ccedil";
-		mapping[0xE8u] = "egrave";
-		mapping[0xE9u] = "eacute";
-		mapping[0xEAu] = "ecirc";
-		mapping[0xEBu] = "euml";
-		mapping[0xECu] = "igrave";
-		mapping[0xEDu] = "iacute";
-		mapping[0xEEu] = "icirc";
-		mapping[0xEFu] = "iuml";
-		mapping[0xF0u] = "eth";
-		mapping[0xF1u] = "ntilde";
-		mapping[0xF2u] = "ograve";
-		mapping[0xF3u] = "oacute";
-		mapping[0xF4u] = "ocirc";
-		mapping[0xF5u] = "otilde";
-		mapping[0xF6u] = "ouml";
-		mapping[0xF7u] = "divide";
-		mapping[0xF8u] = "oslash";
-		mapping[0xF9u] = "ugrave";
-		mapping[0xFAu] = "uacute";
-		mapping[0xFBu] = "ucirc";
-		mapping[0xFCu] = "uuml";
-		mapping[0xFDu] = "yacute";
-		mapping[0xFEu] = "thorn";
-		mapping[0xFFu] = "yuml";
-		mapping[0x152u] = "OElig";
-		mapping[0x153u] = "oelig";
-		mapping[0x160u] = "Scaron";
-		mapping[0x161u] = "scaron";
-		mapping[0x178u] = "Yuml";
-		mapping[0x192u] = "fnof";
-		mapping[0x2C6u] = "circ";
-		mapping[0x2DCu] = "tilde";
-		mapping[0x391u] = "Alpha";
-		mapping[0x392u] = "Beta";
-		mapping[0x393u] = "Gamma";
-		mapping[0x394u] = "Delta";
-		mapping[0x395u] = "Epsilon";
-		mapping[0x396u] = "Zeta";
-		mapping[0x397u] = "Eta";
-		mapping[0x398u] = "Theta";
-		mapping[0x399u] = "Iota";
-		mapping[0x39Au] = "Kappa";
-		mapping[0x39Bu] = "Lambda";
-		mapping[0x39Cu] = "Mu";
-		mapping[0x39Du] = "Nu";
-		mapping[0x39Eu] = "Xi";
-		mapping[0x39Fu] = "Omicron";
-		mapping[0x3A0u] = "Pi";
-		mapping[0x3A1u] = "Rho";
-		mapping[0x3A3u] = "Sigma";
-		mapping[0x3A4u] = "Tau";
-		mapping[0x3A5u] = "Upsilon";
-		mapping[0x3A6u] = "Phi";
-		mapping[0x3A7u] = "Chi";
-		mapping[0x3A8u] = "Psi";
-		mapping[0x3A9u] = "Omega";
-		mapping[0x3B1u] = "alpha";
-		mapping[0x3B2u] = "beta";
-		mapping[0x3B3u] = "gamma";
-		mapping[0x3B4u] = "delta";
-		mapping[0x3B5u] = "epsilon";
-		mapping[0x3B6u] = "zeta";
-		mapping[0x3B7u] = "eta";
-		mapping[0x3B8u] = "theta";
-		mapping[0x3B9u] = "iota";
-		mapping[0x3BAu] = "kappa";
-		mapping[0x3BBu] = "lambda";
-		mapping[0x3BCu] = "mu";
-		mapping[0x3BDu] = "nu";
-		mapping[0x3BEu] = "xi";
-		mapping[0x3BFu] = "omicron";
-		mapping[0x3C0u] = "pi";
-		mapping[0x3C1u] = "rho";
-		mapping[0x3C2u] = "sigmaf";
-		mapping[0x3C3u] = "sigma";
-		mapping[0x3C4u] = "tau";
-		mapping[0x3C5u] = "upsilon";
-		mapping[0x3C6u] = "phi";
-		mapping[0x3C7u] = "chi";
-		mapping[0x3C8u] = "psi";
-		mapping[0x3C9u] = "omega";
-		mapping[0x3D1u] = "thetasym";
-		mapping[0x3D2u] = "upsih";
-		mapping[0x3D6u] = "piv";
-		mapping[0x2002u] = "ensp";
-		mapping[0x2003u] = "emsp";
-		mapping[0x2009u] = "thinsp";
-		mapping[0x200Cu] = "zwnj";
-		mapping[0x200Du] = "zwj";
-		mapping[0x200Eu] = "lrm";
-		mapping[0x200Fu] = "rlm";
-		mapping[0x2013u] = "ndash";
-		mapping[0x2014u] = "mdash";
-		mapping[0x2018u] = "lsquo";
-		mapping[0x2019u] = "rsquo";
-		mapping[0x201Au] = "sbquo";
-		mapping[0x201Cu] = "ldquo";
-		mapping[0x201Du] = "rdquo";
-		mapping[0x201Eu] = "bdquo";
-		mapping[0x2020u] = "dagger";
-		mapping[0x2021u] = "Dagger";
-		mapping[0x2022u] = "bull";
-		mapping[0x2026u] = "hellip";
-		mapping[0x2030u] = "permil";
-		mapping[0x2032u] = "prime";
-		mapping[0x2033u] = "Prime";
-		mapping[0x2039u] = "lsaquo";
-		mapping[0x203Au] = "rsaquo";
-		mapping[0x203Eu] = "oline";
-		mapping[0x2044u] = "frasl";
-		mapping[0x20ACu] = "euro";
-		mapping[0x2111u] = "image";
-		mapping[0x2118u] = "weierp";
-		mapping[0x211Cu] = "real";
-		mapping[0x2122u] = "trade";
-		mapping[0x2135u] = "alefsym";
-		mapping[0x2190u] = "larr";
-		mapping[0x2191u] = "uarr";
-		mapping[0x2192u] = "rarr";
-		mapping[0x2193u] = "darr";
-		mapping[0x2194u] = "harr";
-		mapping[0x21B5u] = "crarr";
-		mapping[0x21D0u] = "lArr";
-		mapping[0x21D1u] = "uArr";
-		mapping[0x21D2u] = "rArr";
-		mapping[0x21D3u] = "dArr";
-		mapping[0x21D4u] = "hArr";
-		mapping[0x2200u] = "forall";
-		mapping[0x2202u] = "part";
-		mapping[0x2203u] = "exist";
-		mapping[0x2205u] = "empty";
-		mapping[0x2207u] = "nabla";
-		mapping[0x2208u] = "isin";
-		mapping[0x2209u] = "notin";
-		mapping[0x220Bu] = "ni";
-		mapping[0x220Fu] = "prod";
-		mapping[0x2211u] = "sum";
-		mapping[0x2212u] = "minus";
-		mapping[0x2217u] = "lowast";
-		mapping[0x221Au] = "radic";
-		mapping[0x221Du] = "prop";
-		mapping[0x221Eu] = "infin";
-		mapping[0x2220u] = "ang";
-		mapping[0x2227u] = "and";
-		mapping[0x2228u] = "or";
-		mapping[0x2229u] = "cap";
-		mapping[0x222Au] = "cup";
-		mapping[0x222Bu] = "int";
-		mapping[0x2234u] = "there4";
-		mapping[0x223Cu] = "sim";
-		mapping[0x2245u] = "cong";
-		mapping[0x2248u] = "asymp";
-		mapping[0x2260u] = "ne";
-		mapping[0x2261u] = "equiv";
-		mapping[0x2264u] = "le";
-		mapping[0x2265u] = "ge";
-		mapping[0x2282u] = "sub";
-		mapping[0x2283u] = "sup";
-		mapping[0x2284u] = "nsub";
-		mapping[0x2286u] = "sube";
-		mapping[0x2287u] = "supe";
-		mapping[0x2295u] = "oplus";
-		mapping[0x2297u] = "otimes";
-		mapping[0x22A5u] = "perp";
-		mapping[0x22C5u] = "sdot";
-		mapping[0x22EEu] = "vellip";
-		mapping[0x2308u] = "lceil";
-		mapping[0x2309u] = "rceil";
-		mapping[0x230Au] = "lfloor";
-		mapping[0x230Bu] = "rfloor";
-		mapping[0x2329u] = "lang";
-		mapping[0x232Au] = "rang";
-		mapping[0x25CAu] = "loz";
-		mapping[0x2660u] = "spades";
-		mapping[0x2663u] = "clubs";
-		mapping[0x2665u] = "hearts";
-		mapping[0x2666u] = "diams";
-		foreach_map (unsigned int, hstr, it, mapping)
-		{
-			reverseMapping[it->second] = hstr::fromUnicode(it->first);
-		}
+		initialized = true;
 		// init states
 		State::allowedBindStates += State::Idle;
 		State::allowedUnbindStates += State::Bound;
@@ -331,6 +600,9 @@ namespace sakit
 		State::allowedServerStopStates += State::Running;
 		State::allowedHttpExecuteStates += State::Idle;
 		State::allowedHttpExecuteStates += State::Connected;
+		State::allowedHttpExecutePipelinedStates += State::Idle;
+		State::allowedHttpExecutePipelinedStates += State::Connected;
+		State::allowedHttpExecutePipelinedStates += State::Running;
 		State::allowedHttpAbortStates += State::Running;
 		// threading
 		if (threadedUpdate)
@@ -366,13 +638,17 @@ namespace sakit
 	void destroy()
 	{
 		hlog::write(logTag, "Destroying Socket Abstraction Kit.");
-		mapping.clear();
+		initialized = false;
 		if (_updateThread != NULL)
 		{
 			_updateThread->join();
 			delete _updateThread;
 			_updateThread = NULL;
 		}
+		Resolver::destroy();
+#ifdef _OPENSSL
+		TlsSession::destroy();
+#endif
 		PlatformSocket::platformDestroy();
 		if (connections.size() > 0)
 		{
@@ -444,7 +720,58 @@ namespace sakit
 
 	Host resolveHost(Host domain)
 	{
-		return PlatformSocket::resolveHost(domain);
+		harray<Host> addresses;
+		if (!Resolver::resolve(domain.toString(), addresses, timeout))
+		{
+			return Host();
+		}
+		return Resolver::getPreferredAddress(addresses);
+	}
+
+	void prefetchHost(Host domain)
+	{
+		Resolver::prefetch(domain.toString());
+	}
+
+	void setResolverCacheTtl(float ttl, float negativeTtl)
+	{
+		Resolver::CacheTtl = ttl;
+		Resolver::NegativeCacheTtl = negativeTtl;
+	}
+
+	void clearResolverCache()
+	{
+		Resolver::clearCache();
+	}
+
+	void setResolverLookupFunction(bool (*function)(chstr hostname, harray<Host>& addresses))
+	{
+		Resolver::setLookupFunction(function);
+	}
+
+	void setTlsCertificateAuthorityFile(chstr filename)
+	{
+#ifdef _OPENSSL
+		TlsSession::setCertificateAuthorityFile(filename);
+#else
+		hlog::warn(logTag, "TLS is not available, SAKit was built without _OPENSSL!");
+#endif
+	}
+
+	void setTlsKernelOffloadEnabled(bool value)
+	{
+#ifdef _OPENSSL
+		TlsSession::KernelOffload = value;
+#else
+		hlog::warn(logTag, "TLS is not available, SAKit was built without _OPENSSL!");
+#endif
+	}
+
+	void clearTlsSessionCache()
+	{
+#ifdef _OPENSSL
+		TlsSession::clearSessionCache();
+#endif
 	}
 
 	Host resolveIp(Host ip)
@@ -457,78 +784,300 @@ namespace sakit
 		return PlatformSocket::resolveServiceName(serviceName);
 	}
 
-	hstr encodeHtmlEntities(chstr string)
+	static const char* _findHtmlEntityName(unsigned int code)
 	{
-		harray<hstr> result; // adding stuff to an array is much faster than concatenating strings
-		std::basic_string<unsigned int> chars = string.uStr();
-		unsigned int start = 0;
-		hstr entity;
-		for_itert (unsigned int, i, 0, chars.size())
+		int first = 0;
+		int last = htmlEntityCount - 1;
+		int middle = 0;
+		while (first <= last)
 		{
-			entity = mapping.tryGet(chars[i], "");
-			if (entity != "")
+			middle = (first + last) / 2;
+			if (htmlEntitiesByCode[middle].code == code)
 			{
-				result += hstr::fromUnicode(chars.substr(start, i - start).c_str()) + "&" + entity + ";";
-				start = i + 1;
+				return htmlEntitiesByCode[middle].name;
 			}
-			else if (chars[i] > 0xFF)
+			if (htmlEntitiesByCode[middle].code < code)
 			{
-				result += hstr::fromUnicode(chars.substr(start, i - start).c_str()) + hsprintf("&%d;", chars[i]);
-				start = i + 1;
+				first = middle + 1;
+			}
+			else
+			{
+				last = middle - 1;
 			}
 		}
-		if (start < chars.size())
+		return NULL;
+	}
+
+	static bool _findHtmlEntityCode(const char* name, int size, unsigned int& code)
+	{
+		int first = 0;
+		int last = htmlEntityCount - 1;
+		int middle = 0;
+		int comparison = 0;
+		while (first <= last)
 		{
-			result += hstr::fromUnicode(chars.substr(start, chars.size() - start).c_str());
+			middle = (first + last) / 2;
+			comparison = strncmp(htmlEntitiesByName[middle].name, name, size);
+			if (comparison == 0 && htmlEntitiesByName[middle].name[size] == '\0')
+			{
+				code = htmlEntitiesByName[middle].code;
+				return true;
+			}
+			if (comparison < 0)
+			{
+				first = middle + 1;
+			}
+			else
+			{
+				last = middle - 1;
+			}
 		}
-		return result.joined("");
+		return false;
 	}
 
-	hstr decodeHtmlEntities(chstr string)
+	// reads one UTF-8 character, invalid bytes are taken as Latin-1 characters
+	static unsigned int _readUtf8(const unsigned char* data, int size, int& position)
+	{
+		unsigned int c = data[position];
+		int count = 0;
+		if (c >= 0xF0 && c <= 0xF4)
+		{
+			count = 3;
+			c &= 0x07;
+		}
+		else if (c >= 0xE0)
+		{
+			count = (c < 0xF0 ? 2 : 0);
+			c &= 0x0F;
+		}
+		else if (c >= 0xC2)
+		{
+			count = 1;
+			c &= 0x1F;
+		}
+		if (count == 0 || position + count >= size)
+		{
+			++position;
+			return data[position - 1];
+		}
+		for_iter (i, 1, count + 1)
+		{
+			if ((data[position + i] & 0xC0) != 0x80)
+			{
+				++position;
+				return data[position - 1];
+			}
+			c = (c << 6) | (data[position + i] & 0x3F);
+		}
+		position += count + 1;
+		return c;
+	}
+
+	static int _writeUtf8(unsigned int code, char* output)
+	{
+		if (code < 0x80)
+		{
+			output[0] = (char)code;
+			return 1;
+		}
+		if (code < 0x800)
+		{
+			output[0] = (char)(0xC0 | (code >> 6));
+			output[1] = (char)(0x80 | (code & 0x3F));
+			return 2;
+		}
+		if (code < 0x10000)
+		{
+			output[0] = (char)(0xE0 | (code >> 12));
+			output[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+			output[2] = (char)(0x80 | (code & 0x3F));
+			return 3;
+		}
+		output[0] = (char)(0xF0 | (code >> 18));
+		output[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+		output[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+		output[3] = (char)(0x80 | (code & 0x3F));
+		return 4;
+	}
+
+	// ASCII characters that have an entity, everything else below 0x80 is copied as it is
+	static inline bool _isHtmlSpecial(unsigned char c)
+	{
+		return (c == '"' || c == '&' || c == '\'' || c == '<' || c == '>');
+	}
+
+	hstr encodeHtmlEntities(chstr string)
 	{
-		harray<hstr> result; // adding stuff to an array is much faster than concatenating strings
-		hstr entity;
+		const unsigned char* data = (const unsigned char*)string.cStr();
+		int size = string.size();
+		// the exact size is calculated first so the result can be written into a single buffer
+		int resultSize = 0;
+		int position = 0;
 		int start = 0;
-		int index = 0;
-		while (start <= string.size())
+		unsigned int code = 0;
+		const char* name = NULL;
+		char number[16] = {'\0'};
+		int length = 0;
+		while (position < size)
+		{
+			if (data[position] < 0x80 && !_isHtmlSpecial(data[position]))
+			{
+				++position;
+				++resultSize;
+				continue;
+			}
+			start = position;
+			code = _readUtf8(data, size, position);
+			name = _findHtmlEntityName(code);
+			if (name != NULL)
+			{
+				resultSize += (int)strlen(name) + 2;
+			}
+			else if (code > 0xFF)
+			{
+				resultSize += sprintf(number, "&#%u;", code);
+			}
+			else
+			{
+				resultSize += position - start;
+			}
+		}
+		if (resultSize == size)
+		{
+			return string;
+		}
+		char* output = new char[resultSize];
+		int written = 0;
+		position = 0;
+		while (position < size)
 		{
-			index = string.indexOf('&', start);
-			if (index < 0)
+			// runs of characters that don't need any escaping are copied at once
+			start = position;
+			while (position < size && data[position] < 0x80 && !_isHtmlSpecial(data[position]))
+			{
+				++position;
+			}
+			if (position > start)
+			{
+				memcpy(&output[written], &data[start], position - start);
+				written += position - start;
+			}
+			if (position >= size)
 			{
 				break;
 			}
-			result += string(start, index - start);
-			start = index + 1;
-			index = string.indexOf(';', start);
-			if (index < 0)
+			start = position;
+			code = _readUtf8(data, size, position);
+			name = _findHtmlEntityName(code);
+			if (name != NULL)
+			{
+				output[written] = '&';
+				++written;
+				length = (int)strlen(name);
+				memcpy(&output[written], name, length);
+				written += length;
+				output[written] = ';';
+				++written;
+			}
+			else if (code > 0xFF)
+			{
+				length = sprintf(number, "&#%u;", code);
+				memcpy(&output[written], number, length);
+				written += length;
+			}
+			else
+			{
+				memcpy(&output[written], &data[start], position - start);
+				written += position - start;
+			}
+		}
+		hstr result(output, written);
+		delete[] output;
+		return result;
+	}
+
+	hstr decodeHtmlEntities(chstr string)
+	{
+		const char* data = string.cStr();
+		int size = string.size();
+		const char* ampersand = (const char*)memchr(data, '&', size);
+		if (ampersand == NULL)
+		{
+			return string;
+		}
+		// decoding never makes the string longer
+		char* output = new char[size];
+		int written = 0;
+		int start = 0;
+		int index = (int)(ampersand - data);
+		int end = 0;
+		unsigned int code = 0;
+		bool decoded = false;
+		bool hex = false;
+		int digits = 0;
+		while (true)
+		{
+			memcpy(&output[written], &data[start], index - start);
+			written += index - start;
+			start = index;
+			ampersand = (const char*)memchr(&data[index + 1], ';', size - index - 1);
+			if (ampersand == NULL)
 			{
-				result += '&';
 				break;
 			}
-			entity = string(start, index - start);
-			start = index + 1;
-			if (entity.startsWith('#'))
+			end = (int)(ampersand - data);
+			decoded = false;
+			if (data[index + 1] == '#')
 			{
-				if (entity[1] != 'x')
+				code = 0;
+				hex = (end > index + 2 && (data[index + 2] == 'x' || data[index + 2] == 'X'));
+				digits = index + (hex ? 3 : 2);
+				decoded = (end > digits);
+				for_iter (i, digits, end)
 				{
-					result += hstr::fromUnicode((unsigned int)entity(1, -1));
+					if (hex ? !isxdigit((unsigned char)data[i]) : (data[i] < '0' || data[i] > '9'))
+					{
+						decoded = false;
+						break;
+					}
+					// larger values only have their digits checked
+					if (code <= 0x10FFFF)
+					{
+						code = code * (hex ? 16 : 10) + (isdigit((unsigned char)data[i]) ? data[i] - '0' : (tolower((unsigned char)data[i]) - 'a' + 10));
+					}
 				}
-				else
+				// like in browsers, NUL, surrogates and values outside of Unicode become the replacement character
+				if (decoded && (code == 0 || (code >= 0xD800 && code <= 0xDFFF) || code > 0x10FFFF))
 				{
-					result += hstr::fromUnicode(entity(2, -1).unhex());
+					code = 0xFFFD;
 				}
 			}
-			else if (reverseMapping.hasKey(entity))
+			else
 			{
-				result += reverseMapping[entity];
+				decoded = _findHtmlEntityCode(&data[index + 1], end - index - 1, code);
 			}
-			else
+			if (decoded)
+			{
+				written += _writeUtf8(code, &output[written]);
+			}
+			else // not decoded
 			{
-				result += "&" + entity + ";"; // not decoded
+				memcpy(&output[written], &data[index], end + 1 - index);
+				written += end + 1 - index;
+			}
+			start = end + 1;
+			ampersand = (const char*)memchr(&data[start], '&', size - start);
+			if (ampersand == NULL)
+			{
+				break;
 			}
+			index = (int)(ampersand - data);
 		}
-		result += string(start, -1);
-		return result.joined("");
+		memcpy(&output[written], &data[start], size - start);
+		written += size - start;
+		hstr result(output, written);
+		delete[] output;
+		return result;
 	}
 
 }